@@ -0,0 +1,6 @@
+#!/bin/sh
+set -e
+
+echo "Building and running decoder benchmarks..."
+gcc -O2 -I./main -DTEST_MODE -o main/bench_codecs main/bench_codecs.c main/ima_adpcm.c main/flac_decoder.c main/sd_fault.c main/test_flac_encoder.c -lm
+./main/bench_codecs
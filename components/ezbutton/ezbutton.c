@@ -1,10 +1,44 @@
 #include "ezbutton.h"
+
+#ifndef TEST_MODE
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+static unsigned long default_millis(void) {
+    return pdTICKS_TO_MS(xTaskGetTickCount());
+}
+
+static int default_read_pin(int pin) {
+    return gpio_get_level(pin);
+}
+#else
+#define ESP_LOGE(tag, format, ...) printf("[ERROR] " format "\n", ##__VA_ARGS__)
+
+// Host builds install their own clock and pins with ezButton_setIO()
+static unsigned long default_millis(void) {
+    return 0;
+}
+
+static int default_read_pin(int pin) {
+    (void)pin;
+    return 1;
+}
+#endif
+
 static const char *TAG = "ezbutton";
 
+static const ezButton_io_t default_io = { default_millis, default_read_pin };
+static const ezButton_io_t *button_io = &default_io;
+
+void ezButton_setIO(const ezButton_io_t* io) {
+    button_io = io ? io : &default_io;
+}
+
+unsigned long ezButton_millis(void) {
+    return button_io->millis();
+}
+
 ezButton_t* ezButton_create(int pin, int mode) {
     ezButton_t* button = malloc(sizeof(ezButton_t));
     if (!button) {
@@ -17,22 +51,22 @@ ezButton_t* ezButton_create(int pin, int mode) {
     button->count = 0;
     button->countMode = EZBUTTON_COUNT_FALLING;
     
-    // Configure the GPIO
-    gpio_config_t io_conf = {};
-    io_conf.pin_bit_mask = (1ULL << pin);
-    io_conf.mode = GPIO_MODE_INPUT;
-    
     if (mode == EZBUTTON_PULLUP) {
-        io_conf.pull_up_en = true;
-        io_conf.pull_down_en = false;
         button->pressedState = 0;   // Active low
         button->unpressedState = 1; // Pulled up
     } else { // EZBUTTON_PULLDOWN
-        io_conf.pull_up_en = false;
-        io_conf.pull_down_en = true;
         button->pressedState = 1;   // Active high
         button->unpressedState = 0; // Pulled down
     }
+
+#ifndef TEST_MODE
+    // Configure the GPIO
+    gpio_config_t io_conf = {};
+    io_conf.pin_bit_mask = (1ULL << pin);
+    io_conf.mode = GPIO_MODE_INPUT;
+    
+    io_conf.pull_up_en = (mode == EZBUTTON_PULLUP);
+    io_conf.pull_down_en = (mode != EZBUTTON_PULLUP);
     
     esp_err_t ret = gpio_config(&io_conf);
     if (ret != ESP_OK) {
@@ -40,9 +74,10 @@ ezButton_t* ezButton_create(int pin, int mode) {
         free(button);
         return NULL;
     }
+#endif
     
     // Initial state
-    button->previousSteadyState = gpio_get_level(pin);
+    button->previousSteadyState = button_io->read_pin(pin);
     button->lastSteadyState = button->previousSteadyState;
     button->lastFlickerableState = button->previousSteadyState;
     
@@ -79,7 +114,7 @@ int ezButton_getState(ezButton_t* button) {
 
 int ezButton_getStateRaw(ezButton_t* button) {
     if (!button) return -1;
-    return gpio_get_level(button->pin);
+    return button_io->read_pin(button->pin);
 }
 
 bool ezButton_isPressed(ezButton_t* button) {
@@ -105,7 +140,7 @@ bool ezButton_isLongPressed(ezButton_t* button) {
     
     // If button is currently pressed and we're past the long press time
     if (button->lastSteadyState == button->pressedState) {
-        unsigned long currentTime = pdTICKS_TO_MS(xTaskGetTickCount());
+        unsigned long currentTime = button_io->millis();
         if (!button->isLongDetected && 
             (currentTime - button->pressStartTime) > button->longPressTime) {
             button->isLongDetected = true;
@@ -143,8 +178,8 @@ void ezButton_loop(ezButton_t* button) {
     if (!button) return;
     
     // Read the current state of the button
-    int currentState = gpio_get_level(button->pin);
-    unsigned long currentTime = pdTICKS_TO_MS(xTaskGetTickCount());
+    int currentState = button_io->read_pin(button->pin);
+    unsigned long currentTime = button_io->millis();
     
     // If the switch/button changed, due to noise or pressing
     if (currentState != button->lastFlickerableState) {
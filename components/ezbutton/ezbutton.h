@@ -4,9 +4,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#ifndef TEST_MODE
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
 #include "esp_system.h"
+#endif
 
 // Button count modes
 #define EZBUTTON_COUNT_FALLING 0
@@ -17,6 +19,14 @@
 #define EZBUTTON_PULLUP   1
 #define EZBUTTON_PULLDOWN 2
 
+/**
+ * Time and pin sources shared by all buttons
+ */
+typedef struct {
+    unsigned long (*millis)(void);  // Milliseconds since start
+    int (*read_pin)(int pin);       // Raw level of a pin
+} ezButton_io_t;
+
 /**
  * ezButton structure for ESP32
  */
@@ -148,4 +158,20 @@ void ezButton_resetCount(ezButton_t* button);
  */
 void ezButton_loop(ezButton_t* button);
 
+/**
+ * Replace the time and pin sources (default is the FreeRTOS tick count and gpio_get_level)
+ *
+ * Host harnesses install a virtual clock and scripted pin levels here.
+ *
+ * @param io Sources to use, or NULL to restore the defaults
+ */
+void ezButton_setIO(const ezButton_io_t* io);
+
+/**
+ * Current time from the installed clock
+ *
+ * @return Milliseconds since start
+ */
+unsigned long ezButton_millis(void);
+
 #endif /* EZBUTTON_H */
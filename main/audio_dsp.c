@@ -0,0 +1,164 @@
+#include "audio_dsp.h"
+#include <string.h>
+#include <math.h>
+
+// Quarter sine wave, 64 segments, Q15. sin(x) fades in, sin(pi/2 - x) fades out.
+static const int32_t quarter_sine[65] = {
+        0,   804,  1608,  2411,  3212,  4011,  4808,  5602,
+     6393,  7180,  7962,  8740,  9512, 10279, 11039, 11793,
+    12540, 13279, 14010, 14733, 15447, 16151, 16846, 17531,
+    18205, 18868, 19520, 20160, 20788, 21403, 22006, 22595,
+    23170, 23732, 24279, 24812, 25330, 25833, 26320, 26791,
+    27246, 27684, 28106, 28511, 28899, 29269, 29622, 29957,
+    30274, 30572, 30853, 31114, 31357, 31581, 31786, 31972,
+    32138, 32286, 32413, 32522, 32610, 32679, 32729, 32758,
+    32768,
+};
+
+// Look up sin(phase * pi/2) where phase is Q16 in [0, 65536]
+static int32_t quarter_sine_q16(uint32_t phase) {
+    if (phase >= 65536) {
+        return AUDIO_DSP_GAIN_UNITY;
+    }
+    uint32_t idx = phase >> 10;          // 64 segments
+    int32_t frac = phase & 0x3FF;        // 10-bit fraction
+    int32_t a = quarter_sine[idx];
+    int32_t b = quarter_sine[idx + 1];
+    return a + (((b - a) * frac) >> 10);
+}
+
+int audio_dsp_supports(uint16_t bit_depth) {
+    return bit_depth == 16 || bit_depth == 24 || bit_depth == 32;
+}
+
+void audio_dsp_crossfade_gains(uint32_t pos, uint32_t len, int32_t *gain_out, int32_t *gain_in) {
+    uint32_t phase = 65536;
+    if (len > 0 && pos < len) {
+        phase = (uint32_t)(((uint64_t)pos << 16) / len);
+    }
+    *gain_in = quarter_sine_q16(phase);
+    *gain_out = quarter_sine_q16(65536 - phase);
+}
+
+// Sample access helpers for little-endian interleaved PCM
+static inline int32_t load_sample(const uint8_t *p, uint16_t bit_depth) {
+    switch (bit_depth) {
+        case 16: return (int16_t)(p[0] | (p[1] << 8));
+        case 24: return ((int32_t)((p[0] << 8) | (p[1] << 16) | ((uint32_t)p[2] << 24))) >> 8;
+        default: return (int32_t)(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+    }
+}
+
+static inline void store_sample(uint8_t *p, uint16_t bit_depth, int64_t v) {
+    switch (bit_depth) {
+        case 16:
+            if (v > INT16_MAX) v = INT16_MAX;
+            if (v < INT16_MIN) v = INT16_MIN;
+            p[0] = v & 0xFF;
+            p[1] = (v >> 8) & 0xFF;
+            break;
+        case 24:
+            if (v > 8388607) v = 8388607;
+            if (v < -8388608) v = -8388608;
+            p[0] = v & 0xFF;
+            p[1] = (v >> 8) & 0xFF;
+            p[2] = (v >> 16) & 0xFF;
+            break;
+        default:
+            if (v > INT32_MAX) v = INT32_MAX;
+            if (v < INT32_MIN) v = INT32_MIN;
+            p[0] = v & 0xFF;
+            p[1] = (v >> 8) & 0xFF;
+            p[2] = (v >> 16) & 0xFF;
+            p[3] = (v >> 24) & 0xFF;
+            break;
+    }
+}
+
+void audio_dsp_crossfade(void *incoming, const void *outgoing, size_t bytes,
+                         uint16_t bit_depth, uint16_t channels,
+                         uint32_t fade_pos, uint32_t fade_len) {
+    if (!audio_dsp_supports(bit_depth) || channels == 0) {
+        return;
+    }
+
+    size_t sample_bytes = bit_depth / 8;
+    size_t frame_bytes = sample_bytes * channels;
+    size_t frames = bytes / frame_bytes;
+    uint8_t *in = (uint8_t *)incoming;
+    const uint8_t *out = (const uint8_t *)outgoing;
+
+    // 16-bit stereo is the common case: keep it in 32-bit arithmetic
+    if (bit_depth == 16) {
+        for (size_t f = 0; f < frames; f++) {
+            int32_t g_out, g_in;
+            audio_dsp_crossfade_gains(fade_pos + f, fade_len, &g_out, &g_in);
+            for (uint16_t c = 0; c < channels; c++) {
+                int16_t a, b;
+                memcpy(&a, in, sizeof(a));
+                memcpy(&b, out, sizeof(b));
+                int32_t v = ((int32_t)a * g_in + (int32_t)b * g_out) >> 15;
+                if (v > INT16_MAX) v = INT16_MAX;
+                if (v < INT16_MIN) v = INT16_MIN;
+                a = (int16_t)v;
+                memcpy(in, &a, sizeof(a));
+                in += 2;
+                out += 2;
+            }
+        }
+        return;
+    }
+
+    for (size_t f = 0; f < frames; f++) {
+        int32_t g_out, g_in;
+        audio_dsp_crossfade_gains(fade_pos + f, fade_len, &g_out, &g_in);
+        for (uint16_t c = 0; c < channels; c++) {
+            int64_t a = load_sample(in, bit_depth);
+            int64_t b = load_sample(out, bit_depth);
+            store_sample(in, bit_depth, (a * g_in + b * g_out) >> 15);
+            in += sample_bytes;
+            out += sample_bytes;
+        }
+    }
+}
+
+int32_t audio_dsp_gain_from_db(float gain_db, float peak) {
+    float linear = powf(10.0f, gain_db / 20.0f);
+    if (peak > 0.0f && linear * peak > 1.0f) {
+        linear = 1.0f / peak;
+    }
+    float q = linear * AUDIO_DSP_GAIN_UNITY;
+    if (q > AUDIO_DSP_GAIN_MAX) {
+        return AUDIO_DSP_GAIN_MAX;
+    }
+    return (int32_t)(q + 0.5f);
+}
+
+void audio_dsp_apply_gain(void *buffer, size_t bytes, uint16_t bit_depth, int32_t gain) {
+    if (gain == AUDIO_DSP_GAIN_UNITY || !audio_dsp_supports(bit_depth)) {
+        return;
+    }
+
+    size_t sample_bytes = bit_depth / 8;
+    size_t samples = bytes / sample_bytes;
+    uint8_t *p = (uint8_t *)buffer;
+
+    if (bit_depth == 16) {
+        for (size_t i = 0; i < samples; i++) {
+            int16_t a;
+            memcpy(&a, p, sizeof(a));
+            int32_t v = (int32_t)(((int64_t)a * gain) >> 15);
+            if (v > INT16_MAX) v = INT16_MAX;
+            if (v < INT16_MIN) v = INT16_MIN;
+            a = (int16_t)v;
+            memcpy(p, &a, sizeof(a));
+            p += 2;
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < samples; i++) {
+        store_sample(p, bit_depth, ((int64_t)load_sample(p, bit_depth) * gain) >> 15);
+        p += sample_bytes;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef AUDIO_DSP_H
+#define AUDIO_DSP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Fixed-point gains are Q15: 32768 == 1.0
+#define AUDIO_DSP_GAIN_UNITY  32768
+
+// Largest gain applied to quiet tracks (+12 dB)
+#define AUDIO_DSP_GAIN_MAX    (AUDIO_DSP_GAIN_UNITY * 4)
+
+/**
+ * @brief Check whether the sample kernels support a bit depth
+ *
+ * @param bit_depth Bits per sample (16, 24 packed or 32)
+ * @return 1 if supported, 0 otherwise
+ */
+int audio_dsp_supports(uint16_t bit_depth);
+
+/**
+ * @brief Get equal-power crossfade gains for a point in the fade
+ *
+ * @param pos Current frame within the fade
+ * @param len Total fade length in frames
+ * @param gain_out Pointer to store the Q15 gain of the outgoing track
+ * @param gain_in Pointer to store the Q15 gain of the incoming track
+ */
+void audio_dsp_crossfade_gains(uint32_t pos, uint32_t len, int32_t *gain_out, int32_t *gain_in);
+
+/**
+ * @brief Mix the outgoing track into the incoming track with an equal-power crossfade
+ *
+ * The result is written back to incoming. Both buffers hold interleaved
+ * little-endian PCM of the same format.
+ *
+ * @param incoming Incoming track samples, overwritten with the mix
+ * @param outgoing Outgoing track samples
+ * @param bytes Number of bytes in each buffer
+ * @param bit_depth Bits per sample
+ * @param channels Number of channels
+ * @param fade_pos Frame position of the first frame within the fade
+ * @param fade_len Total fade length in frames
+ */
+void audio_dsp_crossfade(void *incoming, const void *outgoing, size_t bytes,
+                         uint16_t bit_depth, uint16_t channels,
+                         uint32_t fade_pos, uint32_t fade_len);
+
+/**
+ * @brief Convert a loudness gain to a Q15 factor with peak-aware clipping protection
+ *
+ * The gain is lowered so that peak * gain never exceeds full scale.
+ *
+ * @param gain_db Gain in dB
+ * @param peak Linear peak amplitude of the material (1.0 == full scale), 0 if unknown
+ * @return Q15 gain factor, at most AUDIO_DSP_GAIN_MAX
+ */
+int32_t audio_dsp_gain_from_db(float gain_db, float peak);
+
+/**
+ * @brief Scale interleaved PCM samples in place by a Q15 gain, saturating at full scale
+ *
+ * @param buffer Samples to scale
+ * @param bytes Number of bytes in the buffer
+ * @param bit_depth Bits per sample
+ * @param gain Q15 gain factor
+ */
+void audio_dsp_apply_gain(void *buffer, size_t bytes, uint16_t bit_depth, int32_t gain);
+
+#endif // AUDIO_DSP_H
@@ -10,67 +10,20 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "driver/i2s_std.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
 #else
 #define ESP_LOGI(tag, format, ...) printf("[INFO] " format "\n", ##__VA_ARGS__)
 #define ESP_LOGE(tag, format, ...) printf("[ERROR] " format "\n", ##__VA_ARGS__)
 #define ESP_LOGW(tag, format, ...) printf("[WARN] " format "\n", ##__VA_ARGS__)
+#define esp_random() ((uint32_t)rand())
 
-// Mock FreeRTOS types and definitions for test mode
-typedef void* TaskHandle_t;
-typedef void* QueueHandle_t;
-typedef int BaseType_t;
-typedef void* i2s_chan_handle_t;
-typedef struct { int dummy; } i2s_chan_config_t;
-typedef struct { 
-    struct {
-        int sample_rate_hz;
-        int clk_src;
-        int mclk_multiple;
-    } clk_cfg;
-    struct {
-        int data_bit_width;
-        int slot_bit_width; 
-        int slot_mode;
-        int slot_mask;
-        int ws_width;
-        bool ws_pol;
-        bool bit_shift;
-    } slot_cfg;
-    struct { 
-        int bclk; 
-        int ws; 
-        int dout; 
-        int din; 
-        int mclk; 
-    } gpio_cfg;
-} i2s_std_config_t;
-typedef int i2s_data_bit_width_t;
-typedef int i2s_slot_mode_t;
-
-#define pdPASS 1
-#define pdTRUE 1
-#define pdMS_TO_TICKS(ms) (ms)
-#define portMAX_DELAY 0xFFFFFFFF
-#define tskIDLE_PRIORITY 0
-#define I2S_CHANNEL_DEFAULT_CONFIG(port, role) {0}
-#define I2S_PORT 0
-#define I2S_ROLE_MASTER 0
-#define I2S_NUM_0 0
-#define I2S_CLK_SRC_DEFAULT 0
-#define I2S_MCLK_MULTIPLE_256 0
-#define I2S_DATA_BIT_WIDTH_8BIT 0
-#define I2S_DATA_BIT_WIDTH_16BIT 1
-#define I2S_DATA_BIT_WIDTH_24BIT 2
-#define I2S_DATA_BIT_WIDTH_32BIT 3
-#define I2S_SLOT_BIT_WIDTH_16BIT 1
-#define I2S_SLOT_BIT_WIDTH_32BIT 3
-#define I2S_SLOT_MODE_MONO 1
-#define I2S_SLOT_MODE_STEREO 0
-#define I2S_STD_SLOT_BOTH 0
-#define I2S_GPIO_UNUSED -1
+#include "host_rtos.h"
 
+#ifndef HOST_SIM
 // Mock FreeRTOS functions
 QueueHandle_t xQueueCreate(int items, int size) { return (void*)1; }
 void vQueueDelete(QueueHandle_t queue) {}
@@ -80,6 +33,14 @@ BaseType_t xTaskCreate(void* func, const char* name, int stack, void* param, int
     *handle = (void*)1; 
     return pdPASS; 
 }
+BaseType_t xTaskCreatePinnedToCore(void* func, const char* name, int stack, void* param, int priority,
+                                   TaskHandle_t* handle, int core) {
+    return xTaskCreate(func, name, stack, param, priority, handle);
+}
+SemaphoreHandle_t xSemaphoreCreateBinary(void) { return (void*)1; }
+int xSemaphoreTake(SemaphoreHandle_t sem, int timeout) { return pdTRUE; }
+int xSemaphoreGive(SemaphoreHandle_t sem) { return pdTRUE; }
+void vSemaphoreDelete(SemaphoreHandle_t sem) {}
 void vTaskDelay(int ticks) {}
 void vTaskDelete(TaskHandle_t task) {}
 
@@ -93,14 +54,36 @@ esp_err_t i2s_channel_write(i2s_chan_handle_t handle, const void* src, size_t si
     *bytes_written = size;
     return ESP_OK;
 }
+esp_err_t i2s_channel_register_event_callback(i2s_chan_handle_t handle, const i2s_event_callbacks_t *callbacks,
+                                              void *user_data) {
+    return ESP_OK;
+}
+#endif // HOST_SIM
 
 // Mock neopixel function
 esp_err_t neopixel_indicate_mode(int mode) { return ESP_OK; }
+
+// Mock esp_timer function
+int64_t esp_timer_get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 #endif
 
 #include "sd_card.h"
 #include "pcm_file.h"
+#include "track_cache.h"
+#include "mem_policy.h"
 #include "json_parser.h"
+#include "library_scanner.h"
+#include "index_cache.h"
+#include "shuffle.h"
+#include "quarantine.h"
+#include "playlist.h"
+#include "track_order.h"
+#include "boot_profile.h"
+#include "audio_dsp.h"
 #ifndef TEST_MODE
 #include "neopixel.h"
 #endif
@@ -117,34 +100,188 @@ static const char *TAG = "audio_player";
 #define I2S_SAMPLE_RATE       44100
 #define I2S_BITS_PER_SAMPLE   16
 #define I2S_CHANNELS          2
-#define I2S_DMA_BUFFER_COUNT  8
-#define I2S_DMA_BUFFER_LEN    1024
 
-// Audio buffer size
-#define AUDIO_BUFFER_SIZE     4096
+// I2S DMA queue at boot, the driver defaults; retuned with audio_player_set_dma_buffers()
+#define I2S_DMA_DESC_NUM      6
+#define I2S_DMA_FRAME_NUM     240
+
+// Audio buffer size; each read asks for read_size bytes of it
+#define AUDIO_BUFFER_SIZE     AUDIO_PLAYER_READ_SIZE_MAX
+
+// Trace events held until the console drains them
+#define TRACE_EVENTS          64
+
+// Core the player task (SD reads and I2S writes) runs on, away from the MP3 decoder
+#define PLAYER_TASK_CORE      0
+
+// The index loads on the other core while the saved track already plays
+#define INDEX_TASK_CORE       1
+#define INDEX_TASK_STACK      8192
+
+// Crossfade limits. A crossfade reads two streams per output chunk. The
+// outgoing one is partly read ahead before the fade, so the measured SD
+// throughput, less the headroom, must cover the rest of both streams.
+#define CROSSFADE_MAX_SECONDS         10
+#define CROSSFADE_THROUGHPUT_PCT      150
+#define CROSSFADE_AHEAD_MAX           (32 * 1024)
+#define CROSSFADE_AHEAD_MAX_PSRAM     (256 * 1024)
+
+// How long a caller waits for the player task to carry out a seek
+#define SEEK_TIMEOUT_MS       2000
 
 // State file path
 #define STATE_FILE_PATH       "/ESP32_MUSIC/player_state.bin"
 
+// A removed card is tried again this often until it mounts
+#define CARD_RETRY_MS         1000
+// How often a wired card-detect switch is read
+#define CARD_DETECT_POLL_MS   500
+
 // Player state and buffers
 static player_state_t player_state;
-static uint8_t audio_buffer[AUDIO_BUFFER_SIZE];
+static uint8_t audio_buffer[AUDIO_BUFFER_SIZE] __attribute__((aligned(4)));
 static pcm_file_t current_pcm_file;
 static index_file_t music_index;
+static char music_index_path[256];
+
+// Filled by the index task, with the playlists and sort orders resolved
+// against it, and handed to the player task with CMD_INDEX_READY. Until then
+// music_index is empty and track navigation is refused.
+static index_file_t pending_index;
+static playlist_set_t pending_playlists;
+static track_order_t pending_orders;
+static volatile bool index_ready = false;
+// Set while the index task loads; a reload asked for meanwhile runs after it
+static bool index_loading = false;
+// The index task still has files on the card open
+static volatile bool index_reading = false;
+static bool index_reloading = false;
+static bool reload_queued = false;
+// The index being loaded was just written by a library scan, so an empty one
+// is not scanned again
+static bool index_scanned = false;
+static bool queued_scanned = false;
+// A flash cache store of the pending index, and of music_index once it is
+// installed, put off until no audio plays
+static bool pending_store_due = false;
+static index_cache_key_t pending_store_key;
+static bool cache_store_due = false;
+static index_cache_key_t cache_store_key;
+
+// Reset-to-first-audio is logged once, at the first buffer handed to I2S DMA
+static bool first_audio_logged = false;
+
+// Crossfade state: the outgoing track keeps playing from fading_pcm_file
+// while current_pcm_file already holds the incoming track
+static uint16_t crossfade_seconds = 0;
+static pcm_file_t fading_pcm_file;
+static uint8_t fade_buffer[AUDIO_BUFFER_SIZE] __attribute__((aligned(4)));
+static bool crossfade_active = false;
+static bool crossfade_declined = false;
+static uint32_t crossfade_pos = 0;
+static uint32_t crossfade_len = 0;
+
+// Read-ahead of the track about to fade out, a ring filled with the SD time
+// left over after each chunk before its fade window. Every read of that
+// track drains the ring first, so the fade mostly reads the incoming track.
+static uint8_t *fade_ahead = NULL;
+static size_t fade_ahead_size = 0;
+static size_t fade_ahead_start = 0;     // Oldest byte held
+static size_t fade_ahead_count = 0;     // Bytes held
+static size_t fade_ahead_target = 0;    // Bytes the spare SD time has allowed to hold so far
+static size_t fade_ahead_planned = 0;   // Bytes the fade needs held, fixed when the ring is taken
+static size_t fade_ahead_step = 0;      // Growth of the target per chunk played
+static const pcm_file_t *fade_ahead_of = NULL;
+
+// Loudness normalization gains (Q15) of the current and the outgoing track
+static int32_t current_gain = AUDIO_DSP_GAIN_UNITY;
+static int32_t fading_gain = AUDIO_DSP_GAIN_UNITY;
+
+// Measured SD read throughput in bytes per second: moving averages of the
+// bytes and the time per read, so reads served from RAM do not hide slow ones
+static uint32_t sd_read_bps = 0;
+static uint32_t read_avg_bytes = 0;
+static uint32_t read_avg_us = 0;
+
+// Runtime tuning. The DMA queue is only changed by the player task.
+static uint32_t dma_desc_num = I2S_DMA_DESC_NUM;
+static uint32_t dma_frame_num = I2S_DMA_FRAME_NUM;
+static volatile size_t read_size = AUDIO_BUFFER_SIZE;
+
+// Telemetry published by the player task for audio_player_get_stats()
+static volatile uint32_t pcm_reads = 0;
+static uint32_t read_worst_us = 0;
+static volatile size_t ring_fill = 0;
+
+// Underruns are counted once per starvation, and only after the player fed
+// the queue during playback; pauses, seeks and channel restarts don't count
+static volatile uint32_t underruns = 0;
+static volatile bool output_armed = false;
+static volatile bool output_starved = true;
+
+// Per-read trace events for a single reader; the indices only grow
+static audio_player_trace_t trace_events[TRACE_EVENTS];
+static uint32_t trace_head = 0;
+static uint32_t trace_tail = 0;
+static uint32_t trace_dropped = 0;
+static volatile bool trace_enabled = false;
 
 // Task handle for audio player
 static TaskHandle_t player_task_handle = NULL;
 static QueueHandle_t player_cmd_queue = NULL;
 
-// Random seed initialized
-static bool random_seed_initialized = false;
+// Seek results, sent back by the player task with the number of the request.
+// Callers take seek_lock, so a reply with another number is a late one to a
+// seek that timed out.
+typedef struct {
+    uint32_t seq;
+    esp_err_t result;
+} seek_reply_t;
+
+#define SEEK_REPLY_DEPTH      4
+
+static QueueHandle_t seek_replies = NULL;
+static SemaphoreHandle_t seek_lock = NULL;
+static uint32_t seek_seq = 0;
 
-// Shuffle state
-static int *shuffle_indices = NULL;
-static int shuffle_count = 0;
-static int shuffle_pos = 0;
-// Forward declaration for shuffle list update
+// Playback clock of the current track, published by the player task
+static volatile uint32_t playback_position_ms = 0;
+static volatile uint32_t playback_duration_ms = 0;
+
+// Rough size of one allFiles plus one folder entry in index.json
+#define INDEX_JSON_BYTES_PER_TRACK  600
+
+// Track-head prefetch: the neighbours a skip lands on, warmed one per loop
+// pass so a head read never delays more than one audio buffer
+#define PREFETCH_NEIGHBOURS   2
+static const int prefetch_steps[PREFETCH_NEIGHBOURS] = {1, -1};
+static int prefetch_step = PREFETCH_NEIGHBOURS;
+
+// Shuffle order of the current mode; the seed and position live in player_state
+static shuffle_t shuffle;
+static bool shuffle_active = false;
+
+// Tracks that failed to open on a present card, by allFiles position; every
+// mode steps over them until the index is loaded again
+static quarantine_t quarantine;
+
+// Playlists of the card, resolved against music_index; the folder modes
+// step through them after the index folders
+static playlist_set_t playlists;
+
+// Artist and album orders of music_index, sorted once per load. In the
+// sorted modes current_file_index is a rank in one of them.
+static track_order_t track_orders;
+
+// Set from the moment the card is found missing until it mounts again
+static bool card_missing = false;
+static bool card_released = true;           // Unmounted since it went missing
+static int64_t card_poll_us = 0;            // Next remount attempt
+static int64_t card_watch_us = 0;           // Next look at the detect switch
+static volatile uint32_t card_removals = 0;
+// Forward declarations for shuffle order updates
 static void update_shuffle_list(void);
+static void reseed_shuffle(void);
 
 // Player commands
 typedef enum {
@@ -156,9 +293,23 @@ typedef enum {
     CMD_NEXT_FOLDER,
     CMD_PREV_FOLDER,
     CMD_CHANGE_MODE,
+    CMD_SEEK,
+    CMD_RELOAD_INDEX,
+    CMD_INDEX_READY,
+    CMD_PLAY_INDEX,
+    CMD_RETUNE_OUTPUT,
     CMD_QUIT
 } player_cmd_t;
 
+// Queue message: a command and its argument
+typedef struct {
+    player_cmd_t cmd;
+    uint32_t arg;           // CMD_SEEK: target position in ms, CMD_PLAY_INDEX: track,
+                            // CMD_CHANGE_MODE: new mode, CMD_RELOAD_INDEX: 1 after a library scan,
+                            // CMD_RETUNE_OUTPUT: DMA buffers << 16 | frames per buffer
+    uint32_t seq;           // CMD_SEEK: request number, echoed in the reply
+} player_msg_t;
+
 // Forward declarations
 static void player_task(void *arg);
 static esp_err_t play_file(const char *filepath);
@@ -166,8 +317,26 @@ static esp_err_t select_next_file(void);
 static esp_err_t select_prev_file(void);
 static esp_err_t select_next_folder(void);
 static esp_err_t select_prev_folder(void);
+static esp_err_t play_index(int index);
+static void apply_mode(playback_mode_t mode);
+static esp_err_t load_index(index_file_t *index);
+static esp_err_t load_pending(void);
+static void install_index(esp_err_t ret);
+static void sync_to_index(void);
+#if !defined(TEST_MODE) || defined(HOST_SIM)
+static void post_index(void);
+static void index_task(void *arg);
+#endif
 static void update_current_folder_index_for_file(const char *filepath);
 static esp_err_t configure_i2s(uint32_t sample_rate, uint16_t bit_depth, uint16_t channels);
+static esp_err_t new_tx_channel(void);
+static void retune_output(uint32_t desc_num, uint32_t frame_num);
+static file_entry_t *neighbour_file(int step, bool commit);
+static void reset_quarantine(void);
+static void load_playlists(index_file_t *index, playlist_set_t *set);
+static void build_track_orders(const index_file_t *index, track_order_t *orders);
+static void card_lost(void);
+static bool card_release(void);
 
 // Add static handle for I2S TX channel
 static i2s_chan_handle_t i2s_tx_chan = NULL;
@@ -177,6 +346,23 @@ static uint32_t current_i2s_sample_rate = 0;
 static uint16_t current_i2s_bit_depth = 0;
 static uint16_t current_i2s_channels = 0;
 
+// Report how far the index and read-ahead buffers can grow with the memory at hand
+static void log_capacity(void) {
+    mem_capacity_t bulk;
+    mem_get_capacity(MEM_BULK, &bulk);
+    // Every track is held twice (allFiles and its folder) next to its share of index.json;
+    // allFiles needs a single block
+    size_t max_tracks = bulk.free_bytes / (2 * sizeof(file_entry_t) + INDEX_JSON_BYTES_PER_TRACK);
+    if (max_tracks > bulk.largest_block / sizeof(file_entry_t)) {
+        max_tracks = bulk.largest_block / sizeof(file_entry_t);
+    }
+    ESP_LOGI(TAG, "Bulk memory in %s: %u KB free, largest block %u KB", bulk.psram ? "PSRAM" : "internal RAM",
+             (unsigned)(bulk.free_bytes / 1024), (unsigned)(bulk.largest_block / 1024));
+    ESP_LOGI(TAG, "Capacity: about %u tracks, %u KB MP3 ring per stream, %u KB per prefetched track head",
+             (unsigned)max_tracks, (unsigned)(mp3_source_ring_size() / 1024),
+             (unsigned)((bulk.psram ? TRACK_CACHE_HEAD_SIZE_PSRAM : TRACK_CACHE_HEAD_SIZE) / 1024));
+}
+
 esp_err_t audio_player_init(void) {
     ESP_LOGI(TAG, "Initializing audio player");
     
@@ -187,17 +373,22 @@ esp_err_t audio_player_init(void) {
     }
 
     // Try to load state first
+    int phase = boot_profile_begin("state load");
     esp_err_t state_ret = audio_player_load_state();
+    boot_profile_end(phase);
     if (state_ret != ESP_OK) {
         // If load failed, set defaults
         player_state.mode = MODE_PLAY_ALL_ORDER;
         player_state.current_file_index = 0;
         player_state.current_folder_index = 0;
         player_state.is_playing = false;
+        player_state.shuffle_seed = esp_random();
+        player_state.shuffle_pos = 0;
         memset(player_state.current_file_path, 0, sizeof(player_state.current_file_path));
     }
 
     // Initialize I2S for audio output (fixed for ESP-IDF v5+)
+    phase = boot_profile_begin("i2s setup");
     i2s_std_config_t std_cfg = {
         .clk_cfg = {
             .sample_rate_hz = I2S_SAMPLE_RATE,
@@ -221,8 +412,7 @@ esp_err_t audio_player_init(void) {
             .din = I2S_GPIO_UNUSED
         }
     };
-    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_PORT, I2S_ROLE_MASTER);
-    esp_err_t ret = i2s_new_channel(&chan_cfg, &i2s_tx_chan, NULL);
+    esp_err_t ret = new_tx_channel();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to create I2S TX channel");
         return ret;
@@ -238,32 +428,29 @@ esp_err_t audio_player_init(void) {
         ESP_LOGE(TAG, "Failed to enable I2S TX channel");
         return ret;
     }
+    boot_profile_end(phase);
     
-    // Parse index.json file
-    char index_path[256];
+    log_capacity();
+    
+    // Locate index.json
+    char *index_path = music_index_path;
     const char* mount_point = sd_card_get_mount_point();
     
     // Debug print the mount point
     ESP_LOGI(TAG, "SD card mount point: %s", mount_point);
     
     // Use the proper long filename with the standard mount point
-    snprintf(index_path, sizeof(index_path), "%s/ESP32_MUSIC/index.json", mount_point);
+    snprintf(index_path, sizeof(music_index_path), "%s/ESP32_MUSIC/index.json", mount_point);
     
     ESP_LOGI(TAG, "Looking for index file at: %s", index_path);
     
-    // Parse the index file
-    ret = json_parse_index(index_path, &music_index);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to parse index.json file - continuing without index");
-        // Initialize an empty index to avoid null pointers
-        memset(&music_index, 0, sizeof(index_file_t));
-        // Don't return error - we'll continue without index
-    } else {
-        ESP_LOGI(TAG, "Successfully loaded index with %d files", music_index.total_files);
+    // Skips still work without the prefetch cache, just not from RAM
+    if (track_cache_init(mem_has_psram() ? TRACK_CACHE_HEAD_SIZE_PSRAM : TRACK_CACHE_HEAD_SIZE) != ESP_OK) {
+        ESP_LOGW(TAG, "Track prefetch disabled");
     }
     
     // Create command queue
-    player_cmd_queue = xQueueCreate(10, sizeof(player_cmd_t));
+    player_cmd_queue = xQueueCreate(10, sizeof(player_msg_t));
     if (player_cmd_queue == NULL) {
         ESP_LOGE(TAG, "Failed to create player command queue");
         json_free_index(&music_index);
@@ -274,18 +461,46 @@ esp_err_t audio_player_init(void) {
         return ESP_ERR_NO_MEM;
     }
     
-    // Create player task
-    BaseType_t task_created = xTaskCreate(
+    seek_replies = xQueueCreate(SEEK_REPLY_DEPTH, sizeof(seek_reply_t));
+    seek_lock = xSemaphoreCreateBinary();
+    if (seek_replies == NULL || seek_lock == NULL) {
+        ESP_LOGE(TAG, "Failed to create seek reply queue");
+        if (seek_replies) {
+            vQueueDelete(seek_replies);
+            seek_replies = NULL;
+        }
+        if (seek_lock) {
+            vSemaphoreDelete(seek_lock);
+            seek_lock = NULL;
+        }
+        vQueueDelete(player_cmd_queue);
+        json_free_index(&music_index);
+        if (i2s_tx_chan) {
+            i2s_del_channel(i2s_tx_chan);
+            i2s_tx_chan = NULL;
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(seek_lock);
+    
+    // Create player task; MP3 decoding runs on the other core
+    BaseType_t task_created = xTaskCreatePinnedToCore(
         player_task,
         "player_task",
         4096,
         NULL,
         tskIDLE_PRIORITY + 2,
-        &player_task_handle
+        &player_task_handle,
+        PLAYER_TASK_CORE
     );
+    boot_profile_task("player_task");
     
     if (task_created != pdPASS) {
         ESP_LOGE(TAG, "Failed to create player task");
+        vSemaphoreDelete(seek_lock);
+        seek_lock = NULL;
+        vQueueDelete(seek_replies);
+        seek_replies = NULL;
         vQueueDelete(player_cmd_queue);
         json_free_index(&music_index);
         if (i2s_tx_chan) {
@@ -295,17 +510,169 @@ esp_err_t audio_player_init(void) {
         return ESP_ERR_NO_MEM;
     }
 
+    // Parse the index on the other core; the player task starts the saved
+    // track meanwhile and takes the index over once it is ready
+#if !defined(TEST_MODE) || defined(HOST_SIM)
+    index_loading = true;
+    index_reading = true;
+    task_created = xTaskCreatePinnedToCore(index_task, "index_task", INDEX_TASK_STACK, NULL,
+                                           tskIDLE_PRIORITY + 1, NULL, INDEX_TASK_CORE);
+    boot_profile_task("index_task");
+    if (task_created != pdPASS) {
+        ESP_LOGW(TAG, "Failed to create index task - loading the index in place");
+        post_index();
+    }
+#else
+    // Host tests run no tasks
+    install_index(load_pending());
+#endif
+
     ESP_LOGI(TAG, "Audio player initialized successfully");
     return ESP_OK;
 }
 
+// Whether the I2S queue keeps the DAC fed through a flash sector erase
+static bool queue_outlasts_erase(void) {
+    uint32_t rate = current_i2s_sample_rate > 0 ? current_i2s_sample_rate : I2S_SAMPLE_RATE;
+    return dma_desc_num * dma_frame_num * 1000 / rate > INDEX_CACHE_ERASE_MS;
+}
+
+// Write the flash cache that load_index put off, only while no audio plays
+static void store_index_cache(void) {
+    if (!cache_store_due || (player_state.is_playing && current_pcm_file.file != NULL)) {
+        return;
+    }
+    cache_store_due = false;
+    ESP_LOGI(TAG, "No audio playing - writing the index cache");
+    index_cache_store(&cache_store_key, &music_index);
+}
+
+// Load index.json, from the flash image when it was built from the same file
+static esp_err_t load_index(index_file_t *index) {
+    int64_t start = esp_timer_get_time();
+    int phase = boot_profile_begin("index load");
+    index_cache_key_t key;
+    bool keyed = index_cache_key(music_index_path, &key) == ESP_OK;
+    if (keyed && index_cache_load(&key, index) == ESP_OK) {
+        ESP_LOGI(TAG, "Index ready in %lld ms (flash cache hit)", (long long)((esp_timer_get_time() - start) / 1000));
+        boot_profile_end(phase);
+        return ESP_OK;
+    }
+
+    esp_err_t ret = json_parse_index(music_index_path, index);
+    boot_profile_end(phase);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ESP_LOGI(TAG, "Index ready in %lld ms (parsed from the card%s)",
+             (long long)((esp_timer_get_time() - start) / 1000), index->pager != NULL ? ", paged" : "");
+    if (keyed && index->pager == NULL) {
+        if (queue_outlasts_erase()) {
+            index_cache_store(&key, index);
+        } else {
+            // Written by the player task once no audio plays
+            pending_store_key = key;
+            pending_store_due = true;
+        }
+    }
+    return ESP_OK;
+}
+
+// Load the index with its playlists and sort orders into the pending slots;
+// the M3U reads and the sorts stay off the player task
+static esp_err_t load_pending(void) {
+    esp_err_t ret = load_index(&pending_index);
+    if (ret == ESP_OK) {
+        load_playlists(&pending_index, &pending_playlists);
+        build_track_orders(&pending_index, &pending_orders);
+    }
+    return ret;
+}
+
+#if !defined(TEST_MODE) || defined(HOST_SIM)
+// Load the pending index and hand it to the player task
+static void post_index(void) {
+    player_msg_t msg = {.cmd = CMD_INDEX_READY, .arg = (uint32_t)load_pending()};
+    index_reading = false;
+    if (xQueueSend(player_cmd_queue, &msg, portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to send index ready command to queue");
+    }
+}
+
+static void index_task(void *arg) {
+    post_index();
+    vTaskDelete(NULL);
+}
+#endif
+
+// Swap the pending index, playlists and orders in and enable navigation,
+// freeing the ones they replace. An index that failed to load leaves the
+// current one in use. Without a usable index on the card, one is built in
+// the background and picked up when done.
+static void install_index(esp_err_t ret) {
+    bool reload = index_reloading;
+    bool scanned = index_scanned;
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "%s index with %d files", reload ? "Reloaded" : "Successfully loaded", pending_index.total_files);
+        json_free_index(&music_index);
+        music_index = pending_index;
+        playlist_free(&playlists);
+        playlists = pending_playlists;
+        track_order_free(&track_orders);
+        track_orders = pending_orders;
+        cache_store_due = pending_store_due;
+        cache_store_key = pending_store_key;
+        reset_quarantine();
+    } else {
+        if (reload) {
+            ESP_LOGE(TAG, "Failed to reload index.json - keeping the current index");
+        } else {
+            ESP_LOGE(TAG, "Failed to parse index.json file - continuing without index");
+        }
+        json_free_index(&pending_index);
+        playlist_free(&pending_playlists);
+        track_order_free(&pending_orders);
+    }
+    memset(&pending_index, 0, sizeof(index_file_t));
+    memset(&pending_playlists, 0, sizeof(playlist_set_t));
+    memset(&pending_orders, 0, sizeof(track_order_t));
+    pending_store_due = false;
+    index_ready = true;
+    index_loading = false;
+    index_reloading = false;
+    index_scanned = false;
+    // A card that went missing meanwhile is scanned once it is back
+    if (!scanned && !card_missing && (ret != ESP_OK || music_index.total_files == 0)) {
+        ESP_LOGW(TAG, "Index missing or empty - scanning the library");
+        audio_player_rescan_library();
+    }
+}
+
+static void on_library_scanned(esp_err_t result, const library_scan_stats_t *stats, void *arg) {
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "Library scan failed - keeping the current index");
+        return;
+    }
+    player_msg_t msg = {.cmd = CMD_RELOAD_INDEX, .arg = 1};
+    if (xQueueSend(player_cmd_queue, &msg, portMAX_DELAY) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to send reload command to queue");
+    }
+}
+
+esp_err_t audio_player_rescan_library(void) {
+    if (player_cmd_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return library_scanner_start(on_library_scanned, NULL);
+}
+
 esp_err_t audio_player_start(void) {
     if (player_cmd_queue == NULL) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    player_cmd_t cmd = CMD_PLAY;
-    if (xQueueSend(player_cmd_queue, &cmd, pdMS_TO_TICKS(100)) != pdTRUE) {
+    player_msg_t msg = {.cmd = CMD_PLAY};
+    if (xQueueSend(player_cmd_queue, &msg, pdMS_TO_TICKS(100)) != pdTRUE) {
         ESP_LOGE(TAG, "Failed to send play command to queue");
         return ESP_FAIL;
     }
@@ -318,8 +685,8 @@ esp_err_t audio_player_stop(void) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    player_cmd_t cmd = CMD_STOP;
-    if (xQueueSend(player_cmd_queue, &cmd, pdMS_TO_TICKS(100)) != pdTRUE) {
+    player_msg_t msg = {.cmd = CMD_STOP};
+    if (xQueueSend(player_cmd_queue, &msg, pdMS_TO_TICKS(100)) != pdTRUE) {
         ESP_LOGE(TAG, "Failed to send stop command to queue");
         return ESP_FAIL;
     }
@@ -327,29 +694,75 @@ esp_err_t audio_player_stop(void) {
     return ESP_OK;
 }
 
-esp_err_t audio_player_seek(size_t byte_pos) {
-    if (current_pcm_file.file == NULL) {
-        ESP_LOGW(TAG, "No file is currently open for seeking");
-        return ESP_ERR_INVALID_STATE;
+// Answer seek request seq from the player task. A full queue only holds
+// replies nobody waits for any more, so this one is dropped too.
+static void reply_seek(uint32_t seq, esp_err_t result) {
+    seek_reply_t reply = {.seq = seq, .result = result};
+    xQueueSend(seek_replies, &reply, 0);
+}
+
+// Wait for the reply to seek request seq, dropping late ones to earlier requests
+static esp_err_t seek_wait(uint32_t seq, uint32_t position_ms) {
+    int64_t deadline = esp_timer_get_time() + (int64_t)SEEK_TIMEOUT_MS * 1000;
+    for (;;) {
+        int64_t left_us = deadline - esp_timer_get_time();
+        seek_reply_t reply = {0};
+        if (left_us <= 0 ||
+            xQueueReceive(seek_replies, &reply, pdMS_TO_TICKS((left_us + 999) / 1000)) != pdTRUE) {
+            ESP_LOGE(TAG, "Seek to %u ms timed out", position_ms);
+            return ESP_FAIL;
+        }
+        if (reply.seq == seq) {
+            return reply.result;
+        }
     }
+}
 
-    esp_err_t ret = pcm_file_seek(&current_pcm_file, byte_pos);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to seek to position %zu", byte_pos);
-        return ret;
+esp_err_t audio_player_seek_ms(uint32_t position_ms) {
+    if (player_cmd_queue == NULL || seek_replies == NULL || seek_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    if (xSemaphoreTake(seek_lock, pdMS_TO_TICKS(SEEK_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGE(TAG, "Seek to %u ms timed out behind another seek", position_ms);
+        return ESP_FAIL;
     }
+    player_msg_t msg = {.cmd = CMD_SEEK, .arg = position_ms, .seq = ++seek_seq};
+    esp_err_t ret;
+    if (xQueueSend(player_cmd_queue, &msg, pdMS_TO_TICKS(100)) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to send seek command to queue");
+        ret = ESP_FAIL;
+    } else {
+        ret = seek_wait(msg.seq, position_ms);
+    }
+    xSemaphoreGive(seek_lock);
+    return ret;
+}
 
-    ESP_LOGI(TAG, "Seeked to byte position %zu", byte_pos);
-    return ESP_OK;
+uint32_t audio_player_get_position_ms(void) {
+    return playback_position_ms;
+}
+
+uint32_t audio_player_get_duration_ms(void) {
+    return playback_duration_ms;
+}
+
+// Track and mode changes need the index; refuse them while it loads
+static bool navigation_ready(void) {
+    if (!index_ready) {
+        ESP_LOGW(TAG, "Index still loading - navigation disabled");
+        return false;
+    }
+    return true;
 }
 
 esp_err_t audio_player_next(void) {
-    if (player_cmd_queue == NULL) {
+    if (player_cmd_queue == NULL || !navigation_ready()) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    player_cmd_t cmd = CMD_NEXT;
-    if (xQueueSend(player_cmd_queue, &cmd, pdMS_TO_TICKS(100)) != pdTRUE) {
+    player_msg_t msg = {.cmd = CMD_NEXT};
+    if (xQueueSend(player_cmd_queue, &msg, pdMS_TO_TICKS(100)) != pdTRUE) {
         ESP_LOGE(TAG, "Failed to send next command to queue");
         return ESP_FAIL;
     }
@@ -358,12 +771,12 @@ esp_err_t audio_player_next(void) {
 }
 
 esp_err_t audio_player_prev(void) {
-    if (player_cmd_queue == NULL) {
+    if (player_cmd_queue == NULL || !navigation_ready()) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    player_cmd_t cmd = CMD_PREV;
-    if (xQueueSend(player_cmd_queue, &cmd, pdMS_TO_TICKS(100)) != pdTRUE) {
+    player_msg_t msg = {.cmd = CMD_PREV};
+    if (xQueueSend(player_cmd_queue, &msg, pdMS_TO_TICKS(100)) != pdTRUE) {
         ESP_LOGE(TAG, "Failed to send prev command to queue");
         return ESP_FAIL;
     }
@@ -372,12 +785,12 @@ esp_err_t audio_player_prev(void) {
 }
 
 esp_err_t audio_player_next_folder(void) {
-    if (player_cmd_queue == NULL) {
+    if (player_cmd_queue == NULL || !navigation_ready()) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    player_cmd_t cmd = CMD_NEXT_FOLDER;
-    if (xQueueSend(player_cmd_queue, &cmd, pdMS_TO_TICKS(100)) != pdTRUE) {
+    player_msg_t msg = {.cmd = CMD_NEXT_FOLDER};
+    if (xQueueSend(player_cmd_queue, &msg, pdMS_TO_TICKS(100)) != pdTRUE) {
         ESP_LOGE(TAG, "Failed to send next folder command to queue");
         return ESP_FAIL;
     }
@@ -386,12 +799,12 @@ esp_err_t audio_player_next_folder(void) {
 }
 
 esp_err_t audio_player_prev_folder(void) {
-    if (player_cmd_queue == NULL) {
+    if (player_cmd_queue == NULL || !navigation_ready()) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    player_cmd_t cmd = CMD_PREV_FOLDER;
-    if (xQueueSend(player_cmd_queue, &cmd, pdMS_TO_TICKS(100)) != pdTRUE) {
+    player_msg_t msg = {.cmd = CMD_PREV_FOLDER};
+    if (xQueueSend(player_cmd_queue, &msg, pdMS_TO_TICKS(100)) != pdTRUE) {
         ESP_LOGE(TAG, "Failed to send prev folder command to queue");
         return ESP_FAIL;
     }
@@ -399,109 +812,749 @@ esp_err_t audio_player_prev_folder(void) {
     return ESP_OK;
 }
 
+esp_err_t audio_player_play_index(int index) {
+    if (player_cmd_queue == NULL || !navigation_ready()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (index < 0 || index >= music_index.total_files) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    player_msg_t msg = {.cmd = CMD_PLAY_INDEX, .arg = (uint32_t)index};
+    if (xQueueSend(player_cmd_queue, &msg, pdMS_TO_TICKS(100)) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to send play index command to queue");
+        return ESP_FAIL;
+    }
+    
+    return ESP_OK;
+}
+
 esp_err_t audio_player_set_mode(playback_mode_t mode) {
     if (mode >= MODE_MAX) {
         return ESP_ERR_INVALID_ARG;
     }
-    // If switching to a folder mode, update current_folder_index to match the current file
-    if ((mode == MODE_PLAY_FOLDER_ORDER || mode == MODE_PLAY_FOLDER_SHUFFLE) && strlen(player_state.current_file_path) > 0) {
-        update_current_folder_index_for_file(player_state.current_file_path);
+    if (player_cmd_queue == NULL || !navigation_ready()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+#if !defined(TEST_MODE) || defined(HOST_SIM)
+    // The shuffle order and current position belong to the player task
+    player_msg_t msg = {.cmd = CMD_CHANGE_MODE, .arg = (uint32_t)mode};
+    if (xQueueSend(player_cmd_queue, &msg, pdMS_TO_TICKS(100)) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to send change mode command to queue");
+        return ESP_FAIL;
     }
+#else
+    apply_mode(mode);
+#endif
+    return ESP_OK;
+}
+
+// Runs on the player task
+static void apply_mode(playback_mode_t mode) {
     player_state.mode = mode;
-    // Update shuffle list if entering a shuffle mode
-    update_shuffle_list();
+    // Find the current file's place in the new mode: its folder, rank or position
+    if (strlen(player_state.current_file_path) > 0) {
+        update_current_folder_index_for_file(player_state.current_file_path);
+    }
+    // Entering a shuffle mode deals a new order
+    reseed_shuffle();
+    // The neighbours of the current track change with the mode
+    prefetch_step = 0;
     // Indicate mode with NeoPixel
     neopixel_indicate_mode(mode);
     // Save state
     audio_player_save_state();
+}
+
+esp_err_t audio_player_set_crossfade(uint16_t seconds) {
+    if (seconds > CROSSFADE_MAX_SECONDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    crossfade_seconds = seconds;
+    ESP_LOGI(TAG, "Crossfade set to %u seconds", seconds);
+    return ESP_OK;
+}
+
+void audio_player_get_stats(audio_player_stats_t *stats) {
+    stats->sd_read_bps = sd_read_bps;
+    stats->reads = pcm_reads;
+    stats->read_worst_us = __atomic_exchange_n(&read_worst_us, 0, __ATOMIC_RELAXED);
+    stats->underruns = underruns;
+    stats->ring_fill = ring_fill;
+    stats->dma_desc_num = dma_desc_num;
+    stats->dma_frame_num = dma_frame_num;
+    stats->read_size = read_size;
+    stats->quarantined = quarantine.quarantined;
+    stats->card_removals = card_removals;
+}
+
+void audio_player_set_trace(bool enabled) {
+    trace_enabled = enabled;
+    ESP_LOGI(TAG, "Read tracing %s", enabled ? "on" : "off");
+}
+
+size_t audio_player_take_trace(audio_player_trace_t *events, size_t max_count, uint32_t *dropped) {
+    uint32_t tail = __atomic_load_n(&trace_tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&trace_head, __ATOMIC_ACQUIRE);
+    size_t count = 0;
+    while (tail != head && count < max_count) {
+        events[count++] = trace_events[tail % TRACE_EVENTS];
+        tail++;
+    }
+    __atomic_store_n(&trace_tail, tail, __ATOMIC_RELEASE);
+    uint32_t lost = __atomic_exchange_n(&trace_dropped, 0, __ATOMIC_RELAXED);
+    if (dropped != NULL) {
+        *dropped = lost;
+    }
+    return count;
+}
+
+esp_err_t audio_player_set_read_size(size_t bytes) {
+    if (bytes < AUDIO_PLAYER_READ_SIZE_MIN || bytes > AUDIO_BUFFER_SIZE || bytes % SD_SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    read_size = bytes;
+    ESP_LOGI(TAG, "Read size set to %u bytes", (unsigned)bytes);
     return ESP_OK;
 }
 
-player_state_t audio_player_get_state(void) {
-    return player_state;
+esp_err_t audio_player_set_dma_buffers(uint32_t desc_num, uint32_t frame_num) {
+    if (desc_num < AUDIO_PLAYER_DMA_DESC_MIN || desc_num > AUDIO_PLAYER_DMA_DESC_MAX ||
+        frame_num < AUDIO_PLAYER_DMA_FRAME_MIN || frame_num > AUDIO_PLAYER_DMA_FRAME_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (player_cmd_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    // Only the player task touches the channel
+    player_msg_t msg = {.cmd = CMD_RETUNE_OUTPUT, .arg = desc_num << 16 | frame_num};
+    if (xQueueSend(player_cmd_queue, &msg, pdMS_TO_TICKS(100)) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to send retune command to queue");
+        return ESP_FAIL;
+    }
+    
+    return ESP_OK;
+}
+
+player_state_t audio_player_get_state(void) {
+    return player_state;
+}
+
+esp_err_t audio_player_save_state(void) {
+    if (!sd_card_is_mounted()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return sd_card_write_file(STATE_FILE_PATH, &player_state, sizeof(player_state));
+}
+
+esp_err_t audio_player_load_state(void) {
+    if (!sd_card_is_mounted()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    size_t bytes_read = 0;
+    esp_err_t ret = sd_card_read_file(STATE_FILE_PATH, &player_state, sizeof(player_state), &bytes_read);
+    
+    if (ret == ESP_OK && bytes_read == sizeof(player_state)) {
+        // Validate values
+        if (player_state.mode >= MODE_MAX) {
+            player_state.mode = MODE_PLAY_ALL_ORDER;
+        }
+        
+        if (player_state.current_folder_index < 0) {
+            player_state.current_folder_index = 0;
+        }
+        
+        ESP_LOGI(TAG, "Loaded saved state: mode=%d, file=%s", 
+            player_state.mode, player_state.current_file_path);
+        
+        return ESP_OK;
+    }
+    
+    // If load failed, use default values
+    player_state.mode = MODE_PLAY_ALL_ORDER;
+    player_state.current_file_index = 0;
+    player_state.current_folder_index = 0;
+    player_state.is_playing = false;
+    player_state.shuffle_seed = esp_random();
+    player_state.shuffle_pos = 0;
+    memset(player_state.current_file_path, 0, sizeof(player_state.current_file_path));
+    
+    ESP_LOGI(TAG, "Using default player state");
+    return ESP_ERR_NOT_FOUND;
+}
+
+// Helper: Update current_folder_index to match the folder containing the given file path
+static void update_current_folder_index_for_file(const char *filepath);
+
+// Bytes per interleaved frame of an open file
+static uint32_t frame_bytes_of(const pcm_file_t *pcm_file) {
+    return (pcm_file->bit_depth / 8) * pcm_file->channels;
+}
+
+// Queue a trace event unless the reader has fallen a full buffer behind
+static void trace_read(int64_t now_us, uint32_t read_us, size_t bytes) {
+    uint32_t head = __atomic_load_n(&trace_head, __ATOMIC_RELAXED);
+    if (head - __atomic_load_n(&trace_tail, __ATOMIC_ACQUIRE) >= TRACE_EVENTS) {
+        __atomic_fetch_add(&trace_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    audio_player_trace_t *event = &trace_events[head % TRACE_EVENTS];
+    event->time_ms = (uint32_t)(now_us / 1000);
+    event->read_us = read_us;
+    event->bytes = (uint32_t)bytes;
+    event->ring_fill = (uint32_t)ring_fill;
+    event->underruns = underruns;
+    __atomic_store_n(&trace_head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Read from a PCM file and fold the transfer rate into the SD throughput estimate
+static esp_err_t timed_pcm_read(pcm_file_t *pcm_file, void *buffer, size_t size, size_t *bytes_read) {
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = pcm_file_read(pcm_file, buffer, size, bytes_read);
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - start;
+    if (ret == ESP_OK && *bytes_read > 0 && elapsed > 0) {
+        uint32_t us = elapsed > UINT32_MAX / 8 ? UINT32_MAX / 8 : (uint32_t)elapsed;
+        bool first = read_avg_us == 0;
+        read_avg_bytes = first ? (uint32_t)*bytes_read : (read_avg_bytes * 7 + (uint32_t)*bytes_read) / 8;
+        read_avg_us = first ? us : (read_avg_us * 7 + us) / 8;
+        uint64_t bps = read_avg_us > 0 ? (uint64_t)read_avg_bytes * 1000000 / read_avg_us : UINT32_MAX;
+        sd_read_bps = bps > UINT32_MAX ? UINT32_MAX : (uint32_t)bps;
+    }
+
+    uint32_t read_us = (uint32_t)elapsed;
+    pcm_reads++;
+    if (read_us > __atomic_load_n(&read_worst_us, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&read_worst_us, read_us, __ATOMIC_RELAXED);
+    }
+    if (pcm_file == &current_pcm_file) {
+        ring_fill = pcm_file_buffered(pcm_file);
+    }
+    if (trace_enabled) {
+        trace_read(now, read_us, ret == ESP_OK ? *bytes_read : 0);
+    }
+    return ret;
+}
+
+// Read a track, taking what was read ahead for its fade first
+static esp_err_t read_track(pcm_file_t *pcm_file, uint8_t *buffer, size_t size, size_t *bytes_read) {
+    size_t held = 0;
+    while (fade_ahead_of == pcm_file && fade_ahead_count > 0 && held < size) {
+        size_t span = size - held;
+        if (span > fade_ahead_count) span = fade_ahead_count;
+        if (span > fade_ahead_size - fade_ahead_start) span = fade_ahead_size - fade_ahead_start;
+        memcpy(buffer + held, fade_ahead + fade_ahead_start, span);
+        fade_ahead_start = (fade_ahead_start + span) % fade_ahead_size;
+        fade_ahead_count -= span;
+        held += span;
+    }
+    if (held == size) {
+        *bytes_read = held;
+        return ESP_OK;
+    }
+    esp_err_t ret = timed_pcm_read(pcm_file, buffer + held, size - held, bytes_read);
+    if (held > 0) {
+        // The bytes held are good even if the card fails after them
+        *bytes_read = (ret == ESP_OK ? *bytes_read : 0) + held;
+        return ESP_OK;
+    }
+    return ret;
+}
+
+// Bytes of the current track handed to the output so far
+static uint32_t played_bytes(void) {
+    uint32_t ahead = fade_ahead_of == &current_pcm_file ? (uint32_t)fade_ahead_count : 0;
+    return current_pcm_file.position - ahead;
+}
+
+static uint32_t played_ms(void) {
+    uint32_t byte_rate = current_pcm_file.sample_rate * frame_bytes_of(&current_pcm_file);
+    uint32_t ahead = fade_ahead_of == &current_pcm_file ? (uint32_t)fade_ahead_count : 0;
+    uint32_t ms = pcm_file_position_ms(&current_pcm_file);
+    uint32_t ahead_ms = byte_rate > 0 ? (uint32_t)((uint64_t)ahead * 1000 / byte_rate) : 0;
+    return ms > ahead_ms ? ms - ahead_ms : 0;
+}
+
+static void fade_ahead_drop(void) {
+    mem_free(fade_ahead);
+    fade_ahead = NULL;
+    fade_ahead_size = 0;
+    fade_ahead_start = 0;
+    fade_ahead_count = 0;
+    fade_ahead_target = 0;
+    fade_ahead_planned = 0;
+    fade_ahead_step = 0;
+    fade_ahead_of = NULL;
+}
+
+// How much of a fade of fade_bytes per stream must be read ahead for the SD
+// throughput, less the headroom, to carry both streams: 0 if none, -1 if no
+// read-ahead that fits is enough. Whole reads are held, so it is rounded up
+// to the read size. lead_bytes is the playback over which the spare
+// throughput fills it, with one read to spare.
+static int32_t fade_ahead_needed(uint32_t fade_bytes, uint32_t *lead_bytes) {
+    uint64_t byte_rate = (uint64_t)current_pcm_file.sample_rate * frame_bytes_of(&current_pcm_file);
+    uint64_t usable = (uint64_t)sd_read_bps * 100 / CROSSFADE_THROUGHPUT_PCT;
+    *lead_bytes = 0;
+    if (byte_rate == 0 || usable <= byte_rate) {
+        return -1;
+    }
+    // Two fades of reads minus the read-ahead, in the time of one fade
+    uint64_t carried = (uint64_t)fade_bytes * usable / byte_rate;
+    if (carried >= 2ull * fade_bytes) {
+        return 0;
+    }
+    uint64_t needed = (2ull * fade_bytes - carried + read_size - 1) / read_size * read_size;
+    if (needed > (mem_has_psram() ? CROSSFADE_AHEAD_MAX_PSRAM : CROSSFADE_AHEAD_MAX)) {
+        return -1;
+    }
+    *lead_bytes = (uint32_t)(needed * byte_rate / (usable - byte_rate)) + read_size;
+    return (int32_t)needed;
+}
+
+// Before the fade window, read the current track ahead with the SD time left
+// over after each chunk. Playback drains the ring first, so each pass reads
+// back what it took plus the spare share, at most one extra chunk. The plan
+// is fixed once the ring is taken, so a wobbling estimate cannot stall it.
+static void fade_ahead_fill(uint32_t fade_bytes, uint32_t remaining) {
+    if (fade_ahead_of != &current_pcm_file) {
+        uint32_t lead = 0;
+        int32_t needed = fade_ahead_needed(fade_bytes, &lead);
+        if (needed <= 0 || remaining > fade_bytes + lead || current_pcm_file.pcm_size < fade_bytes * 2) {
+            return;
+        }
+        fade_ahead_drop();
+        fade_ahead = mem_alloc(MEM_BULK, needed + read_size);
+        if (fade_ahead == NULL) {
+            // The fade is declined at its start unless the card keeps up without
+            return;
+        }
+        fade_ahead_size = needed + read_size;
+        fade_ahead_planned = needed;
+        fade_ahead_step = (size_t)(((uint64_t)read_size * needed + lead - 1) / lead);
+        fade_ahead_of = &current_pcm_file;
+        ESP_LOGI(TAG, "Reading %d bytes ahead for the crossfade", (int)needed);
+    }
+    fade_ahead_target += fade_ahead_step;
+    if (fade_ahead_target > fade_ahead_planned) {
+        fade_ahead_target = fade_ahead_planned;
+    }
+    // The ring also holds the chunk playback takes next, so the target survives it
+    for (int chunk = 0; chunk < 2 && fade_ahead_count < fade_ahead_target + read_size; chunk++) {
+        size_t tail = (fade_ahead_start + fade_ahead_count) % fade_ahead_size;
+        size_t span = fade_ahead_size - tail < read_size ? fade_ahead_size - tail : read_size;
+        if (span > fade_ahead_size - fade_ahead_count) {
+            span = fade_ahead_size - fade_ahead_count;
+        }
+        size_t bytes_read = 0;
+        if (timed_pcm_read(&current_pcm_file, fade_ahead + tail, span, &bytes_read) != ESP_OK || bytes_read == 0) {
+            return;
+        }
+        fade_ahead_count += bytes_read;
+    }
+}
+
+// Bit depth a track is played at once decoded
+static uint16_t decoded_bit_depth(const file_entry_t *entry) {
+    switch (entry->codec) {
+        case PCM_CODEC_IMA_ADPCM:
+        case PCM_CODEC_MP3:
+            return 16;
+        case PCM_CODEC_FLAC:
+            return entry->bit_depth <= 16 ? 16 : 24;
+        default:
+            return entry->bit_depth;
+    }
+}
+
+// Stop mixing and drop the outgoing track, and any read-ahead
+static void crossfade_abort(void) {
+    if (fading_pcm_file.file != NULL) {
+        pcm_file_close(&fading_pcm_file);
+    }
+    fade_ahead_drop();
+    crossfade_active = false;
+}
+
+// Start a crossfade into the next track, or decline and leave a hard cut at the end of this one
+static void crossfade_begin(void) {
+    crossfade_declined = true;
+
+    uint32_t frame_bytes = frame_bytes_of(&current_pcm_file);
+    if (frame_bytes == 0 || !audio_dsp_supports(current_pcm_file.bit_depth)) {
+        return;
+    }
+    uint32_t fade_frames = (uint32_t)crossfade_seconds * current_pcm_file.sample_rate;
+    uint32_t total_frames = current_pcm_file.pcm_size / frame_bytes;
+    uint32_t remaining_frames = (current_pcm_file.pcm_size - played_bytes()) / frame_bytes;
+    if (total_frames < fade_frames * 2) {
+        ESP_LOGI(TAG, "Track too short for a %u s crossfade", crossfade_seconds);
+        return;
+    }
+
+    // Two streams are read per output chunk during the fade, less what was read ahead
+    uint32_t lead = 0;
+    bool planned = fade_ahead_of == &current_pcm_file;
+    int32_t needed = planned ? (int32_t)fade_ahead_planned : fade_ahead_needed(fade_frames * frame_bytes, &lead);
+    size_t held = planned ? fade_ahead_count : 0;
+    if (needed < 0 || held < (size_t)needed) {
+        ESP_LOGW(TAG, "SD throughput %u B/s too low for crossfade (%u bytes read ahead), using hard cut",
+                 sd_read_bps, (unsigned)held);
+        return;
+    }
+
+    // Mixing needs identical decoded formats and must not reconfigure I2S under the outgoing track
+    file_entry_t *next = neighbour_file(1, false);
+    if (next == NULL ||
+        next->sample_rate != current_pcm_file.sample_rate ||
+        decoded_bit_depth(next) != current_pcm_file.bit_depth ||
+        next->channels != current_pcm_file.channels) {
+        ESP_LOGI(TAG, "Next track format differs, using hard cut");
+        return;
+    }
+
+    fading_pcm_file = current_pcm_file;
+    fading_gain = current_gain;
+    current_pcm_file.file = NULL;
+    if (fade_ahead_of == &current_pcm_file) {
+        fade_ahead_of = &fading_pcm_file;
+    }
+    if (select_next_file() != ESP_OK || current_pcm_file.file == NULL) {
+        // Let the outgoing track finish on its own
+        ESP_LOGW(TAG, "Failed to open next track for crossfade");
+        current_pcm_file = fading_pcm_file;
+        current_gain = fading_gain;
+        fading_pcm_file.file = NULL;
+        if (fade_ahead_of == &fading_pcm_file) {
+            fade_ahead_of = &current_pcm_file;
+        }
+        crossfade_declined = true;
+        return;
+    }
+
+    // A file header may disagree with the index the decision was based on
+    if (current_pcm_file.sample_rate != fading_pcm_file.sample_rate ||
+        current_pcm_file.bit_depth != fading_pcm_file.bit_depth ||
+        current_pcm_file.channels != fading_pcm_file.channels) {
+        ESP_LOGW(TAG, "Next track header differs from index, dropping crossfade");
+        crossfade_abort();
+        return;
+    }
+
+    crossfade_pos = 0;
+    crossfade_len = remaining_frames < fade_frames ? remaining_frames : fade_frames;
+    crossfade_active = true;
+    ESP_LOGI(TAG, "Crossfading over %u frames", crossfade_len);
+}
+
+// Mix the next chunk of the outgoing track into a chunk of the incoming one
+static void crossfade_mix(size_t bytes) {
+    size_t fade_read = 0;
+    esp_err_t ret = read_track(&fading_pcm_file, fade_buffer, bytes, &fade_read);
+    if (ret != ESP_OK) {
+        fade_read = 0;
+    }
+    audio_dsp_apply_gain(fade_buffer, fade_read, fading_pcm_file.bit_depth, fading_gain);
+    if (fade_read < bytes) {
+        memset(fade_buffer + fade_read, 0, bytes - fade_read);
+    }
+
+    audio_dsp_crossfade(audio_buffer, fade_buffer, bytes,
+                        current_pcm_file.bit_depth, current_pcm_file.channels,
+                        crossfade_pos, crossfade_len);
+    crossfade_pos += bytes / frame_bytes_of(&current_pcm_file);
+
+    if (fade_read < bytes || crossfade_pos >= crossfade_len) {
+        crossfade_abort();
+    }
+}
+
+// Seek the current track on the player task, dropping audio already queued for the DAC
+static esp_err_t seek_current(uint32_t position_ms) {
+    if (current_pcm_file.file == NULL) {
+        ESP_LOGW(TAG, "No file is currently open for seeking");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    crossfade_abort();
+    esp_err_t ret = pcm_file_seek_ms(&current_pcm_file, position_ms);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to seek to %u ms", position_ms);
+        return ret;
+    }
+    // Leaving the fade window by seeking back gives the track another chance to crossfade
+    crossfade_declined = false;
+
+    // Restarting the channel discards the DMA buffers still holding the old position
+    i2s_channel_disable(i2s_tx_chan);
+    output_starved = true;
+    i2s_channel_enable(i2s_tx_chan);
+
+    playback_position_ms = pcm_file_position_ms(&current_pcm_file);
+    ESP_LOGI(TAG, "Seeked to %u ms", playback_position_ms);
+    return ESP_OK;
+}
+
+// Player task function
+// Cache the head of the next neighbour of the current track
+static void prefetch_neighbours(void) {
+    if (prefetch_step >= PREFETCH_NEIGHBOURS) {
+        return;
+    }
+    char paths[PREFETCH_NEIGHBOURS][256];
+    const char *keep[PREFETCH_NEIGHBOURS];
+    for (int i = 0; i < PREFETCH_NEIGHBOURS; i++) {
+        file_entry_t *entry = neighbour_file(prefetch_steps[i], false);
+        keep[i] = NULL;
+        if (entry != NULL) {
+            json_get_full_path(entry->path, paths[i], sizeof(paths[i]));
+            keep[i] = paths[i];
+        }
+    }
+    if (prefetch_step == 0) {
+        track_cache_retain(keep, PREFETCH_NEIGHBOURS);
+    }
+    if (keep[prefetch_step] != NULL) {
+        track_cache_prefetch(keep[prefetch_step]);
+    }
+    prefetch_step++;
+}
+
+// Place the current track in a newly installed index, or start the first
+// track if nothing is playing yet. A saved track that could not be opened
+// before, like a headerless one at boot or one on a pulled card, is opened
+// again with the index and resumed where it stopped.
+static void sync_to_index(void) {
+    prefetch_step = 0;
+    if (strlen(player_state.current_file_path) > 0) {
+        if (current_pcm_file.file == NULL) {
+            uint32_t resume_ms = playback_position_ms;
+            if (play_file(player_state.current_file_path) == ESP_OK && resume_ms > 0) {
+                seek_current(resume_ms);
+            }
+        }
+        update_current_folder_index_for_file(player_state.current_file_path);
+        update_shuffle_list();
+    } else if (json_index_file(&music_index, 0) != NULL) {
+        update_shuffle_list();
+        char full_path[256];
+        json_get_full_path(json_index_file(&music_index, 0)->path, full_path, sizeof(full_path));
+        play_file(full_path);
+    } else {
+        // Playback starts once a rescan fills the index
+        ESP_LOGW(TAG, "No music files in index - waiting for user action");
+    }
+}
+
+// Load a freshly written index.json on the index task; the open tracks keep
+// playing from the current index until CMD_INDEX_READY swaps the new one in.
+// scanned marks an index.json the library scanner just wrote.
+static void reload_index(bool scanned) {
+    if (card_missing) {
+        // card_poll reloads the index of whatever card comes back
+        return;
+    }
+    if (index_loading) {
+        ESP_LOGW(TAG, "Index still loading - reload queued");
+        reload_queued = true;
+        queued_scanned = scanned;
+        return;
+    }
+    index_loading = true;
+    index_reloading = true;
+    index_scanned = scanned;
+#if !defined(TEST_MODE) || defined(HOST_SIM)
+    index_reading = true;
+    if (xTaskCreatePinnedToCore(index_task, "index_task", INDEX_TASK_STACK, NULL,
+                                tskIDLE_PRIORITY + 1, NULL, INDEX_TASK_CORE) == pdPASS) {
+        return;
+    }
+    index_reading = false;
+    ESP_LOGW(TAG, "Failed to create index task - reloading the index in place");
+#endif
+    install_index(load_pending());
+    sync_to_index();
+}
+
+// Every track of a freshly loaded index gets a clean slate
+static void reset_quarantine(void) {
+    if (!quarantine_init(&quarantine, music_index.total_files)) {
+        ESP_LOGW(TAG, "No memory for the track quarantine - failing tracks will be retried");
+    }
+}
+
+// Playlists hold allFiles positions, so they are resolved again with every index
+static void load_playlists(index_file_t *index, playlist_set_t *set) {
+    playlist_free(set);
+    if (index->total_files == 0) {
+        return;
+    }
+    char dir[256];
+    json_get_full_path(PLAYLIST_DIR, dir, sizeof(dir));
+    if (playlist_load_dir(dir, index, set) != ESP_OK) {
+        ESP_LOGW(TAG, "Playlists do not fit in memory - keeping %d", set->count);
+    }
+}
+
+// Sorting needs allFiles in memory; without the orders the sorted modes play in index order
+static void build_track_orders(const index_file_t *index, track_order_t *orders) {
+    track_order_free(orders);
+    if (index->pager != NULL) {
+        ESP_LOGW(TAG, "Paged index - artist and album modes play in index order");
+        return;
+    }
+    if (track_order_build(orders, index->all_files, index->total_files) != ESP_OK) {
+        ESP_LOGW(TAG, "No memory for the artist and album orders - they play in index order");
+    }
+}
+
+static bool sorted_mode(void) {
+    return player_state.mode == MODE_PLAY_ARTIST_ORDER || player_state.mode == MODE_PLAY_ALBUM_ORDER ||
+           player_state.mode == MODE_PLAY_ALBUM_SHUFFLE;
+}
+
+static track_order_key_t sorted_key(void) {
+    return player_state.mode == MODE_PLAY_ARTIST_ORDER ? TRACK_ORDER_ARTIST : TRACK_ORDER_ALBUM;
+}
+
+// allFiles position at a rank of the current sorted mode
+static int sorted_position(int rank) {
+    return track_orders.count > 0 ? track_order_at(&track_orders, sorted_key(), rank) : rank;
+}
+
+// Folders of the folder modes: the index folders, then the playlists
+static int folder_total(void) {
+    return music_index.folder_count + playlists.count;
+}
+
+static int folder_size(int folder) {
+    if (folder >= music_index.folder_count) {
+        return playlist_size(&playlists, folder - music_index.folder_count);
+    }
+    return json_index_folder_size(&music_index, folder);
+}
+
+static file_entry_t *folder_file(int folder, int file_index) {
+    if (folder >= music_index.folder_count) {
+        return json_index_file(&music_index, playlist_track(&playlists, folder - music_index.folder_count, file_index));
+    }
+    return json_index_folder_file(&music_index, folder, file_index);
+}
+
+// A track failed to open. Without the card nothing is at fault but the card.
+// A track whose data cannot be played (ESP_ERR_INVALID_ARG) is skipped by
+// every mode from now on; one that only could not be opened or read this
+// time, e.g. with all file handles in use, is skipped and tried again later.
+static void track_failed(int position, esp_err_t err) {
+    if (card_missing) {
+        return;
+    }
+    if (!sd_card_present()) {
+        card_lost();
+        return;
+    }
+    if (err != ESP_ERR_INVALID_ARG) {
+        ESP_LOGW(TAG, "Track %d could not be opened (%d) - skipped", position, err);
+        return;
+    }
+    if (quarantine_add(&quarantine, position)) {
+        ESP_LOGW(TAG, "Track %d quarantined, %d in total", position, quarantine.quarantined);
+    }
+}
+
+// Let go of everything on the card and wait for one to come back
+static void card_lost(void) {
+    if (card_missing) {
+        return;
+    }
+    ESP_LOGW(TAG, "SD card removed - waiting for a card");
+    card_missing = true;
+    card_removals++;
+    crossfade_abort();
+    if (current_pcm_file.file != NULL) {
+        pcm_file_close(&current_pcm_file);
+    }
+    track_cache_retain(NULL, 0);
+    card_released = false;
+    card_release();
+    card_poll_us = esp_timer_get_time();
 }
 
-esp_err_t audio_player_save_state(void) {
-    if (!sd_card_is_mounted()) {
-        return ESP_ERR_INVALID_STATE;
+// Unmount the missing card once no other task has files on it open. The
+// library scan is stopped; an index load fails fast without the card.
+static bool card_release(void) {
+    if (card_released) {
+        return true;
     }
-
-    return sd_card_write_file(STATE_FILE_PATH, &player_state, sizeof(player_state));
+    library_scanner_cancel();
+    if (library_scanner_busy() || index_reading) {
+        return false;
+    }
+    sd_card_unmount();
+    card_released = true;
+    return true;
 }
 
-esp_err_t audio_player_load_state(void) {
-    if (!sd_card_is_mounted()) {
-        return ESP_ERR_INVALID_STATE;
+// Try to mount the card again; once it is back, reload its index and pick up
+// the track that was playing, or the next one if that track is gone
+static void card_poll(void) {
+    if (!card_release()) {
+        return;
     }
-    
-    size_t bytes_read = 0;
-    esp_err_t ret = sd_card_read_file(STATE_FILE_PATH, &player_state, sizeof(player_state), &bytes_read);
-    
-    if (ret == ESP_OK && bytes_read == sizeof(player_state)) {
-        // Validate values
-        if (player_state.mode >= MODE_MAX) {
-            player_state.mode = MODE_PLAY_ALL_ORDER;
-        }
-        
-        if (player_state.current_folder_index >= music_index.folder_count) {
-            player_state.current_folder_index = 0;
-        }
-        
-        ESP_LOGI(TAG, "Loaded saved state: mode=%d, file=%s", 
-            player_state.mode, player_state.current_file_path);
-        
-        return ESP_OK;
+    int64_t now = esp_timer_get_time();
+    if (now < card_poll_us) {
+        return;
     }
-    
-    // If load failed, use default values
-    player_state.mode = MODE_PLAY_ALL_ORDER;
-    player_state.current_file_index = 0;
-    player_state.current_folder_index = 0;
-    player_state.is_playing = false;
-    memset(player_state.current_file_path, 0, sizeof(player_state.current_file_path));
-    
-    ESP_LOGI(TAG, "Using default player state");
-    return ESP_ERR_NOT_FOUND;
+    card_poll_us = now + CARD_RETRY_MS * 1000LL;
+    if (sd_card_remount() != ESP_OK) {
+        return;
+    }
+    ESP_LOGI(TAG, "SD card back - reloading the index");
+    card_missing = false;
+    // The old card's index is stale: tracks wait for the new one, and
+    // sync_to_index resumes the interrupted track once it is in
+    index_ready = false;
+    reload_index(false);
 }
 
-// Helper: Update current_folder_index to match the folder containing the given file path
-static void update_current_folder_index_for_file(const char *filepath);
+// A wired card-detect switch notices a pulled card before the next read fails
+static void card_watch(void) {
+    if (!sd_card_has_detect()) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    if (now < card_watch_us) {
+        return;
+    }
+    card_watch_us = now + CARD_DETECT_POLL_MS * 1000LL;
+    if (!sd_card_present()) {
+        card_lost();
+    }
+}
 
-// Player task function
 static void player_task(void *arg) {
     ESP_LOGI(TAG, "Player task started");
     
-    player_cmd_t cmd;
+    player_msg_t msg;
     bool running = true;
     
-    // Initialize random number generator if not already done
-    if (!random_seed_initialized) {
-        srand(time(NULL));
-        random_seed_initialized = true;
-    }
-    
-    // If we have a saved file path, try to play it
+    // Start the saved track right away; the file header is enough to play
+    // it, and the index catches up with CMD_INDEX_READY
     if (strlen(player_state.current_file_path) > 0) {
-        // If shuffle mode, regenerate shuffle list
-        update_shuffle_list();
+        int phase = boot_profile_begin("first play_file");
         play_file(player_state.current_file_path);
-    } else if (music_index.total_files > 0 && music_index.all_files != NULL) {
-        // Otherwise, start with first file
-        update_shuffle_list();
-        char full_path[256];
-        json_get_full_path(music_index.all_files[0].path, full_path, sizeof(full_path));
-        play_file(full_path);
+        boot_profile_end(phase);
     } else {
-        ESP_LOGW(TAG, "No music files in index - waiting for user action");
-        // Set state to show we're not currently playing anything
-        player_state.is_playing = false;
-        memset(player_state.current_file_path, 0, sizeof(player_state.current_file_path));
+        ESP_LOGI(TAG, "No saved track - waiting for the index");
     }
     
     // Task loop
     while (running) {
-        if (xQueueReceive(player_cmd_queue, &cmd, pdMS_TO_TICKS(10)) == pdTRUE) {
-            switch (cmd) {
+        if (xQueueReceive(player_cmd_queue, &msg, pdMS_TO_TICKS(10)) == pdTRUE) {
+            switch (msg.cmd) {
                 case CMD_PLAY:
                     player_state.is_playing = true;
                     ESP_LOGI(TAG, "Play command received");
@@ -509,34 +1562,74 @@ static void player_task(void *arg) {
                     
                 case CMD_STOP:
                     player_state.is_playing = false;
+                    output_armed = false;
                     ESP_LOGI(TAG, "Stop command received");
                     break;
                     
                 case CMD_NEXT:
                     ESP_LOGI(TAG, "Next command received");
+                    crossfade_abort();
                     select_next_file();
                     break;
                     
                 case CMD_PREV:
                     ESP_LOGI(TAG, "Previous command received");
+                    crossfade_abort();
                     select_prev_file();
                     break;
                     
                 case CMD_NEXT_FOLDER:
                     ESP_LOGI(TAG, "Next folder command received");
+                    crossfade_abort();
                     select_next_folder();
                     break;
                     
                 case CMD_PREV_FOLDER:
                     ESP_LOGI(TAG, "Previous folder command received");
+                    crossfade_abort();
                     select_prev_folder();
                     break;
                     
                 case CMD_CHANGE_MODE:
-                    ESP_LOGI(TAG, "Change mode command received");
-                    // Cycle through modes
-                    player_state.mode = (player_state.mode + 1) % MODE_MAX;
-                    audio_player_set_mode(player_state.mode);
+                    ESP_LOGI(TAG, "Change mode command received: %u", msg.arg);
+                    // The index may have gone with the card since the command was sent
+                    if (navigation_ready()) {
+                        apply_mode((playback_mode_t)msg.arg);
+                    }
+                    break;
+                    
+                case CMD_SEEK:
+                    ESP_LOGI(TAG, "Seek command received: %u ms", msg.arg);
+                    reply_seek(msg.seq, seek_current(msg.arg));
+                    break;
+                    
+                case CMD_RELOAD_INDEX:
+                    ESP_LOGI(TAG, "Reload index command received");
+                    reload_index(msg.arg != 0);
+                    break;
+                    
+                case CMD_INDEX_READY:
+                    install_index((esp_err_t)msg.arg);
+                    // Before the first track starts, if none plays yet
+                    store_index_cache();
+                    if (reload_queued) {
+                        // Superseded by a newer index.json or card
+                        reload_queued = false;
+                        reload_index(queued_scanned);
+                    } else if (!card_missing) {
+                        // Resume the saved shuffle order where it left off
+                        sync_to_index();
+                    }
+                    break;
+                    
+                case CMD_PLAY_INDEX:
+                    ESP_LOGI(TAG, "Play index command received: %u", msg.arg);
+                    crossfade_abort();
+                    play_index((int)msg.arg);
+                    break;
+                    
+                case CMD_RETUNE_OUTPUT:
+                    retune_output(msg.arg >> 16, msg.arg & 0xFFFF);
                     break;
                     
                 case CMD_QUIT:
@@ -550,18 +1643,56 @@ static void player_task(void *arg) {
         }
         
         // Handle playback
+        if (card_missing) {
+            // Nothing to read until the card is back
+            card_poll();
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+        card_watch();
+        if (card_missing) {
+            continue;
+        }
         if (player_state.is_playing) {
+            // Hand over to the next track once the outgoing one enters the fade
+            // window, reading it ahead on the way there
+            if (current_pcm_file.file != NULL && crossfade_seconds > 0 && !crossfade_active && !crossfade_declined) {
+                uint32_t fade_bytes = (uint32_t)crossfade_seconds * current_pcm_file.sample_rate * frame_bytes_of(&current_pcm_file);
+                uint32_t remaining = current_pcm_file.pcm_size - played_bytes();
+                if (remaining <= fade_bytes) {
+                    crossfade_begin();
+                } else {
+                    fade_ahead_fill(fade_bytes, remaining);
+                }
+            }
+
             // Only read audio data if file is open
             if (current_pcm_file.file != NULL) {
                 size_t bytes_read = 0;
-                esp_err_t ret = pcm_file_read(&current_pcm_file, audio_buffer, AUDIO_BUFFER_SIZE, &bytes_read);
+                esp_err_t ret = read_track(&current_pcm_file, audio_buffer, read_size, &bytes_read);
                 
                 if (ret == ESP_OK && bytes_read > 0) {
+                    playback_position_ms = played_ms();
+                    audio_dsp_apply_gain(audio_buffer, bytes_read, current_pcm_file.bit_depth, current_gain);
+                    if (crossfade_active) {
+                        crossfade_mix(bytes_read);
+                    }
+
                     // Write data to I2S
                     size_t bytes_written = 0;
                     esp_err_t i2s_ret = i2s_channel_write(i2s_tx_chan, audio_buffer, bytes_read, &bytes_written, portMAX_DELAY);
+                    // The queue has audio again; running dry from here on is an underrun
+                    if (bytes_written > 0) {
+                        output_starved = false;
+                        output_armed = true;
+                    }
                     if (i2s_ret != ESP_OK) {
                         ESP_LOGE(TAG, "i2s_channel_write failed: %d", i2s_ret);
+                    } else if (!first_audio_logged) {
+                        first_audio_logged = true;
+                        boot_profile_end(boot_profile_begin("first audio"));
+                        ESP_LOGI(TAG, "First audio %lld ms after reset (index %s)",
+                                 (long long)(esp_timer_get_time() / 1000), index_ready ? "ready" : "still loading");
                     }
                     
                     // Check if all bytes were written
@@ -569,32 +1700,49 @@ static void player_task(void *arg) {
                         ESP_LOGW(TAG, "Not all bytes written to I2S: %zu of %zu", 
                                   bytes_written, bytes_read);
                     }
+                    
+                    // With a buffer queued, warm the cache for the next skip
+                    prefetch_neighbours();
                 } else {
                     // End of file or error
                     if (ret != ESP_OK) {
                         ESP_LOGE(TAG, "Error reading PCM file");
                     }
                     
-                    // Close current file
+                    // Close current file, cutting any fade still in progress
+                    crossfade_abort();
                     pcm_file_close(&current_pcm_file);
                     
-                    // Play next file
-                    select_next_file();
+                    // A read that fails may mean the card was pulled; otherwise play next file
+                    if (ret != ESP_OK && !sd_card_present()) {
+                        card_lost();
+                    } else {
+                        select_next_file();
+                    }
                 }
+            } else if (!index_ready) {
+                // Nothing to move on to until the index is in
+                vTaskDelay(pdMS_TO_TICKS(100));
             } else {
-                // No file is open, try to find one to play
-                select_next_file();
+                // No file is open, try to find one to play; if every track in
+                // reach fails, wait for the user instead of trying again forever
+                if (select_next_file() != ESP_OK && !card_missing && music_index.total_files > 0) {
+                    ESP_LOGW(TAG, "Nothing playable in this mode - pausing");
+                    player_state.is_playing = false;
+                }
                 
                 // Small delay to prevent CPU hogging if no file is found
                 vTaskDelay(pdMS_TO_TICKS(100));
             }
         } else {
-            // Not playing, just delay
+            // Not playing; a put-off index cache store cannot be heard now
+            store_index_cache();
             vTaskDelay(pdMS_TO_TICKS(100));
         }
     }
     
     // Clean up
+    crossfade_abort();
     if (current_pcm_file.file != NULL) {
         pcm_file_close(&current_pcm_file);
     }
@@ -603,6 +1751,19 @@ static void player_task(void *arg) {
     vTaskDelete(NULL);
 }
 
+// Pick the loudness gain for a track: album gain in the modes that keep albums together,
+// track gain in the whole-library modes, falling back to whichever the index provides
+static int32_t loudness_gain_for(const file_entry_t *entry) {
+    bool prefer_album = player_state.mode != MODE_PLAY_ALL_ORDER && player_state.mode != MODE_PLAY_ALL_SHUFFLE;
+    if (entry->has_album_gain && (prefer_album || !entry->has_track_gain)) {
+        return audio_dsp_gain_from_db(entry->album_gain_db, entry->album_peak);
+    }
+    if (entry->has_track_gain) {
+        return audio_dsp_gain_from_db(entry->track_gain_db, entry->track_peak);
+    }
+    return AUDIO_DSP_GAIN_UNITY;
+}
+
 // Play a specific file
 static esp_err_t play_file(const char *filepath) {
     ESP_LOGI(TAG, "Playing file: %s", filepath);
@@ -621,54 +1782,82 @@ static esp_err_t play_file(const char *filepath) {
         }
     }
     
-    // Find the file in the index
-    for (int i = 0; i < music_index.total_files; i++) {
-        if (strcmp(music_index.all_files[i].path, rel_path) == 0) {
-            file_entry = &music_index.all_files[i];
-            break;
-        }
-    }
+    // Find the file in the index; the entry stays valid until the index is read again
+    file_entry = json_index_file(&music_index, json_index_find(&music_index, rel_path));
+    int position = file_entry != NULL ? file_entry->position : -1;
     
-    if (file_entry == NULL) {
-        ESP_LOGE(TAG, "File not found in index: %s", rel_path);
-        return ESP_FAIL;
+    // Close any open file
+    if (current_pcm_file.file != NULL) {
+        pcm_file_close(&current_pcm_file);
     }
     
-    // Configure I2S for this file's audio parameters
-    esp_err_t ret = configure_i2s(file_entry->sample_rate, file_entry->bit_depth, file_entry->channels);
+    // Open the new file; a file header overrides the index metadata
+    esp_err_t ret;
+    if (file_entry != NULL) {
+        ret = pcm_file_open(filepath, &current_pcm_file, file_entry->sample_rate, file_entry->bit_depth, file_entry->channels);
+    } else {
+        ret = pcm_file_open(filepath, &current_pcm_file, 0, 0, 0);
+    }
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to configure I2S for file");
+        ESP_LOGE(TAG, "Failed to open PCM file");
+        track_failed(position, ret);
         return ret;
     }
     
-    // Close any open file
-    if (current_pcm_file.file != NULL) {
+    if (file_entry == NULL && !current_pcm_file.has_header) {
+        ESP_LOGE(TAG, "File not found in index and has no header: %s", rel_path);
         pcm_file_close(&current_pcm_file);
+        return ESP_FAIL;
+    }
+    
+    if (file_entry != NULL && file_entry->codec == PCM_CODEC_MP3) {
+        pcm_file_set_frame_index(&current_pcm_file, &file_entry->frame_index);
+    }
+    if (file_entry != NULL && !current_pcm_file.has_header && file_entry->codec != PCM_CODEC_RAW) {
+        ret = pcm_file_set_codec(&current_pcm_file, file_entry->codec, file_entry->block_align);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Unsupported encoding for file: %s", rel_path);
+            pcm_file_close(&current_pcm_file);
+            track_failed(position, ret);
+            return ret;
+        }
     }
     
-    // Open the new file with metadata
-    ret = pcm_file_open(filepath, &current_pcm_file, file_entry->sample_rate, file_entry->bit_depth, file_entry->channels);
+    // Configure I2S for the decoded audio parameters
+    ret = configure_i2s(current_pcm_file.sample_rate, current_pcm_file.bit_depth, current_pcm_file.channels);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open PCM file");
+        ESP_LOGE(TAG, "Failed to configure I2S for file");
+        pcm_file_close(&current_pcm_file);
         return ret;
     }
     
-    // Update the player state with current song metadata
-    strncpy(player_state.current_file_path, filepath, sizeof(player_state.current_file_path) - 1);
-    player_state.current_file_path[sizeof(player_state.current_file_path) - 1] = '\0';
-    
-    strncpy(player_state.current_song, file_entry->song, sizeof(player_state.current_song) - 1);
-    player_state.current_song[sizeof(player_state.current_song) - 1] = '\0';
-    
-    strncpy(player_state.current_album, file_entry->album, sizeof(player_state.current_album) - 1);
-    player_state.current_album[sizeof(player_state.current_album) - 1] = '\0';
+    // A track that plays again, e.g. picked by index, is out of quarantine
+    quarantine_remove(&quarantine, position);
+
+    // A new track gets its own chance to crossfade into the next one
+    crossfade_declined = false;
+    prefetch_step = 0;
+    playback_position_ms = 0;
+    playback_duration_ms = pcm_file_duration_ms(&current_pcm_file);
+    current_gain = file_entry != NULL ? loudness_gain_for(file_entry) : AUDIO_DSP_GAIN_UNITY;
+
+    // Update the player state with current song metadata; a replayed track passes the path in place
+    if (filepath != player_state.current_file_path) {
+        snprintf(player_state.current_file_path, sizeof(player_state.current_file_path), "%s", filepath);
+    }
     
-    strncpy(player_state.current_artist, file_entry->artist, sizeof(player_state.current_artist) - 1);
-    player_state.current_artist[sizeof(player_state.current_artist) - 1] = '\0';
+    // Files outside the index are named after their path
+    const char *base_name = strrchr(rel_path, '/');
+    const char *song = file_entry != NULL ? file_entry->song : (base_name ? base_name + 1 : rel_path);
+    snprintf(player_state.current_song, sizeof(player_state.current_song), "%s", song);
+    snprintf(player_state.current_album, sizeof(player_state.current_album), "%s",
+             file_entry != NULL ? file_entry->album : "Unknown Album");
+    snprintf(player_state.current_artist, sizeof(player_state.current_artist), "%s",
+             file_entry != NULL ? file_entry->artist : "Unknown Artist");
     
-    player_state.current_sample_rate = file_entry->sample_rate;
-    player_state.current_bit_depth = file_entry->bit_depth;
-    player_state.current_channels = file_entry->channels;
+    player_state.current_sample_rate = current_pcm_file.sample_rate;
+    player_state.current_bit_depth = current_pcm_file.bit_depth;
+    player_state.current_channels = current_pcm_file.channels;
     
     ESP_LOGI(TAG, "Now playing: %s by %s from %s", 
              player_state.current_song, player_state.current_artist, player_state.current_album);
@@ -699,242 +1888,315 @@ static void update_current_folder_index_for_file(const char *filepath) {
     ESP_LOGI(TAG, "Relative path for index lookup: %s", rel_path);
     
     // Find the file in allFiles and use its folderIndex
-    for (int i = 0; i < music_index.total_files; i++) {
-        if (strcmp(music_index.all_files[i].path, rel_path) == 0) {
-            player_state.current_folder_index = music_index.all_files[i].folder_index;
-            
-            // Now find the file index within that folder
-            if (player_state.current_folder_index < music_index.folder_count) {
-                folder_t *folder = &music_index.music_folders[player_state.current_folder_index];
-                for (int j = 0; j < folder->file_count; j++) {
-                    if (strcmp(folder->files[j].path, rel_path) == 0) {
-                        player_state.current_file_index = j;
-                        ESP_LOGI(TAG, "Found file in folder %d, file %d: %s", 
-                                 player_state.current_folder_index, j, folder->files[j].path);
-                        return;
-                    }
-                }
+    int position = json_index_find(&music_index, rel_path);
+    file_entry_t *entry = json_index_file(&music_index, position);
+    if (entry != NULL && (player_state.mode == MODE_PLAY_ALL_ORDER || player_state.mode == MODE_PLAY_ALL_SHUFFLE)) {
+        player_state.current_folder_index = entry->folder_index;
+        player_state.current_file_index = position;
+        return;
+    }
+    if (entry != NULL && sorted_mode()) {
+        // The folder is kept for switching to a folder mode later
+        player_state.current_folder_index = entry->folder_index;
+        player_state.current_file_index = track_orders.count > 0 ?
+                                          track_order_rank_of(&track_orders, sorted_key(), position) : position;
+        ESP_LOGI(TAG, "Found file at rank %d: %s", player_state.current_file_index, rel_path);
+        return;
+    }
+    if (entry != NULL) {
+        // A playlist holding the track stays the current folder
+        int list = player_state.current_folder_index - music_index.folder_count;
+        for (int j = 0; list >= 0 && j < playlist_size(&playlists, list); j++) {
+            if (playlist_track(&playlists, list, j) == position) {
+                player_state.current_file_index = j;
+                ESP_LOGI(TAG, "Found file in playlist %s, file %d: %s", playlists.lists[list].name, j, rel_path);
+                return;
+            }
+        }
+        player_state.current_folder_index = entry->folder_index;
+        
+        // Now find the file index within that folder
+        int size = folder_size(player_state.current_folder_index);
+        for (int j = 0; j < size; j++) {
+            file_entry_t *file = folder_file(player_state.current_folder_index, j);
+            if (file != NULL && strcmp(file->path, rel_path) == 0) {
+                player_state.current_file_index = j;
+                ESP_LOGI(TAG, "Found file in folder %d, file %d: %s", 
+                         player_state.current_folder_index, j, rel_path);
+                return;
             }
-            
-            ESP_LOGI(TAG, "Found file in allFiles with folder index %d: %s", 
-                     player_state.current_folder_index, rel_path);
-            return;
         }
+        
+        ESP_LOGI(TAG, "Found file in allFiles with folder index %d: %s", 
+                 player_state.current_folder_index, rel_path);
+        return;
     }
     
     ESP_LOGW(TAG, "File not found in index: %s", rel_path);
 }
 
-// Helper to free shuffle indices
-static void free_shuffle_indices(void) {
-    if (shuffle_indices) {
-        free(shuffle_indices);
-        shuffle_indices = NULL;
-        shuffle_count = 0;
-        shuffle_pos = 0;
+// Number of tracks the current mode shuffles
+static int shuffle_domain(void) {
+    if (player_state.mode == MODE_PLAY_ALL_SHUFFLE) {
+        return music_index.total_files;
+    }
+    if (player_state.mode == MODE_PLAY_FOLDER_SHUFFLE) {
+        return folder_size(player_state.current_folder_index);
     }
+    if (player_state.mode == MODE_PLAY_ALBUM_SHUFFLE) {
+        return track_orders.album_count;
+    }
+    return 0;
 }
 
-// Fisher-Yates shuffle
-static void shuffle_array(int *array, int n) {
-    for (int i = n - 1; i > 0; --i) {
-        int j = rand() % (i + 1);
-        int tmp = array[i];
-        array[i] = array[j];
-        array[j] = tmp;
+// Call this whenever the mode, folder or index changes. The order follows
+// from the saved seed; the position is kept if it still points at the
+// current track and is looked up from the track otherwise.
+static void update_shuffle_list(void) {
+    int count = shuffle_domain();
+    shuffle_active = count > 0;
+    if (!shuffle_active) {
+        return;
+    }
+    shuffle_init(&shuffle, player_state.shuffle_seed, count);
+    int index = player_state.current_file_index;
+    if (player_state.mode == MODE_PLAY_ALBUM_SHUFFLE) {
+        // Albums are shuffled; the position is the album's
+        index = track_order_album_of(&track_orders, index);
+    }
+    if (index < 0 || index >= count) {
+        index = 0;
+    }
+    int pos = player_state.shuffle_pos;
+    if (pos < 0 || pos >= count || (int)shuffle_index_at(&shuffle, pos) != index) {
+        player_state.shuffle_pos = shuffle_position_of(&shuffle, index);
     }
 }
 
-// Generate shuffle list for all files
-static void generate_shuffle_all(void) {
-    free_shuffle_indices();
-    if (music_index.total_files <= 0) return;
-    shuffle_count = music_index.total_files;
-    shuffle_indices = malloc(sizeof(int) * shuffle_count);
-    for (int i = 0; i < shuffle_count; ++i) shuffle_indices[i] = i;
-    shuffle_array(shuffle_indices, shuffle_count);
-    shuffle_pos = 0;
+// Deal a new shuffle order starting at the current track
+static void reseed_shuffle(void) {
+    player_state.shuffle_seed = esp_random();
+    player_state.shuffle_pos = -1;
+    update_shuffle_list();
 }
 
-// Generate shuffle list for current folder
-static void generate_shuffle_folder(void) {
-    free_shuffle_indices();
-    if (music_index.folder_count == 0 || player_state.current_folder_index >= music_index.folder_count) return;
-    folder_t *folder = &music_index.music_folders[player_state.current_folder_index];
-    if (folder->file_count <= 0) return;
-    shuffle_count = folder->file_count;
-    shuffle_indices = malloc(sizeof(int) * shuffle_count);
-    for (int i = 0; i < shuffle_count; ++i) shuffle_indices[i] = i;
-    shuffle_array(shuffle_indices, shuffle_count);
-    shuffle_pos = 0;
+// Wrap an index into [0, count)
+static int wrap_index(int index, int count) {
+    return ((index % count) + count) % count;
 }
 
-// Call this whenever mode is set or folder changes
-static void update_shuffle_list(void) {
-    if (player_state.mode == MODE_PLAY_ALL_SHUFFLE) {
-        generate_shuffle_all();
-    } else if (player_state.mode == MODE_PLAY_FOLDER_SHUFFLE) {
-        generate_shuffle_folder();
-    } else {
-        free_shuffle_indices();
+// Move one track through the album shuffle: within the album at shuffle
+// position *pos, then on to the first or last track of the adjacent album
+static void album_step(int *rank, int *pos, int direction) {
+    int album = shuffle_index_at(&shuffle, *pos);
+    int next = *rank + direction;
+    if (next >= (int)track_orders.album_first[album] && next < (int)track_orders.album_first[album + 1]) {
+        *rank = next;
+        return;
     }
+    *pos = wrap_index(*pos + direction, shuffle.count);
+    album = shuffle_index_at(&shuffle, *pos);
+    *rank = direction > 0 ? (int)track_orders.album_first[album] : (int)track_orders.album_first[album + 1] - 1;
 }
 
-// Select and play next file based on current mode
-static esp_err_t select_next_file(void) {
-    if (music_index.total_files == 0 || music_index.all_files == NULL) {
-        ESP_LOGW(TAG, "No files in index or all_files is NULL");
-        return ESP_FAIL;
+// Resolve the file `step` positions away from the current one in the current mode,
+// passing over quarantined tracks in the direction of the step. With commit set the
+// player position moves to it; otherwise the state is left untouched.
+static file_entry_t *neighbour_file(int step, bool commit) {
+    if (music_index.total_files == 0) {
+        ESP_LOGW(TAG, "No files in index");
+        return NULL;
     }
-    char full_path[256];
+    bool folder_mode = player_state.mode == MODE_PLAY_FOLDER_ORDER || player_state.mode == MODE_PLAY_FOLDER_SHUFFLE;
+    int count = music_index.total_files;
     if (player_state.mode == MODE_PLAY_ALL_ORDER) {
         // All files in order
-        player_state.current_file_index = (player_state.current_file_index + 1) % music_index.total_files;
-        json_get_full_path(music_index.all_files[player_state.current_file_index].path, full_path, sizeof(full_path));
     } else if (player_state.mode == MODE_PLAY_ALL_SHUFFLE) {
-        if (!shuffle_indices || shuffle_count != music_index.total_files) {
-            generate_shuffle_all();
+        if (!shuffle_active || (int)shuffle.count != count) {
+            update_shuffle_list();
+        }
+    } else if (player_state.mode == MODE_PLAY_ALBUM_SHUFFLE) {
+        if (!shuffle_active || (int)shuffle.count != track_orders.album_count) {
+            update_shuffle_list();
         }
-        shuffle_pos = (shuffle_pos + 1) % shuffle_count;
-        player_state.current_file_index = shuffle_indices[shuffle_pos];
-        json_get_full_path(music_index.all_files[player_state.current_file_index].path, full_path, sizeof(full_path));
-    } else if (player_state.mode == MODE_PLAY_FOLDER_ORDER) {
-        if (music_index.folder_count == 0 || player_state.current_folder_index >= music_index.folder_count) {
+    } else if (sorted_mode()) {
+        // Ranks of the order
+    } else if (folder_mode) {
+        if (folder_total() == 0 || player_state.current_folder_index >= folder_total()) {
             ESP_LOGW(TAG, "No folders or invalid folder index");
-            return ESP_FAIL;
+            return NULL;
         }
-        folder_t *folder = &music_index.music_folders[player_state.current_folder_index];
-        if (folder->file_count == 0) {
+        count = folder_size(player_state.current_folder_index);
+        if (count == 0) {
             ESP_LOGW(TAG, "No files in folder");
-            return ESP_FAIL;
-        }
-        player_state.current_file_index = (player_state.current_file_index + 1) % folder->file_count;
-        json_get_full_path(folder->files[player_state.current_file_index].path, full_path, sizeof(full_path));
-    } else if (player_state.mode == MODE_PLAY_FOLDER_SHUFFLE) {
-        if (music_index.folder_count == 0 || player_state.current_folder_index >= music_index.folder_count) {
-            ESP_LOGW(TAG, "No folders or invalid folder index");
-            return ESP_FAIL;
+            return NULL;
         }
-        folder_t *folder = &music_index.music_folders[player_state.current_folder_index];
-        if (!shuffle_indices || shuffle_count != folder->file_count) {
-            generate_shuffle_folder();
+        if (player_state.mode == MODE_PLAY_FOLDER_SHUFFLE && (!shuffle_active || (int)shuffle.count != count)) {
+            update_shuffle_list();
         }
-        shuffle_pos = (shuffle_pos + 1) % shuffle_count;
-        player_state.current_file_index = shuffle_indices[shuffle_pos];
-        json_get_full_path(folder->files[player_state.current_file_index].path, full_path, sizeof(full_path));
     } else {
         ESP_LOGW(TAG, "Unknown mode");
-        return ESP_FAIL;
+        return NULL;
     }
-    return play_file(full_path);
-}
+    bool shuffled = shuffle_active &&
+                    (player_state.mode == MODE_PLAY_ALL_SHUFFLE || player_state.mode == MODE_PLAY_FOLDER_SHUFFLE);
+    bool album_shuffled = shuffle_active && player_state.mode == MODE_PLAY_ALBUM_SHUFFLE;
+    bool sorted = sorted_mode();
 
-// Select and play previous file
-static esp_err_t select_prev_file(void) {
-    if (music_index.total_files == 0) {
-        ESP_LOGW(TAG, "No files in index");
-        return ESP_FAIL;
-    }
-    char full_path[256];
-    if (player_state.mode == MODE_PLAY_ALL_ORDER) {
-        player_state.current_file_index = (player_state.current_file_index == 0) ? (music_index.total_files - 1) : (player_state.current_file_index - 1);
-        json_get_full_path(music_index.all_files[player_state.current_file_index].path, full_path, sizeof(full_path));
-    } else if (player_state.mode == MODE_PLAY_ALL_SHUFFLE) {
-        if (!shuffle_indices || shuffle_count != music_index.total_files) {
-            generate_shuffle_all();
+    int direction = step < 0 ? -1 : 1;
+    // The album shuffle is walked a track at a time from the current one
+    int album_rank = player_state.current_file_index;
+    int album_pos = player_state.shuffle_pos;
+    for (int tried = 0; tried < count; tried++, step += direction) {
+        int file_index;
+        int pos = player_state.shuffle_pos;
+        if (album_shuffled) {
+            for (int moves = tried == 0 ? step * direction : 1; moves > 0; moves--) {
+                album_step(&album_rank, &album_pos, direction);
+            }
+            file_index = album_rank;
+            pos = album_pos;
+        } else if (shuffled) {
+            pos = wrap_index(pos + step, shuffle.count);
+            file_index = shuffle_index_at(&shuffle, pos);
+        } else {
+            file_index = wrap_index(player_state.current_file_index + step, count);
         }
-        shuffle_pos = (shuffle_pos == 0) ? (shuffle_count - 1) : (shuffle_pos - 1);
-        player_state.current_file_index = shuffle_indices[shuffle_pos];
-        json_get_full_path(music_index.all_files[player_state.current_file_index].path, full_path, sizeof(full_path));
-    } else if (player_state.mode == MODE_PLAY_FOLDER_ORDER) {
-        if (music_index.folder_count == 0 || player_state.current_folder_index >= music_index.folder_count) {
-            ESP_LOGW(TAG, "No folders or invalid folder index");
-            return ESP_FAIL;
+        file_entry_t *entry;
+        if (folder_mode) {
+            entry = folder_file(player_state.current_folder_index, file_index);
+            if (entry != NULL && quarantine_contains(&quarantine, entry->position)) {
+                continue;
+            }
+        } else {
+            // No entry is looked up for a quarantined track
+            int position = sorted ? sorted_position(file_index) : file_index;
+            if (quarantine_contains(&quarantine, position)) {
+                continue;
+            }
+            entry = json_index_file(&music_index, position);
         }
-        folder_t *folder = &music_index.music_folders[player_state.current_folder_index];
-        if (folder->file_count == 0) {
-            ESP_LOGW(TAG, "No files in folder");
-            return ESP_FAIL;
+        if (commit) {
+            player_state.current_file_index = file_index;
+            player_state.shuffle_pos = pos;
         }
-        player_state.current_file_index = (player_state.current_file_index == 0) ? (folder->file_count - 1) : (player_state.current_file_index - 1);
-        json_get_full_path(folder->files[player_state.current_file_index].path, full_path, sizeof(full_path));
-    } else if (player_state.mode == MODE_PLAY_FOLDER_SHUFFLE) {
-        if (music_index.folder_count == 0 || player_state.current_folder_index >= music_index.folder_count) {
-            ESP_LOGW(TAG, "No folders or invalid folder index");
+        return entry;
+    }
+    ESP_LOGW(TAG, "Every track in reach is quarantined");
+    return NULL;
+}
+
+// Play the track `step` away in the current mode, moving on in the same
+// direction past tracks that fail to open. Those are quarantined, so each
+// is tried once; a missing card ends the search.
+static esp_err_t play_neighbour(int step) {
+    esp_err_t ret = ESP_FAIL;
+    for (int tries = 0; tries < music_index.total_files && !card_missing; tries++) {
+        file_entry_t *entry = neighbour_file(tries == 0 ? step : (step < 0 ? -1 : 1), true);
+        if (entry == NULL) {
             return ESP_FAIL;
         }
-        folder_t *folder = &music_index.music_folders[player_state.current_folder_index];
-        if (!shuffle_indices || shuffle_count != folder->file_count) {
-            generate_shuffle_folder();
+        char full_path[256];
+        json_get_full_path(entry->path, full_path, sizeof(full_path));
+        ret = play_file(full_path);
+        if (ret == ESP_OK) {
+            break;
         }
-        shuffle_pos = (shuffle_pos == 0) ? (shuffle_count - 1) : (shuffle_pos - 1);
-        player_state.current_file_index = shuffle_indices[shuffle_pos];
-        json_get_full_path(folder->files[player_state.current_file_index].path, full_path, sizeof(full_path));
+    }
+    return ret;
+}
+
+// Play a track of allFiles, moving the position of the current mode to it
+static esp_err_t play_index(int index) {
+    file_entry_t *entry = json_index_file(&music_index, index);
+    if (entry == NULL) {
+        ESP_LOGW(TAG, "No track %d in the index", index);
+        return ESP_ERR_NOT_FOUND;
+    }
+    int folder_index = entry->folder_index;
+    char full_path[256];
+    json_get_full_path(entry->path, full_path, sizeof(full_path));
+    if (player_state.mode == MODE_PLAY_ALL_ORDER || player_state.mode == MODE_PLAY_ALL_SHUFFLE) {
+        player_state.current_folder_index = folder_index;
+        player_state.current_file_index = index;
     } else {
-        ESP_LOGW(TAG, "Unknown mode");
-        return ESP_FAIL;
+        update_current_folder_index_for_file(full_path);
     }
+    // The shuffle position follows the track
+    update_shuffle_list();
+    prefetch_step = 0;
     return play_file(full_path);
 }
 
+// Select and play next file based on current mode
+static esp_err_t select_next_file(void) {
+    return play_neighbour(1);
+}
+
+// Select and play previous file
+static esp_err_t select_prev_file(void) {
+    return play_neighbour(-1);
+}
+
+// Play the first file of the current folder (or first in shuffle)
+static esp_err_t play_folder_start(void) {
+    if (player_state.mode == MODE_PLAY_FOLDER_SHUFFLE && shuffle_active) {
+        player_state.current_file_index = shuffle_index_at(&shuffle, 0);
+        player_state.shuffle_pos = 0;
+    }
+    file_entry_t *entry = folder_file(player_state.current_folder_index, player_state.current_file_index);
+    if (entry == NULL) {
+        ESP_LOGW(TAG, "No files in folder");
+        return ESP_FAIL;
+    }
+    char full_path[256];
+    json_get_full_path(entry->path, full_path, sizeof(full_path));
+    esp_err_t ret = quarantine_contains(&quarantine, entry->position) ? ESP_FAIL : play_file(full_path);
+    if (ret != ESP_OK && !card_missing) {
+        // The folder's first track is out; start with the next one that plays
+        ret = play_neighbour(1);
+    }
+
+    // Folder skips usually come in runs; read the adjacent folders' pages ahead.
+    // Playlists are not paged by folder and have nothing to prefetch.
+    int count = folder_total();
+    json_index_prefetch_folder(&music_index, (player_state.current_folder_index + 1) % count);
+    json_index_prefetch_folder(&music_index, (player_state.current_folder_index + count - 1) % count);
+    return ret;
+}
+
 // Select and play next folder
 static esp_err_t select_next_folder(void) {
-    if (music_index.folder_count == 0) {
+    if (folder_total() == 0) {
         ESP_LOGW(TAG, "No folders in index");
         return ESP_FAIL;
     }
     // Move to next folder
-    player_state.current_folder_index = (player_state.current_folder_index + 1) % music_index.folder_count;
+    player_state.current_folder_index = (player_state.current_folder_index + 1) % folder_total();
     // Reset file index
     player_state.current_file_index = 0;
-    // Regenerate shuffle list if in folder shuffle mode
+    // Deal a new order for the folder if in folder shuffle mode
     if (player_state.mode == MODE_PLAY_FOLDER_SHUFFLE) {
-        generate_shuffle_folder();
-    }
-    // Play first file in folder (or first in shuffle)
-    folder_t *folder = &music_index.music_folders[player_state.current_folder_index];
-    if (folder->file_count == 0) {
-        ESP_LOGW(TAG, "No files in folder");
-        return ESP_FAIL;
+        reseed_shuffle();
     }
-    char full_path[256];
-    if (player_state.mode == MODE_PLAY_FOLDER_SHUFFLE && shuffle_indices && shuffle_count > 0) {
-        player_state.current_file_index = shuffle_indices[0];
-        json_get_full_path(folder->files[player_state.current_file_index].path, full_path, sizeof(full_path));
-    } else {
-        json_get_full_path(folder->files[0].path, full_path, sizeof(full_path));
-    }
-    return play_file(full_path);
+    return play_folder_start();
 }
 
 // Select and play previous folder
 static esp_err_t select_prev_folder(void) {
-    if (music_index.folder_count == 0) {
+    if (folder_total() == 0) {
         ESP_LOGW(TAG, "No folders in index");
         return ESP_FAIL;
     }
     // Move to previous folder
-    player_state.current_folder_index = (player_state.current_folder_index == 0) ? (music_index.folder_count - 1) : (player_state.current_folder_index - 1);
+    player_state.current_folder_index = (player_state.current_folder_index == 0) ? (folder_total() - 1) : (player_state.current_folder_index - 1);
     // Reset file index
     player_state.current_file_index = 0;
-    // Regenerate shuffle list if in folder shuffle mode
+    // Deal a new order for the folder if in folder shuffle mode
     if (player_state.mode == MODE_PLAY_FOLDER_SHUFFLE) {
-        generate_shuffle_folder();
-    }
-    // Play first file in folder (or first in shuffle)
-    folder_t *folder = &music_index.music_folders[player_state.current_folder_index];
-    if (folder->file_count == 0) {
-        ESP_LOGW(TAG, "No files in folder");
-        return ESP_FAIL;
-    }
-    char full_path[256];
-    if (player_state.mode == MODE_PLAY_FOLDER_SHUFFLE && shuffle_indices && shuffle_count > 0) {
-        player_state.current_file_index = shuffle_indices[0];
-        json_get_full_path(folder->files[player_state.current_file_index].path, full_path, sizeof(full_path));
-    } else {
-        json_get_full_path(folder->files[0].path, full_path, sizeof(full_path));
+        reseed_shuffle();
     }
-    return play_file(full_path);
+    return play_folder_start();
 }
 
 // Function to configure I2S for specific audio parameters
@@ -991,8 +2253,7 @@ static esp_err_t configure_i2s(uint32_t sample_rate, uint16_t bit_depth, uint16_
         }
     };
     
-    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_PORT, I2S_ROLE_MASTER);
-    esp_err_t ret = i2s_new_channel(&chan_cfg, &i2s_tx_chan, NULL);
+    esp_err_t ret = new_tx_channel();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to create I2S TX channel");
         return ret;
@@ -1023,6 +2284,54 @@ static esp_err_t configure_i2s(uint32_t sample_rate, uint16_t bit_depth, uint16_
     return ESP_OK;
 }
 
+// DMA callback: every buffer of the send queue is free, so the DAC gets no new audio
+static IRAM_ATTR bool on_send_underrun(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx) {
+    if (!output_starved) {
+        output_starved = true;
+        if (output_armed) {
+            underruns++;
+        }
+    }
+    return false;
+}
+
+// Create the TX channel with the tuned DMA queue. Starved buffers are sent
+// as silence rather than replaying stale audio.
+static esp_err_t new_tx_channel(void) {
+    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_PORT, I2S_ROLE_MASTER);
+    chan_cfg.dma_desc_num = dma_desc_num;
+    chan_cfg.dma_frame_num = dma_frame_num;
+    chan_cfg.auto_clear = true;
+    output_starved = true;
+    esp_err_t ret = i2s_new_channel(&chan_cfg, &i2s_tx_chan, NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    i2s_event_callbacks_t callbacks = { .on_send_q_ovf = on_send_underrun };
+    ret = i2s_channel_register_event_callback(i2s_tx_chan, &callbacks, NULL);
+    if (ret != ESP_OK) {
+        i2s_del_channel(i2s_tx_chan);
+        i2s_tx_chan = NULL;
+    }
+    return ret;
+}
+
+// Recreate the output channel with a new DMA queue in the current format
+static void retune_output(uint32_t desc_num, uint32_t frame_num) {
+    dma_desc_num = desc_num;
+    dma_frame_num = frame_num;
+    ESP_LOGI(TAG, "I2S DMA queue set to %u x %u frames", (unsigned)desc_num, (unsigned)frame_num);
+    if (current_i2s_sample_rate == 0) {
+        // Nothing played yet; the first track creates the channel
+        return;
+    }
+    uint32_t sample_rate = current_i2s_sample_rate;
+    current_i2s_sample_rate = 0;
+    if (configure_i2s(sample_rate, current_i2s_bit_depth, current_i2s_channels) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to recreate the I2S channel");
+    }
+}
+
 #ifdef TEST_MODE
 // Test helper function to manually trigger file selection
 esp_err_t test_select_next_file(void) {
@@ -1033,11 +2342,45 @@ esp_err_t test_select_prev_file(void) {
     return select_prev_file();
 }
 
+esp_err_t test_play_index(int index) {
+    return play_index(index);
+}
+
+esp_err_t test_select_next_folder(void) {
+    return select_next_folder();
+}
+
+esp_err_t test_select_prev_folder(void) {
+    return select_prev_folder();
+}
+
+// Read index.json and the playlists again, as after a library scan
+void test_reload_index(void) {
+    reload_index(false);
+}
+
+// One pass of the player loop while the card is missing
+void test_card_poll(void) {
+    card_poll();
+}
+
+esp_err_t test_seek_current(uint32_t position_ms) {
+    return seek_current(position_ms);
+}
+
+// One read of the current track with the tuned read size
+esp_err_t test_read_current_file(size_t *bytes_read) {
+    return timed_pcm_read(&current_pcm_file, audio_buffer, read_size, bytes_read);
+}
+
 esp_err_t test_play_current_file(void) {
     // Get current file path
     char filepath[256];
-    esp_err_t ret = json_get_full_path(music_index.all_files[player_state.current_file_index].path, 
-                                       filepath, sizeof(filepath));
+    file_entry_t *entry = json_index_file(&music_index, player_state.current_file_index);
+    if (entry == NULL) {
+        return ESP_FAIL;
+    }
+    esp_err_t ret = json_get_full_path(entry->path, filepath, sizeof(filepath));
     if (ret != ESP_OK) {
         return ret;
     }
@@ -23,6 +23,9 @@ typedef enum {
     MODE_PLAY_ALL_SHUFFLE,        // Play all files in random order
     MODE_PLAY_FOLDER_ORDER,       // Play current folder in order
     MODE_PLAY_FOLDER_SHUFFLE,     // Play current folder in random order
+    MODE_PLAY_ARTIST_ORDER,       // Play all files by artist, then album
+    MODE_PLAY_ALBUM_ORDER,        // Play all files album by album
+    MODE_PLAY_ALBUM_SHUFFLE,      // Play albums in random order, each in order
     MODE_MAX
 } playback_mode_t;
 
@@ -40,8 +43,43 @@ typedef struct {
     uint32_t current_sample_rate;
     uint16_t current_bit_depth;
     uint16_t current_channels;
+    // Shuffle order and how far into it playback is; saved so the order survives a restart
+    uint32_t shuffle_seed;
+    int shuffle_pos;
 } player_state_t;
 
+// Runtime tuning limits. A DMA buffer holds at most 4092 bytes, 511 frames of
+// 32-bit stereo; reads are whole card sectors up to the player's audio buffer.
+#define AUDIO_PLAYER_DMA_DESC_MIN       2
+#define AUDIO_PLAYER_DMA_DESC_MAX       16
+#define AUDIO_PLAYER_DMA_FRAME_MIN      8
+#define AUDIO_PLAYER_DMA_FRAME_MAX      511
+#define AUDIO_PLAYER_READ_SIZE_MIN      512
+#define AUDIO_PLAYER_READ_SIZE_MAX      4096
+
+// Output pipeline telemetry
+typedef struct {
+    uint32_t sd_read_bps;       // Moving average of the track read throughput
+    uint32_t reads;             // Track reads since boot
+    uint32_t read_worst_us;     // Slowest read since the previous call
+    uint32_t underruns;         // Times the I2S DMA queue ran dry during playback
+    size_t ring_fill;           // Decoded MP3 audio queued ahead of the player, 0 for other codecs
+    uint32_t dma_desc_num;      // I2S DMA queue in use
+    uint32_t dma_frame_num;
+    size_t read_size;           // Bytes asked for per read
+    int quarantined;            // Tracks skipped since the index was loaded, having failed to open
+    uint32_t card_removals;     // Times the card went missing since boot
+} audio_player_stats_t;
+
+// One track read, recorded while tracing is on
+typedef struct {
+    uint32_t time_ms;           // Since boot
+    uint32_t read_us;           // How long the read took
+    uint32_t bytes;             // Bytes it returned
+    uint32_t ring_fill;         // MP3 ring fill after the read
+    uint32_t underruns;         // Underrun count at the time
+} audio_player_trace_t;
+
 /**
  * @brief Initialize the audio player
  * 
@@ -94,11 +132,26 @@ esp_err_t audio_player_prev_folder(void);
 /**
  * @brief Change playback mode
  * 
+ * The player task applies the change, after the commands already queued.
+ * 
  * @param mode The new playback mode
- * @return ESP_OK on success
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE while the index loads
  */
 esp_err_t audio_player_set_mode(playback_mode_t mode);
 
+/**
+ * @brief Set the crossfade length between consecutive tracks
+ * 
+ * The fade falls back to a hard cut when the next track has a different
+ * format or the SD card is too slow to read both tracks at once. A card
+ * only slightly too slow gets the outgoing track read ahead before the
+ * fade, sized from the measured throughput.
+ * 
+ * @param seconds Crossfade length in seconds, 0 disables crossfading
+ * @return ESP_OK on success
+ */
+esp_err_t audio_player_set_crossfade(uint16_t seconds);
+
 /**
  * @brief Get current player state
  * 
@@ -121,11 +174,105 @@ esp_err_t audio_player_save_state(void);
 esp_err_t audio_player_load_state(void);
 
 /**
- * @brief Seek to a specific position in the current track
+ * @brief Seek to a time in the current track
  * 
- * @param byte_position Position to seek to, in bytes
- * @return ESP_OK on success
+ * The seek is carried out by the player task, so it never races a read of
+ * the track. The position is rounded down to a frame boundary and audio
+ * already queued for the DAC is dropped. Blocks until the seek is done;
+ * must not be called from the player task.
+ * 
+ * @param position_ms Position in milliseconds from the start of the track
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if no track is open
+ */
+esp_err_t audio_player_seek_ms(uint32_t position_ms);
+
+/**
+ * @brief Get the playback position in the current track
+ * 
+ * Computed from the track format, without touching the file.
+ * 
+ * @return Position in milliseconds
+ */
+uint32_t audio_player_get_position_ms(void);
+
+/**
+ * @brief Get the length of the current track
+ * 
+ * @return Length in milliseconds, 0 if unknown
+ */
+uint32_t audio_player_get_duration_ms(void);
+
+/**
+ * @brief Play a track of the index
+ * 
+ * The current mode stays; next and previous continue from the new track.
+ * 
+ * @param index Position of the track in allFiles
+ * @return ESP_OK if the command was queued, ESP_ERR_INVALID_ARG for an index
+ *         outside the library, ESP_ERR_INVALID_STATE while the index loads
+ */
+esp_err_t audio_player_play_index(int index);
+
+/**
+ * @brief Get output pipeline telemetry
+ * 
+ * Safe to call from any task; the counters are published by the player task.
+ * 
+ * @param stats Pointer to store the telemetry
+ */
+void audio_player_get_stats(audio_player_stats_t *stats);
+
+/**
+ * @brief Turn recording of per-read trace events on or off
+ * 
+ * @param enabled true to record
+ */
+void audio_player_set_trace(bool enabled);
+
+/**
+ * @brief Take recorded trace events, oldest first
+ * 
+ * Meant for a single reader. Events are dropped while the buffer is full.
+ * 
+ * @param events Array to fill
+ * @param max_count Size of the array
+ * @param dropped Pointer to store the events dropped since the previous call, or NULL
+ * @return Number of events taken
+ */
+size_t audio_player_take_trace(audio_player_trace_t *events, size_t max_count, uint32_t *dropped);
+
+/**
+ * @brief Set how many bytes the player asks for per track read
+ * 
+ * Applies from the next read.
+ * 
+ * @param bytes Multiple of 512 from AUDIO_PLAYER_READ_SIZE_MIN to AUDIO_PLAYER_READ_SIZE_MAX
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if out of range
+ */
+esp_err_t audio_player_set_read_size(size_t bytes);
+
+/**
+ * @brief Resize the I2S DMA queue
+ * 
+ * The player task recreates the output channel between two buffers, which
+ * drops the audio still queued. Larger queues ride out longer card stalls at
+ * the cost of RAM and control latency.
+ * 
+ * @param desc_num Number of DMA buffers, AUDIO_PLAYER_DMA_DESC_MIN to AUDIO_PLAYER_DMA_DESC_MAX
+ * @param frame_num Frames per buffer, AUDIO_PLAYER_DMA_FRAME_MIN to AUDIO_PLAYER_DMA_FRAME_MAX
+ * @return ESP_OK if the change was queued, ESP_ERR_INVALID_ARG if out of range
+ */
+esp_err_t audio_player_set_dma_buffers(uint32_t desc_num, uint32_t frame_num);
+
+/**
+ * @brief Rebuild index.json from the files on the card
+ * 
+ * The scan runs in a low-priority task and only probes directories that
+ * changed since the last scan. The player switches to the new index when
+ * it is written.
+ * 
+ * @return ESP_OK if the scan started, ESP_ERR_INVALID_STATE if one is already running
  */
-esp_err_t audio_player_seek(size_t byte_position);
+esp_err_t audio_player_rescan_library(void);
 
 #endif // AUDIO_PLAYER_H
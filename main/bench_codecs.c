@@ -0,0 +1,164 @@
+// Host benchmark for the decoders in the playback pipeline.
+// Reports decode time per second of audio and checks it against the CPU budget
+// on the ESP32, estimated by scaling host time by HOST_TO_ESP32_SLOWDOWN.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "ima_adpcm.h"
+#include "flac_decoder.h"
+#include "test_flac_encoder.h"
+
+// Rough ratio between this host and a 240 MHz Xtensa core on integer DSP code
+#define HOST_TO_ESP32_SLOWDOWN  30.0
+
+// Share of one core the decoder may use; the rest goes to SD reads, I2S and buttons
+#define CPU_BUDGET_PCT          25.0
+
+#define BENCH_SAMPLE_RATE       44100
+#define BENCH_SECONDS           60
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Deterministic test material: two detuned triangle waves plus noise
+static void fill_signal(int16_t *pcm, size_t frames, uint16_t channels) {
+    uint32_t seed = 12345;
+    for (size_t f = 0; f < frames; f++) {
+        for (uint16_t c = 0; c < channels; c++) {
+            int32_t period = c ? 113 : 97;
+            int32_t phase = (int32_t)(f % period);
+            int32_t tri = phase < period / 2 ? phase : period - phase;
+            seed = seed * 1103515245 + 12345;
+            int32_t noise = (int32_t)((seed >> 16) & 0x3FF) - 512;
+            pcm[f * channels + c] = (int16_t)((tri * 4 * 12000) / period - 12000 + noise);
+        }
+    }
+}
+
+// Report one result; returns 0 when within budget
+static int report(const char *name, double audio_seconds, double decode_seconds) {
+    double realtime = audio_seconds / decode_seconds;
+    double esp32_pct = 100.0 * HOST_TO_ESP32_SLOWDOWN / realtime;
+    int ok = esp32_pct <= CPU_BUDGET_PCT;
+    printf("%-28s %8.1f us/s audio %8.0fx realtime  ~%5.1f%% ESP32 core  %s\n",
+           name, 1e6 * decode_seconds / audio_seconds, realtime, esp32_pct, ok ? "OK" : "OVER BUDGET");
+    return ok ? 0 : 1;
+}
+
+static int bench_ima_adpcm(uint16_t channels, size_t block_align) {
+    size_t frames_per_block = ima_adpcm_frames_per_block(block_align, channels);
+    size_t blocks = (size_t)BENCH_SAMPLE_RATE * BENCH_SECONDS / frames_per_block;
+    int16_t *pcm = malloc(frames_per_block * channels * sizeof(int16_t));
+    int16_t *out = malloc(frames_per_block * channels * sizeof(int16_t));
+    uint8_t *encoded = malloc(blocks * block_align);
+    uint8_t step_index[2] = {0, 0};
+    if (!pcm || !out || !encoded) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    fill_signal(pcm, frames_per_block, channels);
+    for (size_t b = 0; b < blocks; b++) {
+        ima_adpcm_encode_block(pcm, channels, block_align, step_index, encoded + b * block_align);
+    }
+
+    double start = now_seconds();
+    uint32_t checksum = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        size_t frames = ima_adpcm_decode_block(encoded + b * block_align, block_align, channels, out);
+        checksum += (uint16_t)out[frames * channels - 1];
+    }
+    double elapsed = now_seconds() - start;
+
+    char name[64];
+    snprintf(name, sizeof(name), "ima_adpcm %s block %zu", channels == 2 ? "stereo" : "mono", block_align);
+    double audio_seconds = (double)(blocks * frames_per_block) / BENCH_SAMPLE_RATE;
+    int ret = report(name, audio_seconds, elapsed);
+    if (checksum == 0xFFFFFFFF) {
+        printf("(checksum %u)\n", checksum);  // keeps the decode loop from being optimized out
+    }
+
+    free(pcm);
+    free(out);
+    free(encoded);
+    return ret;
+}
+
+static int bench_flac(uint16_t bit_depth, uint32_t lpc_order) {
+    const uint16_t channels = 2;
+    size_t frames = (size_t)BENCH_SAMPLE_RATE * BENCH_SECONDS;
+    int16_t *pcm = malloc(frames * channels * sizeof(int16_t));
+    int32_t *samples = malloc(frames * channels * sizeof(int32_t));
+    if (!pcm || !samples) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    fill_signal(pcm, frames, channels);
+    // Add low-level detail below 16 bits so 24-bit material is not just padding
+    uint32_t seed = 777;
+    for (size_t i = 0; i < frames * channels; i++) {
+        seed = seed * 1103515245 + 12345;
+        samples[i] = bit_depth > 16 ? pcm[i] * 256 + (int32_t)((seed >> 16) & 0xFF) - 128 : pcm[i];
+    }
+
+    test_flac_options_t options = {.block_size = 4096, .lpc_order = lpc_order, .seek_interval = 10};
+    size_t size;
+    uint8_t *stream = test_flac_encode(samples, frames, BENCH_SAMPLE_RATE, channels, bit_depth, &options, &size);
+    FILE *file = tmpfile();
+    if (!stream || !file) {
+        fprintf(stderr, "Failed to prepare FLAC stream\n");
+        exit(1);
+    }
+    fwrite(stream, 1, size, file);
+
+    flac_decoder_t *dec = flac_decoder_acquire();
+    if (flac_decoder_open(dec, file) != ESP_OK) {
+        fprintf(stderr, "Failed to open FLAC stream\n");
+        exit(1);
+    }
+    static uint8_t out[4096];
+    size_t bytes_read;
+    size_t total = 0;
+    double start = now_seconds();
+    do {
+        flac_decoder_read(dec, out, sizeof(out), &bytes_read);
+        total += bytes_read;
+    } while (bytes_read > 0);
+    double elapsed = now_seconds() - start;
+
+    char name[64];
+    snprintf(name, sizeof(name), "flac %u-bit stereo lpc %u", bit_depth, lpc_order);
+    double audio_seconds = (double)total / (channels * (dec->bit_depth / 8)) / BENCH_SAMPLE_RATE;
+    int ret = report(name, audio_seconds, elapsed);
+    printf("%-28s %8.1f%% of PCM size\n", "", 100.0 * size / (frames * channels * (bit_depth > 16 ? 3 : 2)));
+
+    flac_decoder_release(dec);
+    fclose(file);
+    free(stream);
+    free(samples);
+    free(pcm);
+    return ret;
+}
+
+int main(void) {
+    printf("Decoder benchmark: %d s of %d Hz audio, budget %.0f%% of an ESP32 core (host x%.0f)\n\n",
+           BENCH_SECONDS, BENCH_SAMPLE_RATE, CPU_BUDGET_PCT, HOST_TO_ESP32_SLOWDOWN);
+
+    int failures = 0;
+    failures += bench_ima_adpcm(2, 1024);
+    failures += bench_ima_adpcm(2, 2048);
+    failures += bench_ima_adpcm(1, 512);
+    failures += bench_flac(16, 8);
+    failures += bench_flac(24, 8);
+    failures += bench_flac(24, 12);
+
+    printf("\n%s\n", failures ? "Some decoders exceed the CPU budget" : "All decoders within the CPU budget");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+#include "boot_profile.h"
+#include "mem_policy.h"
+#include <stdio.h>
+
+#ifndef TEST_MODE
+#include "esp_log.h"
+#include "esp_timer.h"
+#else
+#include <time.h>
+#define ESP_LOGI(tag, format, ...) printf("[INFO] " format "\n", ##__VA_ARGS__)
+
+// Host runs measure from the first event instead of from reset
+static int64_t esp_timer_get_time(void) {
+    static int64_t origin = 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t now = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    if (origin == 0) {
+        origin = now;
+    }
+    return now - origin;
+}
+#endif
+
+static const char *TAG = "boot_profile";
+
+static boot_event_t events[BOOT_PROFILE_MAX_EVENTS];
+static int event_count = 0;
+
+// Claim a slot; phases begin from app_main, the player task and the index task
+static int claim_event(void) {
+    int id = __atomic_fetch_add(&event_count, 1, __ATOMIC_RELAXED);
+    if (id >= BOOT_PROFILE_MAX_EVENTS) {
+        return -1;
+    }
+    return id;
+}
+
+static void heap_snapshot(boot_event_t *event) {
+    mem_capacity_t capacity;
+    mem_get_capacity(MEM_HOT, &capacity);
+    event->heap_free = capacity.free_bytes;
+    event->heap_largest = capacity.largest_block;
+}
+
+int boot_profile_begin(const char *name) {
+    int id = claim_event();
+    if (id < 0) {
+        return -1;
+    }
+    events[id].name = name;
+    events[id].start_us = esp_timer_get_time();
+    events[id].end_us = -1;
+    events[id].task = false;
+    return id;
+}
+
+void boot_profile_end(int id) {
+    if (id < 0 || id >= BOOT_PROFILE_MAX_EVENTS) {
+        return;
+    }
+    heap_snapshot(&events[id]);
+    events[id].end_us = esp_timer_get_time();
+}
+
+void boot_profile_task(const char *name) {
+    int id = claim_event();
+    if (id < 0) {
+        return;
+    }
+    events[id].name = name;
+    events[id].start_us = esp_timer_get_time();
+    heap_snapshot(&events[id]);
+    events[id].task = true;
+    events[id].end_us = events[id].start_us;
+}
+
+bool boot_profile_get(int index, boot_event_t *event) {
+    int count = event_count < BOOT_PROFILE_MAX_EVENTS ? event_count : BOOT_PROFILE_MAX_EVENTS;
+    if (index < 0 || index >= count) {
+        return false;
+    }
+    *event = events[index];
+    return true;
+}
+
+void boot_profile_report(void) {
+    ESP_LOGI(TAG, "%-24s %9s %9s %10s %10s", "phase", "start ms", "took ms", "free heap", "largest");
+    boot_event_t event;
+    for (int i = 0; boot_profile_get(i, &event); i++) {
+        char took[16];
+        if (event.task) {
+            snprintf(took, sizeof(took), "task");
+        } else if (event.end_us < 0) {
+            snprintf(took, sizeof(took), "running");
+        } else {
+            snprintf(took, sizeof(took), "%.1f", (event.end_us - event.start_us) / 1000.0);
+        }
+        bool ended = event.end_us >= 0;
+        ESP_LOGI(TAG, "%-24s %9.1f %9s %10u %10u", event.name, event.start_us / 1000.0, took,
+                 (unsigned)(ended ? event.heap_free : 0), (unsigned)(ended ? event.heap_largest : 0));
+    }
+    if (event_count > BOOT_PROFILE_MAX_EVENTS) {
+        ESP_LOGI(TAG, "%d events dropped", event_count - BOOT_PROFILE_MAX_EVENTS);
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Events kept for the report; later ones are dropped
+#define BOOT_PROFILE_MAX_EVENTS  24
+
+typedef struct {
+    const char *name;           // Static string, not copied
+    int64_t start_us;           // Time since reset
+    int64_t end_us;             // -1 while the phase is still running
+    uint32_t heap_free;         // Free internal RAM when the phase ended
+    uint32_t heap_largest;      // Largest free block of it; far below heap_free means fragmented
+    bool task;                  // Task creation rather than a phase
+} boot_event_t;
+
+/**
+ * @brief Start timing a boot phase
+ *
+ * Safe to call from any task. Phases may overlap, e.g. the index loading
+ * on the other core while the first track starts.
+ *
+ * @param name Phase name, must stay valid until the report is printed
+ * @return Handle for boot_profile_end(), -1 if the event table is full
+ */
+int boot_profile_begin(const char *name);
+
+/**
+ * @brief End a boot phase and take a free-heap and largest-block snapshot
+ *
+ * @param id Handle from boot_profile_begin(); -1 is ignored
+ */
+void boot_profile_end(int id);
+
+/**
+ * @brief Record the creation of a task
+ *
+ * @param name Task name
+ */
+void boot_profile_task(const char *name);
+
+/**
+ * @brief Copy out a recorded event
+ *
+ * @param index Event index in recording order
+ * @param event Pointer to store the event
+ * @return true if the event exists
+ */
+bool boot_profile_get(int index, boot_event_t *event);
+
+/**
+ * @brief Log the boot timeline as one table
+ *
+ * Phases still running are shown as such.
+ */
+void boot_profile_report(void);
+
+#endif // BOOT_PROFILE_H
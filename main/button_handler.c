@@ -1,12 +1,17 @@
 #include "button_handler.h"
 #include <stdio.h>
 #include <string.h>
-#include "esp_log.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
 #include "../components/ezbutton/ezbutton.h"
 #include "audio_player.h"
 
+#ifndef TEST_MODE
+#include "esp_log.h"
+#else
+// Host harnesses set up thousands of handlers; only errors are printed
+#define ESP_LOGI(tag, format, ...) ((void)0)
+#define ESP_LOGE(tag, format, ...) printf("[ERROR] " format "\n", ##__VA_ARGS__)
+#endif
+
 static const char *TAG = "button_handler";
 
 #define BTN_LONGPRESS_TIME_MS 1000
@@ -29,6 +34,11 @@ static button_state_t menu_state = {0};
 
 static unsigned long last_back_press_time = 0;
 
+// The steady level is the pin level; buttons are wired active low
+static bool is_pressed(ezButton_t *button) {
+    return ezButton_getState(button) == button->pressedState;
+}
+
 // Initialize button handling
 esp_err_t button_handler_init(void) {
     ESP_LOGI(TAG, "Initializing button handler");
@@ -64,9 +74,18 @@ esp_err_t button_handler_init(void) {
     return ESP_OK;
 }
 
+void button_handler_deinit(void) {
+    ezButton_delete(btn_fwd);
+    ezButton_delete(btn_bck);
+    ezButton_delete(btn_menu);
+    btn_fwd = btn_bck = btn_menu = NULL;
+    fwd_state = bck_state = menu_state = (button_state_t){0};
+    last_back_press_time = 0;
+}
+
 // Process button states and return the appropriate action
 button_action_t button_handler_get_action(void) {
-    unsigned long now = pdTICKS_TO_MS(xTaskGetTickCount());
+    unsigned long now = ezButton_millis();
     
     // MUST call loop() first to update button states
     ezButton_loop(btn_fwd);
@@ -76,12 +95,13 @@ button_action_t button_handler_get_action(void) {
     player_state_t state = audio_player_get_state();
 
     // FORWARD BUTTON
-    bool fwd_pressed = ezButton_getState(btn_fwd);
+    bool fwd_pressed = is_pressed(btn_fwd);
     if (fwd_pressed && !fwd_state.last_state) {
         fwd_state.pressed_time = now;
         fwd_state.long_press_handled = false;
     }
     if (!fwd_pressed && fwd_state.last_state) {
+        fwd_state.last_state = false;
         unsigned long press_duration = now - fwd_state.pressed_time;
         if ((state.mode == MODE_PLAY_FOLDER_ORDER || state.mode == MODE_PLAY_FOLDER_SHUFFLE) && press_duration >= BTN_LONGPRESS_TIME_MS) {
             return BTN_ACTION_NEXT_FOLDER;
@@ -92,12 +112,13 @@ button_action_t button_handler_get_action(void) {
     fwd_state.last_state = fwd_pressed;
 
     // BACK BUTTON
-    bool bck_pressed = ezButton_getState(btn_bck);
+    bool bck_pressed = is_pressed(btn_bck);
     if (bck_pressed && !bck_state.last_state) {
         bck_state.pressed_time = now;
         bck_state.long_press_handled = false;
     }
     if (!bck_pressed && bck_state.last_state) {
+        bck_state.last_state = false;
         unsigned long press_duration = now - bck_state.pressed_time;
         if ((state.mode == MODE_PLAY_FOLDER_ORDER || state.mode == MODE_PLAY_FOLDER_SHUFFLE) && press_duration >= BTN_LONGPRESS_TIME_MS) {
             return BTN_ACTION_PREV_FOLDER;
@@ -115,12 +136,13 @@ button_action_t button_handler_get_action(void) {
     bck_state.last_state = bck_pressed;
 
     // MENU BUTTON
-    bool menu_pressed = ezButton_getState(btn_menu);
+    bool menu_pressed = is_pressed(btn_menu);
     if (menu_pressed && !menu_state.last_state) {
         menu_state.pressed_time = now;
         menu_state.long_press_handled = false;
     }
     if (!menu_pressed && menu_state.last_state) {
+        menu_state.last_state = false;
         // Only short press for menu
         return BTN_ACTION_CHANGE_MODE;
     }
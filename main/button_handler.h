@@ -1,7 +1,13 @@
 #ifndef BUTTON_HANDLER_H
 #define BUTTON_HANDLER_H
 
+#ifndef TEST_MODE
 #include "esp_err.h"
+#else
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#endif
 
 // Button pins
 #define BTN_FWD_PIN     33
@@ -26,8 +32,16 @@ typedef enum {
  */
 esp_err_t button_handler_init(void);
 
+/**
+ * @brief Release the buttons and forget press history
+ */
+void button_handler_deinit(void);
+
 /**
  * @brief Get the current button action
+ *
+ * Poll this every tick. Actions fire when the button is released, once the
+ * release has been stable for the debounce time.
  * 
  * @return Button action
  */
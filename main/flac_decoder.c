@@ -0,0 +1,672 @@
+#include "flac_decoder.h"
+#include "sd_fault.h"
+#include <string.h>
+
+#ifndef TEST_MODE
+#include "esp_log.h"
+#else
+// Test mode definitions
+#define ESP_LOGI(tag, format, ...) printf("[INFO] " format "\n", ##__VA_ARGS__)
+#define ESP_LOGE(tag, format, ...) printf("[ERROR] " format "\n", ##__VA_ARGS__)
+#endif
+
+static const char *TAG = "flac_decoder";
+
+static flac_decoder_t decoder_pool[FLAC_DECODER_POOL_SIZE];
+
+flac_decoder_t *flac_decoder_acquire(void) {
+    for (int i = 0; i < FLAC_DECODER_POOL_SIZE; i++) {
+        if (!decoder_pool[i].in_use) {
+            decoder_pool[i].in_use = true;
+            return &decoder_pool[i];
+        }
+    }
+    return NULL;
+}
+
+void flac_decoder_release(flac_decoder_t *dec) {
+    if (dec != NULL) {
+        dec->in_use = false;
+        dec->file = NULL;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Bit reader
+
+static void reader_reset(flac_decoder_t *dec, long offset) {
+    dec->input_len = 0;
+    dec->input_pos = 0;
+    dec->input_offset = offset;
+    dec->bit_cache = 0;
+    dec->bit_count = 0;
+    dec->error = false;
+}
+
+static bool reader_fill(flac_decoder_t *dec) {
+    dec->input_offset += dec->input_len;
+    size_t want = sizeof(dec->input);
+    dec->input_len = sd_fault_inject(SD_FAULT_READ, &want, true) == ESP_OK ? fread(dec->input, 1, want, dec->file) : 0;
+    dec->input_pos = 0;
+    return dec->input_len > 0;
+}
+
+static inline bool load_byte(flac_decoder_t *dec) {
+    if (dec->input_pos >= dec->input_len && !reader_fill(dec)) {
+        dec->error = true;
+        return false;
+    }
+    dec->bit_cache = (dec->bit_cache << 8) | dec->input[dec->input_pos++];
+    dec->bit_count += 8;
+    return true;
+}
+
+// Read up to 32 bits, MSB first
+static inline uint32_t read_bits(flac_decoder_t *dec, uint32_t n) {
+    if (n == 0) {
+        return 0;
+    }
+    while (dec->bit_count < n) {
+        if (!load_byte(dec)) {
+            return 0;
+        }
+    }
+    dec->bit_count -= n;
+    return (uint32_t)((dec->bit_cache >> dec->bit_count) & ((1ULL << n) - 1));
+}
+
+static inline int32_t read_signed(flac_decoder_t *dec, uint32_t n) {
+    if (n == 0) {
+        return 0;
+    }
+    uint32_t v = read_bits(dec, n);
+    return (int32_t)(v << (32 - n)) >> (32 - n);
+}
+
+// Count zero bits up to the next one bit, consuming the one
+static inline uint32_t read_unary(flac_decoder_t *dec) {
+    uint32_t q = 0;
+    for (;;) {
+        if (dec->bit_count == 0 && !load_byte(dec)) {
+            return 0;
+        }
+        uint64_t bits = dec->bit_cache & ((1ULL << dec->bit_count) - 1);
+        if (bits == 0) {
+            q += dec->bit_count;
+            dec->bit_count = 0;
+            continue;
+        }
+        uint32_t top = 63 - __builtin_clzll(bits);
+        q += dec->bit_count - 1 - top;
+        dec->bit_count = top;
+        return q;
+    }
+}
+
+static inline void align_to_byte(flac_decoder_t *dec) {
+    dec->bit_count -= dec->bit_count & 7;
+}
+
+// File offset of the next unread byte; only meaningful when byte aligned
+static long reader_tell(flac_decoder_t *dec) {
+    return dec->input_offset + (long)dec->input_pos - (long)(dec->bit_count / 8);
+}
+
+static bool reader_seek(flac_decoder_t *dec, long offset) {
+    align_to_byte(dec);
+    if (offset >= dec->input_offset && offset <= dec->input_offset + (long)dec->input_len) {
+        dec->input_pos = offset - dec->input_offset;
+        dec->bit_count = 0;
+        dec->error = false;
+        return true;
+    }
+    if (fseek(dec->file, offset, SEEK_SET) != 0) {
+        return false;
+    }
+    reader_reset(dec, offset);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Metadata
+
+static esp_err_t parse_streaminfo(flac_decoder_t *dec) {
+    read_bits(dec, 16);     // min block size
+    dec->max_block_size = read_bits(dec, 16);
+    read_bits(dec, 24);     // min frame size
+    read_bits(dec, 24);     // max frame size
+    dec->sample_rate = read_bits(dec, 20);
+    dec->channels = read_bits(dec, 3) + 1;
+    dec->stream_bit_depth = read_bits(dec, 5) + 1;
+    dec->total_samples = ((uint64_t)read_bits(dec, 4) << 32) | read_bits(dec, 32);
+    for (int i = 0; i < 4; i++) {
+        read_bits(dec, 32);     // MD5 signature
+    }
+
+    if (dec->error || dec->sample_rate == 0) {
+        ESP_LOGE(TAG, "Invalid STREAMINFO");
+        return ESP_FAIL;
+    }
+    if (dec->channels > FLAC_MAX_CHANNELS || dec->max_block_size > FLAC_MAX_BLOCK_SIZE ||
+        dec->stream_bit_depth < 4 || dec->stream_bit_depth > 24) {
+        ESP_LOGE(TAG, "Unsupported FLAC stream: %u channels, %u-bit, block size %u",
+                 dec->channels, dec->stream_bit_depth, dec->max_block_size);
+        return ESP_FAIL;
+    }
+    dec->bit_depth = dec->stream_bit_depth <= 16 ? 16 : 24;
+    return ESP_OK;
+}
+
+static void parse_seektable(flac_decoder_t *dec, uint32_t length) {
+    uint32_t count = length / 18;
+    // Keep every n-th point when the table does not fit
+    uint32_t step = (count + FLAC_MAX_SEEK_POINTS - 1) / FLAC_MAX_SEEK_POINTS;
+    dec->seek_count = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t sample = ((uint64_t)read_bits(dec, 32) << 32) | read_bits(dec, 32);
+        uint64_t offset = ((uint64_t)read_bits(dec, 32) << 32) | read_bits(dec, 32);
+        read_bits(dec, 16);     // frame samples
+        if (sample == UINT64_MAX || i % step != 0 || dec->seek_count >= FLAC_MAX_SEEK_POINTS) {
+            continue;   // placeholder or thinned out
+        }
+        dec->seek_points[dec->seek_count].sample = sample;
+        dec->seek_points[dec->seek_count].offset = offset;
+        dec->seek_count++;
+    }
+    for (uint32_t i = count * 18; i < length; i++) {
+        read_bits(dec, 8);
+    }
+}
+
+esp_err_t flac_decoder_open(flac_decoder_t *dec, FILE *file) {
+    if (dec == NULL || file == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    dec->file = file;
+    dec->seek_count = 0;
+    dec->block_size = 0;
+    dec->block_pos = 0;
+    dec->block_first_sample = 0;
+    dec->next_sample = 0;
+    if (fseek(file, 0, SEEK_SET) != 0) {
+        return ESP_FAIL;
+    }
+    reader_reset(dec, 0);
+
+    // Skip an ID3v2 tag some tools put in front of the stream
+    uint32_t marker = read_bits(dec, 32);
+    if ((marker >> 8) == 0x494433) {   // "ID3"
+        read_bits(dec, 16);             // version low byte and flags
+        uint32_t size = 0;
+        for (int i = 0; i < 4; i++) {
+            size = (size << 7) | (read_bits(dec, 8) & 0x7F);
+        }
+        if (!reader_seek(dec, 10 + (long)size)) {
+            return ESP_FAIL;
+        }
+        marker = read_bits(dec, 32);
+    }
+    if (marker != 0x664C6143) {        // "fLaC"
+        ESP_LOGE(TAG, "Not a FLAC stream");
+        return ESP_FAIL;
+    }
+
+    bool have_streaminfo = false;
+    bool last = false;
+    while (!last) {
+        last = read_bits(dec, 1);
+        uint32_t type = read_bits(dec, 7);
+        uint32_t length = read_bits(dec, 24);
+        if (dec->error) {
+            ESP_LOGE(TAG, "Truncated FLAC metadata");
+            return ESP_FAIL;
+        }
+        long end = reader_tell(dec) + (long)length;
+
+        if (type == 0) {
+            if (parse_streaminfo(dec) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            have_streaminfo = true;
+        } else if (type == 3) {
+            parse_seektable(dec, length);
+        }
+        // Skip the rest, which also covers pictures and tags
+        if (!reader_seek(dec, end)) {
+            return ESP_FAIL;
+        }
+    }
+
+    if (!have_streaminfo) {
+        ESP_LOGE(TAG, "FLAC stream has no STREAMINFO");
+        return ESP_FAIL;
+    }
+
+    dec->first_frame_offset = reader_tell(dec);
+    ESP_LOGI(TAG, "FLAC: %u Hz, %u-bit, %u channels, %llu samples, %u seek points",
+             dec->sample_rate, dec->stream_bit_depth, dec->channels,
+             (unsigned long long)dec->total_samples, dec->seek_count);
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Frames
+
+static uint8_t crc8(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+typedef struct {
+    uint32_t block_size;
+    uint32_t channel_assignment;
+    uint32_t bit_depth;
+    uint64_t first_sample;
+} frame_header_t;
+
+// Parse a frame header whose two sync bytes are already in hdr; returns false on a bad header
+static bool parse_frame_header(flac_decoder_t *dec, uint8_t *hdr, frame_header_t *fh) {
+    size_t len = 2;
+    hdr[len++] = read_bits(dec, 8);
+    hdr[len++] = read_bits(dec, 8);
+
+    uint32_t bs_code = hdr[2] >> 4;
+    uint32_t sr_code = hdr[2] & 0x0F;
+    fh->channel_assignment = hdr[3] >> 4;
+    uint32_t ss_code = (hdr[3] >> 1) & 0x07;
+    if (bs_code == 0 || sr_code == 15 || fh->channel_assignment > 10 || ss_code == 3 || (hdr[3] & 1)) {
+        return false;
+    }
+
+    // UTF-8 style coded frame or sample number
+    uint8_t first = read_bits(dec, 8);
+    hdr[len++] = first;
+    uint64_t number;
+    int extra;
+    if (!(first & 0x80)) {
+        number = first;
+        extra = 0;
+    } else if ((first & 0xE0) == 0xC0) {
+        number = first & 0x1F;
+        extra = 1;
+    } else if ((first & 0xF0) == 0xE0) {
+        number = first & 0x0F;
+        extra = 2;
+    } else if ((first & 0xF8) == 0xF0) {
+        number = first & 0x07;
+        extra = 3;
+    } else if ((first & 0xFC) == 0xF8) {
+        number = first & 0x03;
+        extra = 4;
+    } else if ((first & 0xFE) == 0xFC) {
+        number = first & 0x01;
+        extra = 5;
+    } else if (first == 0xFE) {
+        number = 0;
+        extra = 6;
+    } else {
+        return false;
+    }
+    for (int i = 0; i < extra; i++) {
+        uint8_t b = read_bits(dec, 8);
+        hdr[len++] = b;
+        if ((b & 0xC0) != 0x80) {
+            return false;
+        }
+        number = (number << 6) | (b & 0x3F);
+    }
+
+    if (bs_code == 1) {
+        fh->block_size = 192;
+    } else if (bs_code <= 5) {
+        fh->block_size = 576u << (bs_code - 2);
+    } else if (bs_code == 6) {
+        hdr[len++] = read_bits(dec, 8);
+        fh->block_size = hdr[len - 1] + 1;
+    } else if (bs_code == 7) {
+        hdr[len++] = read_bits(dec, 8);
+        hdr[len++] = read_bits(dec, 8);
+        fh->block_size = ((hdr[len - 2] << 8) | hdr[len - 1]) + 1;
+    } else {
+        fh->block_size = 256u << (bs_code - 8);
+    }
+
+    // The rate comes from STREAMINFO; the header copy only needs to be skipped
+    if (sr_code == 12) {
+        hdr[len++] = read_bits(dec, 8);
+    } else if (sr_code == 13 || sr_code == 14) {
+        hdr[len++] = read_bits(dec, 8);
+        hdr[len++] = read_bits(dec, 8);
+    }
+
+    uint8_t crc = read_bits(dec, 8);
+    if (dec->error || crc != crc8(hdr, len)) {
+        return false;
+    }
+
+    static const uint8_t sample_sizes[8] = {0, 8, 12, 0, 16, 20, 24, 32};
+    fh->bit_depth = ss_code ? sample_sizes[ss_code] : dec->stream_bit_depth;
+    if (fh->block_size > FLAC_MAX_BLOCK_SIZE || fh->bit_depth != dec->stream_bit_depth) {
+        return false;
+    }
+    uint32_t channels = fh->channel_assignment < 8 ? fh->channel_assignment + 1 : 2;
+    if (channels != dec->channels) {
+        return false;
+    }
+
+    // Fixed block size streams count frames, variable ones count samples
+    fh->first_sample = (hdr[1] & 1) ? number : number * dec->max_block_size;
+    return true;
+}
+
+static bool decode_residual(flac_decoder_t *dec, int32_t *out, uint32_t block_size, uint32_t order) {
+    uint32_t method = read_bits(dec, 2);
+    if (method > 1) {
+        return false;
+    }
+    uint32_t param_bits = method == 0 ? 4 : 5;
+    uint32_t escape = method == 0 ? 15 : 31;
+    uint32_t partition_order = read_bits(dec, 4);
+    uint32_t partitions = 1u << partition_order;
+    uint32_t partition_size = block_size >> partition_order;
+    if ((partition_size << partition_order) != block_size || partition_size < order) {
+        return false;
+    }
+
+    int32_t *dst = out + order;
+    for (uint32_t p = 0; p < partitions; p++) {
+        uint32_t n = p == 0 ? partition_size - order : partition_size;
+        uint32_t param = read_bits(dec, param_bits);
+        if (param == escape) {
+            uint32_t bits = read_bits(dec, 5);
+            for (uint32_t i = 0; i < n; i++) {
+                *dst++ = read_signed(dec, bits);
+            }
+        } else {
+            for (uint32_t i = 0; i < n; i++) {
+                uint32_t q = read_unary(dec);
+                uint32_t u = (q << param) | read_bits(dec, param);
+                *dst++ = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+            }
+        }
+        if (dec->error) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void restore_fixed(int32_t *s, uint32_t block_size, uint32_t order) {
+    switch (order) {
+        case 1:
+            for (uint32_t i = 1; i < block_size; i++) s[i] += s[i - 1];
+            break;
+        case 2:
+            for (uint32_t i = 2; i < block_size; i++) s[i] += 2 * s[i - 1] - s[i - 2];
+            break;
+        case 3:
+            for (uint32_t i = 3; i < block_size; i++) s[i] += 3 * s[i - 1] - 3 * s[i - 2] + s[i - 3];
+            break;
+        case 4:
+            for (uint32_t i = 4; i < block_size; i++) s[i] += 4 * s[i - 1] - 6 * s[i - 2] + 4 * s[i - 3] - s[i - 4];
+            break;
+        default:
+            break;
+    }
+}
+
+static void restore_lpc(int32_t *s, uint32_t block_size, const int32_t *coefs, uint32_t order,
+                        int shift, bool wide) {
+    if (!wide) {
+        // Fits in 32 bits for 16-bit material with typical coefficient precision
+        for (uint32_t i = order; i < block_size; i++) {
+            int32_t sum = 0;
+            for (uint32_t j = 0; j < order; j++) {
+                sum += coefs[j] * s[i - 1 - j];
+            }
+            s[i] += sum >> shift;
+        }
+        return;
+    }
+    for (uint32_t i = order; i < block_size; i++) {
+        int64_t sum = 0;
+        for (uint32_t j = 0; j < order; j++) {
+            sum += (int64_t)coefs[j] * s[i - 1 - j];
+        }
+        s[i] += (int32_t)(sum >> shift);
+    }
+}
+
+static bool decode_subframe(flac_decoder_t *dec, int32_t *s, uint32_t block_size, uint32_t bps) {
+    if (read_bits(dec, 1) != 0) {
+        return false;
+    }
+    uint32_t type = read_bits(dec, 6);
+    uint32_t wasted = 0;
+    if (read_bits(dec, 1)) {
+        wasted = read_unary(dec) + 1;
+        if (wasted >= bps) {
+            return false;
+        }
+        bps -= wasted;
+    }
+
+    if (type == 0) {
+        int32_t v = read_signed(dec, bps);
+        for (uint32_t i = 0; i < block_size; i++) s[i] = v;
+    } else if (type == 1) {
+        for (uint32_t i = 0; i < block_size; i++) s[i] = read_signed(dec, bps);
+    } else if (type >= 8 && type <= 12) {
+        uint32_t order = type - 8;
+        if (order > block_size) {
+            return false;
+        }
+        for (uint32_t i = 0; i < order; i++) s[i] = read_signed(dec, bps);
+        if (!decode_residual(dec, s, block_size, order)) {
+            return false;
+        }
+        restore_fixed(s, block_size, order);
+    } else if (type >= 32) {
+        uint32_t order = (type & 31) + 1;
+        if (order > block_size) {
+            return false;
+        }
+        for (uint32_t i = 0; i < order; i++) s[i] = read_signed(dec, bps);
+        uint32_t precision = read_bits(dec, 4) + 1;
+        int32_t shift = read_signed(dec, 5);
+        if (precision == 16 || shift < 0) {
+            return false;
+        }
+        int32_t coefs[32];
+        for (uint32_t i = 0; i < order; i++) coefs[i] = read_signed(dec, precision);
+        if (!decode_residual(dec, s, block_size, order)) {
+            return false;
+        }
+        uint32_t order_bits = 0;
+        while ((1u << order_bits) < order) order_bits++;
+        restore_lpc(s, block_size, coefs, order, shift, bps + precision + order_bits > 32);
+    } else {
+        return false;
+    }
+
+    if (wasted) {
+        for (uint32_t i = 0; i < block_size; i++) s[i] = (int32_t)((uint32_t)s[i] << wasted);
+    }
+    return !dec->error;
+}
+
+// Find and decode the next frame; returns 1 on success, 0 at end of stream, -1 on error
+static int decode_frame(flac_decoder_t *dec) {
+    if (dec->total_samples > 0 && dec->next_sample >= dec->total_samples) {
+        return 0;
+    }
+
+    frame_header_t fh;
+    for (;;) {
+        align_to_byte(dec);
+        // Scan for the sync code, then check the header CRC to rule out false syncs
+        uint8_t hdr[16];
+        hdr[0] = read_bits(dec, 8);
+        while (!dec->error) {
+            if (hdr[0] == 0xFF) {
+                hdr[1] = read_bits(dec, 8);
+                if ((hdr[1] & 0xFE) == 0xF8) {
+                    break;
+                }
+                hdr[0] = hdr[1];
+            } else {
+                hdr[0] = read_bits(dec, 8);
+            }
+        }
+        if (dec->error) {
+            return 0;
+        }
+        long resume = reader_tell(dec);
+        if (parse_frame_header(dec, hdr, &fh)) {
+            break;
+        }
+        if (dec->error) {
+            return 0;
+        }
+        reader_seek(dec, resume);
+    }
+
+    uint32_t n = fh.block_size;
+    for (uint32_t c = 0; c < dec->channels; c++) {
+        uint32_t bps = fh.bit_depth;
+        // The side channel carries one extra bit
+        if ((fh.channel_assignment == 8 && c == 1) || (fh.channel_assignment == 9 && c == 0) ||
+            (fh.channel_assignment == 10 && c == 1)) {
+            bps++;
+        }
+        if (!decode_subframe(dec, dec->samples[c], n, bps)) {
+            ESP_LOGE(TAG, "Corrupt FLAC subframe at sample %llu", (unsigned long long)fh.first_sample);
+            return -1;
+        }
+    }
+
+    int32_t *a = dec->samples[0];
+    int32_t *b = dec->samples[1];
+    switch (fh.channel_assignment) {
+        case 8:     // left/side
+            for (uint32_t i = 0; i < n; i++) b[i] = a[i] - b[i];
+            break;
+        case 9:     // side/right
+            for (uint32_t i = 0; i < n; i++) a[i] += b[i];
+            break;
+        case 10:    // mid/side
+            for (uint32_t i = 0; i < n; i++) {
+                int32_t side = b[i];
+                int32_t mid = (int32_t)((uint32_t)a[i] << 1) | (side & 1);
+                a[i] = (mid + side) >> 1;
+                b[i] = (mid - side) >> 1;
+            }
+            break;
+        default:
+            break;
+    }
+
+    // Footer CRC-16 is not checked; the header CRC guards resynchronization
+    align_to_byte(dec);
+    read_bits(dec, 16);
+
+    dec->block_size = n;
+    dec->block_pos = 0;
+    dec->block_first_sample = fh.first_sample;
+    dec->next_sample = fh.first_sample + n;
+    if (dec->total_samples > 0 && dec->next_sample > dec->total_samples) {
+        dec->block_size = dec->total_samples > fh.first_sample ? (uint32_t)(dec->total_samples - fh.first_sample) : 0;
+    }
+    return 1;
+}
+
+esp_err_t flac_decoder_read(flac_decoder_t *dec, void *buffer, size_t buffer_size, size_t *bytes_read) {
+    if (dec == NULL || dec->file == NULL || buffer == NULL || bytes_read == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t sample_bytes = dec->bit_depth / 8;
+    uint32_t frame_bytes = sample_bytes * dec->channels;
+    uint32_t shift = dec->bit_depth - dec->stream_bit_depth;
+    size_t frames_wanted = buffer_size / frame_bytes;
+    uint8_t *out = buffer;
+    size_t frames_done = 0;
+
+    while (frames_done < frames_wanted) {
+        if (dec->block_pos >= dec->block_size) {
+            int ret = decode_frame(dec);
+            if (ret < 0) {
+                *bytes_read = frames_done * frame_bytes;
+                return ESP_FAIL;
+            }
+            if (ret == 0) {
+                break;
+            }
+            continue;
+        }
+
+        uint32_t count = dec->block_size - dec->block_pos;
+        if (count > frames_wanted - frames_done) {
+            count = frames_wanted - frames_done;
+        }
+        for (uint32_t f = dec->block_pos; f < dec->block_pos + count; f++) {
+            for (uint32_t c = 0; c < dec->channels; c++) {
+                uint32_t v = (uint32_t)dec->samples[c][f] << shift;
+                *out++ = v & 0xFF;
+                *out++ = (v >> 8) & 0xFF;
+                if (sample_bytes == 3) {
+                    *out++ = (v >> 16) & 0xFF;
+                }
+            }
+        }
+        dec->block_pos += count;
+        frames_done += count;
+    }
+
+    *bytes_read = frames_done * frame_bytes;
+    return ESP_OK;
+}
+
+esp_err_t flac_decoder_seek(flac_decoder_t *dec, uint64_t sample) {
+    if (dec == NULL || dec->file == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Start from the last seek point at or before the target
+    uint64_t offset = 0;
+    for (uint16_t i = 0; i < dec->seek_count; i++) {
+        if (dec->seek_points[i].sample > sample) {
+            break;
+        }
+        offset = dec->seek_points[i].offset;
+    }
+    if (!reader_seek(dec, dec->first_frame_offset + (long)offset)) {
+        ESP_LOGE(TAG, "Failed to seek in FLAC file");
+        return ESP_FAIL;
+    }
+    dec->block_size = 0;
+    dec->block_pos = 0;
+    dec->next_sample = 0;
+
+    // Decode forward to the frame holding the target
+    for (;;) {
+        int ret = decode_frame(dec);
+        if (ret < 0) {
+            return ESP_FAIL;
+        }
+        if (ret == 0) {
+            return ESP_OK;     // past the end: reads return no data
+        }
+        if (sample < dec->block_first_sample + dec->block_size) {
+            dec->block_pos = sample > dec->block_first_sample ? (uint32_t)(sample - dec->block_first_sample) : 0;
+            return ESP_OK;
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef FLAC_DECODER_H
+#define FLAC_DECODER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef TEST_MODE
+#include "esp_err.h"
+#else
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG -2
+#endif
+
+// Working set limits. Streams outside them are rejected at open.
+#define FLAC_MAX_BLOCK_SIZE     4608    // Subset limit for rates up to 48 kHz; the reference encoder uses 4096
+#define FLAC_MAX_CHANNELS       2
+#define FLAC_MAX_SEEK_POINTS    128     // Larger seek tables are thinned out evenly
+#define FLAC_INPUT_BUFFER_SIZE  4096
+
+// Decoders are taken from a static pool: one for the playing track, one for a crossfade
+#define FLAC_DECODER_POOL_SIZE  2
+
+typedef struct {
+    uint64_t sample;        // First sample of the target frame
+    uint64_t offset;        // Byte offset of the frame from the first frame
+} flac_seek_point_t;
+
+// Streaming FLAC decoder state; all buffers are fixed size
+typedef struct {
+    bool in_use;
+    FILE *file;
+
+    // STREAMINFO
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint16_t stream_bit_depth;  // Bits per sample in the stream
+    uint16_t bit_depth;         // Bits per sample of the output, 16 or 24
+    uint16_t max_block_size;
+    uint64_t total_samples;     // Samples per channel, 0 if unknown
+
+    // SEEKTABLE
+    flac_seek_point_t seek_points[FLAC_MAX_SEEK_POINTS];
+    uint16_t seek_count;
+    long first_frame_offset;
+
+    // Bit reader over the file
+    uint8_t input[FLAC_INPUT_BUFFER_SIZE];
+    size_t input_len;
+    size_t input_pos;
+    long input_offset;          // File offset of input[0]
+    uint64_t bit_cache;
+    uint32_t bit_count;
+    bool error;
+
+    // Current decoded block
+    int32_t samples[FLAC_MAX_CHANNELS][FLAC_MAX_BLOCK_SIZE];
+    uint32_t block_size;
+    uint32_t block_pos;         // Next frame of the block to hand out
+    uint64_t block_first_sample;
+    uint64_t next_sample;       // First sample of the following block
+} flac_decoder_t;
+
+/**
+ * @brief Take a decoder from the static pool
+ *
+ * @return Decoder, or NULL if all are in use
+ */
+flac_decoder_t *flac_decoder_acquire(void);
+
+/**
+ * @brief Return a decoder to the pool
+ *
+ * @param dec Decoder from flac_decoder_acquire()
+ */
+void flac_decoder_release(flac_decoder_t *dec);
+
+/**
+ * @brief Read the stream metadata and prepare to decode the first frame
+ *
+ * @param dec Decoder
+ * @param file File positioned anywhere; the stream must start at offset 0 (an ID3v2 tag is skipped)
+ * @return ESP_OK on success, ESP_FAIL for unsupported or corrupt streams
+ */
+esp_err_t flac_decoder_open(flac_decoder_t *dec, FILE *file);
+
+/**
+ * @brief Decode interleaved little-endian PCM at the output bit depth
+ *
+ * Only whole frames are written.
+ *
+ * @param dec Decoder
+ * @param buffer Buffer to store the PCM data
+ * @param buffer_size Size of buffer
+ * @param bytes_read Pointer to store number of bytes written, 0 at end of stream
+ * @return ESP_OK on success
+ */
+esp_err_t flac_decoder_read(flac_decoder_t *dec, void *buffer, size_t buffer_size, size_t *bytes_read);
+
+/**
+ * @brief Seek to a sample, using the seek table to find a nearby frame
+ *
+ * @param dec Decoder
+ * @param sample Target sample per channel
+ * @return ESP_OK on success
+ */
+esp_err_t flac_decoder_seek(flac_decoder_t *dec, uint64_t sample);
+
+#endif // FLAC_DECODER_H
@@ -0,0 +1,114 @@
+#ifndef HOST_RTOS_H
+#define HOST_RTOS_H
+
+// FreeRTOS, I2S and esp_timer stand-ins for host builds of the player.
+// Unit tests define them as no-ops next to the code under test; the host
+// simulator (sim_player.c) backs them with pthreads and a WAV file sink.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ESP_OK
+typedef int esp_err_t;
+#endif
+
+typedef void* TaskHandle_t;
+typedef void* QueueHandle_t;
+typedef void* SemaphoreHandle_t;
+typedef int BaseType_t;
+typedef void* i2s_chan_handle_t;
+typedef struct {
+    int id;
+    int role;
+    uint32_t dma_desc_num;
+    uint32_t dma_frame_num;
+    bool auto_clear;
+} i2s_chan_config_t;
+typedef struct {
+    void *data;
+    size_t size;
+} i2s_event_data_t;
+typedef bool (*i2s_isr_callback_t)(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx);
+typedef struct {
+    i2s_isr_callback_t on_recv;
+    i2s_isr_callback_t on_recv_q_ovf;
+    i2s_isr_callback_t on_sent;
+    i2s_isr_callback_t on_send_q_ovf;
+} i2s_event_callbacks_t;
+typedef struct { 
+    struct {
+        int sample_rate_hz;
+        int clk_src;
+        int mclk_multiple;
+    } clk_cfg;
+    struct {
+        int data_bit_width;
+        int slot_bit_width; 
+        int slot_mode;
+        int slot_mask;
+        int ws_width;
+        bool ws_pol;
+        bool bit_shift;
+    } slot_cfg;
+    struct { 
+        int bclk; 
+        int ws; 
+        int dout; 
+        int din; 
+        int mclk; 
+    } gpio_cfg;
+} i2s_std_config_t;
+typedef int i2s_data_bit_width_t;
+typedef int i2s_slot_mode_t;
+
+#define pdPASS 1
+#define pdTRUE 1
+#define pdMS_TO_TICKS(ms) (ms)
+#define portMAX_DELAY 0xFFFFFFFF
+#define tskIDLE_PRIORITY 0
+#define I2S_CHANNEL_DEFAULT_CONFIG(i2s_num, i2s_role) { .id = (i2s_num), .role = (i2s_role), .dma_desc_num = 6, .dma_frame_num = 240 }
+#define IRAM_ATTR
+#define I2S_PORT 0
+#define I2S_ROLE_MASTER 0
+#define I2S_NUM_0 0
+#define I2S_CLK_SRC_DEFAULT 0
+#define I2S_MCLK_MULTIPLE_256 0
+#define I2S_DATA_BIT_WIDTH_8BIT 0
+#define I2S_DATA_BIT_WIDTH_16BIT 1
+#define I2S_DATA_BIT_WIDTH_24BIT 2
+#define I2S_DATA_BIT_WIDTH_32BIT 3
+#define I2S_SLOT_BIT_WIDTH_16BIT 1
+#define I2S_SLOT_BIT_WIDTH_32BIT 3
+#define I2S_SLOT_MODE_MONO 1
+#define I2S_SLOT_MODE_STEREO 0
+#define I2S_STD_SLOT_BOTH 0
+#define I2S_GPIO_UNUSED -1
+
+
+QueueHandle_t xQueueCreate(int items, int size);
+void vQueueDelete(QueueHandle_t queue);
+int xQueueSend(QueueHandle_t queue, const void* item, int timeout);
+int xQueueReceive(QueueHandle_t queue, void* item, int timeout);
+BaseType_t xTaskCreate(void* func, const char* name, int stack, void* param, int priority, TaskHandle_t* handle);
+BaseType_t xTaskCreatePinnedToCore(void* func, const char* name, int stack, void* param, int priority,
+                                   TaskHandle_t* handle, int core);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+int xSemaphoreTake(SemaphoreHandle_t sem, int timeout);
+int xSemaphoreGive(SemaphoreHandle_t sem);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+void vTaskDelay(int ticks);
+void vTaskDelete(TaskHandle_t task);
+
+esp_err_t i2s_new_channel(i2s_chan_config_t* config, i2s_chan_handle_t* tx, i2s_chan_handle_t* rx);
+esp_err_t i2s_channel_init_std_mode(i2s_chan_handle_t handle, i2s_std_config_t* config);
+esp_err_t i2s_channel_enable(i2s_chan_handle_t handle);
+esp_err_t i2s_channel_disable(i2s_chan_handle_t handle);
+esp_err_t i2s_del_channel(i2s_chan_handle_t handle);
+esp_err_t i2s_channel_write(i2s_chan_handle_t handle, const void* src, size_t size, size_t* bytes_written, int timeout);
+esp_err_t i2s_channel_register_event_callback(i2s_chan_handle_t handle, const i2s_event_callbacks_t *callbacks,
+                                              void *user_data);
+
+int64_t esp_timer_get_time(void);
+
+#endif // HOST_RTOS_H
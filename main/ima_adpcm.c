@@ -0,0 +1,147 @@
+#include "ima_adpcm.h"
+#include <string.h>
+
+static const int16_t step_table[89] = {
+        7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
+       19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+       50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+      130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+      337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+      876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+     2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+     5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+typedef struct {
+    int32_t predictor;
+    int32_t index;
+} channel_state_t;
+
+// Apply one nibble to the channel state and return the new sample
+static inline int16_t decode_nibble(channel_state_t *ch, uint8_t nibble) {
+    int32_t step = step_table[ch->index];
+    int32_t diff = step >> 3;
+    if (nibble & 1) diff += step >> 2;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 4) diff += step;
+    if (nibble & 8) {
+        ch->predictor -= diff;
+        if (ch->predictor < -32768) ch->predictor = -32768;
+    } else {
+        ch->predictor += diff;
+        if (ch->predictor > 32767) ch->predictor = 32767;
+    }
+    ch->index += index_table[nibble];
+    if (ch->index < 0) ch->index = 0;
+    if (ch->index > 88) ch->index = 88;
+    return (int16_t)ch->predictor;
+}
+
+size_t ima_adpcm_frames_per_block(size_t block_size, uint16_t channels) {
+    if (channels == 0 || channels > 2 || block_size < 4u * channels) {
+        return 0;
+    }
+    // Nibbles come in 4-byte groups per channel, so a partial group carries no frames
+    size_t groups = (block_size - 4u * channels) / (4u * channels);
+    return 1 + groups * 8;
+}
+
+size_t ima_adpcm_decode_block(const uint8_t *block, size_t block_size, uint16_t channels, int16_t *out) {
+    size_t frames = ima_adpcm_frames_per_block(block_size, channels);
+    if (frames == 0) {
+        return 0;
+    }
+
+    channel_state_t state[2];
+    for (uint16_t c = 0; c < channels; c++) {
+        const uint8_t *hdr = block + 4 * c;
+        state[c].predictor = (int16_t)(hdr[0] | (hdr[1] << 8));
+        state[c].index = hdr[2] > 88 ? 88 : hdr[2];
+        out[c] = (int16_t)state[c].predictor;
+    }
+
+    const uint8_t *data = block + 4 * channels;
+    size_t groups = (frames - 1) / 8;
+    for (size_t g = 0; g < groups; g++) {
+        for (uint16_t c = 0; c < channels; c++) {
+            int16_t *dst = out + (1 + g * 8) * channels + c;
+            for (int b = 0; b < 4; b++) {
+                uint8_t byte = *data++;
+                dst[0] = decode_nibble(&state[c], byte & 0x0F);
+                dst[channels] = decode_nibble(&state[c], byte >> 4);
+                dst += 2 * channels;
+            }
+        }
+    }
+    return frames;
+}
+
+// Pick the nibble that best approximates the sample and advance the state like the decoder does
+static uint8_t encode_nibble(channel_state_t *ch, int16_t sample) {
+    int32_t step = step_table[ch->index];
+    int32_t diff = sample - ch->predictor;
+    uint8_t nibble = 0;
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        nibble |= 4;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        nibble |= 2;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        nibble |= 1;
+    }
+    decode_nibble(ch, nibble);
+    return nibble;
+}
+
+void ima_adpcm_encode_block(const int16_t *in, uint16_t channels, size_t block_align,
+                            uint8_t *step_index, uint8_t *block) {
+    size_t frames = ima_adpcm_frames_per_block(block_align, channels);
+    memset(block, 0, block_align);
+    if (frames == 0) {
+        return;
+    }
+
+    channel_state_t state[2];
+    for (uint16_t c = 0; c < channels; c++) {
+        state[c].predictor = in[c];
+        state[c].index = step_index[c] > 88 ? 88 : step_index[c];
+        uint8_t *hdr = block + 4 * c;
+        hdr[0] = (uint16_t)in[c] & 0xFF;
+        hdr[1] = ((uint16_t)in[c] >> 8) & 0xFF;
+        hdr[2] = (uint8_t)state[c].index;
+        hdr[3] = 0;
+    }
+
+    uint8_t *data = block + 4 * channels;
+    size_t groups = (frames - 1) / 8;
+    for (size_t g = 0; g < groups; g++) {
+        for (uint16_t c = 0; c < channels; c++) {
+            const int16_t *src = in + (1 + g * 8) * channels + c;
+            for (int b = 0; b < 4; b++) {
+                uint8_t lo = encode_nibble(&state[c], src[0]);
+                uint8_t hi = encode_nibble(&state[c], src[channels]);
+                *data++ = lo | (hi << 4);
+                src += 2 * channels;
+            }
+        }
+    }
+
+    for (uint16_t c = 0; c < channels; c++) {
+        step_index[c] = (uint8_t)state[c].index;
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef IMA_ADPCM_H
+#define IMA_ADPCM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Block layout follows WAV format tag 0x11 (IMA ADPCM): per channel a 4-byte
+// header (int16 predictor, uint8 step index, reserved byte), then the nibbles
+// interleaved in 4-byte groups per channel, low nibble first.
+
+// Largest block accepted by the player
+#define IMA_ADPCM_MAX_BLOCK_ALIGN  2048
+
+/**
+ * @brief Number of frames decoded from a block of the given size
+ *
+ * @param block_size Block size in bytes (block_align, or less for the final block)
+ * @param channels Number of channels (1 or 2)
+ * @return Frames in the block, 0 if the block is too small
+ */
+size_t ima_adpcm_frames_per_block(size_t block_size, uint16_t channels);
+
+/**
+ * @brief Decode one block to interleaved 16-bit PCM
+ *
+ * @param block Encoded block
+ * @param block_size Size of the block in bytes
+ * @param channels Number of channels (1 or 2)
+ * @param out Output buffer, at least ima_adpcm_frames_per_block() * channels samples
+ * @return Number of frames decoded
+ */
+size_t ima_adpcm_decode_block(const uint8_t *block, size_t block_size, uint16_t channels, int16_t *out);
+
+/**
+ * @brief Encode interleaved 16-bit PCM into one block
+ *
+ * Used by the host tests and benchmarks to produce test material.
+ *
+ * @param in Interleaved PCM, ima_adpcm_frames_per_block(block_align, channels) frames
+ * @param channels Number of channels (1 or 2)
+ * @param block_align Block size in bytes
+ * @param step_index Per-channel step index, carried from block to block (start with zeros)
+ * @param block Output block of block_align bytes
+ */
+void ima_adpcm_encode_block(const int16_t *in, uint16_t channels, size_t block_align,
+                            uint8_t *step_index, uint8_t *block);
+
+#endif // IMA_ADPCM_H
@@ -0,0 +1,485 @@
+#include "index_cache.h"
+#include "mem_policy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifndef TEST_MODE
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#else
+#define ESP_LOGI(tag, format, ...) printf("[INFO] " format "\n", ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) printf("[WARN] " format "\n", ##__VA_ARGS__)
+#define ESP_LOGE(tag, format, ...) printf("[ERROR] " format "\n", ##__VA_ARGS__)
+#endif
+
+static const char *TAG = "index_cache";
+
+#define IMAGE_MAGIC         0x58444E49  // "INDX"
+#define IMAGE_FORMAT        3
+#define SECTOR_SIZE         4096
+// The payload starts one sector in, so the header can be written last
+#define PAYLOAD_OFFSET      SECTOR_SIZE
+// Flash erases stall both cores' code fetches; the writer rests this long
+// after each sector so the player can top up the I2S DMA queue in between
+#define SECTOR_PAUSE_MS     20
+
+typedef struct {
+    uint32_t magic;
+    uint32_t format;
+    index_cache_key_t key;
+    uint32_t payload_len;
+    uint32_t payload_hash;
+    int32_t total_files;
+    int32_t folder_count;
+    uint32_t arena_size;    // Arena bytes the loaded index takes
+    char version[16];
+} image_header_t;
+
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t len) {
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Flash access -------------------------------------------------------------
+
+#ifndef TEST_MODE
+static const esp_partition_t *partition;
+static esp_partition_mmap_handle_t map_handle;
+
+static size_t storage_capacity(void) {
+    if (partition == NULL) {
+        partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, INDEX_CACHE_PARTITION);
+    }
+    return partition != NULL ? partition->size : 0;
+}
+
+static esp_err_t storage_erase_sector(size_t offset) {
+    return esp_partition_erase_range(partition, offset, SECTOR_SIZE);
+}
+
+static void storage_pause(void) {
+    vTaskDelay(pdMS_TO_TICKS(SECTOR_PAUSE_MS));
+}
+
+static esp_err_t storage_write(size_t offset, const void *data, size_t len) {
+    return esp_partition_write(partition, offset, data, len);
+}
+
+static const uint8_t *storage_map(size_t len) {
+    const void *ptr;
+    if (esp_partition_mmap(partition, 0, len, ESP_PARTITION_MMAP_DATA, &ptr, &map_handle) != ESP_OK) {
+        return NULL;
+    }
+    return ptr;
+}
+
+static void storage_unmap(void) {
+    esp_partition_munmap(map_handle);
+}
+#else
+// Host builds keep the partition in RAM
+#define TEST_PARTITION_SIZE (1024 * 1024)
+static uint8_t *test_partition;
+
+static size_t storage_capacity(void) {
+    if (test_partition == NULL) {
+        test_partition = malloc(TEST_PARTITION_SIZE);
+        memset(test_partition, 0xFF, TEST_PARTITION_SIZE);
+    }
+    return TEST_PARTITION_SIZE;
+}
+
+static esp_err_t storage_erase_sector(size_t offset) {
+    memset(test_partition + offset, 0xFF, SECTOR_SIZE);
+    return ESP_OK;
+}
+
+static void storage_pause(void) {
+}
+
+static esp_err_t storage_write(size_t offset, const void *data, size_t len) {
+    memcpy(test_partition + offset, data, len);
+    return ESP_OK;
+}
+
+static const uint8_t *storage_map(size_t len) {
+    (void)len;
+    return test_partition;
+}
+
+static void storage_unmap(void) {
+}
+#endif
+
+// Image writer -------------------------------------------------------------
+
+// Streams the payload through a sector buffer; with no buffer it only counts.
+// Each sector is erased just before it is written, so only the sectors the
+// image needs are erased and no single flash operation is longer than one sector.
+typedef struct {
+    uint8_t *buf;
+    size_t fill;
+    size_t offset;          // Flash offset of buf[0]
+    size_t len;             // Payload bytes so far
+    uint32_t hash;
+    esp_err_t err;
+} image_writer_t;
+
+static void flush_sector(image_writer_t *w) {
+    if (w->err == ESP_OK) {
+        w->err = storage_erase_sector(w->offset);
+    }
+    if (w->err == ESP_OK) {
+        w->err = storage_write(w->offset, w->buf, w->fill);
+    }
+    storage_pause();
+}
+
+static void put_bytes(image_writer_t *w, const void *data, size_t len) {
+    const uint8_t *bytes = data;
+    w->len += len;
+    w->hash = fnv1a(w->hash, data, len);
+    while (w->buf != NULL && len > 0) {
+        size_t n = SECTOR_SIZE - w->fill;
+        n = n < len ? n : len;
+        memcpy(w->buf + w->fill, bytes, n);
+        w->fill += n;
+        bytes += n;
+        len -= n;
+        if (w->fill == SECTOR_SIZE) {
+            flush_sector(w);
+            w->offset += SECTOR_SIZE;
+            w->fill = 0;
+        }
+    }
+}
+
+static void put_u32(image_writer_t *w, uint32_t v) {
+    put_bytes(w, &v, sizeof(v));
+}
+
+static void put_string(image_writer_t *w, const char *s) {
+    uint16_t len = strnlen(s, 255);
+    put_bytes(w, &len, sizeof(len));
+    put_bytes(w, s, len);
+}
+
+static void put_entry(image_writer_t *w, const file_entry_t *e) {
+    put_string(w, e->name);
+    put_string(w, e->path);
+    put_string(w, e->song);
+    put_string(w, e->album);
+    put_string(w, e->artist);
+    put_u32(w, e->sample_rate);
+    put_u32(w, e->bit_depth | ((uint32_t)e->channels << 16));
+    put_u32(w, e->codec | ((uint32_t)e->block_align << 16));
+    put_u32(w, (uint32_t)e->folder_index);
+    put_u32(w, (uint32_t)e->position);
+    put_u32(w, (e->has_track_gain ? 1 : 0) | (e->has_album_gain ? 2 : 0));
+    put_bytes(w, &e->track_gain_db, sizeof(float));
+    put_bytes(w, &e->track_peak, sizeof(float));
+    put_bytes(w, &e->album_gain_db, sizeof(float));
+    put_bytes(w, &e->album_peak, sizeof(float));
+    uint16_t count = e->frame_index.offsets != NULL ? e->frame_index.count : 0;
+    put_u32(w, e->frame_index.frame_count);
+    put_u32(w, e->frame_index.interval | ((uint32_t)count << 16));
+    put_bytes(w, e->frame_index.offsets, count * sizeof(uint32_t));
+}
+
+// Arena bytes of an entry's frame table once loaded
+static size_t frames_size(const file_entry_t *e) {
+    return e->frame_index.offsets != NULL && e->frame_index.count > 0 ?
+           MEM_ARENA_SPAN(e->frame_index.count * sizeof(uint32_t)) : 0;
+}
+
+// Arena bytes get_index() allocates for the index
+static size_t arena_size(const index_file_t *index) {
+    size_t size = MEM_ARENA_SPAN(index->total_files * sizeof(file_entry_t)) +
+                  MEM_ARENA_SPAN(index->folder_count * sizeof(folder_t));
+    for (int i = 0; i < index->total_files; i++) {
+        size += frames_size(&index->all_files[i]);
+    }
+    for (int i = 0; i < index->folder_count; i++) {
+        const folder_t *folder = &index->music_folders[i];
+        if (folder->files != NULL && folder->file_count > 0) {
+            size += MEM_ARENA_SPAN(folder->file_count * sizeof(file_entry_t));
+            for (int j = 0; j < folder->file_count; j++) {
+                size += frames_size(&folder->files[j]);
+            }
+        }
+    }
+    return size;
+}
+
+static void put_index(image_writer_t *w, const index_file_t *index) {
+    for (int i = 0; i < index->total_files; i++) {
+        put_entry(w, &index->all_files[i]);
+    }
+    for (int i = 0; i < index->folder_count; i++) {
+        const folder_t *folder = &index->music_folders[i];
+        put_string(w, folder->name);
+        put_u32(w, folder->files != NULL ? folder->file_count : 0);
+        for (int j = 0; folder->files != NULL && j < folder->file_count; j++) {
+            put_entry(w, &folder->files[j]);
+        }
+    }
+}
+
+// Image reader -------------------------------------------------------------
+
+typedef struct {
+    const uint8_t *pos;
+    const uint8_t *end;
+    bool overrun;
+} image_reader_t;
+
+static void get_bytes(image_reader_t *r, void *out, size_t len) {
+    if ((size_t)(r->end - r->pos) < len) {
+        r->overrun = true;
+        memset(out, 0, len);
+        return;
+    }
+    memcpy(out, r->pos, len);
+    r->pos += len;
+}
+
+static uint32_t get_u32(image_reader_t *r) {
+    uint32_t v;
+    get_bytes(r, &v, sizeof(v));
+    return v;
+}
+
+static void get_string(image_reader_t *r, char *out, size_t size) {
+    uint16_t len;
+    get_bytes(r, &len, sizeof(len));
+    if (len >= size) {
+        r->overrun = true;
+        len = 0;
+    }
+    get_bytes(r, out, len);
+    out[len] = '\0';
+}
+
+static bool get_entry(image_reader_t *r, file_entry_t *e, mem_arena_t *arena) {
+    memset(e, 0, sizeof(*e));
+    get_string(r, e->name, sizeof(e->name));
+    get_string(r, e->path, sizeof(e->path));
+    get_string(r, e->song, sizeof(e->song));
+    get_string(r, e->album, sizeof(e->album));
+    get_string(r, e->artist, sizeof(e->artist));
+    e->sample_rate = get_u32(r);
+    uint32_t v = get_u32(r);
+    e->bit_depth = v & 0xFFFF;
+    e->channels = v >> 16;
+    v = get_u32(r);
+    e->codec = (pcm_codec_t)(v & 0xFFFF);
+    e->block_align = v >> 16;
+    e->folder_index = (int32_t)get_u32(r);
+    e->position = (int32_t)get_u32(r);
+    v = get_u32(r);
+    e->has_track_gain = v & 1;
+    e->has_album_gain = (v & 2) != 0;
+    get_bytes(r, &e->track_gain_db, sizeof(float));
+    get_bytes(r, &e->track_peak, sizeof(float));
+    get_bytes(r, &e->album_gain_db, sizeof(float));
+    get_bytes(r, &e->album_peak, sizeof(float));
+    e->frame_index.frame_count = get_u32(r);
+    v = get_u32(r);
+    e->frame_index.interval = v & 0xFFFF;
+    e->frame_index.count = v >> 16;
+    if (e->frame_index.count > 0 && !r->overrun) {
+        e->frame_index.offsets = mem_arena_alloc(arena, e->frame_index.count * sizeof(uint32_t));
+        if (e->frame_index.offsets == NULL) {
+            return false;
+        }
+        get_bytes(r, e->frame_index.offsets, e->frame_index.count * sizeof(uint32_t));
+    }
+    return !r->overrun;
+}
+
+static esp_err_t get_index(image_reader_t *r, const image_header_t *header, index_file_t *index) {
+    index->total_files = header->total_files;
+    index->folder_count = header->folder_count;
+    snprintf(index->version, sizeof(index->version), "%s", header->version);
+    mem_arena_init(&index->arena, MEM_BULK, JSON_INDEX_ARENA_CHUNK);
+    if (header->arena_size > 0 && !mem_arena_reserve(&index->arena, header->arena_size)) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (index->total_files > 0) {
+        index->all_files = mem_arena_calloc(&index->arena, index->total_files, sizeof(file_entry_t));
+        if (index->all_files == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    for (int i = 0; i < index->total_files; i++) {
+        if (!get_entry(r, &index->all_files[i], &index->arena)) {
+            return r->overrun ? ESP_ERR_NOT_FOUND : ESP_ERR_NO_MEM;
+        }
+    }
+    if (index->folder_count > 0) {
+        index->music_folders = mem_arena_calloc(&index->arena, index->folder_count, sizeof(folder_t));
+        if (index->music_folders == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    for (int i = 0; i < index->folder_count; i++) {
+        folder_t *folder = &index->music_folders[i];
+        get_string(r, folder->name, sizeof(folder->name));
+        folder->file_count = get_u32(r);
+        if (r->overrun || folder->file_count < 0 || folder->file_count > index->total_files) {
+            folder->file_count = 0;
+            return ESP_ERR_NOT_FOUND;
+        }
+        if (folder->file_count > 0) {
+            folder->files = mem_arena_alloc(&index->arena, folder->file_count * sizeof(file_entry_t));
+            if (folder->files == NULL) {
+                folder->file_count = 0;
+                return ESP_ERR_NO_MEM;
+            }
+        }
+        for (int j = 0; j < folder->file_count; j++) {
+            if (!get_entry(r, &folder->files[j], &index->arena)) {
+                return r->overrun ? ESP_ERR_NOT_FOUND : ESP_ERR_NO_MEM;
+            }
+        }
+    }
+    // Lookups still work by scanning without it
+    json_index_build_paths(index);
+    return ESP_OK;
+}
+
+// API ----------------------------------------------------------------------
+
+esp_err_t index_cache_key(const char *path, index_cache_key_t *key) {
+    struct stat st;
+    if (path == NULL || key == NULL || stat(path, &st) != 0) {
+        return ESP_FAIL;
+    }
+    // Such files are paged and never cached; skip reading them
+    if (st.st_size > JSON_INDEX_PAGED_THRESHOLD) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return ESP_FAIL;
+    }
+    uint8_t buf[512];
+    size_t n;
+    key->size = (uint32_t)st.st_size;
+    key->mtime = (uint32_t)st.st_mtime;
+    key->hash = 2166136261u;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        key->hash = fnv1a(key->hash, buf, n);
+    }
+    bool failed = ferror(file);
+    fclose(file);
+    return failed ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t index_cache_load(const index_cache_key_t *key, index_file_t *index) {
+    if (key == NULL || index == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(index, 0, sizeof(*index));
+    size_t capacity = storage_capacity();
+    if (capacity < PAYLOAD_OFFSET) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const uint8_t *image = storage_map(PAYLOAD_OFFSET);
+    if (image == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    image_header_t header;
+    memcpy(&header, image, sizeof(header));
+    storage_unmap();
+    if (header.magic != IMAGE_MAGIC || header.format != IMAGE_FORMAT ||
+        memcmp(&header.key, key, sizeof(*key)) != 0 ||
+        header.payload_len > capacity - PAYLOAD_OFFSET) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    image = storage_map(PAYLOAD_OFFSET + header.payload_len);
+    if (image == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    const uint8_t *payload = image + PAYLOAD_OFFSET;
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (fnv1a(2166136261u, payload, header.payload_len) == header.payload_hash) {
+        image_reader_t reader = {payload, payload + header.payload_len, false};
+        ret = get_index(&reader, &header, index);
+    }
+    storage_unmap();
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Discarding the cached index image");
+        json_free_index(index);
+        memset(index, 0, sizeof(*index));
+    }
+    return ret;
+}
+
+esp_err_t index_cache_store(const index_cache_key_t *key, const index_file_t *index) {
+    if (key == NULL || index == NULL || index->pager != NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t capacity = storage_capacity();
+    if (capacity == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Size the payload first so only the sectors it needs are erased
+    image_writer_t writer = {.hash = 2166136261u};
+    put_index(&writer, index);
+    size_t payload_len = writer.len;
+    if (PAYLOAD_OFFSET + payload_len > capacity) {
+        ESP_LOGW(TAG, "Index image of %u bytes does not fit the %u byte partition",
+                 (unsigned)payload_len, (unsigned)capacity);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t *buf = mem_alloc(MEM_BULK, SECTOR_SIZE);
+    if (buf == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    // The old header goes first, so a half-written payload is never taken for an image
+    esp_err_t ret = storage_erase_sector(0);
+    writer = (image_writer_t){.buf = buf, .offset = PAYLOAD_OFFSET, .hash = 2166136261u, .err = ret};
+    put_index(&writer, index);
+    if (writer.fill > 0) {
+        flush_sector(&writer);
+    }
+    ret = writer.err;
+
+    // A header only lands once the payload it describes is complete
+    if (ret == ESP_OK) {
+        memset(buf, 0xFF, SECTOR_SIZE);
+        image_header_t *header = (image_header_t *)buf;
+        header->magic = IMAGE_MAGIC;
+        header->format = IMAGE_FORMAT;
+        header->key = *key;
+        header->payload_len = payload_len;
+        header->payload_hash = writer.hash;
+        header->total_files = index->total_files;
+        header->folder_count = index->folder_count;
+        header->arena_size = arena_size(index);
+        memset(header->version, 0, sizeof(header->version));
+        snprintf(header->version, sizeof(header->version), "%s", index->version);
+        ret = storage_write(0, header, sizeof(*header));
+    }
+    mem_free(buf);
+
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Cached index image: %d files, %u bytes", index->total_files, (unsigned)payload_len);
+    } else {
+        ESP_LOGE(TAG, "Failed to write the index image (%d)", ret);
+    }
+    return ret;
+}
@@ -0,0 +1,67 @@
+#ifndef INDEX_CACHE_H
+#define INDEX_CACHE_H
+
+#include <stdint.h>
+#include "json_parser.h"
+
+#ifndef TEST_MODE
+#include "esp_err.h"
+#else
+#define ESP_ERR_NOT_FOUND -5
+#define ESP_ERR_INVALID_SIZE -6
+#endif
+
+// Data partition (subtype 0x40, see partitions.csv) holding the parsed index
+#define INDEX_CACHE_PARTITION   "index_cache"
+
+// Longest one 4 KB sector erase keeps the flash cache off, stalling code that
+// runs from flash on both cores
+#define INDEX_CACHE_ERASE_MS    45
+
+// Identifies the index.json an image was built from
+typedef struct {
+    uint32_t size;
+    uint32_t mtime;
+    uint32_t hash;          // FNV-1a over the whole file
+} index_cache_key_t;
+
+/**
+ * @brief Compute the cache key of an index.json
+ *
+ * Reads the whole file once to hash it.
+ *
+ * @param path Path to index.json
+ * @param key Pointer to store the key
+ * @return ESP_OK on success, ESP_FAIL if the file cannot be read,
+ *         ESP_ERR_INVALID_SIZE if the file is large enough to be paged
+ */
+esp_err_t index_cache_key(const char *path, index_cache_key_t *key);
+
+/**
+ * @brief Build an index from the flash image if it matches the key
+ *
+ * The result is laid out like a json_parse_index() result and is released
+ * with json_free_index().
+ *
+ * @param key Key of the index.json on the card
+ * @param index Pointer to store the index
+ * @return ESP_OK on a hit, ESP_ERR_NOT_FOUND if there is no matching image,
+ *         ESP_ERR_NO_MEM if it does not fit in RAM
+ */
+esp_err_t index_cache_load(const index_cache_key_t *key, index_file_t *index);
+
+/**
+ * @brief Write an index to the flash image
+ *
+ * Only fully loaded indexes are cached; paged ones are left alone. Each
+ * sector erase stalls for up to INDEX_CACHE_ERASE_MS, so the player only
+ * stores while no audio plays, or when its I2S queue outlasts an erase.
+ *
+ * @param key Key of the index.json the index was parsed from
+ * @param index Parsed index
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND without a partition,
+ *         ESP_ERR_INVALID_SIZE if the image does not fit, ESP_ERR_INVALID_ARG for a paged index
+ */
+esp_err_t index_cache_store(const index_cache_key_t *key, const index_file_t *index);
+
+#endif // INDEX_CACHE_H
@@ -1,4 +1,5 @@
 #include "json_parser.h"
+#include "mem_policy.h"
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
@@ -24,14 +25,15 @@ static const char *TAG = "json_parser";
 // Simple JSON parser for index.json
 // This is a simple parser that doesn't handle all JSON cases but works for our specific format
 
-// Helper function to extract string value between quotes
-static char* extract_string(const char* json, const char* key) {
+// Helper function to copy a string value into a fixed-size field; returns false if the key is missing.
+// Values longer than the field are cut short.
+static bool copy_string(const char* json, const char* key, char* out, size_t size) {
     char search_key[256];
     sprintf(search_key, "\"%s\":", key);
     
     char* key_pos = strstr(json, search_key);
     if (!key_pos) {
-        return NULL;
+        return false;
     }
     
     // Move pointer to after key
@@ -44,7 +46,7 @@ static char* extract_string(const char* json, const char* key) {
     
     // Check if we have a string (starts with ")
     if (*key_pos != '"') {
-        return NULL;
+        return false;
     }
     
     // Move past opening quote
@@ -53,22 +55,18 @@ static char* extract_string(const char* json, const char* key) {
     // Find closing quote
     char* end_pos = strchr(key_pos, '"');
     if (!end_pos) {
-        return NULL;
+        return false;
     }
     
-    // Calculate length
+    // Copy what fits
     size_t len = end_pos - key_pos;
-    
-    // Allocate and copy string
-    char* result = malloc(len + 1);
-    if (!result) {
-        return NULL;
+    if (len >= size) {
+        len = size - 1;
     }
+    memcpy(out, key_pos, len);
+    out[len] = '\0';
     
-    strncpy(result, key_pos, len);
-    result[len] = '\0';
-    
-    return result;
+    return true;
 }
 
 // Helper function to extract integer value
@@ -93,31 +91,111 @@ static int extract_int(const char* json, const char* key) {
     return atoi(key_pos);
 }
 
-// Helper function to find array size
+// Helper function to extract a floating point value; returns false if the key is missing
+static bool extract_float(const char* json, const char* key, float *value) {
+    char search_key[256];
+    sprintf(search_key, "\"%s\":", key);
+    
+    char* key_pos = strstr(json, search_key);
+    if (!key_pos) {
+        return false;
+    }
+    
+    // Move pointer to after key
+    key_pos += strlen(search_key);
+    
+    // Convert to float
+    char* end_pos = NULL;
+    float parsed = strtof(key_pos, &end_pos);
+    if (end_pos == key_pos) {
+        return false;
+    }
+    
+    *value = parsed;
+    return true;
+}
+
+// Helper function to locate an array of unsigned integers; returns the number of values
+static int count_uint_array(const char* json, const char* key, char** start) {
+    char search_key[256];
+    sprintf(search_key, "\"%s\":", key);
+    
+    char* key_pos = strstr(json, search_key);
+    if (!key_pos) {
+        return 0;
+    }
+    key_pos = strchr(key_pos + strlen(search_key), '[');
+    char* end_pos = key_pos ? strchr(key_pos, ']') : NULL;
+    if (!end_pos) {
+        return 0;
+    }
+    
+    // Count entries by their separators
+    int count = 0;
+    for (const char* p = key_pos + 1; p < end_pos; p++) {
+        if (*p >= '0' && *p <= '9' && (p[-1] < '0' || p[-1] > '9')) {
+            count++;
+        }
+    }
+    *start = key_pos + 1;
+    return count;
+}
+
+// Helper function to extract an array of unsigned integers into an arena; returns the number of values
+static int extract_uint_array(const char* json, const char* key, mem_arena_t *arena, uint32_t **values) {
+    *values = NULL;
+    char* p;
+    int count = count_uint_array(json, key, &p);
+    if (count == 0) {
+        return 0;
+    }
+    
+    *values = mem_arena_alloc(arena, sizeof(uint32_t) * count);
+    if (!*values) {
+        return 0;
+    }
+    while (*p < '0' || *p > '9') {
+        p++;
+    }
+    for (int i = 0; i < count; i++) {
+        (*values)[i] = (uint32_t)strtoul(p, &p, 10);
+        while (*p != ']' && (*p < '0' || *p > '9')) {
+            p++;
+        }
+    }
+    return count;
+}
+
+// Helper function to find array size; braces inside strings are skipped
 static int get_array_size(const char* array_start) {
     int count = 0;
     int brace_level = 0;
-    bool in_object = false;
+    bool in_string = false;
+    bool escaped = false;
     
     // Skip the opening bracket
     array_start++;
     
     while (*array_start) {
-        if (*array_start == '{') {
-            if (brace_level == 0 && !in_object) {
-                in_object = true;
+        if (in_string) {
+            if (escaped) {
+                escaped = false;
+            } else if (*array_start == '\\') {
+                escaped = true;
+            } else if (*array_start == '"') {
+                in_string = false;
             }
+        } else if (*array_start == '"') {
+            in_string = true;
+        } else if (*array_start == '{') {
             brace_level++;
         } else if (*array_start == '}') {
             brace_level--;
-            if (brace_level == 0 && in_object) {
+            if (brace_level == 0) {
                 count++;
-                in_object = false;
             }
-        }
-        
-        // End of array
-        if (*array_start == ']' && brace_level == 0 && !in_object) {
+        } else if (*array_start == ']' && brace_level == 0) {
+            // End of array
             break;
         }
         
@@ -127,44 +205,71 @@ static int get_array_size(const char* array_start) {
     return count;
 }
 
-// Helper to extract a JSON object as a string
-static char* extract_object(const char* start) {
-    // Skip leading whitespace
-    while (*start == ' ' || *start == '\t' || *start == '\n' || *start == '\r') {
-        start++;
+// Helper to find the end of the object starting at start; returns the
+// character after its closing brace, NULL if the braces do not balance
+static char* object_end(char* start) {
+    int depth = 0;
+    bool in_string = false;
+    bool escaped = false;
+    for (char* p = start; *p; p++) {
+        if (in_string) {
+            if (escaped) {
+                escaped = false;
+            } else if (*p == '\\') {
+                escaped = true;
+            } else if (*p == '"') {
+                in_string = false;
+            }
+        } else if (*p == '"') {
+            in_string = true;
+        } else if (*p == '{') {
+            depth++;
+        } else if (*p == '}' && --depth == 0) {
+            return p + 1;
+        }
     }
-    
-    if (*start != '{') {
-        return NULL;
+    return NULL;
+}
+
+// Walks the objects of an array in a writable buffer. Each object is
+// terminated in place while it is current, so it is parsed without a copy.
+typedef struct {
+    char* pos;              // Where the search for the next object starts
+    char* end;              // Terminator written after the current object, NULL if none
+    char saved;             // Character the terminator replaced
+} object_cursor_t;
+
+static void cursor_init(object_cursor_t* cursor, const char* array_start) {
+    cursor->pos = (char*)array_start + 1;  // Skip opening bracket
+    cursor->end = NULL;
+}
+
+// Put back the character under the terminator of the current object
+static void cursor_close(object_cursor_t* cursor) {
+    if (cursor->end) {
+        *cursor->end = cursor->saved;
+        cursor->pos = cursor->end;
+        cursor->end = NULL;
     }
-    
-    int brace_count = 1;
-    const char* end = start + 1;
-    
-    while (*end && brace_count > 0) {
-        if (*end == '{') {
-            brace_count++;
-        } else if (*end == '}') {
-            brace_count--;
-        }
-        end++;
+}
+
+// Next object of the array, NUL-terminated until the next call; NULL at the end of the array
+static char* cursor_next(object_cursor_t* cursor) {
+    cursor_close(cursor);
+    while (*cursor->pos && *cursor->pos != '{' && *cursor->pos != ']') {
+        cursor->pos++;
     }
-    
-    if (brace_count != 0) {
-        // Unbalanced braces
+    if (*cursor->pos != '{') {
         return NULL;
     }
-    
-    size_t len = end - start;
-    char* obj = malloc(len + 1);
-    if (!obj) {
+    char* end = object_end(cursor->pos);
+    if (!end) {
         return NULL;
     }
-    
-    strncpy(obj, start, len);
-    obj[len] = '\0';
-    
-    return obj;
+    cursor->saved = *end;
+    cursor->end = end;
+    *end = '\0';
+    return cursor->pos;
 }
 
 // Helper to find the beginning of an array
@@ -193,34 +298,23 @@ static const char* find_array(const char* json, const char* key) {
     return key_pos;
 }
 
-// Helper function to parse a file entry with all metadata
-static void parse_file_entry(const char *file_obj, file_entry_t *file_entry) {
+// Helper function to parse a file entry with all metadata.
+// The MP3 frame table is only kept for allFiles entries, which are the ones played;
+// it goes into the frames arena, and is skipped when that is NULL.
+static void parse_file_entry(const char *file_obj, file_entry_t *file_entry, mem_arena_t *frames) {
     // Initialize with defaults
     memset(file_entry, 0, sizeof(file_entry_t));
     file_entry->sample_rate = 44100;  // Default
     file_entry->bit_depth = 16;       // Default
     file_entry->channels = 2;         // Default
     file_entry->folder_index = 0;     // Default
+    file_entry->position = -1;
     
-    // Parse name
-    char *name = extract_string(file_obj, "name");
-    if (name) {
-        strncpy(file_entry->name, name, sizeof(file_entry->name) - 1);
-        file_entry->name[sizeof(file_entry->name) - 1] = '\0';
-        free(name);
-    } else {
+    // Parse name and path
+    if (!copy_string(file_obj, "name", file_entry->name, sizeof(file_entry->name))) {
         strncpy(file_entry->name, "unknown", sizeof(file_entry->name) - 1);
     }
-    
-    // Parse path
-    char *path = extract_string(file_obj, "path");
-    if (path) {
-        strncpy(file_entry->path, path, sizeof(file_entry->path) - 1);
-        file_entry->path[sizeof(file_entry->path) - 1] = '\0';
-        free(path);
-    } else {
-        strncpy(file_entry->path, "", sizeof(file_entry->path) - 1);
-    }
+    copy_string(file_obj, "path", file_entry->path, sizeof(file_entry->path));
     
     // Parse audio parameters
     file_entry->sample_rate = extract_int(file_obj, "sampleRate");
@@ -228,40 +322,634 @@ static void parse_file_entry(const char *file_obj, file_entry_t *file_entry) {
     file_entry->channels = extract_int(file_obj, "channels");
     file_entry->folder_index = extract_int(file_obj, "folderIndex");
     
+    // Parse optional encoding; anything unknown is treated as raw PCM
+    char format[16];
+    if (copy_string(file_obj, "format", format, sizeof(format))) {
+        if (strcmp(format, "ima_adpcm") == 0) {
+            file_entry->codec = PCM_CODEC_IMA_ADPCM;
+            file_entry->block_align = extract_int(file_obj, "blockAlign");
+        } else if (strcmp(format, "flac") == 0) {
+            file_entry->codec = PCM_CODEC_FLAC;
+        } else if (strcmp(format, "mp3") == 0) {
+            file_entry->codec = PCM_CODEC_MP3;
+            if (frames) {
+                file_entry->frame_index.frame_count = extract_int(file_obj, "frameCount");
+                file_entry->frame_index.interval = extract_int(file_obj, "frameInterval");
+                file_entry->frame_index.count = extract_uint_array(file_obj, "frameOffsets", frames,
+                                                                   &file_entry->frame_index.offsets);
+            }
+        } else if (strcmp(format, "pcm") != 0) {
+            ESP_LOGW(TAG, "Unknown format '%s', assuming raw PCM", format);
+        }
+    }
+    
+    // Parse optional loudness normalization data; peaks default to unknown (0)
+    file_entry->has_track_gain = extract_float(file_obj, "trackGain", &file_entry->track_gain_db);
+    extract_float(file_obj, "trackPeak", &file_entry->track_peak);
+    file_entry->has_album_gain = extract_float(file_obj, "albumGain", &file_entry->album_gain_db);
+    extract_float(file_obj, "albumPeak", &file_entry->album_peak);
+    
     // Parse song metadata
-    char *song = extract_string(file_obj, "song");
-    if (song) {
-        strncpy(file_entry->song, song, sizeof(file_entry->song) - 1);
-        file_entry->song[sizeof(file_entry->song) - 1] = '\0';
-        free(song);
-    } else {
+    if (!copy_string(file_obj, "song", file_entry->song, sizeof(file_entry->song))) {
         strncpy(file_entry->song, "Unknown Song", sizeof(file_entry->song) - 1);
     }
-    
-    char *album = extract_string(file_obj, "album");
-    if (album) {
-        strncpy(file_entry->album, album, sizeof(file_entry->album) - 1);
-        file_entry->album[sizeof(file_entry->album) - 1] = '\0';
-        free(album);
-    } else {
+    if (!copy_string(file_obj, "album", file_entry->album, sizeof(file_entry->album))) {
         strncpy(file_entry->album, "Unknown Album", sizeof(file_entry->album) - 1);
     }
-    
-    char *artist = extract_string(file_obj, "artist");
-    if (artist) {
-        strncpy(file_entry->artist, artist, sizeof(file_entry->artist) - 1);
-        file_entry->artist[sizeof(file_entry->artist) - 1] = '\0';
-        free(artist);
-    } else {
+    if (!copy_string(file_obj, "artist", file_entry->artist, sizeof(file_entry->artist))) {
         strncpy(file_entry->artist, "Unknown Artist", sizeof(file_entry->artist) - 1);
     }
 }
 
+// Paged index ---------------------------------------------------------------
+
+// Upper bound on the text of one allFiles entry (MP3 frame tables included)
+#define JSON_MAX_OBJECT_SIZE    (64 * 1024)
+// Chunk sizes of the entry text scratch arena and of each page's frame tables
+#define JSON_SCRATCH_CHUNK      (4 * 1024)
+#define JSON_PAGE_FRAMES_CHUNK  (2 * 1024)
+
+// allFiles entries of one page
+typedef struct {
+    int page;               // Page held, -1 if the slot is free
+    int count;
+    uint32_t last_use;
+    file_entry_t files[JSON_PAGE_FILES];
+    mem_arena_t frames;     // MP3 frame tables of the files, reset on eviction
+} json_page_t;
+
+struct json_index_pager {
+    char path[256];
+    uint32_t *page_offsets;     // index.json offset of allFiles entry page * JSON_PAGE_FILES
+    int page_count;
+    int32_t *folder_first;      // allFiles position of each folder's first file
+    int32_t *folder_files;      // Number of files in each folder
+    uint32_t *folder_dir_hash;  // Hash of the directory holding each folder's files
+    uint32_t *path_hashes;      // Hash of each file's path, until the path table is built
+    json_page_t *pages;
+    int page_slots;
+    mem_arena_t scratch;        // Text of the entry being parsed
+    uint32_t clock;
+    json_page_stats_t stats;
+};
+
+// Buffered reader that hands out the objects of a JSON array one at a time
+typedef struct {
+    FILE *file;
+    char buf[512];
+    size_t len;
+    size_t pos;
+    long base;              // File offset of buf[0]
+} json_reader_t;
+
+static void reader_init(json_reader_t *r, FILE *file, long offset) {
+    fseek(file, offset, SEEK_SET);
+    r->file = file;
+    r->len = 0;
+    r->pos = 0;
+    r->base = offset;
+}
+
+static int reader_getc(json_reader_t *r) {
+    if (r->pos == r->len) {
+        r->base += r->len;
+        r->len = fread(r->buf, 1, sizeof(r->buf), r->file);
+        r->pos = 0;
+        if (r->len == 0) {
+            return EOF;
+        }
+    }
+    return (unsigned char)r->buf[r->pos++];
+}
+
+static long reader_tell(const json_reader_t *r) {
+    return r->base + (long)r->pos;
+}
+
+// Skip to just after the '[' of the array stored under key
+static bool reader_find_array(json_reader_t *r, const char *key) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    size_t matched = 0;
+    int c;
+    while ((c = reader_getc(r)) != EOF) {
+        if (c == pattern[matched]) {
+            matched++;
+        } else {
+            matched = (c == '"') ? 1 : 0;
+        }
+        if (pattern[matched] != '\0') {
+            continue;
+        }
+        do {
+            c = reader_getc(r);
+        } while (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ':');
+        return c == '[';
+    }
+    return false;
+}
+
+// Read the next object of the array into the scratch arena; returns its text,
+// valid until the arena is reset, or NULL at the end of the array
+static char *reader_next_object(json_reader_t *r, mem_arena_t *scratch, long *offset) {
+    int c;
+    do {
+        c = reader_getc(r);
+    } while (c != EOF && c != '{' && c != ']');
+    if (c != '{') {
+        return NULL;
+    }
+    *offset = reader_tell(r) - 1;
+
+    size_t cap = 1024;
+    size_t len = 0;
+    char *obj = mem_arena_alloc(scratch, cap);
+    int depth = 0;
+    bool in_string = false;
+    bool escaped = false;
+    for (; obj != NULL && c != EOF; c = reader_getc(r)) {
+        if (len + 1 >= cap) {
+            // The outgrown copy stays in the arena until its next reset
+            char *grown = cap < JSON_MAX_OBJECT_SIZE ? mem_arena_alloc(scratch, cap * 2) : NULL;
+            if (grown == NULL) {
+                break;
+            }
+            memcpy(grown, obj, len);
+            obj = grown;
+            cap *= 2;
+        }
+        obj[len++] = (char)c;
+        if (in_string) {
+            if (escaped) {
+                escaped = false;
+            } else if (c == '\\') {
+                escaped = true;
+            } else if (c == '"') {
+                in_string = false;
+            }
+        } else if (c == '"') {
+            in_string = true;
+        } else if (c == '{') {
+            depth++;
+        } else if (c == '}' && --depth == 0) {
+            obj[len] = '\0';
+            return obj;
+        }
+    }
+    ESP_LOGE(TAG, "Unterminated or oversized entry at offset %ld", *offset);
+    return NULL;
+}
+
+// Bits of a path table slot holding the allFiles position + 1
+#define PATH_SLOT_POSITION_MASK ((1u << JSON_PATH_POSITION_BITS) - 1)
+
+// FNV-1a over a whole relative path
+static uint32_t path_hash(const char *path) {
+    uint32_t hash = 2166136261u;
+    for (; *path != '\0'; path++) {
+        hash = (hash ^ (uint8_t)*path) * 16777619u;
+    }
+    return hash;
+}
+
+// FNV-1a over the directory part of a path
+static uint32_t dir_hash(const char *path) {
+    const char *slash = strrchr(path, '/');
+    size_t len = slash ? (size_t)(slash - path) : 0;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)path[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void free_pager(json_index_pager_t *pager) {
+    if (pager->pages != NULL) {
+        for (int i = 0; i < pager->page_slots; i++) {
+            mem_arena_release(&pager->pages[i].frames);
+        }
+    }
+    mem_arena_release(&pager->scratch);
+    mem_free(pager->pages);
+    mem_free(pager->page_offsets);
+    mem_free(pager->folder_first);
+    mem_free(pager->folder_files);
+    mem_free(pager->folder_dir_hash);
+    mem_free(pager->path_hashes);
+    mem_free(pager);
+}
+
+// Grow a table to hold at least count elements; capacity doubles
+static bool grow_table(void **table, int *capacity, int count, size_t elem_size) {
+    if (count <= *capacity) {
+        return true;
+    }
+    int new_capacity = *capacity > 0 ? *capacity : 64;
+    while (new_capacity < count) {
+        new_capacity *= 2;
+    }
+    void *grown = mem_realloc(MEM_BULK, *table, (size_t)new_capacity * elem_size);
+    if (grown == NULL) {
+        return false;
+    }
+    *table = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+// Fill the path table from one hash per allFiles position; NULL hashes them from all_files
+static esp_err_t build_path_table(index_file_t *index, const uint32_t *hashes) {
+    json_path_table_t *table = &index->paths;
+    mem_free(table->slots);
+    table->slots = NULL;
+    table->count = 0;
+    if (index->total_files <= 0) {
+        return ESP_OK;
+    }
+    if ((uint32_t)index->total_files >= PATH_SLOT_POSITION_MASK) {
+        ESP_LOGW(TAG, "Too many tracks for the path table - lookups scan the index");
+        return ESP_FAIL;
+    }
+    uint32_t count = (uint32_t)index->total_files * 4 / 3 + 1;
+    size_t size = count * sizeof(json_path_slot_t);
+    // Host builds report no figures
+    mem_capacity_t bulk;
+    mem_get_capacity(MEM_BULK, &bulk);
+    if (bulk.free_bytes > 0 && (size > bulk.free_bytes / JSON_PATH_TABLE_SHARE || size > bulk.largest_block)) {
+        ESP_LOGW(TAG, "Path table of %u KB skipped with %u KB free - lookups scan the index",
+                 (unsigned)(size / 1024), (unsigned)(bulk.free_bytes / 1024));
+        return ESP_ERR_NO_MEM;
+    }
+    table->slots = mem_calloc(MEM_BULK, count, sizeof(json_path_slot_t));
+    if (table->slots == NULL) {
+        ESP_LOGW(TAG, "No memory for the path table - lookups scan the index");
+        return ESP_ERR_NO_MEM;
+    }
+    table->count = count;
+    for (int i = 0; i < index->total_files; i++) {
+        uint32_t hash = hashes != NULL ? hashes[i] : path_hash(index->all_files[i].path);
+        uint32_t slot = hash % count;
+        while (table->slots[slot] != 0) {
+            slot = slot + 1 < count ? slot + 1 : 0;
+        }
+        table->slots[slot] = (hash & ~PATH_SLOT_POSITION_MASK) | (uint32_t)(i + 1);
+    }
+    return ESP_OK;
+}
+
+esp_err_t json_index_build_paths(index_file_t *index) {
+    if (index == NULL || index->pager != NULL || (index->total_files > 0 && index->all_files == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return build_path_table(index, NULL);
+}
+
+// Walk allFiles once, recording page offsets and the folder ranges
+static esp_err_t scan_all_files(FILE *file, json_index_pager_t *pager, index_file_t *index) {
+    json_reader_t reader;
+    reader_init(&reader, file, 0);
+    if (!reader_find_array(&reader, "allFiles")) {
+        ESP_LOGE(TAG, "No allFiles array in %s", pager->path);
+        return ESP_FAIL;
+    }
+
+    int page_capacity = 0;
+    int hash_capacity = 0;
+    int folder_capacity = 0;
+    bool hashing = true;
+    int total = 0;
+    int last_folder = -1;
+    long offset;
+    char *obj;
+    char path[256];
+    for (; (obj = reader_next_object(&reader, &pager->scratch, &offset)) != NULL; mem_arena_reset(&pager->scratch)) {
+        int folder = extract_int(obj, "folderIndex");
+        if (!copy_string(obj, "path", path, sizeof(path))) {
+            path[0] = '\0';
+        }
+        if (folder < 0) {
+            folder = 0;
+        }
+
+        // The path hashes only speed up lookups; without room for them the index still pages
+        if (hashing && grow_table((void **)&pager->path_hashes, &hash_capacity, total + 1, sizeof(uint32_t))) {
+            pager->path_hashes[total] = path_hash(path);
+        } else if (hashing) {
+            ESP_LOGW(TAG, "No memory for the path hashes - lookups scan the matching folders");
+            mem_free(pager->path_hashes);
+            pager->path_hashes = NULL;
+            hashing = false;
+        }
+        bool ok = true;
+        if (total % JSON_PAGE_FILES == 0) {
+            ok = grow_table((void **)&pager->page_offsets, &page_capacity, pager->page_count + 1, sizeof(uint32_t));
+            if (ok) {
+                pager->page_offsets[pager->page_count++] = (uint32_t)offset;
+            }
+        }
+        if (ok && folder >= index->folder_count) {
+            int capacity = folder_capacity;
+            ok = grow_table((void **)&pager->folder_first, &capacity, folder + 1, sizeof(int32_t));
+            capacity = folder_capacity;
+            ok = ok && grow_table((void **)&pager->folder_files, &capacity, folder + 1, sizeof(int32_t));
+            capacity = folder_capacity;
+            ok = ok && grow_table((void **)&pager->folder_dir_hash, &capacity, folder + 1, sizeof(uint32_t));
+            if (ok) {
+                folder_capacity = capacity;
+                for (int f = index->folder_count; f <= folder; f++) {
+                    pager->folder_first[f] = -1;
+                    pager->folder_files[f] = 0;
+                    pager->folder_dir_hash[f] = 0;
+                }
+                index->folder_count = folder + 1;
+            }
+        }
+        if (ok && pager->folder_first[folder] < 0) {
+            pager->folder_first[folder] = total;
+            pager->folder_dir_hash[folder] = dir_hash(path);
+        } else if (ok && folder != last_folder) {
+            ESP_LOGE(TAG, "allFiles is not grouped by folder (entry %d), cannot page the index", total);
+            ok = false;
+        }
+        if (!ok) {
+            return ESP_FAIL;
+        }
+        pager->folder_files[folder]++;
+        last_folder = folder;
+        total++;
+    }
+
+    for (int f = 0; f < index->folder_count; f++) {
+        if (pager->folder_first[f] < 0) {
+            pager->folder_first[f] = 0;
+        }
+    }
+    index->total_files = total;
+    return ESP_OK;
+}
+
+esp_err_t json_parse_index_paged(const char *filepath, index_file_t *index) {
+    if (filepath == NULL || index == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(index, 0, sizeof(*index));
+    strncpy(index->version, "1.0", sizeof(index->version) - 1);
+
+    FILE *file = fopen(filepath, "rb");
+    if (file == NULL) {
+        ESP_LOGE(TAG, "Failed to open index file: %s (errno: %d)", filepath, errno);
+        return ESP_FAIL;
+    }
+
+    json_index_pager_t *pager = mem_calloc(MEM_BULK, 1, sizeof(json_index_pager_t));
+    if (pager == NULL) {
+        fclose(file);
+        return ESP_ERR_NO_MEM;
+    }
+    strncpy(pager->path, filepath, sizeof(pager->path) - 1);
+    mem_arena_init(&pager->scratch, MEM_BULK, JSON_SCRATCH_CHUNK);
+
+    // The version sits ahead of the arrays
+    char head[256];
+    size_t n = fread(head, 1, sizeof(head) - 1, file);
+    head[n] = '\0';
+    copy_string(head, "version", index->version, sizeof(index->version));
+
+    esp_err_t ret = scan_all_files(file, pager, index);
+    fclose(file);
+    if (ret != ESP_OK) {
+        index->folder_count = 0;
+        free_pager(pager);
+        return ret;
+    }
+    if (pager->path_hashes != NULL) {
+        build_path_table(index, pager->path_hashes);
+        mem_free(pager->path_hashes);
+        pager->path_hashes = NULL;
+    }
+
+    size_t budget = mem_has_psram() ? JSON_PAGE_BUDGET_PSRAM : JSON_PAGE_BUDGET;
+    pager->page_slots = budget / sizeof(json_page_t);
+    if (pager->page_slots < 3) {
+        pager->page_slots = 3;
+    }
+    pager->pages = mem_calloc(MEM_BULK, pager->page_slots, sizeof(json_page_t));
+    if (pager->pages == NULL) {
+        index->folder_count = 0;
+        free_pager(pager);
+        mem_free(index->paths.slots);
+        index->paths.slots = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < pager->page_slots; i++) {
+        pager->pages[i].page = -1;
+        mem_arena_init(&pager->pages[i].frames, MEM_BULK, JSON_PAGE_FRAMES_CHUNK);
+    }
+
+    index->pager = pager;
+    ESP_LOGI(TAG, "Paged index: %d files in %d folders, %d pages, %d resident at most",
+             index->total_files, index->folder_count, pager->page_count, pager->page_slots);
+    return ESP_OK;
+}
+
+// Return the slot holding a page, reading it from index.json if needed
+static json_page_t *load_page(json_index_pager_t *pager, int page) {
+    pager->clock++;
+    json_page_t *victim = &pager->pages[0];
+    for (int i = 0; i < pager->page_slots; i++) {
+        json_page_t *slot = &pager->pages[i];
+        if (slot->page == page) {
+            slot->last_use = pager->clock;
+            pager->stats.hits++;
+            return slot;
+        }
+        if (slot->page < 0 || (victim->page >= 0 && slot->last_use < victim->last_use)) {
+            victim = slot;
+        }
+    }
+
+    FILE *file = fopen(pager->path, "rb");
+    if (file == NULL) {
+        ESP_LOGE(TAG, "Failed to reopen %s for page %d", pager->path, page);
+        return NULL;
+    }
+    mem_arena_reset(&victim->frames);
+    if (victim->page < 0) {
+        pager->stats.resident_pages++;
+    }
+    victim->page = -1;
+    victim->count = 0;
+
+    json_reader_t reader;
+    reader_init(&reader, file, pager->page_offsets[page]);
+    long offset;
+    char *obj;
+    while (victim->count < JSON_PAGE_FILES && (obj = reader_next_object(&reader, &pager->scratch, &offset)) != NULL) {
+        file_entry_t *entry = &victim->files[victim->count];
+        parse_file_entry(obj, entry, &victim->frames);
+        entry->position = page * JSON_PAGE_FILES + victim->count++;
+        mem_arena_reset(&pager->scratch);
+    }
+    fclose(file);
+
+    victim->page = page;
+    victim->last_use = pager->clock;
+    pager->stats.loads++;
+    return victim;
+}
+
+file_entry_t *json_index_file(index_file_t *index, int file_index) {
+    if (index == NULL || file_index < 0 || file_index >= index->total_files) {
+        return NULL;
+    }
+    if (index->pager == NULL) {
+        return index->all_files != NULL ? &index->all_files[file_index] : NULL;
+    }
+    json_page_t *page = load_page(index->pager, file_index / JSON_PAGE_FILES);
+    int slot = file_index % JSON_PAGE_FILES;
+    return (page != NULL && slot < page->count) ? &page->files[slot] : NULL;
+}
+
+int json_index_folder_size(index_file_t *index, int folder) {
+    if (index == NULL || folder < 0 || folder >= index->folder_count) {
+        return 0;
+    }
+    if (index->pager == NULL) {
+        return index->music_folders != NULL ? index->music_folders[folder].file_count : 0;
+    }
+    return index->pager->folder_files[folder];
+}
+
+file_entry_t *json_index_folder_file(index_file_t *index, int folder, int file_index) {
+    if (file_index < 0 || file_index >= json_index_folder_size(index, folder)) {
+        return NULL;
+    }
+    if (index->pager == NULL) {
+        return &index->music_folders[folder].files[file_index];
+    }
+    return json_index_file(index, index->pager->folder_first[folder] + file_index);
+}
+
+int json_index_find(index_file_t *index, const char *rel_path) {
+    if (index == NULL || rel_path == NULL) {
+        return -1;
+    }
+    const json_path_table_t *table = &index->paths;
+    if (table->slots != NULL) {
+        // Positions are inserted in order, so the first of repeated paths is met first
+        uint32_t hash = path_hash(rel_path);
+        for (uint32_t slot = hash % table->count; table->slots[slot] != 0;
+             slot = slot + 1 < table->count ? slot + 1 : 0) {
+            if ((table->slots[slot] & ~PATH_SLOT_POSITION_MASK) != (hash & ~PATH_SLOT_POSITION_MASK)) {
+                continue;
+            }
+            int position = (int)(table->slots[slot] & PATH_SLOT_POSITION_MASK) - 1;
+            file_entry_t *entry = json_index_file(index, position);
+            if (entry != NULL && strcmp(entry->path, rel_path) == 0) {
+                return position;
+            }
+        }
+        return -1;
+    }
+    if (index->pager == NULL) {
+        for (int i = 0; i < index->total_files && index->all_files != NULL; i++) {
+            if (strcmp(index->all_files[i].path, rel_path) == 0) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // Only folders whose directory matches need their pages read
+    uint32_t hash = dir_hash(rel_path);
+    for (int f = 0; f < index->folder_count; f++) {
+        if (index->pager->folder_dir_hash[f] != hash) {
+            continue;
+        }
+        for (int j = 0; j < index->pager->folder_files[f]; j++) {
+            int i = index->pager->folder_first[f] + j;
+            file_entry_t *entry = json_index_file(index, i);
+            if (entry != NULL && strcmp(entry->path, rel_path) == 0) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+void json_index_prefetch_folder(index_file_t *index, int folder) {
+    if (index != NULL && index->pager != NULL && json_index_folder_size(index, folder) > 0) {
+        load_page(index->pager, index->pager->folder_first[folder] / JSON_PAGE_FILES);
+    }
+}
+
+void json_index_get_page_stats(const index_file_t *index, json_page_stats_t *stats) {
+    if (index == NULL || index->pager == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    *stats = index->pager->stats;
+}
+
+// Arena bytes for an index: the tables, the folder file lists and the MP3
+// frame tables of the allFiles entries
+static size_t index_arena_estimate(const char *all_files_array, int files_count,
+                                   const char *folders_array, int folders_count) {
+    size_t size = MEM_ARENA_SPAN(files_count * sizeof(file_entry_t)) +
+                  MEM_ARENA_SPAN(folders_count * sizeof(folder_t));
+    object_cursor_t cursor;
+    char *obj;
+    char *values;
+    if (files_count > 0) {
+        cursor_init(&cursor, all_files_array);
+        for (int i = 0; i < files_count && (obj = cursor_next(&cursor)) != NULL; i++) {
+            int count = count_uint_array(obj, "frameOffsets", &values);
+            if (count > 0) {
+                size += MEM_ARENA_SPAN(count * sizeof(uint32_t));
+            }
+        }
+        cursor_close(&cursor);
+    }
+    if (folders_count > 0) {
+        cursor_init(&cursor, folders_array);
+        for (int i = 0; i < folders_count && (obj = cursor_next(&cursor)) != NULL; i++) {
+            const char *files_array = find_array(obj, "files");
+            int count = files_array ? get_array_size(files_array) : 0;
+            if (count > 0) {
+                size += MEM_ARENA_SPAN(count * sizeof(file_entry_t));
+            }
+        }
+        cursor_close(&cursor);
+    }
+    return size;
+}
+
+// Point each folder entry at its allFiles twin. Folders list their files in
+// allFiles order, so the entry after the last match is tried before a search.
+static void link_folder_files(index_file_t *index) {
+    int next = 0;
+    for (int f = 0; f < index->folder_count; f++) {
+        folder_t *folder = &index->music_folders[f];
+        for (int j = 0; j < folder->file_count; j++) {
+            file_entry_t *entry = &folder->files[j];
+            if (next < index->total_files && strcmp(index->all_files[next].path, entry->path) == 0) {
+                entry->position = next;
+            } else {
+                entry->position = json_index_find(index, entry->path);
+            }
+            if (entry->position >= 0) {
+                next = entry->position + 1;
+            }
+        }
+    }
+}
+
 esp_err_t json_parse_index(const char *filepath, index_file_t *index) {
     if (filepath == NULL || index == NULL) {
         ESP_LOGE(TAG, "Invalid arguments for json_parse_index");
         return ESP_ERR_INVALID_ARG;
     }
+    memset(index, 0, sizeof(*index));
 
     ESP_LOGI(TAG, "Attempting to open index file: %s", filepath);
     
@@ -323,12 +1011,18 @@ esp_err_t json_parse_index(const char *filepath, index_file_t *index) {
         return ESP_FAIL;
     }
 
+    // Large libraries do not fit in RAM as a whole
+    if (file_size > JSON_INDEX_PAGED_THRESHOLD) {
+        fclose(file);
+        return json_parse_index_paged(filepath, index);
+    }
+
     // Allocate memory for the file content
-    char *file_content = (char *)malloc(file_size + 1);
+    char *file_content = (char *)mem_alloc(MEM_BULK, file_size + 1);
     if (!file_content) {
-        ESP_LOGE(TAG, "Failed to allocate memory for file content");
+        ESP_LOGW(TAG, "Not enough memory to load the index, falling back to paged mode");
         fclose(file);
-        return ESP_ERR_NO_MEM;
+        return json_parse_index_paged(filepath, index);
     }
 
     // Read the file
@@ -337,7 +1031,7 @@ esp_err_t json_parse_index(const char *filepath, index_file_t *index) {
     
     if (read_size != file_size) {
         ESP_LOGE(TAG, "Failed to read file content");
-        free(file_content);
+        mem_free(file_content);
         return ESP_FAIL;
     }
 
@@ -348,196 +1042,105 @@ esp_err_t json_parse_index(const char *filepath, index_file_t *index) {
     ESP_LOGI(TAG, "File content preview (first 100 chars): %.100s", file_content);
 
     // Parse version
-    char *version_str = extract_string(file_content, "version");
-    if (version_str) {
-        strncpy(index->version, version_str, sizeof(index->version) - 1);
-        index->version[sizeof(index->version) - 1] = '\0';
-        free(version_str);
-    } else {
+    if (!copy_string(file_content, "version", index->version, sizeof(index->version))) {
         strncpy(index->version, "1.0", sizeof(index->version) - 1);
     }
     
     // Parse totalFiles
     index->total_files = extract_int(file_content, "totalFiles");
 
-    // Parse allFiles array
+    // Size the arena for the whole index up front, so its tables and frame
+    // tables end up in one heap block instead of thousands of small ones
     const char *all_files_array = find_array(file_content, "allFiles");
-    if (all_files_array) {
-        int files_count = get_array_size(all_files_array);
-        index->total_files = files_count;  // Update with actual count
-        
-        // Allocate memory for files
-        index->all_files = (file_entry_t *)malloc(sizeof(file_entry_t) * files_count);
+    const char *folders_array = find_array(file_content, "musicFolders");
+    int files_count = all_files_array ? get_array_size(all_files_array) : 0;
+    int folders_count = folders_array ? get_array_size(folders_array) : 0;
+    mem_arena_init(&index->arena, MEM_BULK, JSON_INDEX_ARENA_CHUNK);
+    size_t arena_size = index_arena_estimate(all_files_array, files_count, folders_array, folders_count);
+    if (arena_size > 0 && !mem_arena_reserve(&index->arena, arena_size)) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes for the index", (unsigned)arena_size);
+        mem_free(file_content);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Parse allFiles array
+    index->total_files = files_count;  // Update with actual count
+    if (files_count > 0) {
+        index->all_files = (file_entry_t *)mem_arena_calloc(&index->arena, files_count, sizeof(file_entry_t));
         if (!index->all_files) {
             ESP_LOGE(TAG, "Failed to allocate memory for all_files");
-            free(file_content);
+            json_free_index(index);
+            mem_free(file_content);
             return ESP_ERR_NO_MEM;
         }
         
-        // Parse each file entry
-        const char *pos = all_files_array + 1;  // Skip opening bracket
-        for (int i = 0; i < files_count; i++) {
-            // Find next object
-            while (*pos && (*pos != '{')) {
-                pos++;
-            }
-            
-            if (!*pos) break;  // End of string
-            
-            // Extract object
-            char *obj = extract_object(pos);
-            if (obj) {
-                parse_file_entry(obj, &index->all_files[i]);
-                
-                free(obj);
-                
-                // Move to end of object
-                while (*pos && (*pos != '}')) {
-                    pos++;
-                }
-                
-                if (*pos) pos++;  // Skip closing brace
-            }
+        // Parse each file entry in place
+        object_cursor_t files;
+        cursor_init(&files, all_files_array);
+        char *obj;
+        for (int i = 0; i < files_count && (obj = cursor_next(&files)) != NULL; i++) {
+            parse_file_entry(obj, &index->all_files[i], &index->arena);
+            index->all_files[i].position = i;
         }
-    } else {
-        index->all_files = NULL;
-        index->total_files = 0;
+        cursor_close(&files);
+        build_path_table(index, NULL);
     }
 
     // Parse musicFolders array
-    const char *folders_array = find_array(file_content, "musicFolders");
-    if (folders_array) {
-        int folders_count = get_array_size(folders_array);
-        index->folder_count = folders_count;
-        
-        // Allocate memory for folders
-        index->music_folders = (folder_t *)malloc(sizeof(folder_t) * folders_count);
+    index->folder_count = folders_count;
+    if (folders_count > 0) {
+        index->music_folders = (folder_t *)mem_arena_calloc(&index->arena, folders_count, sizeof(folder_t));
         if (!index->music_folders) {
             ESP_LOGE(TAG, "Failed to allocate memory for music_folders");
-            if (index->all_files) free(index->all_files);
-            free(file_content);
+            json_free_index(index);
+            mem_free(file_content);
             return ESP_ERR_NO_MEM;
         }
         
-        // Parse each folder entry
-        const char *pos = folders_array + 1;  // Skip opening bracket
-        for (int i = 0; i < folders_count; i++) {
-            ESP_LOGI(TAG, "Parsing folder %d", i);
-            
-            // Find next object
-            while (*pos && (*pos != '{')) {
-                pos++;
+        // Parse each folder entry in place; its files are parsed within it
+        object_cursor_t folders;
+        cursor_init(&folders, folders_array);
+        char *folder_obj;
+        for (int i = 0; i < folders_count && (folder_obj = cursor_next(&folders)) != NULL; i++) {
+            folder_t *folder = &index->music_folders[i];
+            if (!copy_string(folder_obj, "name", folder->name, sizeof(folder->name))) {
+                ESP_LOGW(TAG, "No name found for folder %d", i);
+                strncpy(folder->name, "unknown", sizeof(folder->name) - 1);
             }
             
-            if (!*pos) {
-                ESP_LOGW(TAG, "No opening brace found for folder %d", i);
-                break;  // End of string
+            // Find files array in folder
+            const char *files_array = find_array(folder_obj, "files");
+            int count = files_array ? get_array_size(files_array) : 0;
+            if (count == 0) {
+                continue;
+            }
+            folder->files = (file_entry_t *)mem_arena_calloc(&index->arena, count, sizeof(file_entry_t));
+            if (!folder->files) {
+                ESP_LOGE(TAG, "Failed to allocate memory for folder files");
+                cursor_close(&folders);
+                json_free_index(index);
+                mem_free(file_content);
+                return ESP_ERR_NO_MEM;
             }
+            folder->file_count = count;
             
-            // Extract object
-            char *folder_obj = extract_object(pos);
-            if (folder_obj) {
-                ESP_LOGI(TAG, "Folder object %d: %.100s...", i, folder_obj);
-                
-                char *name = extract_string(folder_obj, "name");
-                if (name) {
-                    ESP_LOGI(TAG, "Found folder name: %s", name);
-                    strncpy(index->music_folders[i].name, name, sizeof(index->music_folders[i].name) - 1);
-                    index->music_folders[i].name[sizeof(index->music_folders[i].name) - 1] = '\0';
-                    free(name);
-                } else {
-                    ESP_LOGW(TAG, "No name found for folder %d", i);
-                    strncpy(index->music_folders[i].name, "unknown", sizeof(index->music_folders[i].name) - 1);
-                }
-                
-                // Find files array in folder
-                const char *files_array = find_array(folder_obj, "files");
-                if (files_array) {
-                    int files_count = get_array_size(files_array);
-                    index->music_folders[i].file_count = files_count;
-                    
-                    // Allocate memory for folder files
-                    index->music_folders[i].files = (file_entry_t *)malloc(sizeof(file_entry_t) * files_count);
-                    if (!index->music_folders[i].files) {
-                        ESP_LOGE(TAG, "Failed to allocate memory for folder files");
-                        // Clean up previously allocated folders
-                        for (int j = 0; j < i; j++) {
-                            if (index->music_folders[j].files) {
-                                free(index->music_folders[j].files);
-                            }
-                        }
-                        if (index->music_folders) free(index->music_folders);
-                        if (index->all_files) free(index->all_files);
-                        free(folder_obj);
-                        free(file_content);
-                        return ESP_ERR_NO_MEM;
-                    }
-                    
-                    // Parse each file in folder
-                    const char *file_pos = files_array + 1;  // Skip opening bracket
-                    for (int j = 0; j < files_count; j++) {
-                        // Find next object
-                        while (*file_pos && (*file_pos != '{')) {
-                            file_pos++;
-                        }
-                        
-                        if (!*file_pos) break;  // End of string
-                        
-                        // Extract object
-                        char *file_obj = extract_object(file_pos);
-                        if (file_obj) {
-                            parse_file_entry(file_obj, &index->music_folders[i].files[j]);
-                            
-                            free(file_obj);
-                            
-                            // Move to end of object
-                            while (*file_pos && (*file_pos != '}')) {
-                                file_pos++;
-                            }
-                            
-                            if (*file_pos) file_pos++;  // Skip closing brace
-                        }
-                    }
-                } else {
-                    index->music_folders[i].files = NULL;
-                    index->music_folders[i].file_count = 0;
-                }
-                
-                free(folder_obj);
-                
-                // Move to end of the extracted object
-                int brace_count = 1;
-                pos++; // Move past the opening brace we found
-                while (*pos && brace_count > 0) {
-                    if (*pos == '{') {
-                        brace_count++;
-                    } else if (*pos == '}') {
-                        brace_count--;
-                    }
-                    pos++;
-                }
-            } else {
-                // If extract_object failed, try to skip this malformed object
-                int brace_count = 1;
-                pos++;
-                while (*pos && brace_count > 0) {
-                    if (*pos == '{') {
-                        brace_count++;
-                    } else if (*pos == '}') {
-                        brace_count--;
-                    }
-                    pos++;
-                }
+            object_cursor_t folder_files;
+            cursor_init(&folder_files, files_array);
+            char *file_obj;
+            for (int j = 0; j < count && (file_obj = cursor_next(&folder_files)) != NULL; j++) {
+                parse_file_entry(file_obj, &folder->files[j], NULL);
             }
+            cursor_close(&folder_files);
+            ESP_LOGI(TAG, "Folder %d: %s, %d files", i, folder->name, count);
         }
-    } else {
-        index->music_folders = NULL;
-        index->folder_count = 0;
+        cursor_close(&folders);
+        link_folder_files(index);
     }
 
     // Cleanup
-    free(file_content);
-    ESP_LOGI(TAG, "Index file successfully parsed");
+    mem_free(file_content);
+    ESP_LOGI(TAG, "Index file successfully parsed into %u KB in %d block(s), %u KB used",
+             (unsigned)(index->arena.capacity / 1024), index->arena.chunks, (unsigned)(index->arena.used / 1024));
     
     return ESP_OK;
 }
@@ -547,9 +1150,27 @@ esp_err_t json_free_index(index_file_t *index) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    // Free all files
+    if (index->pager != NULL) {
+        free_pager(index->pager);
+        index->pager = NULL;
+    }
+    mem_free(index->paths.slots);
+    index->paths.slots = NULL;
+
+    // Everything of a parsed or cached index lives in its arena
+    if (index->arena.chunks > 0) {
+        mem_arena_release(&index->arena);
+        index->all_files = NULL;
+        index->music_folders = NULL;
+        return ESP_OK;
+    }
+
+    // Indexes assembled table by table: free all files
     if (index->all_files != NULL) {
-        free(index->all_files);
+        for (int i = 0; i < index->total_files; i++) {
+            mem_free(index->all_files[i].frame_index.offsets);
+        }
+        mem_free(index->all_files);
         index->all_files = NULL;
     }
 
@@ -557,11 +1178,11 @@ esp_err_t json_free_index(index_file_t *index) {
     if (index->music_folders != NULL) {
         for (int i = 0; i < index->folder_count; i++) {
             if (index->music_folders[i].files != NULL) {
-                free(index->music_folders[i].files);
+                mem_free(index->music_folders[i].files);
                 index->music_folders[i].files = NULL;
             }
         }
-        free(index->music_folders);
+        mem_free(index->music_folders);
         index->music_folders = NULL;
     }
 
@@ -15,6 +15,9 @@ typedef int esp_err_t;
 #define ESP_ERR_NO_MEM -3
 #endif
 
+#include "pcm_file.h"
+#include "mem_policy.h"
+
 // File entry structure
 typedef struct {
     char name[256];
@@ -22,10 +25,21 @@ typedef struct {
     uint32_t sample_rate;
     uint16_t bit_depth;
     uint16_t channels;
+    pcm_codec_t codec;      // Encoding declared by "format" (raw PCM by default)
+    uint16_t block_align;   // Encoded block size for block codecs
+    mp3_frame_index_t frame_index;  // MP3 frame offsets for seeking (allFiles entries only)
     int folder_index;
+    int32_t position;       // allFiles position of the track, -1 if it is not in allFiles
     char song[256];
     char album[256];
     char artist[256];
+    // Optional ReplayGain-style loudness data (gain in dB, peak as linear amplitude)
+    bool has_track_gain;
+    float track_gain_db;
+    float track_peak;
+    bool has_album_gain;
+    float album_gain_db;
+    float album_peak;
 } file_entry_t;
 
 // Folder structure
@@ -35,6 +49,36 @@ typedef struct {
     int file_count;
 } folder_t;
 
+// Index files larger than this are opened in paged mode
+#ifndef JSON_INDEX_PAGED_THRESHOLD
+#define JSON_INDEX_PAGED_THRESHOLD  (256 * 1024)
+#endif
+
+// Paged mode: allFiles entries per page, and the RAM kept for resident pages
+#define JSON_PAGE_FILES             8
+#ifndef JSON_PAGE_BUDGET
+#define JSON_PAGE_BUDGET            (64 * 1024)
+#endif
+#define JSON_PAGE_BUDGET_PSRAM      (8 * JSON_PAGE_BUDGET)
+
+// Chunks added to an index arena when its up-front size falls short
+#define JSON_INDEX_ARENA_CHUNK      (16 * 1024)
+
+typedef struct json_index_pager json_index_pager_t;
+
+// Path lookup slot: the allFiles position + 1 in the low JSON_PATH_POSITION_BITS,
+// the top bits of the path's FNV-1a above them; 0 for an empty slot
+#define JSON_PATH_POSITION_BITS     20
+typedef uint32_t json_path_slot_t;
+
+// Open addressing with linear probing, kept at most three quarters full. The
+// table takes at most 1/JSON_PATH_TABLE_SHARE of the free bulk memory.
+#define JSON_PATH_TABLE_SHARE       8
+typedef struct {
+    json_path_slot_t *slots;
+    uint32_t count;         // Slot count
+} json_path_table_t;
+
 // Index file structure
 typedef struct {
     char version[16];
@@ -42,8 +86,24 @@ typedef struct {
     file_entry_t *all_files;
     folder_t *music_folders;
     int folder_count;
+    // Paged mode: all_files and music_folders stay NULL and track records are
+    // loaded from index.json on demand; use the json_index_* accessors
+    json_index_pager_t *pager;
+    // Holds all_files, music_folders, the folder file lists and the MP3 frame
+    // tables of a parsed or cached index, so freeing the index is one step
+    mem_arena_t arena;
+    // Relative path to allFiles position, built when the index is loaded;
+    // json_index_find() falls back to a scan without it
+    json_path_table_t paths;
 } index_file_t;
 
+// Page cache activity of a paged index
+typedef struct {
+    uint32_t hits;
+    uint32_t loads;
+    int resident_pages;
+} json_page_stats_t;
+
 /**
  * @brief Parse index.json file
  * 
@@ -53,6 +113,88 @@ typedef struct {
  */
 esp_err_t json_parse_index(const char *filepath, index_file_t *index);
 
+/**
+ * @brief Open index.json in paged mode
+ * 
+ * Only the page and folder tables stay resident; track records are read in
+ * pages of JSON_PAGE_FILES and evicted least recently used first. The
+ * allFiles entries of a folder must be consecutive.
+ * 
+ * @param filepath Path to index.json file
+ * @param index Pointer to store the index
+ * @return ESP_OK on success, ESP_FAIL if the file cannot be scanned
+ */
+esp_err_t json_parse_index_paged(const char *filepath, index_file_t *index);
+
+/**
+ * @brief Get an entry of allFiles
+ * 
+ * In paged mode the entry stays valid until other pages push its page out
+ * of the cache; copy what is needed across further index calls.
+ * 
+ * @param index Index
+ * @param file_index Position in allFiles
+ * @return Entry, or NULL if out of range or the page cannot be read
+ */
+file_entry_t *json_index_file(index_file_t *index, int file_index);
+
+/**
+ * @brief Get the number of files in a folder
+ * 
+ * @param index Index
+ * @param folder Folder index
+ * @return Number of files, 0 if the folder does not exist
+ */
+int json_index_folder_size(index_file_t *index, int folder);
+
+/**
+ * @brief Get a file of a folder; same lifetime as json_index_file()
+ * 
+ * @param index Index
+ * @param folder Folder index
+ * @param file_index Position in the folder
+ * @return Entry, or NULL if out of range or the page cannot be read
+ */
+file_entry_t *json_index_folder_file(index_file_t *index, int folder, int file_index);
+
+/**
+ * @brief Find a file in allFiles by its relative path
+ * 
+ * A hash lookup once the path table is built; in paged mode only the page
+ * holding the match is read.
+ * 
+ * @param index Index
+ * @param rel_path Path relative to the music directory
+ * @return Position in allFiles, the first one if a path repeats; -1 if not found
+ */
+int json_index_find(index_file_t *index, const char *rel_path);
+
+/**
+ * @brief Build the path table of an index assembled in memory
+ * 
+ * json_parse_index() and json_parse_index_paged() build it themselves.
+ * 
+ * @param index Index with all_files filled in
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the table does not fit; lookups still work by scanning
+ */
+esp_err_t json_index_build_paths(index_file_t *index);
+
+/**
+ * @brief Load the first page of a folder ahead of use; no-op when not paged
+ * 
+ * @param index Index
+ * @param folder Folder index
+ */
+void json_index_prefetch_folder(index_file_t *index, int folder);
+
+/**
+ * @brief Get page cache counters; all zero when not paged
+ * 
+ * @param index Index
+ * @param stats Pointer to store the counters
+ */
+void json_index_get_page_stats(const index_file_t *index, json_page_stats_t *stats);
+
 /**
  * @brief Free memory allocated for index file
  * 
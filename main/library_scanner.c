@@ -0,0 +1,709 @@
+#include "library_scanner.h"
+#include "mem_policy.h"
+#include "mp3_frame.h"
+#include "pcm_file.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#ifndef TEST_MODE
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sd_card.h"
+#else
+#include <time.h>
+#define ESP_LOGI(tag, format, ...) printf("[INFO] " format "\n", ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) printf("[WARN] " format "\n", ##__VA_ARGS__)
+#define ESP_LOGE(tag, format, ...) printf("[ERROR] " format "\n", ##__VA_ARGS__)
+
+static int64_t esp_timer_get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+#endif
+
+static const char *TAG = "library_scanner";
+
+#define MANIFEST_MAGIC      "ESP32SCAN 1\n"
+#define MANIFEST_LINE_SIZE  (LIBRARY_SCAN_MAX_OFFSETS * 11 + 512)
+
+// Headerless .pcm files are taken to be in the Music Manager's output format
+#define DEFAULT_SAMPLE_RATE 44100
+#define DEFAULT_BIT_DEPTH   16
+#define DEFAULT_CHANNELS    2
+
+// Codec names as used by the "format" key of index.json, by pcm_codec_t
+static const char *const FORMAT_NAMES[] = {"pcm", "ima_adpcm", "flac", "mp3"};
+
+// What the index needs to know about one track
+typedef struct {
+    char name[256];
+    pcm_codec_t codec;
+    uint32_t sample_rate;
+    uint16_t bit_depth;
+    uint16_t channels;
+    uint16_t block_align;
+    uint32_t frame_count;
+    uint16_t interval;
+    uint16_t count;
+    uint32_t offsets[LIBRARY_SCAN_MAX_OFFSETS];
+} scan_record_t;
+
+// A directory of the previous manifest
+typedef struct {
+    uint32_t dir_hash;
+    uint32_t sig;
+    long offset;            // Manifest offset of its D line
+} manifest_dir_t;
+
+// Entry of the directory being walked
+typedef struct {
+    size_t name_offset;
+    bool is_dir;
+    uint32_t size;
+    uint32_t mtime;
+} dir_entry_t;
+
+typedef struct {
+    const char *root;
+    FILE *old;              // Previous manifest, NULL if there is none
+    manifest_dir_t *old_dirs;
+    int old_dir_count;
+    FILE *out;              // New manifest
+    char *line;
+    scan_record_t *record;
+    library_scan_stats_t *stats;
+} scan_ctx_t;
+
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t len) {
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t hash_string(const char *s) {
+    return fnv1a(2166136261u, s, strlen(s));
+}
+
+static uint16_t read_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static const char *extension_of(const char *name) {
+    const char *dot = strrchr(name, '.');
+    return dot ? dot + 1 : "";
+}
+
+static bool is_audio_file(const char *name) {
+    const char *ext = extension_of(name);
+    return strcasecmp(ext, "pcm") == 0 || strcasecmp(ext, "wav") == 0 ||
+           strcasecmp(ext, "flac") == 0 || strcasecmp(ext, "mp3") == 0;
+}
+
+// Read the fmt chunk of a RIFF/WAVE file positioned after the 12-byte RIFF header
+static bool probe_wav(FILE *file, scan_record_t *rec) {
+    uint8_t chunk[8];
+    while (fread(chunk, 1, sizeof(chunk), file) == sizeof(chunk)) {
+        uint32_t size = read_le32(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (size < sizeof(fmt) || fread(fmt, 1, sizeof(fmt), file) != sizeof(fmt)) {
+                return false;
+            }
+            uint16_t tag = read_le16(fmt);
+            rec->channels = read_le16(fmt + 2);
+            rec->sample_rate = read_le32(fmt + 4);
+            rec->block_align = read_le16(fmt + 12);
+            rec->bit_depth = read_le16(fmt + 14);
+            if (tag == 0x11) {
+                rec->codec = PCM_CODEC_IMA_ADPCM;
+                rec->bit_depth = 16;
+                return true;
+            }
+            rec->block_align = 0;
+            return tag == 1;
+        }
+        if (fseek(file, size + (size & 1), SEEK_CUR) != 0) {
+            return false;
+        }
+    }
+    return false;
+}
+
+// Count the frames and record every LIBRARY_SCAN_MP3_INTERVAL-th frame offset
+static bool probe_mp3(FILE *file, scan_record_t *rec) {
+    long offset;
+    mp3_header_t header;
+    if (!mp3_find_first_frame(file, &offset, &header)) {
+        return false;
+    }
+    rec->codec = PCM_CODEC_MP3;
+    rec->sample_rate = header.sample_rate;
+    rec->bit_depth = 16;
+    rec->channels = header.channels;
+    rec->interval = LIBRARY_SCAN_MP3_INTERVAL;
+    for (;;) {
+        long entry = offset;
+        uint32_t skipped = mp3_skip_frames(file, &offset, LIBRARY_SCAN_MP3_INTERVAL);
+        if (skipped > 0 && rec->count < LIBRARY_SCAN_MAX_OFFSETS) {
+            rec->offsets[rec->count++] = (uint32_t)entry;
+        }
+        rec->frame_count += skipped;
+        if (skipped < LIBRARY_SCAN_MP3_INTERVAL) {
+            return true;
+        }
+    }
+}
+
+// Fill a record from the file's own header
+static bool probe_file(const char *path, scan_record_t *rec) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    uint8_t header[32];
+    size_t n = fread(header, 1, sizeof(header), file);
+    const char *ext = extension_of(rec->name);
+    bool ok = true;
+
+    rec->codec = PCM_CODEC_RAW;
+    rec->sample_rate = DEFAULT_SAMPLE_RATE;
+    rec->bit_depth = DEFAULT_BIT_DEPTH;
+    rec->channels = DEFAULT_CHANNELS;
+    rec->block_align = 0;
+    rec->frame_count = 0;
+    rec->interval = 0;
+    rec->count = 0;
+
+    if (n == sizeof(header) && memcmp(header, "ESP32PCM", 8) == 0) {
+        rec->sample_rate = read_le32(header + 8);
+        rec->bit_depth = read_le16(header + 12);
+        rec->channels = read_le16(header + 14);
+    } else if (n >= 12 && memcmp(header, "RIFF", 4) == 0 && memcmp(header + 8, "WAVE", 4) == 0) {
+        fseek(file, 12, SEEK_SET);
+        ok = probe_wav(file, rec);
+    } else if (n >= 22 && memcmp(header, "fLaC", 4) == 0) {
+        // STREAMINFO follows the first metadata block header
+        rec->codec = PCM_CODEC_FLAC;
+        rec->sample_rate = ((uint32_t)header[18] << 12) | ((uint32_t)header[19] << 4) | (header[20] >> 4);
+        rec->channels = ((header[20] >> 1) & 0x07) + 1;
+        rec->bit_depth = ((((header[20] & 0x01) << 4) | (header[21] >> 4)) + 1) <= 16 ? 16 : 24;
+    } else if (strcasecmp(ext, "mp3") == 0) {
+        ok = probe_mp3(file, rec);
+    } else if (strcasecmp(ext, "pcm") != 0) {
+        ok = false;
+    }
+    fclose(file);
+    return ok && rec->sample_rate > 0 && rec->channels > 0;
+}
+
+static void write_record(FILE *out, const scan_record_t *rec) {
+    fprintf(out, "F %d %u %u %u %u %u %u %u", (int)rec->codec, (unsigned)rec->sample_rate,
+            rec->bit_depth, rec->channels, rec->block_align,
+            (unsigned)rec->frame_count, rec->interval, rec->count);
+    for (int i = 0; i < rec->count; i++) {
+        fprintf(out, " %u", (unsigned)rec->offsets[i]);
+    }
+    fprintf(out, "\t%s\n", rec->name);
+}
+
+static bool read_record(const char *line, scan_record_t *rec) {
+    const char *tab = strchr(line, '\t');
+    if (strncmp(line, "F ", 2) != 0 || tab == NULL) {
+        return false;
+    }
+    char *p;
+    rec->codec = (pcm_codec_t)strtoul(line + 2, &p, 10);
+    rec->sample_rate = strtoul(p, &p, 10);
+    rec->bit_depth = strtoul(p, &p, 10);
+    rec->channels = strtoul(p, &p, 10);
+    rec->block_align = strtoul(p, &p, 10);
+    rec->frame_count = strtoul(p, &p, 10);
+    rec->interval = strtoul(p, &p, 10);
+    rec->count = strtoul(p, &p, 10);
+    if (rec->codec > PCM_CODEC_MP3 || rec->count > LIBRARY_SCAN_MAX_OFFSETS) {
+        return false;
+    }
+    for (int i = 0; i < rec->count; i++) {
+        rec->offsets[i] = strtoul(p, &p, 10);
+    }
+    size_t len = strcspn(tab + 1, "\n");
+    if (len >= sizeof(rec->name)) {
+        return false;
+    }
+    memcpy(rec->name, tab + 1, len);
+    rec->name[len] = '\0';
+    return true;
+}
+
+// Parse a "D <sig> <count> <dir>" line; dir points into line
+static bool read_dir_line(char *line, uint32_t *sig, int *count, char **dir) {
+    char *p;
+    if (strncmp(line, "D ", 2) != 0) {
+        return false;
+    }
+    *sig = strtoul(line + 2, &p, 16);
+    *count = strtol(p, &p, 10);
+    if (*p != ' ') {
+        return false;
+    }
+    *dir = p + 1;
+    (*dir)[strcspn(*dir, "\n")] = '\0';
+    return true;
+}
+
+// Index the directories of the previous manifest by path hash
+static void load_manifest(scan_ctx_t *ctx, const char *path) {
+    ctx->old = fopen(path, "r");
+    if (ctx->old == NULL) {
+        return;
+    }
+    int capacity = 0;
+    long offset = ftell(ctx->old);
+    if (fgets(ctx->line, MANIFEST_LINE_SIZE, ctx->old) == NULL || strcmp(ctx->line, MANIFEST_MAGIC) != 0) {
+        ESP_LOGW(TAG, "Ignoring unknown manifest %s", path);
+        fclose(ctx->old);
+        ctx->old = NULL;
+        return;
+    }
+    offset = ftell(ctx->old);
+    while (fgets(ctx->line, MANIFEST_LINE_SIZE, ctx->old) != NULL) {
+        uint32_t sig;
+        int count;
+        char *dir;
+        if (read_dir_line(ctx->line, &sig, &count, &dir)) {
+            if (ctx->old_dir_count == capacity) {
+                int grown = capacity ? capacity * 2 : 64;
+                manifest_dir_t *dirs = mem_realloc(MEM_BULK, ctx->old_dirs, grown * sizeof(manifest_dir_t));
+                if (dirs == NULL) {
+                    break;
+                }
+                ctx->old_dirs = dirs;
+                capacity = grown;
+            }
+            ctx->old_dirs[ctx->old_dir_count++] = (manifest_dir_t){hash_string(dir), sig, offset};
+        }
+        offset = ftell(ctx->old);
+    }
+}
+
+// Copy a directory's records from the previous manifest; false if it changed
+static bool reuse_dir(scan_ctx_t *ctx, const char *rel_dir, uint32_t sig) {
+    if (ctx->old == NULL) {
+        return false;
+    }
+    uint32_t hash = hash_string(rel_dir);
+    for (int i = 0; i < ctx->old_dir_count; i++) {
+        manifest_dir_t *d = &ctx->old_dirs[i];
+        uint32_t old_sig;
+        int count;
+        char *dir;
+        if (d->dir_hash != hash || d->sig != sig ||
+            fseek(ctx->old, d->offset, SEEK_SET) != 0 ||
+            fgets(ctx->line, MANIFEST_LINE_SIZE, ctx->old) == NULL ||
+            !read_dir_line(ctx->line, &old_sig, &count, &dir) || strcmp(dir, rel_dir) != 0) {
+            continue;
+        }
+        fprintf(ctx->out, "D %08x %d %s\n", (unsigned)sig, count, rel_dir);
+        for (int j = 0; j < count && fgets(ctx->line, MANIFEST_LINE_SIZE, ctx->old) != NULL; j++) {
+            fputs(ctx->line, ctx->out);
+        }
+        ctx->stats->files += count;
+        return true;
+    }
+    return false;
+}
+
+// qsort has no context argument; the walk is single-threaded per scan
+static const char *sort_names;
+
+// Set by library_scanner_cancel(), cleared when a scan starts
+static volatile bool scan_cancelled = false;
+
+static int compare_entries(const void *a, const void *b) {
+    const dir_entry_t *ea = a;
+    const dir_entry_t *eb = b;
+    return strcmp(sort_names + ea->name_offset, sort_names + eb->name_offset);
+}
+
+static esp_err_t walk_dir(scan_ctx_t *ctx, const char *rel_dir, int depth) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s%s%s", ctx->root, rel_dir[0] ? "/" : "", rel_dir);
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        ESP_LOGW(TAG, "Cannot open directory %s (errno: %d)", path, errno);
+        return ESP_FAIL;
+    }
+
+    // Collect and sort the entries so the index order does not depend on the card
+    dir_entry_t *entries = NULL;
+    char *names = NULL;
+    int count = 0;
+    int capacity = 0;
+    size_t names_len = 0;
+    size_t names_capacity = 0;
+    esp_err_t ret = ESP_OK;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (scan_cancelled) {
+            ret = ESP_ERR_INVALID_STATE;
+            break;
+        }
+        if (de->d_name[0] == '.') {
+            continue;
+        }
+        struct stat st;
+        snprintf(path, sizeof(path), "%s%s%s/%s", ctx->root, rel_dir[0] ? "/" : "", rel_dir, de->d_name);
+        if (stat(path, &st) != 0) {
+            continue;
+        }
+        bool is_dir = S_ISDIR(st.st_mode);
+        if (!is_dir && !is_audio_file(de->d_name)) {
+            continue;
+        }
+        size_t len = strlen(de->d_name) + 1;
+        if (count == capacity || names_len + len > names_capacity) {
+            int new_capacity = capacity ? capacity * 2 : 32;
+            size_t new_names = names_capacity ? names_capacity * 2 + len : 1024;
+            dir_entry_t *e = mem_realloc(MEM_BULK, entries, new_capacity * sizeof(dir_entry_t));
+            entries = e ? e : entries;
+            char *n = e ? mem_realloc(MEM_BULK, names, new_names) : NULL;
+            names = n ? n : names;
+            if (n == NULL) {
+                ret = ESP_ERR_NO_MEM;
+                break;
+            }
+            capacity = new_capacity;
+            names_capacity = new_names;
+        }
+        memcpy(names + names_len, de->d_name, len);
+        entries[count++] = (dir_entry_t){names_len, is_dir, (uint32_t)st.st_size, (uint32_t)st.st_mtime};
+        names_len += len;
+    }
+    closedir(dir);
+    if (ret != ESP_OK) {
+        mem_free(entries);
+        mem_free(names);
+        return ret;
+    }
+    sort_names = names;
+    if (count > 1) {
+        qsort(entries, count, sizeof(dir_entry_t), compare_entries);
+    }
+
+    // Any added, removed, resized or rewritten track changes the signature
+    uint32_t sig = 2166136261u;
+    int file_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (!entries[i].is_dir) {
+            const char *name = names + entries[i].name_offset;
+            sig = fnv1a(sig, name, strlen(name) + 1);
+            sig = fnv1a(sig, &entries[i].size, sizeof(entries[i].size));
+            sig = fnv1a(sig, &entries[i].mtime, sizeof(entries[i].mtime));
+            file_count++;
+        }
+    }
+
+    if (file_count > 0 && reuse_dir(ctx, rel_dir, sig)) {
+        ctx->stats->dirs_reused++;
+        ctx->stats->folders++;
+    } else if (file_count > 0) {
+        // Probe into a temporary list first; unreadable files are left out
+        long d_line = ftell(ctx->out);
+        int written = 0;
+        fprintf(ctx->out, "D %08x %6d %s\n", (unsigned)sig, 0, rel_dir);
+        for (int i = 0; i < count; i++) {
+            if (entries[i].is_dir) {
+                continue;
+            }
+            if (scan_cancelled) {
+                ret = ESP_ERR_INVALID_STATE;
+                break;
+            }
+            scan_record_t *rec = ctx->record;
+            strncpy(rec->name, names + entries[i].name_offset, sizeof(rec->name) - 1);
+            rec->name[sizeof(rec->name) - 1] = '\0';
+            snprintf(path, sizeof(path), "%s%s%s/%s", ctx->root, rel_dir[0] ? "/" : "", rel_dir, rec->name);
+            if (!probe_file(path, rec)) {
+                ESP_LOGW(TAG, "Skipping unreadable track %s", path);
+                ctx->stats->skipped++;
+                continue;
+            }
+            write_record(ctx->out, rec);
+            written++;
+        }
+        // Patch the record count into the fixed-width field of the D line
+        long end = ftell(ctx->out);
+        fseek(ctx->out, d_line, SEEK_SET);
+        fprintf(ctx->out, "D %08x %6d", (unsigned)sig, written);
+        fseek(ctx->out, end, SEEK_SET);
+        ctx->stats->dirs_scanned++;
+        ctx->stats->files += written;
+        ctx->stats->folders += written > 0 ? 1 : 0;
+    }
+
+    for (int i = 0; i < count && ret == ESP_OK; i++) {
+        if (!entries[i].is_dir) {
+            continue;
+        }
+        if (depth >= LIBRARY_SCAN_MAX_DEPTH) {
+            ESP_LOGW(TAG, "Not descending below %s", rel_dir);
+            break;
+        }
+        char sub_dir[256];
+        int len = snprintf(sub_dir, sizeof(sub_dir), "%s%s%s", rel_dir, rel_dir[0] ? "/" : "", names + entries[i].name_offset);
+        if (len >= (int)sizeof(sub_dir)) {
+            continue;
+        }
+        ret = walk_dir(ctx, sub_dir, depth + 1);
+        if (ret == ESP_FAIL) {
+            ret = ESP_OK;
+        }
+    }
+    mem_free(entries);
+    mem_free(names);
+    return ret;
+}
+
+static void write_string(FILE *out, const char *key, const char *value) {
+    fprintf(out, "\"%s\": \"%s\"", key, value);
+}
+
+// Write one track object; folder entries carry no seek table
+static void write_entry(FILE *out, const char *rel_dir, const scan_record_t *rec, int folder_index, const char *indent) {
+    const char *folder = strrchr(rel_dir, '/');
+    folder = folder ? folder + 1 : rel_dir;
+    char song[256];
+    strncpy(song, rec->name, sizeof(song) - 1);
+    song[sizeof(song) - 1] = '\0';
+    char *dot = strrchr(song, '.');
+    if (dot != NULL) {
+        *dot = '\0';
+    }
+
+    fprintf(out, "%s{\n%s  ", indent, indent);
+    write_string(out, "name", rec->name);
+    fprintf(out, ",\n%s  \"path\": \"%s%s%s\"", indent, rel_dir, rel_dir[0] ? "/" : "", rec->name);
+    fprintf(out, ",\n%s  \"sampleRate\": %u, \"bitDepth\": %u, \"channels\": %u",
+            indent, (unsigned)rec->sample_rate, rec->bit_depth, rec->channels);
+    fprintf(out, ",\n%s  ", indent);
+    write_string(out, "format", FORMAT_NAMES[rec->codec]);
+    if (rec->codec == PCM_CODEC_IMA_ADPCM) {
+        fprintf(out, ", \"blockAlign\": %u", rec->block_align);
+    }
+    if (rec->codec == PCM_CODEC_MP3 && folder_index >= 0) {
+        fprintf(out, ",\n%s  \"frameCount\": %u, \"frameInterval\": %u,\n%s  \"frameOffsets\": [",
+                indent, (unsigned)rec->frame_count, rec->interval, indent);
+        for (int i = 0; i < rec->count; i++) {
+            fprintf(out, "%s%u", i ? ", " : "", (unsigned)rec->offsets[i]);
+        }
+        fprintf(out, "]");
+    }
+    if (folder_index >= 0) {
+        fprintf(out, ",\n%s  \"folderIndex\": %d", indent, folder_index);
+    }
+    fprintf(out, ",\n%s  ", indent);
+    write_string(out, "song", song);
+    if (folder[0] != '\0') {
+        fprintf(out, ",\n%s  ", indent);
+        write_string(out, "album", folder);
+    }
+    fprintf(out, "\n%s}", indent);
+}
+
+// Write index.json from the manifest: allFiles first, then musicFolders
+static esp_err_t write_index(scan_ctx_t *ctx, FILE *manifest, FILE *out) {
+    fprintf(out, "{\n  \"version\": \"1.1\",\n  \"totalFiles\": %d,\n  \"allFiles\": [\n", ctx->stats->files);
+    for (int pass = 0; pass < 2; pass++) {
+        fseek(manifest, strlen(MANIFEST_MAGIC), SEEK_SET);
+        char rel_dir[256] = "";
+        int folder = -1;
+        int in_folder = 0;
+        int written = 0;
+        while (fgets(ctx->line, MANIFEST_LINE_SIZE, manifest) != NULL) {
+            uint32_t sig;
+            int count;
+            char *dir;
+            if (read_dir_line(ctx->line, &sig, &count, &dir)) {
+                if (count == 0) {
+                    continue;
+                }
+                strncpy(rel_dir, dir, sizeof(rel_dir) - 1);
+                rel_dir[sizeof(rel_dir) - 1] = '\0';
+                if (pass == 1) {
+                    const char *name = strrchr(rel_dir, '/');
+                    if (name == NULL) {
+                        // Tracks at the top level form a folder named after the music directory
+                        name = rel_dir[0] ? rel_dir : (strrchr(ctx->root, '/') ? strrchr(ctx->root, '/') + 1 : ctx->root);
+                    } else {
+                        name++;
+                    }
+                    fprintf(out, "%s    {\n      \"name\": \"%s\",\n      \"path\": \"%s\",\n      \"files\": [\n",
+                            folder >= 0 ? "\n      ]\n    },\n" : "", name, rel_dir);
+                }
+                folder++;
+                in_folder = 0;
+            } else if (read_record(ctx->line, ctx->record)) {
+                if (pass == 0) {
+                    fprintf(out, "%s", written ? ",\n" : "");
+                    write_entry(out, rel_dir, ctx->record, folder, "    ");
+                } else {
+                    fprintf(out, "%s", in_folder ? ",\n" : "");
+                    write_entry(out, rel_dir, ctx->record, -1, "        ");
+                }
+                in_folder++;
+                written++;
+            }
+        }
+        if (pass == 0) {
+            fprintf(out, "\n  ],\n  \"musicFolders\": [\n");
+        } else {
+            fprintf(out, "%s  ]\n}\n", folder >= 0 ? "\n      ]\n    }\n" : "");
+        }
+    }
+    return ferror(out) ? ESP_FAIL : ESP_OK;
+}
+
+// Replace a file with its freshly written temporary copy
+static esp_err_t replace_file(const char *tmp_path, const char *path) {
+    remove(path);
+    if (rename(tmp_path, path) != 0) {
+        ESP_LOGE(TAG, "Failed to rename %s (errno: %d)", tmp_path, errno);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t library_scanner_run(const char *music_dir, library_scan_stats_t *stats) {
+    if (music_dir == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    scan_cancelled = false;
+    library_scan_stats_t local;
+    scan_ctx_t ctx = {.root = music_dir, .stats = stats ? stats : &local};
+    memset(ctx.stats, 0, sizeof(*ctx.stats));
+    int64_t start = esp_timer_get_time();
+
+    char manifest_path[256];
+    char manifest_tmp[sizeof(manifest_path) + 4];
+    char index_path[256];
+    char index_tmp[sizeof(index_path) + 4];
+    snprintf(manifest_path, sizeof(manifest_path), "%s/%s", music_dir, LIBRARY_SCAN_MANIFEST);
+    snprintf(manifest_tmp, sizeof(manifest_tmp), "%s.tmp", manifest_path);
+    snprintf(index_path, sizeof(index_path), "%s/index.json", music_dir);
+    snprintf(index_tmp, sizeof(index_tmp), "%s.tmp", index_path);
+
+    ctx.line = mem_alloc(MEM_BULK, MANIFEST_LINE_SIZE);
+    ctx.record = mem_alloc(MEM_BULK, sizeof(scan_record_t));
+    if (ctx.line == NULL || ctx.record == NULL) {
+        mem_free(ctx.line);
+        mem_free(ctx.record);
+        return ESP_ERR_NO_MEM;
+    }
+    load_manifest(&ctx, manifest_path);
+
+    esp_err_t ret = ESP_FAIL;
+    ctx.out = fopen(manifest_tmp, "w+");
+    if (ctx.out != NULL) {
+        fputs(MANIFEST_MAGIC, ctx.out);
+        ret = walk_dir(&ctx, "", 0);
+    } else {
+        ESP_LOGE(TAG, "Cannot create %s (errno: %d)", manifest_tmp, errno);
+    }
+    if (ctx.old != NULL) {
+        fclose(ctx.old);
+    }
+    mem_free(ctx.old_dirs);
+
+    if (ret == ESP_OK) {
+        FILE *index = fopen(index_tmp, "w");
+        ret = index != NULL ? write_index(&ctx, ctx.out, index) : ESP_FAIL;
+        if (index != NULL && fclose(index) != 0) {
+            ret = ESP_FAIL;
+        }
+    }
+    if (ctx.out != NULL && fclose(ctx.out) != 0) {
+        ret = ESP_FAIL;
+    }
+    if (ret == ESP_OK) {
+        ret = replace_file(index_tmp, index_path);
+    }
+    if (ret == ESP_OK) {
+        ret = replace_file(manifest_tmp, manifest_path);
+    } else {
+        remove(index_tmp);
+        remove(manifest_tmp);
+    }
+    mem_free(ctx.line);
+    mem_free(ctx.record);
+
+    ctx.stats->elapsed_us = esp_timer_get_time() - start;
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Indexed %d tracks in %d folders in %lld ms (%d directories scanned, %d unchanged, %d skipped)",
+                 ctx.stats->files, ctx.stats->folders, (long long)(ctx.stats->elapsed_us / 1000),
+                 ctx.stats->dirs_scanned, ctx.stats->dirs_reused, ctx.stats->skipped);
+    } else if (ret == ESP_ERR_INVALID_STATE) {
+        ESP_LOGW(TAG, "Library scan of %s cancelled", music_dir);
+    } else {
+        ESP_LOGE(TAG, "Library scan of %s failed", music_dir);
+    }
+    return ret;
+}
+
+void library_scanner_cancel(void) {
+    scan_cancelled = true;
+}
+
+#ifndef TEST_MODE
+// Below the player task, so the scan only runs while audio is waiting on I2S
+#define SCANNER_TASK_PRIORITY   (tskIDLE_PRIORITY + 1)
+#define SCANNER_TASK_STACK      8192
+
+static TaskHandle_t scanner_task_handle = NULL;
+static library_scan_done_cb_t scan_done;
+static void *scan_done_arg;
+
+static void scanner_task(void *arg) {
+    char music_dir[256];
+    snprintf(music_dir, sizeof(music_dir), "%s/ESP32_MUSIC", sd_card_get_mount_point());
+    library_scan_stats_t stats;
+    esp_err_t ret = library_scanner_run(music_dir, &stats);
+    if (scan_done != NULL) {
+        scan_done(ret, &stats, scan_done_arg);
+    }
+    scanner_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+esp_err_t library_scanner_start(library_scan_done_cb_t done, void *arg) {
+    if (scanner_task_handle != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    scan_done = done;
+    scan_done_arg = arg;
+    if (xTaskCreate(scanner_task, "lib_scan", SCANNER_TASK_STACK, NULL, SCANNER_TASK_PRIORITY,
+                    &scanner_task_handle) != pdPASS) {
+        scanner_task_handle = NULL;
+        ESP_LOGE(TAG, "Failed to create scanner task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool library_scanner_busy(void) {
+    return scanner_task_handle != NULL;
+}
+#endif
@@ -0,0 +1,83 @@
+#ifndef LIBRARY_SCANNER_H
+#define LIBRARY_SCANNER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef TEST_MODE
+#include "esp_err.h"
+#else
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG -2
+#define ESP_ERR_NO_MEM -3
+#define ESP_ERR_INVALID_STATE -4
+#endif
+
+// Scan results of the previous run, kept next to index.json. Directories
+// whose audio files have the same names, sizes and dates are not probed again.
+#define LIBRARY_SCAN_MANIFEST       ".scan_manifest"
+
+// Frames between entries of the MP3 seek tables the scanner writes
+#define LIBRARY_SCAN_MP3_INTERVAL   250
+#define LIBRARY_SCAN_MAX_OFFSETS    512
+
+// Directory levels below the music directory that are walked
+#define LIBRARY_SCAN_MAX_DEPTH      8
+
+typedef struct {
+    int dirs_scanned;       // Directories whose files were probed
+    int dirs_reused;        // Directories taken unchanged from the manifest
+    int files;              // Tracks in the new index
+    int folders;            // Directories holding at least one track
+    int skipped;            // Audio files that could not be read
+    int64_t elapsed_us;
+} library_scan_stats_t;
+
+/**
+ * @brief Called from the scanner task when a background scan ends
+ *
+ * @param result ESP_OK if a new index.json was written
+ * @param stats Scan figures
+ * @param arg Argument given to library_scanner_start()
+ */
+typedef void (*library_scan_done_cb_t)(esp_err_t result, const library_scan_stats_t *stats, void *arg);
+
+/**
+ * @brief Walk a music directory and write its index.json and manifest
+ *
+ * Files are probed for their format: ESP32PCM and WAV headers, FLAC
+ * STREAMINFO, and the MP3 frame headers, which also give the seek table.
+ * Tracks of a directory become one folder, in name order.
+ *
+ * @param music_dir Directory to index, e.g. /sdcard/ESP32_MUSIC
+ * @param stats Pointer to store the scan figures, or NULL
+ * @return ESP_OK on success, ESP_FAIL if the directory or the outputs cannot be accessed,
+ *         ESP_ERR_INVALID_STATE if library_scanner_cancel() stopped it
+ */
+esp_err_t library_scanner_run(const char *music_dir, library_scan_stats_t *stats);
+
+/**
+ * @brief Stop the running scan at the next file, leaving index.json as it was
+ *
+ * The scan closes its files before it returns; library_scanner_busy()
+ * tells when a background scan has ended.
+ */
+void library_scanner_cancel(void);
+
+/**
+ * @brief Scan /ESP32_MUSIC on the card in a low-priority task
+ *
+ * @param done Called when the scan ends, or NULL
+ * @param arg Argument passed to done
+ * @return ESP_OK if the scan started, ESP_ERR_INVALID_STATE if one is running
+ */
+esp_err_t library_scanner_start(library_scan_done_cb_t done, void *arg);
+
+/**
+ * @brief Check whether a background scan is running
+ */
+bool library_scanner_busy(void);
+
+#endif // LIBRARY_SCANNER_H
@@ -11,11 +11,20 @@
 #include "audio_player.h"
 #include "button_handler.h"
 #include "neopixel.h"
+#include "boot_profile.h"
+#include "sd_fault.h"
+#include "player_console.h"
 #include "esp_wifi.h"
 
 
 static const char *TAG = "main";
 
+// Define to log seek latency on a long track at boot, e.g. "/sdcard/ESP32_MUSIC/long.pcm"
+// #define SD_SEEK_BENCH_FILE "/sdcard/ESP32_MUSIC/long.pcm"
+
+// Define to inject card latency, stalls, short reads and errors (see sd_fault.h)
+// #define SD_FAULT_PROFILE "stall_ms=100-300,stall_every_kb=1024"
+
 // Button polling task
 static void button_task(void *arg)
 {
@@ -44,7 +53,7 @@ static void button_task(void *arg)
             player_state_t state_restart = audio_player_get_state();
             if (strlen(state_restart.current_file_path) > 0)
             {
-                audio_player_seek(0); // Seek to start of file
+                audio_player_seek_ms(0); // Seek to start of file
             }
             break;
 
@@ -89,6 +98,7 @@ void app_main(void)
     }
 
     // Initialize NVS flash
+    int phase = boot_profile_begin("nvs_flash_init");
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
     {
@@ -96,31 +106,38 @@ void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    boot_profile_end(phase);
 
     // Initialize SD card
+    phase = boot_profile_begin("sd_card_init");
     ret = sd_card_init();
+    boot_profile_end(phase);
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to initialize SD card");
         return;
     }
 
-    // Initialize NeoPixel
-    ret = neopixel_init();
-    if (ret != ESP_OK)
+#ifdef SD_SEEK_BENCH_FILE
+    sd_card_benchmark_seek(SD_SEEK_BENCH_FILE);
+#endif
+
+#ifdef SD_FAULT_PROFILE
+    sd_fault_config_t fault_config;
+    if (sd_fault_parse(SD_FAULT_PROFILE, &fault_config) == ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to initialize NeoPixel");
+        sd_fault_configure(&fault_config);
     }
-
-    // Initialize button handler
-    ret = button_handler_init();
-    if (ret != ESP_OK)
+    else
     {
-        ESP_LOGE(TAG, "Failed to initialize button handler");
+        ESP_LOGE(TAG, "Bad SD_FAULT_PROFILE");
     }
+#endif
 
-    // Initialize audio player
+    // Start the saved track before anything else; the index loads alongside
+    phase = boot_profile_begin("audio_player_init");
     ret = audio_player_init();
+    boot_profile_end(phase);
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to initialize audio player");
@@ -129,14 +146,43 @@ void app_main(void)
     {
         // Start playback
         audio_player_start();
+    }
 
+    // Initialize NeoPixel
+    phase = boot_profile_begin("neopixel_init");
+    esp_err_t np_ret = neopixel_init();
+    boot_profile_end(phase);
+    if (np_ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to initialize NeoPixel");
+    }
+    else if (ret == ESP_OK)
+    {
         // Indicate current mode
         player_state_t state = audio_player_get_state();
         neopixel_indicate_mode(state.mode);
     }
 
+    // Initialize button handler
+    phase = boot_profile_begin("button_handler_init");
+    err = button_handler_init();
+    boot_profile_end(phase);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to initialize button handler");
+    }
+
     // Create button polling task with larger stack size to prevent overflow
     xTaskCreate(button_task, "button_task", 4096, NULL, 5, NULL);
+    boot_profile_task("button_task");
 
     ESP_LOGI(TAG, "Initialization complete");
+    boot_profile_report();
+
+    // Console last, so its prompt follows the boot log
+    err = player_console_init();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to start the serial console");
+    }
 }
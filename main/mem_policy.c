@@ -0,0 +1,197 @@
+#include "mem_policy.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef TEST_MODE
+#include "esp_heap_caps.h"
+
+// Internal byte-addressable RAM; DMA capable on the ESP32
+#define CAPS_INTERNAL   (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#define CAPS_PSRAM      (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+
+void *mem_alloc(mem_class_t cls, size_t size) {
+    void *ptr = NULL;
+    if (cls == MEM_BULK) {
+        ptr = heap_caps_malloc(size, CAPS_PSRAM);
+    }
+    if (ptr == NULL) {
+        ptr = heap_caps_malloc(size, CAPS_INTERNAL);
+    }
+    return ptr;
+}
+
+void *mem_calloc(mem_class_t cls, size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *ptr = mem_alloc(cls, count * size);
+    if (ptr != NULL) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void *mem_realloc(mem_class_t cls, void *ptr, size_t size) {
+    void *resized = NULL;
+    if (cls == MEM_BULK) {
+        resized = heap_caps_realloc(ptr, size, CAPS_PSRAM);
+    }
+    if (resized == NULL) {
+        resized = heap_caps_realloc(ptr, size, CAPS_INTERNAL);
+    }
+    return resized;
+}
+
+void mem_free(void *ptr) {
+    heap_caps_free(ptr);
+}
+
+bool mem_has_psram(void) {
+    return heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+}
+
+void mem_get_capacity(mem_class_t cls, mem_capacity_t *capacity) {
+    uint32_t caps = (cls == MEM_BULK && mem_has_psram()) ? CAPS_PSRAM : CAPS_INTERNAL;
+    capacity->psram = caps == CAPS_PSRAM;
+    capacity->free_bytes = heap_caps_get_free_size(caps);
+    capacity->largest_block = heap_caps_get_largest_free_block(caps);
+}
+
+#else
+// Host builds have a single heap and no PSRAM
+static size_t realloc_limit;
+
+void mem_test_limit_realloc(size_t max_size) {
+    realloc_limit = max_size;
+}
+
+void *mem_alloc(mem_class_t cls, size_t size) {
+    (void)cls;
+    return malloc(size);
+}
+
+void *mem_calloc(mem_class_t cls, size_t count, size_t size) {
+    (void)cls;
+    return calloc(count, size);
+}
+
+void *mem_realloc(mem_class_t cls, void *ptr, size_t size) {
+    (void)cls;
+    if (realloc_limit > 0 && size > realloc_limit) {
+        return NULL;
+    }
+    return realloc(ptr, size);
+}
+
+void mem_free(void *ptr) {
+    free(ptr);
+}
+
+bool mem_has_psram(void) {
+    return false;
+}
+
+// No figures for the host heap, except the limit a test has set
+void mem_get_capacity(mem_class_t cls, mem_capacity_t *capacity) {
+    (void)cls;
+    capacity->psram = false;
+    capacity->free_bytes = realloc_limit;
+    capacity->largest_block = realloc_limit;
+}
+#endif
+
+// Arena ---------------------------------------------------------------------
+
+struct mem_arena_chunk {
+    mem_arena_chunk_t *prev;    // Older chunk
+    size_t size;                // Usable bytes after the header
+    size_t used;
+};
+
+#define CHUNK_HEADER        MEM_ARENA_SPAN(sizeof(mem_arena_chunk_t))
+
+static uint8_t *chunk_data(mem_arena_chunk_t *chunk) {
+    return (uint8_t *)chunk + CHUNK_HEADER;
+}
+
+static bool add_chunk(mem_arena_t *arena, size_t size) {
+    if (size > SIZE_MAX - CHUNK_HEADER - MEM_ARENA_ALIGN) {
+        return false;
+    }
+    size = MEM_ARENA_SPAN(size);
+    mem_arena_chunk_t *chunk = mem_alloc(arena->cls, CHUNK_HEADER + size);
+    if (chunk == NULL) {
+        return false;
+    }
+    chunk->prev = arena->head;
+    chunk->size = size;
+    chunk->used = 0;
+    arena->head = chunk;
+    arena->capacity += size;
+    arena->chunks++;
+    return true;
+}
+
+void mem_arena_init(mem_arena_t *arena, mem_class_t cls, size_t chunk_size) {
+    memset(arena, 0, sizeof(*arena));
+    arena->cls = cls;
+    arena->chunk_size = chunk_size;
+}
+
+// Whether the next size bytes fit the newest chunk
+static bool fits(const mem_arena_t *arena, size_t size) {
+    return arena->head != NULL && arena->head->size - arena->head->used >= size;
+}
+
+bool mem_arena_reserve(mem_arena_t *arena, size_t size) {
+    return fits(arena, size) || add_chunk(arena, size);
+}
+
+void *mem_arena_alloc(mem_arena_t *arena, size_t size) {
+    if (size == 0 || size > SIZE_MAX - MEM_ARENA_ALIGN) {
+        return NULL;
+    }
+    size = MEM_ARENA_SPAN(size);
+    if (!fits(arena, size) && !add_chunk(arena, size > arena->chunk_size ? size : arena->chunk_size)) {
+        return NULL;
+    }
+    mem_arena_chunk_t *chunk = arena->head;
+    void *ptr = chunk_data(chunk) + chunk->used;
+    chunk->used += size;
+    arena->used += size;
+    return ptr;
+}
+
+void *mem_arena_calloc(mem_arena_t *arena, size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *ptr = mem_arena_alloc(arena, count * size);
+    if (ptr != NULL) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void mem_arena_reset(mem_arena_t *arena) {
+    if (arena->chunks > 1) {
+        size_t capacity = arena->capacity;
+        mem_arena_release(arena);
+        add_chunk(arena, capacity);
+    } else if (arena->head != NULL) {
+        arena->head->used = 0;
+    }
+    arena->used = 0;
+}
+
+void mem_arena_release(mem_arena_t *arena) {
+    while (arena->head != NULL) {
+        mem_arena_chunk_t *prev = arena->head->prev;
+        mem_free(arena->head);
+        arena->head = prev;
+    }
+    arena->used = 0;
+    arena->capacity = 0;
+    arena->chunks = 0;
+}
@@ -0,0 +1,158 @@
+#ifndef MEM_POLICY_H
+#define MEM_POLICY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Where large allocations go. PSRAM is optional: the same binary runs on
+// modules without it, and bulk allocations then fall back to internal RAM.
+typedef enum {
+    MEM_HOT,    // DMA buffers and state touched for every audio buffer: always internal RAM
+    MEM_BULK,   // Index tables, metadata, caches and read-ahead rings: PSRAM when present
+} mem_class_t;
+
+// Memory a bulk class can offer at the moment
+typedef struct {
+    bool psram;                 // Bulk allocations land in PSRAM
+    size_t free_bytes;
+    size_t largest_block;
+} mem_capacity_t;
+
+/**
+ * @brief Allocate memory for a placement class
+ *
+ * Bulk allocations fall back to internal RAM when PSRAM is missing or full.
+ *
+ * @param cls Placement class
+ * @param size Bytes to allocate
+ * @return Pointer to the memory, NULL if none is available; release with mem_free()
+ */
+void *mem_alloc(mem_class_t cls, size_t size);
+
+/**
+ * @brief Allocate zeroed memory for a placement class
+ *
+ * @param cls Placement class
+ * @param count Number of elements
+ * @param size Size of an element
+ * @return Pointer to the memory, NULL if none is available; release with mem_free()
+ */
+void *mem_calloc(mem_class_t cls, size_t count, size_t size);
+
+/**
+ * @brief Resize memory from mem_alloc(), keeping its placement class
+ *
+ * @param cls Placement class the memory was allocated with
+ * @param ptr Memory to resize, or NULL to allocate
+ * @param size New size in bytes
+ * @return Pointer to the resized memory, NULL if none is available (ptr stays valid)
+ */
+void *mem_realloc(mem_class_t cls, void *ptr, size_t size);
+
+/**
+ * @brief Release memory from mem_alloc() or mem_calloc(); NULL is ignored
+ */
+void mem_free(void *ptr);
+
+/**
+ * @brief Check whether PSRAM was found at boot
+ */
+bool mem_has_psram(void);
+
+/**
+ * @brief Get the memory currently available to a placement class
+ *
+ * Host builds report 0 for both figures, as unknown.
+ *
+ * @param cls Placement class
+ * @param capacity Pointer to store the figures
+ */
+void mem_get_capacity(mem_class_t cls, mem_capacity_t *capacity);
+
+#ifdef TEST_MODE
+/**
+ * @brief Make host reallocations above a size fail
+ *
+ * Stands in for a fragmented heap when testing how growing tables cope;
+ * mem_get_capacity() reports the limit as free and as the largest block.
+ *
+ * @param max_size Largest size that still succeeds, 0 for no limit
+ */
+void mem_test_limit_realloc(size_t max_size);
+#endif
+
+// Bump allocator over chunks of one placement class. Allocations are never
+// freed one by one; the arena is reset or released as a whole.
+#define MEM_ARENA_ALIGN         8
+// Arena bytes taken by an allocation of size bytes
+#define MEM_ARENA_SPAN(size)    (((size) + MEM_ARENA_ALIGN - 1) & ~(size_t)(MEM_ARENA_ALIGN - 1))
+
+typedef struct mem_arena_chunk mem_arena_chunk_t;
+
+typedef struct {
+    mem_class_t cls;
+    size_t chunk_size;          // Smallest chunk added when the arena runs out
+    mem_arena_chunk_t *head;    // Newest chunk; allocations come from it
+    size_t used;                // Bytes handed out, alignment included
+    size_t capacity;            // Bytes in all chunks
+    int chunks;
+} mem_arena_t;
+
+/**
+ * @brief Set up an empty arena; no memory is taken until the first allocation
+ *
+ * @param arena Arena
+ * @param cls Placement class of the chunks
+ * @param chunk_size Smallest chunk to add when the arena runs out
+ */
+void mem_arena_init(mem_arena_t *arena, mem_class_t cls, size_t chunk_size);
+
+/**
+ * @brief Make sure the next size bytes fit without another chunk
+ *
+ * A chunk of exactly the missing size is added, whatever the chunk size;
+ * sizing an arena up front keeps a whole structure in one heap block.
+ *
+ * @param arena Arena
+ * @param size Bytes to have free in the newest chunk
+ * @return true if they fit, false if no chunk could be added
+ */
+bool mem_arena_reserve(mem_arena_t *arena, size_t size);
+
+/**
+ * @brief Allocate from an arena, 8-byte aligned
+ *
+ * @param arena Arena
+ * @param size Bytes to allocate
+ * @return Pointer to the memory, NULL if size is 0 or no chunk could be added
+ */
+void *mem_arena_alloc(mem_arena_t *arena, size_t size);
+
+/**
+ * @brief Allocate zeroed memory from an arena
+ *
+ * @param arena Arena
+ * @param count Number of elements
+ * @param size Size of an element
+ * @return Pointer to the memory, NULL if none is available
+ */
+void *mem_arena_calloc(mem_arena_t *arena, size_t count, size_t size);
+
+/**
+ * @brief Drop every allocation but keep the memory for reuse
+ *
+ * Several chunks are merged into one of their total size, so an arena
+ * reset per work item soon serves every item from a single block.
+ *
+ * @param arena Arena
+ */
+void mem_arena_reset(mem_arena_t *arena);
+
+/**
+ * @brief Free every chunk; the arena is empty and can be used again
+ *
+ * @param arena Arena
+ */
+void mem_arena_release(mem_arena_t *arena);
+
+#endif // MEM_POLICY_H
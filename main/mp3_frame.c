@@ -0,0 +1,110 @@
+#include "mp3_frame.h"
+#include <string.h>
+
+// Layer III bitrates in kbps for MPEG-1 and MPEG-2/2.5
+static const uint16_t bitrates[2][15] = {
+    {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+    {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+};
+
+static const uint32_t sample_rates[3] = {44100, 48000, 32000};
+
+bool mp3_parse_header(const uint8_t *hdr, mp3_header_t *header) {
+    if (hdr[0] != 0xFF || (hdr[1] & 0xE0) != 0xE0) {
+        return false;
+    }
+    uint32_t version = (hdr[1] >> 3) & 0x03;    // 3: MPEG-1, 2: MPEG-2, 0: MPEG-2.5
+    uint32_t layer = (hdr[1] >> 1) & 0x03;      // 1: Layer III
+    uint32_t bitrate_index = hdr[2] >> 4;
+    uint32_t rate_index = (hdr[2] >> 2) & 0x03;
+    uint32_t padding = (hdr[2] >> 1) & 0x01;
+    if (version == 1 || layer != 1 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3) {
+        return false;
+    }
+
+    bool mpeg1 = version == 3;
+    header->bitrate_kbps = bitrates[mpeg1 ? 0 : 1][bitrate_index];
+    header->sample_rate = sample_rates[rate_index] >> (mpeg1 ? 0 : (version == 2 ? 1 : 2));
+    header->samples = mpeg1 ? 1152 : 576;
+    header->channels = (hdr[3] >> 6) == 3 ? 1 : 2;
+    header->frame_bytes = (mpeg1 ? 144000 : 72000) * header->bitrate_kbps / header->sample_rate + padding;
+    return true;
+}
+
+static bool read_header_at(FILE *file, long offset, mp3_header_t *header) {
+    uint8_t hdr[4];
+    if (fseek(file, offset, SEEK_SET) != 0 || fread(hdr, 1, sizeof(hdr), file) != sizeof(hdr)) {
+        return false;
+    }
+    return mp3_parse_header(hdr, header);
+}
+
+bool mp3_find_first_frame(FILE *file, long *offset, mp3_header_t *header) {
+    uint8_t buf[512];
+    long start = 0;
+
+    // ID3v2: "ID3", version, flags, 28-bit syncsafe size, optional 10-byte footer
+    if (fseek(file, 0, SEEK_SET) == 0 && fread(buf, 1, 10, file) == 10 && memcmp(buf, "ID3", 3) == 0) {
+        start = 10 + (((long)(buf[6] & 0x7F) << 21) | ((buf[7] & 0x7F) << 14) | ((buf[8] & 0x7F) << 7) | (buf[9] & 0x7F));
+        if (buf[5] & 0x10) {
+            start += 10;
+        }
+    }
+
+    // Scan a bounded window for a header followed by another valid header
+    for (long base = start; base < start + 64 * 1024; base += sizeof(buf) - 3) {
+        if (fseek(file, base, SEEK_SET) != 0) {
+            return false;
+        }
+        size_t n = fread(buf, 1, sizeof(buf), file);
+        if (n < 4) {
+            return false;
+        }
+        for (size_t i = 0; i + 4 <= n; i++) {
+            mp3_header_t first, next;
+            if (mp3_parse_header(buf + i, &first) &&
+                read_header_at(file, base + (long)i + first.frame_bytes, &next) &&
+                next.sample_rate == first.sample_rate) {
+                *offset = base + (long)i;
+                *header = first;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+uint32_t mp3_skip_frames(FILE *file, long *offset, uint32_t count) {
+    uint32_t skipped = 0;
+    mp3_header_t header;
+    while (skipped < count && read_header_at(file, *offset, &header)) {
+        *offset += header.frame_bytes;
+        skipped++;
+    }
+    return skipped;
+}
+
+void mp3_plan_seek(const mp3_frame_index_t *index, long first_frame_offset,
+                   uint32_t samples_per_frame, uint64_t sample, mp3_seek_plan_t *plan) {
+    uint32_t target_frame = (uint32_t)(sample / samples_per_frame);
+    if (index != NULL && index->frame_count > 0 && target_frame >= index->frame_count) {
+        target_frame = index->frame_count - 1;
+        sample = (uint64_t)target_frame * samples_per_frame;
+    }
+    uint32_t start_frame = target_frame > MP3_SEEK_PREROLL_FRAMES ? target_frame - MP3_SEEK_PREROLL_FRAMES : 0;
+
+    plan->preroll_frames = target_frame - start_frame;
+    plan->discard_samples = (uint32_t)(sample - (uint64_t)target_frame * samples_per_frame);
+
+    if (index != NULL && index->count > 0 && index->interval > 0) {
+        uint32_t entry = start_frame / index->interval;
+        if (entry >= index->count) {
+            entry = index->count - 1;
+        }
+        plan->offset = index->offsets[entry];
+        plan->skip_frames = start_frame - entry * index->interval;
+    } else {
+        plan->offset = first_frame_offset;
+        plan->skip_frames = start_frame;
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef MP3_FRAME_H
+#define MP3_FRAME_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// MPEG audio Layer III frame parsing and seek planning. The decoding itself
+// lives in mp3_source; this part has no ESP-IDF dependencies.
+
+// A decoded frame may depend on up to this many earlier frames through the bit reservoir
+#define MP3_SEEK_PREROLL_FRAMES  2
+
+typedef struct {
+    uint32_t frame_bytes;       // Frame length including the header
+    uint32_t samples;           // Samples per channel (1152 or 576)
+    uint32_t sample_rate;
+    uint16_t bitrate_kbps;
+    uint16_t channels;
+} mp3_header_t;
+
+// Sparse table of frame offsets, as stored in index.json
+typedef struct {
+    uint32_t frame_count;       // Total frames in the file, 0 if unknown
+    uint16_t interval;          // Frames between table entries
+    uint16_t count;             // Number of entries
+    uint32_t *offsets;          // File offset of frame i * interval
+} mp3_frame_index_t;
+
+// Where to start decoding to land exactly on a sample
+typedef struct {
+    long offset;                // File offset to seek to (a frame start)
+    uint32_t skip_frames;       // Frames to step over by header only
+    uint32_t preroll_frames;    // Frames to decode and drop to refill the bit reservoir
+    uint32_t discard_samples;   // Samples per channel to drop from the target frame
+} mp3_seek_plan_t;
+
+/**
+ * @brief Parse a 4-byte Layer III frame header
+ *
+ * Free-format and reserved values are rejected.
+ *
+ * @param hdr Header bytes
+ * @param header Pointer to store the parsed header
+ * @return true if the bytes form a valid Layer III header
+ */
+bool mp3_parse_header(const uint8_t *hdr, mp3_header_t *header);
+
+/**
+ * @brief Find the first audio frame, skipping an ID3v2 tag
+ *
+ * A frame only counts when the next frame also has a valid header.
+ *
+ * @param file Open file
+ * @param offset Pointer to store the offset of the first frame
+ * @param header Pointer to store its header
+ * @return true if a frame was found
+ */
+bool mp3_find_first_frame(FILE *file, long *offset, mp3_header_t *header);
+
+/**
+ * @brief Step over frames by reading only their headers
+ *
+ * @param file Open file
+ * @param offset Frame start, advanced past the skipped frames
+ * @param count Number of frames to skip
+ * @return Number of frames actually skipped (less at end of file)
+ */
+uint32_t mp3_skip_frames(FILE *file, long *offset, uint32_t count);
+
+/**
+ * @brief Plan a seek to a sample
+ *
+ * @param index Frame index from the index file, or NULL to walk from the first frame
+ * @param first_frame_offset Offset of the first audio frame
+ * @param samples_per_frame Samples per channel in a frame
+ * @param sample Target sample per channel
+ * @param plan Pointer to store the plan
+ */
+void mp3_plan_seek(const mp3_frame_index_t *index, long first_frame_offset,
+                   uint32_t samples_per_frame, uint64_t sample, mp3_seek_plan_t *plan);
+
+#endif // MP3_FRAME_H
@@ -0,0 +1,410 @@
+#include "mp3_source.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mp3dec.h"
+#include "mem_policy.h"
+#include "sd_fault.h"
+
+static const char *TAG = "mp3_source";
+
+#define MP3_INPUT_BUFFER_SIZE   (MAINBUF_SIZE * 2)
+#define MP3_MAX_FRAME_SAMPLES   (1152 * 2)
+#define MP3_MAX_BITRATES        16
+#define MP3_READ_WAIT_MS        20
+#define MP3_STALL_TIMEOUT_MS    1000
+
+// Sources are opened, read, seeked and closed from the player task only. The
+// decode task services every active source; requests that touch the decoder
+// state are handed to it through flags and acknowledged with a semaphore.
+struct mp3_source {
+    volatile bool in_use;
+    volatile bool active;
+    FILE *file;
+    mp3_frame_index_t index;        // Copy of the caller's table; the offsets stay the caller's
+    HMP3Decoder decoder;
+    RingbufHandle_t pcm_ring;
+    StaticRingbuffer_t ring_struct;
+    uint8_t *ring_storage;          // Read-ahead ring, in PSRAM when present
+    SemaphoreHandle_t ack;
+
+    long first_frame_offset;
+    uint32_t samples_per_frame;
+    uint16_t channels;
+
+    uint8_t input[MP3_INPUT_BUFFER_SIZE];
+    uint8_t *input_ptr;
+    int input_left;
+    bool file_eof;
+    int16_t output[MP3_MAX_FRAME_SAMPLES];
+
+    volatile bool eof;              // Every decoded frame is in the ring buffer
+    volatile bool error;
+    volatile bool seek_pending;
+    volatile bool close_pending;
+    uint64_t seek_sample;
+    esp_err_t seek_result;
+    uint32_t drop_frames;           // Preroll frames still to decode and drop
+    uint32_t drop_samples;          // Samples per channel to drop from the next frame
+};
+
+static mp3_source_t source_pool[MP3_SOURCE_POOL_SIZE];
+static TaskHandle_t decode_task_handle = NULL;
+
+static mp3_bitrate_stats_t bitrate_stats[MP3_MAX_BITRATES];
+static size_t bitrate_stats_count = 0;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void record_stats(uint16_t bitrate_kbps, int64_t decode_us, uint32_t samples, uint32_t sample_rate) {
+    taskENTER_CRITICAL(&stats_mux);
+    size_t i = 0;
+    while (i < bitrate_stats_count && bitrate_stats[i].bitrate_kbps != bitrate_kbps) {
+        i++;
+    }
+    if (i == bitrate_stats_count && bitrate_stats_count < MP3_MAX_BITRATES) {
+        bitrate_stats[i].bitrate_kbps = bitrate_kbps;
+        bitrate_stats_count++;
+    }
+    if (i < bitrate_stats_count) {
+        bitrate_stats[i].frames++;
+        bitrate_stats[i].decode_us += decode_us;
+        bitrate_stats[i].audio_us += (uint64_t)samples * 1000000 / sample_rate;
+    }
+    taskEXIT_CRITICAL(&stats_mux);
+}
+
+static void drain_ring(mp3_source_t *src) {
+    size_t n;
+    void *item;
+    while ((item = xRingbufferReceiveUpTo(src->pcm_ring, &n, 0, mp3_source_ring_size())) != NULL) {
+        vRingbufferReturnItem(src->pcm_ring, item);
+    }
+}
+
+static void reset_input(mp3_source_t *src, long offset) {
+    fseek(src->file, offset, SEEK_SET);
+    src->input_ptr = src->input;
+    src->input_left = 0;
+    src->file_eof = false;
+    src->eof = false;
+    src->error = false;
+}
+
+static void refill_input(mp3_source_t *src) {
+    if (src->input_left > 0 && src->input_ptr != src->input) {
+        memmove(src->input, src->input_ptr, src->input_left);
+    }
+    src->input_ptr = src->input;
+    size_t want = sizeof(src->input) - src->input_left;
+    if (sd_fault_inject(SD_FAULT_READ, &want, true) != ESP_OK) {
+        ESP_LOGE(TAG, "Error reading MP3 file");
+        src->error = true;
+        return;
+    }
+    size_t n = fread(src->input + src->input_left, 1, want, src->file);
+    if (n == 0) {
+        src->file_eof = true;
+        if (ferror(src->file)) {
+            ESP_LOGE(TAG, "Error reading MP3 file");
+            src->error = true;
+        }
+    }
+    src->input_left += n;
+}
+
+// Decode one frame into the ring buffer
+static void decode_frame(mp3_source_t *src) {
+    if (src->input_left < MAINBUF_SIZE && !src->file_eof) {
+        refill_input(src);
+    }
+
+    int sync = MP3FindSyncWord(src->input_ptr, src->input_left);
+    if (sync < 0) {
+        // Keep the tail in case a header straddles the refill
+        int keep = src->input_left < 3 ? src->input_left : 3;
+        src->input_ptr += src->input_left - keep;
+        src->input_left = keep;
+        if (src->file_eof) {
+            src->eof = true;
+        }
+        return;
+    }
+    src->input_ptr += sync;
+    src->input_left -= sync;
+
+    int64_t start = esp_timer_get_time();
+    int err = MP3Decode(src->decoder, &src->input_ptr, &src->input_left, src->output, 0);
+    int64_t elapsed = esp_timer_get_time() - start;
+
+    if (err == ERR_MP3_INDATA_UNDERFLOW) {
+        if (src->file_eof) {
+            src->eof = true;
+        } else {
+            refill_input(src);
+        }
+        return;
+    }
+    if (err != ERR_MP3_NONE && err != ERR_MP3_MAINDATA_UNDERFLOW) {
+        // Skip past the bad sync and look for the next frame
+        ESP_LOGW(TAG, "MP3 decode error %d, resyncing", err);
+        src->input_ptr++;
+        src->input_left--;
+        return;
+    }
+
+    // A reservoir underflow still produces a frame of silence, which keeps seeks sample-accurate
+    MP3FrameInfo info;
+    MP3GetLastFrameInfo(src->decoder, &info);
+    uint32_t samples = info.outputSamps / info.nChans;
+    if (err == ERR_MP3_NONE) {
+        record_stats(info.bitrate / 1000, elapsed, samples, info.samprate);
+    }
+
+    if (src->drop_frames > 0) {
+        src->drop_frames--;
+        return;
+    }
+    uint32_t skip = src->drop_samples < samples ? src->drop_samples : samples;
+    src->drop_samples -= skip;
+    size_t bytes = (samples - skip) * info.nChans * sizeof(int16_t);
+    if (bytes > 0) {
+        xRingbufferSend(src->pcm_ring, src->output + skip * info.nChans, bytes, 0);
+    }
+}
+
+static void do_seek(mp3_source_t *src) {
+    drain_ring(src);
+
+    mp3_seek_plan_t plan;
+    mp3_plan_seek(&src->index, src->first_frame_offset, src->samples_per_frame, src->seek_sample, &plan);
+    long offset = plan.offset;
+    uint32_t skipped = mp3_skip_frames(src->file, &offset, plan.skip_frames);
+
+    reset_input(src, offset);
+    src->drop_frames = plan.preroll_frames;
+    src->drop_samples = plan.discard_samples;
+    if (skipped < plan.skip_frames) {
+        src->eof = true;    // past the end: reads return no data
+    }
+    src->seek_result = ESP_OK;
+}
+
+static void mp3_decode_task(void *arg) {
+    for (;;) {
+        bool busy = false;
+        for (int i = 0; i < MP3_SOURCE_POOL_SIZE; i++) {
+            mp3_source_t *src = &source_pool[i];
+            if (!src->active) {
+                continue;
+            }
+            if (src->close_pending) {
+                src->active = false;
+                src->close_pending = false;
+                drain_ring(src);
+                xSemaphoreGive(src->ack);
+                continue;
+            }
+            if (src->seek_pending) {
+                do_seek(src);
+                src->seek_pending = false;
+                xSemaphoreGive(src->ack);
+                busy = true;
+                continue;
+            }
+            if (!src->eof && !src->error &&
+                xRingbufferGetCurFreeSize(src->pcm_ring) >= sizeof(src->output)) {
+                decode_frame(src);
+                busy = true;
+            }
+        }
+        if (!busy) {
+            // Woken by readers freeing ring buffer space
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MP3_READ_WAIT_MS));
+        }
+    }
+}
+
+esp_err_t mp3_source_open(FILE *file, const mp3_frame_index_t *index, mp3_source_t **source,
+                          mp3_header_t *format) {
+    if (file == NULL || source == NULL || format == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    long first_frame_offset;
+    if (!mp3_find_first_frame(file, &first_frame_offset, format)) {
+        ESP_LOGE(TAG, "No MP3 frame found");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    mp3_source_t *src = NULL;
+    for (int i = 0; i < MP3_SOURCE_POOL_SIZE; i++) {
+        if (!source_pool[i].in_use) {
+            src = &source_pool[i];
+            break;
+        }
+    }
+    if (src == NULL) {
+        ESP_LOGE(TAG, "No free MP3 source");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Decoder, ring buffer and semaphore are created once per slot and reused
+    if (src->decoder == NULL) {
+        src->decoder = MP3InitDecoder();
+    }
+    if (src->pcm_ring == NULL) {
+        size_t ring_size = mp3_source_ring_size();
+        src->ring_storage = mem_alloc(MEM_BULK, ring_size);
+        if (src->ring_storage != NULL) {
+            src->pcm_ring = xRingbufferCreateStatic(ring_size, RINGBUF_TYPE_BYTEBUF, src->ring_storage, &src->ring_struct);
+        }
+    }
+    if (src->ack == NULL) {
+        src->ack = xSemaphoreCreateBinary();
+    }
+    if (src->decoder == NULL || src->pcm_ring == NULL || src->ack == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate MP3 decoder");
+        return ESP_ERR_NO_MEM;
+    }
+    if (decode_task_handle == NULL &&
+        xTaskCreatePinnedToCore(mp3_decode_task, "mp3_decode", 6144, NULL, tskIDLE_PRIORITY + 2,
+                                &decode_task_handle, MP3_DECODE_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create MP3 decode task");
+        decode_task_handle = NULL;
+        return ESP_FAIL;
+    }
+
+    src->in_use = true;
+    src->file = file;
+    if (index != NULL) {
+        src->index = *index;
+    } else {
+        memset(&src->index, 0, sizeof(src->index));
+    }
+    src->first_frame_offset = first_frame_offset;
+    src->samples_per_frame = format->samples;
+    src->channels = format->channels;
+    src->drop_frames = 0;
+    src->drop_samples = 0;
+    src->seek_pending = false;
+    src->close_pending = false;
+    reset_input(src, first_frame_offset);
+    src->active = true;
+    xTaskNotifyGive(decode_task_handle);
+
+    ESP_LOGI(TAG, "MP3: %u Hz, %u channels, %u kbps, first frame at %ld",
+             format->sample_rate, format->channels, format->bitrate_kbps, first_frame_offset);
+    *source = src;
+    return ESP_OK;
+}
+
+void mp3_source_set_index(mp3_source_t *source, const mp3_frame_index_t *index) {
+    if (source == NULL) {
+        return;
+    }
+    // Seeks are planned on the decode task, but only while the player waits on one
+    if (index != NULL) {
+        source->index = *index;
+    } else {
+        memset(&source->index, 0, sizeof(source->index));
+    }
+}
+
+void mp3_source_close(mp3_source_t *source) {
+    if (source == NULL || !source->in_use) {
+        return;
+    }
+    source->close_pending = true;
+    xTaskNotifyGive(decode_task_handle);
+    xSemaphoreTake(source->ack, portMAX_DELAY);
+    source->file = NULL;
+    source->in_use = false;
+    mp3_source_log_stats();
+}
+
+esp_err_t mp3_source_read(mp3_source_t *source, void *buffer, size_t buffer_size, size_t *bytes_read) {
+    if (source == NULL || !source->active || buffer == NULL || bytes_read == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t frame_bytes = source->channels * sizeof(int16_t);
+    size_t wanted = buffer_size - buffer_size % frame_bytes;
+    size_t total = 0;
+    int stalled_ms = 0;
+    *bytes_read = 0;
+
+    while (total < wanted) {
+        bool done = source->eof;
+        size_t n = 0;
+        uint8_t *item = xRingbufferReceiveUpTo(source->pcm_ring, &n, pdMS_TO_TICKS(MP3_READ_WAIT_MS), wanted - total);
+        if (item != NULL) {
+            memcpy((uint8_t *)buffer + total, item, n);
+            vRingbufferReturnItem(source->pcm_ring, item);
+            total += n;
+            stalled_ms = 0;
+            xTaskNotifyGive(decode_task_handle);
+            continue;
+        }
+        if (source->error) {
+            *bytes_read = total;
+            return ESP_FAIL;
+        }
+        // Hand out what we have, as long as it ends on a frame boundary
+        if (done || (total > 0 && total % frame_bytes == 0)) {
+            break;
+        }
+        stalled_ms += MP3_READ_WAIT_MS;
+        if (stalled_ms >= MP3_STALL_TIMEOUT_MS) {
+            ESP_LOGE(TAG, "MP3 decoder stalled");
+            *bytes_read = total;
+            return ESP_FAIL;
+        }
+    }
+
+    *bytes_read = total;
+    return ESP_OK;
+}
+
+esp_err_t mp3_source_seek(mp3_source_t *source, uint64_t sample) {
+    if (source == NULL || !source->active) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    source->seek_sample = sample;
+    source->seek_pending = true;
+    xTaskNotifyGive(decode_task_handle);
+    xSemaphoreTake(source->ack, portMAX_DELAY);
+    return source->seek_result;
+}
+
+size_t mp3_source_ring_size(void) {
+    return mem_has_psram() ? MP3_PCM_BUFFER_SIZE_PSRAM : MP3_PCM_BUFFER_SIZE;
+}
+
+size_t mp3_source_buffered(mp3_source_t *source) {
+    return mp3_source_ring_size() - xRingbufferGetCurFreeSize(source->pcm_ring);
+}
+
+size_t mp3_source_get_stats(mp3_bitrate_stats_t *stats, size_t max_count) {
+    taskENTER_CRITICAL(&stats_mux);
+    size_t count = bitrate_stats_count < max_count ? bitrate_stats_count : max_count;
+    memcpy(stats, bitrate_stats, count * sizeof(mp3_bitrate_stats_t));
+    taskEXIT_CRITICAL(&stats_mux);
+    return count;
+}
+
+void mp3_source_log_stats(void) {
+    mp3_bitrate_stats_t stats[MP3_MAX_BITRATES];
+    size_t count = mp3_source_get_stats(stats, MP3_MAX_BITRATES);
+    for (size_t i = 0; i < count; i++) {
+        if (stats[i].audio_us == 0) {
+            continue;
+        }
+        uint32_t permille = (uint32_t)(stats[i].decode_us * 1000 / stats[i].audio_us);
+        ESP_LOGI(TAG, "%3u kbps: %u.%u%% CPU over %u frames", stats[i].bitrate_kbps,
+                 permille / 10, permille % 10, stats[i].frames);
+    }
+}
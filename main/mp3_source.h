@@ -0,0 +1,122 @@
+#ifndef MP3_SOURCE_H
+#define MP3_SOURCE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+#include "mp3_frame.h"
+
+#ifndef TEST_MODE
+#include "esp_err.h"
+#else
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG -2
+#endif
+
+// Core the decoder runs on; the player task feeding I2S stays on the other one
+#define MP3_DECODE_CORE         1
+
+// Decoded PCM handed from the decode task to the player (about 90 ms at 44.1 kHz
+// stereo); with PSRAM the ring is placed there and holds about 370 ms
+#define MP3_PCM_BUFFER_SIZE         (16 * 1024)
+#define MP3_PCM_BUFFER_SIZE_PSRAM   (64 * 1024)
+
+// Streams decoded at once: the playing track and the outgoing track of a crossfade
+#define MP3_SOURCE_POOL_SIZE    2
+
+typedef struct mp3_source mp3_source_t;
+
+// Decode cost for one bitrate
+typedef struct {
+    uint16_t bitrate_kbps;
+    uint32_t frames;
+    uint64_t decode_us;         // Time spent in the decoder
+    uint64_t audio_us;          // Duration of the decoded audio
+} mp3_bitrate_stats_t;
+
+/**
+ * @brief Start decoding an MP3 file on the decode core
+ *
+ * Takes over the file handle until mp3_source_close().
+ *
+ * @param file File to decode
+ * @param index Frame offset table from the index, or NULL; copied, but its offsets
+ *              must outlive the source
+ * @param source Pointer to store the source
+ * @param format Pointer to store the header of the first frame
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if no MP3 frame is found,
+ *         ESP_ERR_NO_MEM if no source is free or its buffers cannot be allocated
+ */
+esp_err_t mp3_source_open(FILE *file, const mp3_frame_index_t *index, mp3_source_t **source,
+                          mp3_header_t *format);
+
+/**
+ * @brief Replace the frame offset table used to plan seeks
+ *
+ * Call from the player task, outside mp3_source_seek().
+ *
+ * @param source Source from mp3_source_open()
+ * @param index Frame offset table, or NULL; copied, but its offsets must
+ *              outlive the source
+ */
+void mp3_source_set_index(mp3_source_t *source, const mp3_frame_index_t *index);
+
+/**
+ * @brief Stop decoding and release the source
+ *
+ * @param source Source from mp3_source_open()
+ */
+void mp3_source_close(mp3_source_t *source);
+
+/**
+ * @brief Read decoded 16-bit interleaved PCM
+ *
+ * @param source Source from mp3_source_open()
+ * @param buffer Buffer to store the PCM data
+ * @param buffer_size Size of buffer
+ * @param bytes_read Pointer to store number of bytes read, 0 at end of stream
+ * @return ESP_OK on success
+ */
+esp_err_t mp3_source_read(mp3_source_t *source, void *buffer, size_t buffer_size, size_t *bytes_read);
+
+/**
+ * @brief Seek to a sample, waiting until the decoder has repositioned
+ *
+ * @param source Source from mp3_source_open()
+ * @param sample Target sample per channel
+ * @return ESP_OK on success
+ */
+esp_err_t mp3_source_seek(mp3_source_t *source, uint64_t sample);
+
+/**
+ * @brief Get the size of the decoded PCM ring of each source
+ *
+ * @return MP3_PCM_BUFFER_SIZE_PSRAM with PSRAM, MP3_PCM_BUFFER_SIZE without
+ */
+size_t mp3_source_ring_size(void);
+
+/**
+ * @brief Get how much decoded PCM is waiting for the player
+ *
+ * @param source Source from mp3_source_open()
+ * @return Bytes in the ring, up to mp3_source_ring_size()
+ */
+size_t mp3_source_buffered(mp3_source_t *source);
+
+/**
+ * @brief Get decode cost per bitrate since boot
+ *
+ * @param stats Array to fill
+ * @param max_count Size of the array
+ * @return Number of bitrates filled in
+ */
+size_t mp3_source_get_stats(mp3_bitrate_stats_t *stats, size_t max_count);
+
+/**
+ * @brief Log decode CPU percentage per bitrate
+ */
+void mp3_source_log_stats(void);
+
+#endif // MP3_SOURCE_H
@@ -25,7 +25,10 @@ static const rgb_color_t mode_colors[MODE_MAX] = {
     {50, 0, 0},     // Red - MODE_PLAY_ALL_ORDER
     {0, 50, 0},     // Green - MODE_PLAY_ALL_SHUFFLE
     {0, 0, 50},     // Blue - MODE_PLAY_FOLDER_ORDER
-    {50, 50, 0}    // Yellow - MODE_PLAY_FOLDER_SHUFFLE
+    {50, 50, 0},    // Yellow - MODE_PLAY_FOLDER_SHUFFLE
+    {0, 50, 50},    // Cyan - MODE_PLAY_ARTIST_ORDER
+    {50, 0, 50},    // Magenta - MODE_PLAY_ALBUM_ORDER
+    {30, 30, 30}    // White - MODE_PLAY_ALBUM_SHUFFLE
 };
 
 // Global brightness setting (0-100%)
@@ -1,19 +1,285 @@
 #include "pcm_file.h"
+#include "mem_policy.h"
+#include "sd_fault.h"
 #include <string.h>
 #include <stdio.h>
 #include <errno.h>
 
 #ifndef TEST_MODE
 #include "esp_log.h"
-#include "sd_card.h" // Add for path resolution
+#include "esp_timer.h"
 #else
 // Test mode definitions
+#include <time.h>
 #define ESP_LOGI(tag, format, ...) printf("[INFO] " format "\n", ##__VA_ARGS__)
 #define ESP_LOGE(tag, format, ...) printf("[ERROR] " format "\n", ##__VA_ARGS__)
+static int64_t esp_timer_get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 #endif
 
 static const char *TAG = "pcm_file";
 
+// WAV format tags
+#define WAVE_FORMAT_PCM         0x0001
+#define WAVE_FORMAT_IMA_ADPCM   0x0011
+#define WAVE_FORMAT_EXTENSIBLE  0xFFFE
+
+// Upper bound on chunks walked before "data" (LIST, fact, bext, ...)
+#define WAV_MAX_CHUNKS          16
+
+// Read cost per path, for comparing direct sector reads with the file system
+static pcm_read_stats_t fatfs_stats;
+static pcm_read_stats_t direct_stats;
+
+// Read from the card sector by sector: partial sectors go through sector_buf,
+// whole sectors are transferred straight into the caller's buffer in one go
+static size_t read_direct(pcm_file_t *pcm_file, uint8_t *buffer, size_t size) {
+    size_t left = pcm_file->file_size > (size_t)pcm_file->file_pos ? pcm_file->file_size - pcm_file->file_pos : 0;
+    if (size > left) {
+        size = left;
+    }
+
+    size_t done = 0;
+    while (done < size) {
+        uint32_t offset = pcm_file->file_pos + done;
+        uint32_t sector = offset / SD_SECTOR_SIZE;
+        uint32_t in_sector = offset % SD_SECTOR_SIZE;
+
+        if (in_sector == 0 && size - done >= SD_SECTOR_SIZE) {
+            uint32_t count = (size - done) / SD_SECTOR_SIZE;
+            if (sd_card_read_sectors(buffer + done, pcm_file->first_sector + sector, count) != ESP_OK) {
+                pcm_file->read_error = true;
+                break;
+            }
+            done += count * SD_SECTOR_SIZE;
+            continue;
+        }
+
+        if (pcm_file->cached_sector != sector) {
+            if (sd_card_read_sectors(pcm_file->sector_buf, pcm_file->first_sector + sector, 1) != ESP_OK) {
+                pcm_file->read_error = true;
+                break;
+            }
+            pcm_file->cached_sector = sector;
+        }
+        size_t chunk = SD_SECTOR_SIZE - in_sector;
+        if (chunk > size - done) {
+            chunk = size - done;
+        }
+        memcpy(buffer + done, pcm_file->sector_buf + in_sector, chunk);
+        done += chunk;
+    }
+    return done;
+}
+
+// Read file bytes at file_pos: the prefetched head from RAM, the rest
+// through whichever path the file uses. With partial, the card part may
+// come back short.
+static size_t read_data(pcm_file_t *pcm_file, void *buffer, size_t size, bool partial) {
+    uint8_t *dst = buffer;
+    size_t from_head = 0;
+    if ((size_t)pcm_file->file_pos < pcm_file->head_len) {
+        from_head = pcm_file->head_len - pcm_file->file_pos;
+        if (from_head > size) {
+            from_head = size;
+        }
+        memcpy(dst, pcm_file->head + pcm_file->file_pos, from_head);
+        pcm_file->file_pos += from_head;
+        if (from_head == size) {
+            return size;
+        }
+    }
+
+    int64_t start = esp_timer_get_time();
+    size_t n = 0;
+    size_t want = size - from_head;
+    if (want > 0 && sd_fault_inject(SD_FAULT_READ, &want, partial) != ESP_OK) {
+        pcm_file->read_error = true;
+    } else if (pcm_file->direct) {
+        n = read_direct(pcm_file, dst + from_head, want);
+    } else if (pcm_file->fs_pos != pcm_file->file_pos &&
+               fseek(pcm_file->file, pcm_file->file_pos, SEEK_SET) != 0) {
+        ESP_LOGE(TAG, "Failed to seek to offset %ld (errno: %d)", pcm_file->file_pos, errno);
+        pcm_file->read_error = true;
+    } else {
+        n = fread(dst + from_head, 1, want, pcm_file->file);
+        pcm_file->fs_pos = pcm_file->file_pos + n;
+    }
+    pcm_read_stats_t *stats = pcm_file->direct ? &direct_stats : &fatfs_stats;
+    stats->bytes += n;
+    stats->us += esp_timer_get_time() - start;
+    pcm_file->file_pos += n;
+    return from_head + n;
+}
+
+// Seeks only move file_pos; the next read positions the handle if it needs to
+static void seek_data(pcm_file_t *pcm_file, long offset) {
+    pcm_file->file_pos = offset;
+}
+
+static bool read_failed(pcm_file_t *pcm_file) {
+    return pcm_file->read_error || (!pcm_file->direct && ferror(pcm_file->file) != 0);
+}
+
+// Close the handle and hand a prefetched head back to the track cache
+static void release_file(pcm_file_t *pcm_file) {
+    fclose(pcm_file->file);
+    pcm_file->file = NULL;
+    track_cache_release(pcm_file->head);
+    pcm_file->head = NULL;
+    pcm_file->head_len = 0;
+}
+
+static uint32_t read_le32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t read_le16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+// Clamp a size declared in a header to what the file actually holds
+static size_t clamp_data_size(const pcm_file_t *pcm_file, uint32_t declared) {
+    size_t available = pcm_file->file_size - pcm_file->data_offset;
+    return (declared == 0 || declared > available) ? available : declared;
+}
+
+// Walk the RIFF chunks for "fmt " and "data". The file is positioned after the RIFF/WAVE preamble.
+static esp_err_t parse_wav_header(pcm_file_t *pcm_file, uint16_t *format_tag, uint16_t *block_align) {
+    bool have_fmt = false;
+    for (int i = 0; i < WAV_MAX_CHUNKS; i++) {
+        uint8_t chunk[8];
+        if (read_data(pcm_file, chunk, sizeof(chunk), false) != sizeof(chunk)) {
+            break;
+        }
+        uint32_t size = read_le32(chunk + 4);
+        long body = pcm_file->file_pos;
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            uint8_t fmt[40] = {0};
+            if (read_data(pcm_file, fmt, size < sizeof(fmt) ? size : sizeof(fmt), false) < 16) {
+                break;
+            }
+            *format_tag = read_le16(fmt);
+            if (*format_tag == WAVE_FORMAT_EXTENSIBLE && size >= 40) {
+                *format_tag = read_le16(fmt + 24);  // First bytes of the SubFormat GUID
+            }
+            pcm_file->channels = read_le16(fmt + 2);
+            pcm_file->sample_rate = read_le32(fmt + 4);
+            *block_align = read_le16(fmt + 12);
+            pcm_file->bit_depth = read_le16(fmt + 14);
+            have_fmt = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!have_fmt) {
+                break;
+            }
+            pcm_file->data_offset = body;
+            pcm_file->data_size = clamp_data_size(pcm_file, size);
+            return ESP_OK;
+        }
+
+        // Chunks are padded to an even length
+        seek_data(pcm_file, body + size + (size & 1));
+    }
+
+    ESP_LOGE(TAG, "Malformed WAV header in %s", pcm_file->filepath);
+    return ESP_FAIL;
+}
+
+static esp_err_t flac_attach(pcm_file_t *pcm_file);
+static esp_err_t mp3_attach(pcm_file_t *pcm_file);
+
+// Size of an ID3v2 tag from its 10-byte header, including header and footer
+static long id3_tag_size(const uint8_t *tag) {
+    long size = 10 + (((long)(tag[6] & 0x7F) << 21) | ((tag[7] & 0x7F) << 14) | ((tag[8] & 0x7F) << 7) | (tag[9] & 0x7F));
+    return (tag[5] & 0x10) ? size + 10 : size;
+}
+
+// An MPEG frame header at offset, followed by a second one where the frame ends
+static bool mpeg_frames_at(pcm_file_t *pcm_file, long offset) {
+    uint8_t hdr[4];
+    mp3_header_t header;
+    seek_data(pcm_file, offset);
+    if (read_data(pcm_file, hdr, sizeof(hdr), false) != sizeof(hdr) || !mp3_parse_header(hdr, &header)) {
+        return false;
+    }
+    seek_data(pcm_file, offset + header.frame_bytes);
+    return read_data(pcm_file, hdr, sizeof(hdr), false) == sizeof(hdr) && mp3_parse_header(hdr, &header);
+}
+
+// Recognise a FLAC or MP3 stream and attach its decoder. An ID3v2 tag is
+// followed by FLAC or, padded or not, by MPEG frames. Without a free decoder
+// the file stays raw and the codec from the index is tried later.
+static void probe_stream(pcm_file_t *pcm_file, const uint8_t *header, size_t n) {
+    bool tagged = n >= 10 && memcmp(header, "ID3", 3) == 0;
+    uint8_t magic[4];
+    if (tagged) {
+        seek_data(pcm_file, id3_tag_size(header));
+        if (read_data(pcm_file, magic, sizeof(magic), false) != sizeof(magic)) {
+            return;
+        }
+    } else if (n >= sizeof(magic)) {
+        memcpy(magic, header, sizeof(magic));
+    } else {
+        return;
+    }
+
+    esp_err_t ret;
+    if (memcmp(magic, "fLaC", 4) == 0) {
+        ret = flac_attach(pcm_file);
+    } else if (tagged || (magic[0] == 0xFF && (magic[1] & 0xE0) == 0xE0 && mpeg_frames_at(pcm_file, 0))) {
+        ret = mp3_attach(pcm_file);
+    } else {
+        return;
+    }
+    // The decoders move the FILE themselves
+    pcm_file->fs_pos = -1;
+    if (ret == ESP_OK) {
+        pcm_file->has_header = true;
+    }
+}
+
+// Take format and data range from an ESP32PCM or WAV header if the file has
+// one, and attach the decoder of a FLAC or MP3 stream
+static esp_err_t parse_header(pcm_file_t *pcm_file) {
+    uint8_t header[PCM_FILE_HEADER_SIZE];
+    size_t n = read_data(pcm_file, header, sizeof(header), false);
+
+    if (n == sizeof(header) && memcmp(header, "ESP32PCM", 8) == 0) {
+        pcm_file->sample_rate = read_le32(header + 8);
+        pcm_file->bit_depth = read_le16(header + 12);
+        pcm_file->channels = read_le16(header + 14);
+        pcm_file->data_offset = PCM_FILE_HEADER_SIZE;
+        pcm_file->data_size = clamp_data_size(pcm_file, read_le32(header + 16));
+        pcm_file->has_header = true;
+        return ESP_OK;
+    }
+
+    if (n >= 12 && memcmp(header, "RIFF", 4) == 0 && memcmp(header + 8, "WAVE", 4) == 0) {
+        uint16_t format_tag = 0;
+        uint16_t block_align = 0;
+        seek_data(pcm_file, 12);
+        if (parse_wav_header(pcm_file, &format_tag, &block_align) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        pcm_file->has_header = true;
+        if (format_tag == WAVE_FORMAT_IMA_ADPCM) {
+            return pcm_file_set_codec(pcm_file, PCM_CODEC_IMA_ADPCM, block_align);
+        }
+        if (format_tag != WAVE_FORMAT_PCM) {
+            ESP_LOGE(TAG, "Unsupported WAV format 0x%04x in %s", format_tag, pcm_file->filepath);
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+
+    probe_stream(pcm_file, header, n);
+    return ESP_OK;
+}
+
 esp_err_t pcm_file_open(const char *filepath, pcm_file_t *pcm_file, uint32_t sample_rate, uint16_t bit_depth, uint16_t channels) {
     if (filepath == NULL || pcm_file == NULL) {
         return ESP_ERR_INVALID_ARG;
@@ -21,13 +287,31 @@ esp_err_t pcm_file_open(const char *filepath, pcm_file_t *pcm_file, uint32_t sam
 
     ESP_LOGI(TAG, "Opening PCM file: %s", filepath);
     
-    // Open the file directly
-    pcm_file->file = fopen(filepath, "rb");
-    
-    // Check if we have an open file
-    if (pcm_file->file == NULL) {
-        ESP_LOGE(TAG, "Failed to open PCM file: %s (errno: %d)", filepath, errno);
-        return ESP_FAIL;
+    // Take the prefetched handle and head if the track cache has them,
+    // otherwise open the file directly
+    track_cache_entry_t cached;
+    if (track_cache_take(filepath, &cached)) {
+        pcm_file->file = cached.file;
+        pcm_file->head = cached.head;
+        pcm_file->head_len = cached.head_len;
+        pcm_file->file_size = cached.file_size;
+        pcm_file->fs_pos = cached.head_len;
+    } else {
+        pcm_file->file = fopen(filepath, "rb");
+        pcm_file->head = NULL;
+        pcm_file->head_len = 0;
+        
+        // Check if we have an open file
+        if (pcm_file->file == NULL) {
+            ESP_LOGE(TAG, "Failed to open PCM file: %s (errno: %d)", filepath, errno);
+            return ESP_FAIL;
+        }
+        
+        // Get file size
+        fseek(pcm_file->file, 0, SEEK_END);
+        pcm_file->file_size = ftell(pcm_file->file);
+        fseek(pcm_file->file, 0, SEEK_SET);
+        pcm_file->fs_pos = 0;
     }
 
     // Store the filepath and audio parameters
@@ -39,31 +323,243 @@ esp_err_t pcm_file_open(const char *filepath, pcm_file_t *pcm_file, uint32_t sam
     pcm_file->bit_depth = bit_depth;
     pcm_file->channels = channels;
     
-    // Get file size
-    fseek(pcm_file->file, 0, SEEK_END);
-    pcm_file->file_size = ftell(pcm_file->file);
-    fseek(pcm_file->file, 0, SEEK_SET);
-    
-    // Initialize position
+    // Initialize position; files are raw PCM until a codec is set
     pcm_file->position = 0;
+    pcm_file->file_pos = 0;
+    pcm_file->data_offset = 0;
+    pcm_file->data_size = pcm_file->file_size;
+    pcm_file->has_header = false;
+    pcm_file->pcm_size = pcm_file->file_size;
+    pcm_file->codec = PCM_CODEC_RAW;
+    pcm_file->block_align = 0;
+    pcm_file->decoded_len = 0;
+    pcm_file->decoded_pos = 0;
+    pcm_file->flac = NULL;
+    pcm_file->mp3 = NULL;
+    memset(&pcm_file->frame_index, 0, sizeof(pcm_file->frame_index));
+    pcm_file->frame_samples = 0;
+    pcm_file->direct = false;
+    pcm_file->read_error = false;
+    pcm_file->cached_sector = UINT32_MAX;
+    
+    // A header that could be read but not understood is a format error
+    if (parse_header(pcm_file) != ESP_OK) {
+        esp_err_t ret = read_failed(pcm_file) ? ESP_FAIL : ESP_ERR_INVALID_ARG;
+        release_file(pcm_file);
+        return ret;
+    }
+    if (pcm_file->codec == PCM_CODEC_RAW) {
+        pcm_file->pcm_size = pcm_file->data_size;
+    }
+    
+    // A single run of clusters can be addressed as a plain sector range. Only
+    // raw and ADPCM data is read through pcm_file_read, so streams the probe
+    // handed to a decoder skip the chain walk.
+    sd_file_layout_t layout;
+    if ((pcm_file->codec == PCM_CODEC_RAW || pcm_file->codec == PCM_CODEC_IMA_ADPCM) &&
+        sd_card_get_file_layout(filepath, &layout) == ESP_OK && layout.fragments == 1 && layout.clusters > 0) {
+        pcm_file->direct = true;
+        pcm_file->first_sector = layout.first_sector;
+    }
+    seek_data(pcm_file, pcm_file->data_offset);
     
-    ESP_LOGI(TAG, "PCM file opened: %s", filepath);
+    ESP_LOGI(TAG, "PCM file opened: %s%s%s%s", filepath, pcm_file->has_header ? " (format from header)" : "",
+             pcm_file->direct ? " (direct sector reads)" : "", pcm_file->head != NULL ? " (prefetched)" : "");
     ESP_LOGI(TAG, "Sample rate: %u Hz, Bit depth: %u bits, Channels: %u, Size: %zu bytes", 
              pcm_file->sample_rate, pcm_file->bit_depth, pcm_file->channels, pcm_file->file_size);
     
     return ESP_OK;
 }
 
-esp_err_t pcm_file_seek(pcm_file_t *pcm_file, uint32_t byte_pos) {
+// Decoded size of an IMA ADPCM stream: full blocks plus a possibly short final block
+static size_t adpcm_pcm_size(size_t data_size, uint16_t block_align, uint16_t channels) {
+    size_t full_blocks = data_size / block_align;
+    size_t frames = full_blocks * ima_adpcm_frames_per_block(block_align, channels);
+    frames += ima_adpcm_frames_per_block(data_size % block_align, channels);
+    return frames * 2 * channels;
+}
+
+// Read and decode the next IMA ADPCM block; returns the number of frames decoded, 0 at end of data
+static size_t adpcm_decode_next(pcm_file_t *pcm_file) {
+    long data_end = pcm_file->data_offset + (long)pcm_file->data_size;
+    long left = data_end - pcm_file->file_pos;
+    size_t want = left < (long)pcm_file->block_align ? (left > 0 ? (size_t)left : 0) : pcm_file->block_align;
+    size_t n = read_data(pcm_file, pcm_file->block, want, false);
+    size_t frames = ima_adpcm_decode_block(pcm_file->block, n, pcm_file->channels, pcm_file->decoded);
+    pcm_file->decoded_len = frames * 2 * pcm_file->channels;
+    pcm_file->decoded_pos = 0;
+    return frames;
+}
+
+// Attach a pooled FLAC decoder and take the audio parameters from STREAMINFO
+static esp_err_t flac_attach(pcm_file_t *pcm_file) {
+    if (pcm_file->flac != NULL) {
+        return ESP_OK;
+    }
+    flac_decoder_t *dec = flac_decoder_acquire();
+    if (dec == NULL) {
+        ESP_LOGE(TAG, "No free FLAC decoder for %s", pcm_file->filepath);
+        return ESP_ERR_NO_MEM;
+    }
+    if (flac_decoder_open(dec, pcm_file->file) != ESP_OK) {
+        flac_decoder_release(dec);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // The decoder reads through the file system
+    pcm_file->flac = dec;
+    pcm_file->codec = PCM_CODEC_FLAC;
+    pcm_file->direct = false;
+    pcm_file->sample_rate = dec->sample_rate;
+    pcm_file->bit_depth = dec->bit_depth;
+    pcm_file->channels = dec->channels;
+    pcm_file->pcm_size = (size_t)dec->total_samples * (dec->bit_depth / 8) * dec->channels;
+    return ESP_OK;
+}
+
+// Hand the file to an MP3 source decoding on the other core
+static esp_err_t mp3_attach(pcm_file_t *pcm_file) {
+#ifdef TEST_MODE
+    (void)pcm_file;
+    ESP_LOGE(TAG, "MP3 decoding is not available in host builds");
+    return ESP_ERR_INVALID_ARG;
+#else
+    if (pcm_file->mp3 != NULL) {
+        return ESP_OK;
+    }
+    // The source copies the file's table, which may be set after this. The copy
+    // stays valid when a crossfade moves this struct to another one.
+    mp3_header_t format;
+    esp_err_t ret = mp3_source_open(pcm_file->file, &pcm_file->frame_index, &pcm_file->mp3, &format);
+    if (ret != ESP_OK) {
+        pcm_file->mp3 = NULL;
+        return ret;
+    }
+
+    pcm_file->codec = PCM_CODEC_MP3;
+    pcm_file->direct = false;
+    pcm_file->sample_rate = format.sample_rate;
+    pcm_file->bit_depth = 16;
+    pcm_file->channels = format.channels;
+    pcm_file->frame_samples = format.samples;
+    pcm_file->pcm_size = (size_t)pcm_file->frame_index.frame_count * format.samples * format.channels * 2;
+    return ESP_OK;
+#endif
+}
+
+esp_err_t pcm_file_set_frame_index(pcm_file_t *pcm_file, const mp3_frame_index_t *frame_index) {
     if (pcm_file == NULL || pcm_file->file == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
+    // Index entries can be evicted from memory while the file plays
+    uint32_t *offsets = NULL;
+    if (frame_index != NULL && frame_index->count > 0) {
+        offsets = mem_alloc(MEM_BULK, frame_index->count * sizeof(uint32_t));
+        if (offsets == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(offsets, frame_index->offsets, frame_index->count * sizeof(uint32_t));
+    }
+    mem_free(pcm_file->frame_index.offsets);
+    memset(&pcm_file->frame_index, 0, sizeof(pcm_file->frame_index));
+    if (frame_index != NULL) {
+        pcm_file->frame_index = *frame_index;
+        pcm_file->frame_index.offsets = offsets;
+    }
+    if (pcm_file->mp3 != NULL) {
+#ifndef TEST_MODE
+        mp3_source_set_index(pcm_file->mp3, &pcm_file->frame_index);
+#endif
+        pcm_file->pcm_size = (size_t)pcm_file->frame_index.frame_count * pcm_file->frame_samples * pcm_file->channels * 2;
+    }
+    return ESP_OK;
+}
+
+esp_err_t pcm_file_set_codec(pcm_file_t *pcm_file, pcm_codec_t codec, uint16_t block_align) {
+    if (pcm_file == NULL || pcm_file->file == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    switch (codec) {
+        case PCM_CODEC_RAW:
+            pcm_file->codec = PCM_CODEC_RAW;
+            pcm_file->pcm_size = pcm_file->data_size;
+            return ESP_OK;
+
+        case PCM_CODEC_IMA_ADPCM:
+            if (block_align > IMA_ADPCM_MAX_BLOCK_ALIGN ||
+                ima_adpcm_frames_per_block(block_align, pcm_file->channels) <= 1) {
+                ESP_LOGE(TAG, "Unsupported IMA ADPCM layout: block_align=%u, channels=%u",
+                         block_align, pcm_file->channels);
+                return ESP_ERR_INVALID_ARG;
+            }
+            pcm_file->codec = PCM_CODEC_IMA_ADPCM;
+            pcm_file->block_align = block_align;
+            pcm_file->bit_depth = 16;
+            pcm_file->pcm_size = adpcm_pcm_size(pcm_file->data_size, block_align, pcm_file->channels);
+            pcm_file->decoded_len = 0;
+            pcm_file->decoded_pos = 0;
+            ESP_LOGI(TAG, "IMA ADPCM: block_align=%u, decoded size %zu bytes", block_align, pcm_file->pcm_size);
+            return ESP_OK;
 
-    if (fseek(pcm_file->file, byte_pos, SEEK_SET) != 0) {
-        ESP_LOGE(TAG, "Failed to seek to byte position %u in PCM file (errno: %d)", byte_pos, errno);
+        case PCM_CODEC_FLAC:
+            return flac_attach(pcm_file);
+
+        case PCM_CODEC_MP3:
+            return mp3_attach(pcm_file);
+
+        default:
+            return ESP_ERR_INVALID_ARG;
+    }
+}
+
+// Seek within an IMA ADPCM stream: jump to the containing block, then skip into it
+static esp_err_t adpcm_seek(pcm_file_t *pcm_file, uint32_t byte_pos) {
+    uint32_t frame_bytes = 2 * pcm_file->channels;
+    size_t frames_per_block = ima_adpcm_frames_per_block(pcm_file->block_align, pcm_file->channels);
+    uint32_t frame = byte_pos / frame_bytes;
+    uint32_t block_index = frame / frames_per_block;
+
+    seek_data(pcm_file, pcm_file->data_offset + (long)block_index * pcm_file->block_align);
+    adpcm_decode_next(pcm_file);
+    if (read_failed(pcm_file)) {
+        ESP_LOGE(TAG, "Failed to read block %u in ADPCM file", block_index);
         return ESP_FAIL;
     }
+    size_t skip = (frame % frames_per_block) * frame_bytes + (byte_pos % frame_bytes);
+    pcm_file->decoded_pos = skip < pcm_file->decoded_len ? skip : pcm_file->decoded_len;
+    pcm_file->position = byte_pos;
+    return ESP_OK;
+}
+
+esp_err_t pcm_file_seek(pcm_file_t *pcm_file, uint32_t byte_pos) {
+    if (pcm_file == NULL || pcm_file->file == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (pcm_file->codec == PCM_CODEC_IMA_ADPCM) {
+        return adpcm_seek(pcm_file, byte_pos);
+    }
 
+    if (pcm_file->codec == PCM_CODEC_FLAC || pcm_file->codec == PCM_CODEC_MP3) {
+        // Decoded output comes in whole frames, so land on the containing frame
+        uint32_t frame_bytes = (pcm_file->bit_depth / 8) * pcm_file->channels;
+        esp_err_t ret = ESP_ERR_INVALID_ARG;
+        if (pcm_file->codec == PCM_CODEC_FLAC) {
+            ret = flac_decoder_seek(pcm_file->flac, byte_pos / frame_bytes);
+        }
+#ifndef TEST_MODE
+        if (pcm_file->codec == PCM_CODEC_MP3) {
+            ret = mp3_source_seek(pcm_file->mp3, byte_pos / frame_bytes);
+        }
+#endif
+        if (ret == ESP_OK) {
+            pcm_file->position = byte_pos - byte_pos % frame_bytes;
+        }
+        return ret;
+    }
+
+    seek_data(pcm_file, pcm_file->data_offset + byte_pos);
     pcm_file->position = byte_pos;
 
     ESP_LOGI(TAG, "PCM file seek: byte_pos=%u, new position=%u", byte_pos, pcm_file->position);
@@ -71,36 +567,183 @@ esp_err_t pcm_file_seek(pcm_file_t *pcm_file, uint32_t byte_pos) {
     return ESP_OK;
 }
 
+// Bytes per decoded frame, 0 if the format is unknown
+static uint32_t frame_bytes_of(const pcm_file_t *pcm_file) {
+    return (pcm_file->bit_depth / 8) * pcm_file->channels;
+}
+
+// Convert a byte count in the decoded stream to milliseconds
+static uint32_t bytes_to_ms(const pcm_file_t *pcm_file, size_t bytes) {
+    uint32_t frame_bytes = frame_bytes_of(pcm_file);
+    if (frame_bytes == 0 || pcm_file->sample_rate == 0) {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)(bytes / frame_bytes) * 1000 / pcm_file->sample_rate);
+}
+
+esp_err_t pcm_file_seek_ms(pcm_file_t *pcm_file, uint32_t position_ms) {
+    if (pcm_file == NULL || pcm_file->file == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t frame_bytes = frame_bytes_of(pcm_file);
+    if (frame_bytes == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint64_t byte_pos = (uint64_t)position_ms * pcm_file->sample_rate / 1000 * frame_bytes;
+    if (pcm_file->pcm_size > 0 && byte_pos > pcm_file->pcm_size) {
+        byte_pos = pcm_file->pcm_size - pcm_file->pcm_size % frame_bytes;
+    }
+    if (byte_pos > UINT32_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return pcm_file_seek(pcm_file, (uint32_t)byte_pos);
+}
+
+uint32_t pcm_file_position_ms(const pcm_file_t *pcm_file) {
+    return pcm_file != NULL ? bytes_to_ms(pcm_file, pcm_file->position) : 0;
+}
+
+uint32_t pcm_file_duration_ms(const pcm_file_t *pcm_file) {
+    return pcm_file != NULL ? bytes_to_ms(pcm_file, pcm_file->pcm_size) : 0;
+}
+
+size_t pcm_file_buffered(const pcm_file_t *pcm_file) {
+#ifndef TEST_MODE
+    if (pcm_file != NULL && pcm_file->mp3 != NULL) {
+        return mp3_source_buffered(pcm_file->mp3);
+    }
+#else
+    (void)pcm_file;
+#endif
+    return 0;
+}
+
+void pcm_file_get_read_stats(pcm_read_stats_t *fatfs, pcm_read_stats_t *direct) {
+    if (fatfs != NULL) {
+        *fatfs = fatfs_stats;
+    }
+    if (direct != NULL) {
+        *direct = direct_stats;
+    }
+}
+
+static void log_path_stats(const char *name, const pcm_read_stats_t *stats) {
+    if (stats->bytes == 0 || stats->us == 0) {
+        return;
+    }
+    double mb = stats->bytes / (1024.0 * 1024.0);
+    ESP_LOGI(TAG, "%s reads: %.2f MB/s, %.0f us/MB over %.1f MB", name,
+             mb * 1000000.0 / stats->us, stats->us / mb, mb);
+}
+
+void pcm_file_log_read_stats(void) {
+    log_path_stats("FATFS", &fatfs_stats);
+    log_path_stats("Direct sector", &direct_stats);
+}
+
 esp_err_t pcm_file_close(pcm_file_t *pcm_file) {
     if (pcm_file == NULL || pcm_file->file == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    fclose(pcm_file->file);
-    pcm_file->file = NULL;
+    if (pcm_file->flac != NULL) {
+        flac_decoder_release(pcm_file->flac);
+        pcm_file->flac = NULL;
+    }
+#ifndef TEST_MODE
+    if (pcm_file->mp3 != NULL) {
+        mp3_source_close(pcm_file->mp3);
+        pcm_file->mp3 = NULL;
+    }
+#endif
+    mem_free(pcm_file->frame_index.offsets);
+    memset(&pcm_file->frame_index, 0, sizeof(pcm_file->frame_index));
+    release_file(pcm_file);
     ESP_LOGI(TAG, "PCM file closed");
+    pcm_file_log_read_stats();
     
     return ESP_OK;
 }
 
+// Serve decoded PCM, decoding one block at a time
+static esp_err_t adpcm_read(pcm_file_t *pcm_file, uint8_t *buffer, size_t buffer_size, size_t *bytes_read) {
+    size_t total = 0;
+    while (total < buffer_size) {
+        if (pcm_file->decoded_pos >= pcm_file->decoded_len && adpcm_decode_next(pcm_file) == 0) {
+            if (read_failed(pcm_file)) {
+                ESP_LOGE(TAG, "Error reading ADPCM file");
+                *bytes_read = total;
+                pcm_file->position += total;
+                return ESP_FAIL;
+            }
+            ESP_LOGI(TAG, "End of PCM file reached");
+            break;
+        }
+        size_t chunk = pcm_file->decoded_len - pcm_file->decoded_pos;
+        if (chunk > buffer_size - total) {
+            chunk = buffer_size - total;
+        }
+        memcpy(buffer + total, (const uint8_t *)pcm_file->decoded + pcm_file->decoded_pos, chunk);
+        pcm_file->decoded_pos += chunk;
+        total += chunk;
+    }
+
+    *bytes_read = total;
+    pcm_file->position += total;
+    return ESP_OK;
+}
+
 esp_err_t pcm_file_read(pcm_file_t *pcm_file, void *buffer, size_t buffer_size, size_t *bytes_read) {
     if (pcm_file == NULL || pcm_file->file == NULL || buffer == NULL || bytes_read == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    // Read data from the file
-    *bytes_read = fread(buffer, 1, buffer_size, pcm_file->file);
+    if (pcm_file->codec == PCM_CODEC_IMA_ADPCM) {
+        return adpcm_read(pcm_file, buffer, buffer_size, bytes_read);
+    }
+
+#ifndef TEST_MODE
+    if (pcm_file->codec == PCM_CODEC_MP3) {
+        esp_err_t ret = mp3_source_read(pcm_file->mp3, buffer, buffer_size, bytes_read);
+        pcm_file->position += *bytes_read;
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Error decoding MP3 file");
+        } else if (*bytes_read == 0) {
+            ESP_LOGI(TAG, "End of PCM file reached");
+        }
+        return ret;
+    }
+#endif
+
+    if (pcm_file->codec == PCM_CODEC_FLAC) {
+        esp_err_t ret = flac_decoder_read(pcm_file->flac, buffer, buffer_size, bytes_read);
+        pcm_file->position += *bytes_read;
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Error decoding FLAC file");
+        } else if (*bytes_read == 0) {
+            ESP_LOGI(TAG, "End of PCM file reached");
+        }
+        return ret;
+    }
+
+    // Read data from the file, stopping at the end of the data chunk
+    size_t left = pcm_file->pcm_size > pcm_file->position ? pcm_file->pcm_size - pcm_file->position : 0;
+    if (buffer_size > left) {
+        buffer_size = left;
+    }
+    *bytes_read = read_data(pcm_file, buffer, buffer_size, true);
     
     // Update position
     pcm_file->position += *bytes_read;
     
-    // Check if we've reached the end of file
+    // Check if we've reached the end of file; a short read carries on
     if (*bytes_read < buffer_size) {
-        if (feof(pcm_file->file)) {
-            ESP_LOGI(TAG, "End of PCM file reached");
-        } else {
+        if (read_failed(pcm_file)) {
             ESP_LOGE(TAG, "Error reading PCM file");
             return ESP_FAIL;
+        } else if (*bytes_read == 0 || pcm_file->position >= pcm_file->pcm_size) {
+            ESP_LOGI(TAG, "End of PCM file reached");
         }
     }
     
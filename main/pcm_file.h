@@ -4,6 +4,12 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stddef.h>
+#include <stdbool.h>
+#include "ima_adpcm.h"
+#include "flac_decoder.h"
+#include "mp3_source.h"
+#include "sd_card.h"
+#include "track_cache.h"
 
 #ifndef TEST_MODE
 #include "esp_err.h"
@@ -14,7 +20,19 @@ typedef int esp_err_t;
 #define ESP_ERR_INVALID_ARG -2
 #endif
 
-// PCM file handle - no more custom headers, files are plain PCM
+// Encoding of the audio data in a file
+typedef enum {
+    PCM_CODEC_RAW = 0,      // Plain interleaved little-endian PCM
+    PCM_CODEC_IMA_ADPCM,    // WAV-style IMA ADPCM blocks, decoded to 16-bit PCM
+    PCM_CODEC_FLAC,         // FLAC stream, decoded to 16- or 24-bit PCM
+    PCM_CODEC_MP3           // MPEG Layer III, decoded to 16-bit PCM on the decode core
+} pcm_codec_t;
+
+// Size of the ESP32PCM header described in infos/specs.md
+#define PCM_FILE_HEADER_SIZE    32
+
+// PCM file handle. Files are plain PCM, optionally behind an ESP32PCM or
+// WAV header. Positions and sizes are in decoded PCM bytes, whatever the codec.
 typedef struct {
     FILE *file;
     char filepath[256];
@@ -23,20 +41,95 @@ typedef struct {
     uint16_t bit_depth;     // Bit depth (e.g., 16 bits)
     uint16_t channels;      // Number of channels (e.g., 2 for stereo)
     size_t file_size;       // Total file size in bytes
+    long data_offset;       // Start of the audio data, after any header
+    size_t data_size;       // Size of the audio data in the file
+    bool has_header;        // Format was read from an ESP32PCM or WAV header or a FLAC/MP3 stream
+    size_t pcm_size;        // Total decoded PCM size in bytes
+    pcm_codec_t codec;
+    // Block decoder state for IMA ADPCM
+    uint16_t block_align;
+    size_t decoded_len;     // Bytes of PCM in decoded
+    size_t decoded_pos;     // Next byte to hand out from decoded
+    uint8_t block[IMA_ADPCM_MAX_BLOCK_ALIGN];
+    int16_t decoded[IMA_ADPCM_MAX_BLOCK_ALIGN * 2];
+    // FLAC decoder from the shared pool
+    flac_decoder_t *flac;
+    // MP3 source and its optional frame offset table, copied from the index
+    mp3_source_t *mp3;
+    mp3_frame_index_t frame_index;
+    uint32_t frame_samples; // Samples per channel in an MP3 frame
+    // Raw PCM and ADPCM data of contiguous files is read straight from the card
+    bool direct;
+    uint32_t first_sector;  // Card sector of the first file byte
+    long file_pos;          // File offset of the next data read
+    long fs_pos;            // Offset the FILE handle is at; seeks are applied lazily
+    bool read_error;
+    uint32_t cached_sector; // File sector held in sector_buf, UINT32_MAX if none
+    uint8_t sector_buf[SD_SECTOR_SIZE];
+    // Start of the file prefetched into RAM by the track cache, NULL if none
+    const uint8_t *head;
+    size_t head_len;
 } pcm_file_t;
 
+// Cumulative cost of one read path
+typedef struct {
+    uint64_t bytes;
+    uint64_t us;
+} pcm_read_stats_t;
+
 /**
  * @brief Open a PCM file
  * 
+ * Files starting with an ESP32PCM or RIFF/WAV header take their format and
+ * data range from it (WAV IMA ADPCM also sets the codec). FLAC and MP3
+ * streams, behind an ID3v2 tag or not, get their decoder attached when one
+ * is free; otherwise they open as raw and pcm_file_set_codec() can retry.
+ * The parameters passed in are only used for headerless files. Raw PCM
+ * and ADPCM data of a file stored in a single cluster run is read with
+ * direct sector reads; fragmented files and decoded streams go through the
+ * file system, and only files left to pcm_file_read have their cluster
+ * chain walked. A track prefetched by the
+ * track cache takes over its open handle and serves its first bytes from RAM.
+ * 
  * @param filepath Path to the PCM file
  * @param pcm_file Pointer to store PCM file handle
- * @param sample_rate Sample rate for this file
- * @param bit_depth Bit depth for this file
- * @param channels Number of channels for this file
- * @return ESP_OK on success
+ * @param sample_rate Sample rate for a headerless file
+ * @param bit_depth Bit depth for a headerless file
+ * @param channels Number of channels for a headerless file
+ * @return ESP_OK on success, ESP_FAIL if the file cannot be opened or read,
+ *         ESP_ERR_INVALID_ARG if its header is malformed or its WAV format is unsupported
  */
 esp_err_t pcm_file_open(const char *filepath, pcm_file_t *pcm_file, uint32_t sample_rate, uint16_t bit_depth, uint16_t channels);
 
+/**
+ * @brief Set the codec of an opened file before the first read
+ * 
+ * IMA ADPCM always decodes to 16-bit PCM, so bit_depth becomes 16. FLAC
+ * takes all audio parameters from the stream and decodes to 16 or 24 bits;
+ * it fails when no decoder is free in the pool. MP3 decodes to 16-bit PCM
+ * with the rate and channels of the first frame.
+ * 
+ * @param pcm_file PCM file handle
+ * @param codec Codec of the file data
+ * @param block_align Encoded block size in bytes for block codecs
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the data is not in that
+ *         codec, ESP_ERR_NO_MEM if no decoder is free
+ */
+esp_err_t pcm_file_set_codec(pcm_file_t *pcm_file, pcm_codec_t codec, uint16_t block_align);
+
+/**
+ * @brief Attach a frame offset table for fast MP3 seeks
+ * 
+ * May be called before or after the MP3 decoder is attached, but before
+ * the first seek. The table also gives the decoded size; without it MP3
+ * files report a pcm_size of 0.
+ * 
+ * @param pcm_file PCM file handle
+ * @param frame_index Frame offset table; the file keeps its own copy
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the copy cannot be allocated
+ */
+esp_err_t pcm_file_set_frame_index(pcm_file_t *pcm_file, const mp3_frame_index_t *frame_index);
+
 /**
  * @brief Close a PCM file
  * 
@@ -71,9 +164,58 @@ esp_err_t pcm_file_get_params(pcm_file_t *pcm_file, uint32_t *sample_rate, uint1
  * @brief Seek to a specific byte position in the PCM data
  * 
  * @param pcm_file PCM file handle
- * @param byte_pos Byte position from start of file
+ * @param byte_pos Byte position in the decoded PCM data
  * @return ESP_OK on success
  */
 esp_err_t pcm_file_seek(pcm_file_t *pcm_file, uint32_t byte_pos);
 
+/**
+ * @brief Seek to a time in the decoded audio
+ * 
+ * The position is rounded down to a frame boundary and clamped to the end
+ * of the data when the decoded size is known.
+ * 
+ * @param pcm_file PCM file handle
+ * @param position_ms Position in milliseconds
+ * @return ESP_OK on success
+ */
+esp_err_t pcm_file_seek_ms(pcm_file_t *pcm_file, uint32_t position_ms);
+
+/**
+ * @brief Get the playback position from the format fields
+ * 
+ * @param pcm_file PCM file handle
+ * @return Position in milliseconds, 0 if the format is unknown
+ */
+uint32_t pcm_file_position_ms(const pcm_file_t *pcm_file);
+
+/**
+ * @brief Get the track length from the format fields
+ * 
+ * @param pcm_file PCM file handle
+ * @return Length in milliseconds, 0 if the format or decoded size is unknown
+ */
+uint32_t pcm_file_duration_ms(const pcm_file_t *pcm_file);
+
+/**
+ * @brief Get how much decoded audio is queued ahead of the reader
+ * 
+ * @param pcm_file PCM file handle
+ * @return Bytes in the MP3 decode ring, 0 for codecs decoded in place
+ */
+size_t pcm_file_buffered(const pcm_file_t *pcm_file);
+
+/**
+ * @brief Get the read cost of both read paths since boot
+ * 
+ * @param fatfs Pointer to store the stats of reads through the file system
+ * @param direct Pointer to store the stats of direct sector reads
+ */
+void pcm_file_get_read_stats(pcm_read_stats_t *fatfs, pcm_read_stats_t *direct);
+
+/**
+ * @brief Log throughput and time per MB of both read paths
+ */
+void pcm_file_log_read_stats(void);
+
 #endif // PCM_FILE_H
@@ -0,0 +1,230 @@
+#include "player_console.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_console.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_system.h"
+
+#include "audio_player.h"
+#include "mp3_source.h"
+#include "pcm_file.h"
+#include "sd_fault.h"
+
+static const char *TAG = "console";
+
+// CPU use is measured over this window when `stats` runs
+#define STATS_WINDOW_MS     1000
+#define STATS_MAX_TASKS     24
+
+// Trace events are printed in batches, so UART output never paces the player
+#define TRACE_PERIOD_MS     100
+#define TRACE_BATCH         16
+#define TRACE_TASK_STACK    3072
+
+static TaskHandle_t trace_task_handle = NULL;
+static volatile bool tracing = false;
+
+// Parse a whole decimal argument
+static bool parse_u32(const char *text, uint32_t *value) {
+    char *end;
+    unsigned long v = strtoul(text, &end, 10);
+    if (end == text || *end != '\0') {
+        return false;
+    }
+    *value = (uint32_t)v;
+    return true;
+}
+
+static double mb_per_s(uint64_t bytes, uint64_t us) {
+    return us > 0 ? bytes * 1000000.0 / us / (1024 * 1024) : 0.0;
+}
+
+#if configGENERATE_RUN_TIME_STATS
+// Two snapshots of the task list, STATS_WINDOW_MS apart
+static TaskStatus_t tasks_before[STATS_MAX_TASKS];
+static TaskStatus_t tasks_after[STATS_MAX_TASKS];
+
+static void print_task_stats(void) {
+    configRUN_TIME_COUNTER_TYPE total_before, total_after;
+    UBaseType_t count_before = uxTaskGetSystemState(tasks_before, STATS_MAX_TASKS, &total_before);
+    vTaskDelay(pdMS_TO_TICKS(STATS_WINDOW_MS));
+    UBaseType_t count_after = uxTaskGetSystemState(tasks_after, STATS_MAX_TASKS, &total_after);
+    configRUN_TIME_COUNTER_TYPE elapsed = total_after - total_before;
+
+    printf("%-16s %4s %9s %11s\n", "Task", "Prio", "CPU/core", "Stack free");
+    for (UBaseType_t i = 0; i < count_after; i++) {
+        const TaskStatus_t *task = &tasks_after[i];
+        configRUN_TIME_COUNTER_TYPE ran = task->ulRunTimeCounter;
+        for (UBaseType_t j = 0; j < count_before; j++) {
+            if (tasks_before[j].xHandle == task->xHandle) {
+                ran -= tasks_before[j].ulRunTimeCounter;
+                break;
+            }
+        }
+        printf("%-16s %4u %8.1f%% %9u B\n", task->pcTaskName, (unsigned)task->uxCurrentPriority,
+               elapsed > 0 ? ran * 100.0 / elapsed : 0.0, (unsigned)task->usStackHighWaterMark);
+    }
+}
+#else
+static void print_task_stats(void) {
+    printf("Per-task CPU needs CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS\n");
+}
+#endif
+
+static int cmd_stats(int argc, char **argv) {
+    audio_player_stats_t player;
+    audio_player_get_stats(&player);
+    pcm_read_stats_t fatfs, direct;
+    pcm_file_get_read_stats(&fatfs, &direct);
+
+    printf("SD: %.2f MB/s now; since boot %.2f MB/s FATFS, %.2f MB/s direct\n",
+           player.sd_read_bps / (1024.0 * 1024.0), mb_per_s(fatfs.bytes, fatfs.us), mb_per_s(direct.bytes, direct.us));
+    printf("Reads: %u of %u bytes, slowest %u us since the last stats\n",
+           (unsigned)player.reads, (unsigned)player.read_size, (unsigned)player.read_worst_us);
+    printf("Underruns: %u, MP3 ring %u of %u KB, I2S DMA %u x %u frames\n", (unsigned)player.underruns,
+           (unsigned)(player.ring_fill / 1024), (unsigned)(mp3_source_ring_size() / 1024),
+           (unsigned)player.dma_desc_num, (unsigned)player.dma_frame_num);
+    printf("Card: %u removals, %d tracks quarantined\n", (unsigned)player.card_removals, player.quarantined);
+    if (sd_fault_enabled()) {
+        sd_fault_stats_t faults;
+        sd_fault_get_stats(&faults);
+        printf("Card faults: %u stalls, %u short reads, %u errors, worst %u us\n", (unsigned)faults.stalls,
+               (unsigned)faults.short_reads, (unsigned)faults.errors, (unsigned)faults.worst_us);
+    }
+    printf("Heap: %u free, %u minimum free, %u largest block\n", (unsigned)esp_get_free_heap_size(),
+           (unsigned)esp_get_minimum_free_heap_size(), (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    print_task_stats();
+    return 0;
+}
+
+// Print trace events while tracing, sleep on a notification otherwise
+static void trace_task(void *arg) {
+    audio_player_trace_t events[TRACE_BATCH];
+    uint32_t dropped;
+    while (1) {
+        if (!tracing) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        size_t count;
+        while ((count = audio_player_take_trace(events, TRACE_BATCH, &dropped)) > 0 || dropped > 0) {
+            if (dropped > 0) {
+                printf("T %u events dropped\n", (unsigned)dropped);
+            }
+            for (size_t i = 0; i < count; i++) {
+                printf("T %u ms: read %u B in %u us, ring %u B, underruns %u\n", (unsigned)events[i].time_ms,
+                       (unsigned)events[i].bytes, (unsigned)events[i].read_us, (unsigned)events[i].ring_fill,
+                       (unsigned)events[i].underruns);
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(TRACE_PERIOD_MS));
+    }
+}
+
+static int cmd_trace(int argc, char **argv) {
+    if (argc != 2 || (strcmp(argv[1], "on") != 0 && strcmp(argv[1], "off") != 0)) {
+        printf("Usage: trace on|off\n");
+        return 1;
+    }
+    tracing = strcmp(argv[1], "on") == 0;
+    audio_player_set_trace(tracing);
+    if (tracing) {
+        xTaskNotifyGive(trace_task_handle);
+    }
+    return 0;
+}
+
+static int cmd_set(int argc, char **argv) {
+    uint32_t value, frames;
+    esp_err_t ret;
+    if (argc == 4 && strcmp(argv[1], "bufsize") == 0 && parse_u32(argv[2], &value) && parse_u32(argv[3], &frames)) {
+        ret = audio_player_set_dma_buffers(value, frames);
+        if (ret == ESP_ERR_INVALID_ARG) {
+            printf("Buffers %d-%d, frames %d-%d\n", AUDIO_PLAYER_DMA_DESC_MIN, AUDIO_PLAYER_DMA_DESC_MAX,
+                   AUDIO_PLAYER_DMA_FRAME_MIN, AUDIO_PLAYER_DMA_FRAME_MAX);
+        }
+    } else if (argc == 3 && strcmp(argv[1], "readsize") == 0 && parse_u32(argv[2], &value)) {
+        ret = audio_player_set_read_size(value);
+        if (ret == ESP_ERR_INVALID_ARG) {
+            printf("Read size: multiple of 512 from %d to %d\n", AUDIO_PLAYER_READ_SIZE_MIN, AUDIO_PLAYER_READ_SIZE_MAX);
+        }
+    } else {
+        printf("Usage: set bufsize <buffers> <frames> | set readsize <bytes>\n");
+        return 1;
+    }
+    return ret == ESP_OK ? 0 : 1;
+}
+
+static int cmd_play(int argc, char **argv) {
+    uint32_t index;
+    if (argc != 2 || !parse_u32(argv[1], &index)) {
+        printf("Usage: play <id>\n");
+        return 1;
+    }
+    esp_err_t ret = audio_player_play_index((int)index);
+    if (ret == ESP_OK) {
+        ret = audio_player_start();
+    }
+    if (ret != ESP_OK) {
+        printf("Cannot play track %u: %s\n", (unsigned)index, esp_err_to_name(ret));
+        return 1;
+    }
+    return 0;
+}
+
+static int cmd_seek(int argc, char **argv) {
+    uint32_t position_ms;
+    if (argc != 2 || !parse_u32(argv[1], &position_ms)) {
+        printf("Usage: seek <ms>\n");
+        return 1;
+    }
+    esp_err_t ret = audio_player_seek_ms(position_ms);
+    if (ret != ESP_OK) {
+        printf("Seek failed: %s\n", esp_err_to_name(ret));
+        return 1;
+    }
+    return 0;
+}
+
+static const esp_console_cmd_t commands[] = {
+    { .command = "stats", .help = "SD throughput, underruns, ring fill, card removals, heap, CPU and stack per task",
+      .func = cmd_stats },
+    { .command = "trace", .help = "Print every track read: trace on|off", .func = cmd_trace },
+    { .command = "set", .help = "Tune the player: set bufsize <buffers> <frames> | set readsize <bytes>",
+      .func = cmd_set },
+    { .command = "play", .help = "Play a track by its index position: play <id>", .func = cmd_play },
+    { .command = "seek", .help = "Seek the current track: seek <ms>", .func = cmd_seek },
+};
+
+esp_err_t player_console_init(void) {
+    if (xTaskCreate(trace_task, "trace_task", TRACE_TASK_STACK, NULL, PLAYER_CONSOLE_PRIORITY,
+                    &trace_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create trace task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = "player>";
+    repl_config.task_priority = PLAYER_CONSOLE_PRIORITY;
+    esp_console_dev_uart_config_t uart_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    esp_err_t ret = esp_console_new_repl_uart(&uart_config, &repl_config, &repl);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create the console: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    esp_console_register_help_command();
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        ret = esp_console_cmd_register(&commands[i]);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    return esp_console_start_repl(repl);
+}
@@ -0,0 +1,20 @@
+#ifndef PLAYER_CONSOLE_H
+#define PLAYER_CONSOLE_H
+
+#include "esp_err.h"
+
+// The REPL and the trace printer run just above idle, below every audio task
+#define PLAYER_CONSOLE_PRIORITY     1
+
+/**
+ * @brief Start the serial console on the console UART
+ *
+ * Commands: stats, trace on|off, set bufsize <buffers> <frames>,
+ * set readsize <bytes>, play <id>, seek <ms> and help. Tuning applies to
+ * the running player without a reboot.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t player_console_init(void);
+
+#endif // PLAYER_CONSOLE_H
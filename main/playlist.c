@@ -0,0 +1,230 @@
+#include "playlist.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+
+#ifndef TEST_MODE
+#include "esp_log.h"
+#else
+#define ESP_LOGI(tag, format, ...) printf("[INFO] " format "\n", ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) printf("[WARN] " format "\n", ##__VA_ARGS__)
+#endif
+
+static const char *TAG = "playlist";
+
+// Absolute lines are cut after this directory, so card-root paths resolve too
+#define MUSIC_DIR_MARKER    "ESP32_MUSIC/"
+
+// Length of the name without a .m3u or .m3u8 extension, 0 for other files
+static size_t playlist_name_len(const char *file_name) {
+    const char *dot = strrchr(file_name, '.');
+    if (dot == NULL || dot == file_name || file_name[0] == '.') {
+        return 0;
+    }
+    if (strcasecmp(dot, ".m3u") != 0 && strcasecmp(dot, ".m3u8") != 0) {
+        return 0;
+    }
+    return dot - file_name;
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(((const playlist_t *)a)->name, ((const playlist_t *)b)->name);
+}
+
+// Drop the line break, trailing blanks and a UTF-8 byte order mark
+static char *trim_line(char *line) {
+    if ((uint8_t)line[0] == 0xEF && (uint8_t)line[1] == 0xBB && (uint8_t)line[2] == 0xBF) {
+        line += 3;
+    }
+    while (*line == ' ' || *line == '\t') {
+        line++;
+    }
+    size_t len = strlen(line);
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' || line[len - 1] == ' ' || line[len - 1] == '\t')) {
+        line[--len] = '\0';
+    }
+    return line;
+}
+
+bool playlist_resolve_path(const char *line, char *rel_path, size_t max_len) {
+    char slashed[PLAYLIST_LINE_MAX];
+    char joined[PLAYLIST_LINE_MAX + sizeof(PLAYLIST_DIR) + 1];
+    if (line[0] == '\0' || line[0] == '#' || strstr(line, "://") != NULL || max_len == 0) {
+        return false;
+    }
+    snprintf(slashed, sizeof(slashed), "%s", line);
+    for (char *c = slashed; *c != '\0'; c++) {
+        if (*c == '\\') {
+            *c = '/';
+        }
+    }
+    if (slashed[0] == '/') {
+        const char *marker = strstr(slashed, MUSIC_DIR_MARKER);
+        snprintf(joined, sizeof(joined), "%s", marker != NULL ? marker + strlen(MUSIC_DIR_MARKER) : slashed + 1);
+    } else {
+        snprintf(joined, sizeof(joined), "%s/%s", PLAYLIST_DIR, slashed);
+    }
+
+    // Fold "." and ".." components; climbing out of the music root fails
+    size_t len = 0;
+    char *save;
+    for (char *part = strtok_r(joined, "/", &save); part != NULL; part = strtok_r(NULL, "/", &save)) {
+        if (strcmp(part, ".") == 0) {
+            continue;
+        }
+        if (strcmp(part, "..") == 0) {
+            if (len == 0) {
+                return false;
+            }
+            while (len > 0 && rel_path[len - 1] != '/') {
+                len--;
+            }
+            if (len > 0) {
+                len--;
+            }
+            continue;
+        }
+        size_t part_len = strlen(part);
+        if (len + (len > 0) + part_len + 1 > max_len) {
+            return false;
+        }
+        if (len > 0) {
+            rel_path[len++] = '/';
+        }
+        memcpy(rel_path + len, part, part_len);
+        len += part_len;
+    }
+    rel_path[len] = '\0';
+    return len > 0;
+}
+
+// Resolve the lines of one playlist into its track array
+static esp_err_t load_playlist(const char *path, index_file_t *index, playlist_set_t *set, playlist_t *list) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        ESP_LOGW(TAG, "Cannot open %s", path);
+        return ESP_FAIL;
+    }
+
+    // Lines that may name a track bound the array; unresolved ones leave it partly unused
+    char line[PLAYLIST_LINE_MAX];
+    int lines = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *text = trim_line(line);
+        lines += text[0] != '\0' && text[0] != '#';
+    }
+    list->tracks = lines > 0 ? mem_arena_alloc(&set->arena, lines * sizeof(uint32_t)) : NULL;
+    if (lines > 0 && list->tracks == NULL) {
+        fclose(file);
+        return ESP_ERR_NO_MEM;
+    }
+
+    rewind(file);
+    int missing = 0;
+    char rel_path[256];
+    while (list->track_count < lines && fgets(line, sizeof(line), file) != NULL) {
+        char *text = trim_line(line);
+        if (text[0] == '\0' || text[0] == '#') {
+            continue;
+        }
+        int position = playlist_resolve_path(text, rel_path, sizeof(rel_path)) ? json_index_find(index, rel_path) : -1;
+        if (position < 0) {
+            missing++;
+            continue;
+        }
+        list->tracks[list->track_count++] = (uint32_t)position;
+    }
+    fclose(file);
+    if (missing > 0) {
+        ESP_LOGW(TAG, "%s: %d entries not in the index", list->name, missing);
+    }
+    return ESP_OK;
+}
+
+esp_err_t playlist_load_dir(const char *dir_path, index_file_t *index, playlist_set_t *set) {
+    if (dir_path == NULL || index == NULL || set == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(set, 0, sizeof(*set));
+    mem_arena_init(&set->arena, MEM_BULK, PLAYLIST_ARENA_CHUNK);
+    DIR *dir = opendir(dir_path);
+    if (dir == NULL) {
+        return ESP_OK;
+    }
+
+    // Names first, so the table is sized once and sorted before any file is read
+    int found = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        found += playlist_name_len(de->d_name) > 0;
+    }
+    if (found > PLAYLIST_MAX) {
+        ESP_LOGW(TAG, "%d playlists, reading the first %d", found, PLAYLIST_MAX);
+        found = PLAYLIST_MAX;
+    }
+    set->lists = found > 0 ? mem_arena_calloc(&set->arena, found, sizeof(playlist_t)) : NULL;
+    if (found > 0 && set->lists == NULL) {
+        closedir(dir);
+        return ESP_ERR_NO_MEM;
+    }
+    // Names keep their extension until the file is read
+    rewinddir(dir);
+    int named = 0;
+    while (named < found && (de = readdir(dir)) != NULL) {
+        if (playlist_name_len(de->d_name) == 0) {
+            continue;
+        }
+        if (strlen(de->d_name) >= PLAYLIST_NAME_MAX) {
+            ESP_LOGW(TAG, "Playlist name too long: %s", de->d_name);
+            continue;
+        }
+        strcpy(set->lists[named++].name, de->d_name);
+    }
+    closedir(dir);
+    qsort(set->lists, named, sizeof(playlist_t), compare_names);
+
+    esp_err_t ret = ESP_OK;
+    char path[512];
+    for (int i = 0; i < named && ret != ESP_ERR_NO_MEM; i++) {
+        playlist_t *list = &set->lists[set->count];
+        if (list != &set->lists[i]) {
+            *list = set->lists[i];
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir_path, list->name);
+        list->name[playlist_name_len(list->name)] = '\0';
+        list->tracks = NULL;
+        list->track_count = 0;
+        ret = load_playlist(path, index, set, list);
+        if (ret == ESP_OK && list->track_count > 0) {
+            set->count++;
+        }
+    }
+    if (ret == ESP_ERR_NO_MEM) {
+        ESP_LOGW(TAG, "Out of memory after %d playlists", set->count);
+        return ret;
+    }
+    ESP_LOGI(TAG, "%d playlists in %u bytes", set->count, (unsigned)set->arena.used);
+    return ESP_OK;
+}
+
+void playlist_free(playlist_set_t *set) {
+    mem_arena_release(&set->arena);
+    set->lists = NULL;
+    set->count = 0;
+}
+
+int playlist_size(const playlist_set_t *set, int list) {
+    if (list < 0 || list >= set->count) {
+        return 0;
+    }
+    return set->lists[list].track_count;
+}
+
+int playlist_track(const playlist_set_t *set, int list, int slot) {
+    if (slot < 0 || slot >= playlist_size(set, list)) {
+        return -1;
+    }
+    return (int)set->lists[list].tracks[slot];
+}
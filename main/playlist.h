@@ -0,0 +1,85 @@
+#ifndef PLAYLIST_H
+#define PLAYLIST_H
+
+#include <stdint.h>
+#include "json_parser.h"
+#include "mem_policy.h"
+
+// Directory under the music root holding the .m3u files
+#define PLAYLIST_DIR            "playlists"
+
+// Playlists read from the directory, and the name length kept per playlist
+#define PLAYLIST_MAX            64
+#define PLAYLIST_NAME_MAX       64
+
+// Longest playlist line read
+#define PLAYLIST_LINE_MAX       512
+
+// Chunks the playlist arena grows by
+#define PLAYLIST_ARENA_CHUNK    (2 * 1024)
+
+// A playlist resolved against the index: only allFiles positions are kept
+typedef struct {
+    char name[PLAYLIST_NAME_MAX];   // File name without the extension
+    uint32_t *tracks;               // allFiles positions in playlist order
+    int track_count;
+} playlist_t;
+
+// Every playlist of the card, ordered by file name
+typedef struct {
+    playlist_t *lists;
+    int count;
+    mem_arena_t arena;              // Holds lists and every track array
+} playlist_set_t;
+
+/**
+ * @brief Read the .m3u and .m3u8 files of a directory
+ *
+ * Each line that is not blank or a #comment names a track: relative to the
+ * playlist directory, or absolute from the card root or the music root.
+ * Backslashes count as slashes. Lines are resolved once through
+ * json_index_find(); those that match no track are dropped. Playlists without
+ * a playable line are left out.
+ *
+ * @param dir Full path of the playlist directory
+ * @param index Index the tracks are looked up in
+ * @param set Set to fill, zeroed or freed before; empty if the directory is missing
+ * @return ESP_OK on success, also without a directory; ESP_ERR_NO_MEM if the set does not fit
+ */
+esp_err_t playlist_load_dir(const char *dir, index_file_t *index, playlist_set_t *set);
+
+/**
+ * @brief Free a set of playlists
+ */
+void playlist_free(playlist_set_t *set);
+
+/**
+ * @brief Number of tracks in a playlist
+ *
+ * @param set Playlists
+ * @param list Playlist number
+ * @return Track count, 0 if list is out of range
+ */
+int playlist_size(const playlist_set_t *set, int list);
+
+/**
+ * @brief Track at a position of a playlist
+ *
+ * @param set Playlists
+ * @param list Playlist number
+ * @param slot Position in the playlist
+ * @return allFiles position, -1 if out of range
+ */
+int playlist_track(const playlist_set_t *set, int list, int slot);
+
+/**
+ * @brief Turn a playlist line into a path relative to the music root
+ *
+ * @param line Line as written in the playlist, without the line break
+ * @param rel_path Buffer for the path
+ * @param max_len Size of rel_path
+ * @return true if the line names a path inside the music root
+ */
+bool playlist_resolve_path(const char *line, char *rel_path, size_t max_len);
+
+#endif // PLAYLIST_H
@@ -0,0 +1,60 @@
+#include "quarantine.h"
+#include "mem_policy.h"
+#include <string.h>
+
+#define WORD_BITS   32
+
+static int words_for(int count) {
+    return (count + WORD_BITS - 1) / WORD_BITS;
+}
+
+static bool in_range(const quarantine_t *quarantine, int track) {
+    return quarantine->bits != NULL && track >= 0 && track < quarantine->count;
+}
+
+bool quarantine_init(quarantine_t *quarantine, int count) {
+    quarantine_free(quarantine);
+    if (count <= 0) {
+        return true;
+    }
+    quarantine->bits = mem_calloc(MEM_BULK, words_for(count), sizeof(uint32_t));
+    if (quarantine->bits == NULL) {
+        return false;
+    }
+    quarantine->count = count;
+    return true;
+}
+
+void quarantine_free(quarantine_t *quarantine) {
+    mem_free(quarantine->bits);
+    quarantine->bits = NULL;
+    quarantine->count = 0;
+    quarantine->quarantined = 0;
+}
+
+bool quarantine_add(quarantine_t *quarantine, int track) {
+    if (!in_range(quarantine, track) || quarantine_contains(quarantine, track)) {
+        return false;
+    }
+    quarantine->bits[track / WORD_BITS] |= 1U << (track % WORD_BITS);
+    quarantine->quarantined++;
+    return true;
+}
+
+void quarantine_remove(quarantine_t *quarantine, int track) {
+    if (quarantine_contains(quarantine, track)) {
+        quarantine->bits[track / WORD_BITS] &= ~(1U << (track % WORD_BITS));
+        quarantine->quarantined--;
+    }
+}
+
+bool quarantine_contains(const quarantine_t *quarantine, int track) {
+    return in_range(quarantine, track) && (quarantine->bits[track / WORD_BITS] >> (track % WORD_BITS)) & 1;
+}
+
+void quarantine_clear(quarantine_t *quarantine) {
+    if (quarantine->bits != NULL) {
+        memset(quarantine->bits, 0, words_for(quarantine->count) * sizeof(uint32_t));
+    }
+    quarantine->quarantined = 0;
+}
@@ -0,0 +1,61 @@
+#ifndef QUARANTINE_H
+#define QUARANTINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Tracks that failed to open, one bit per allFiles position
+typedef struct {
+    uint32_t *bits;
+    int count;                          // Positions covered
+    int quarantined;                    // Bits set
+} quarantine_t;
+
+/**
+ * @brief Cover count tracks with nothing quarantined
+ *
+ * Frees the previous bitmap; count / 8 bytes come from bulk memory.
+ *
+ * @param quarantine Quarantine, zeroed before its first use
+ * @param count Number of tracks, 0 for none
+ * @return false if the bitmap could not be allocated; nothing is quarantined then
+ */
+bool quarantine_init(quarantine_t *quarantine, int count);
+
+/**
+ * @brief Free the bitmap
+ */
+void quarantine_free(quarantine_t *quarantine);
+
+/**
+ * @brief Quarantine a track
+ *
+ * @param quarantine Quarantine
+ * @param track allFiles position; out of range is ignored
+ * @return true if the track was not quarantined before
+ */
+bool quarantine_add(quarantine_t *quarantine, int track);
+
+/**
+ * @brief Give a track another chance
+ *
+ * @param quarantine Quarantine
+ * @param track allFiles position; out of range is ignored
+ */
+void quarantine_remove(quarantine_t *quarantine, int track);
+
+/**
+ * @brief Check a track in constant time
+ *
+ * @param quarantine Quarantine
+ * @param track allFiles position
+ * @return true if quarantined; out of range is never quarantined
+ */
+bool quarantine_contains(const quarantine_t *quarantine, int track);
+
+/**
+ * @brief Release every track
+ */
+void quarantine_clear(quarantine_t *quarantine);
+
+#endif // QUARANTINE_H
@@ -1,5 +1,7 @@
 #include "sd_card.h"
+#include "sd_fault.h"
 #include <string.h>
+#include <stdlib.h>
 #include <sys/unistd.h>
 #include <sys/stat.h>
 #include <dirent.h>
@@ -9,31 +11,81 @@
 #include "driver/spi_common.h"
 #include "sdmmc_cmd.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "ff.h"
+#include "diskio_sdmmc.h"
+#include "driver/gpio.h"
 
 // SD Card pins
 #define SD_MISO_PIN 19
 #define SD_MOSI_PIN 23
 #define SD_SCK_PIN  18
 #define SD_CS_PIN   5
+// Card-detect switch of the slot, -1 when not wired; without it a removed card
+// is noticed by failing I/O. Most slots pull the pin low with a card inserted.
+#define SD_CD_PIN           -1
+#define SD_CD_ACTIVE_LEVEL  0
 
 #define MOUNT_POINT "/sdcard"
-#define MAX_FILES 5
+// Files open at once at worst: playing and fading tracks (2), the track cache
+// slots (3), the state file (1), the library scanner's old and new manifests
+// and the track it reads (3), index.json for the cache key, a page or a parse
+// next to the handle of the index being replaced (2), and a playlist (1).
+// The FAT VFS reserves a FIL, sector buffer included, for each.
+#define MAX_FILES 12
+
+// Seeks per open mode in sd_card_benchmark_seek
+#define SEEK_BENCH_POINTS 8
+
+// The volume lock API changed in FatFs R0.15
+#if FF_DEFINED == 86604 || FF_DEFINED == 86606 || FF_DEFINED == 86631
+#define FAT_LOCK_VOLUME(fs)     ff_req_grant((fs)->sobj)
+#define FAT_UNLOCK_VOLUME(fs)   ff_rel_grant((fs)->sobj)
+#else
+#define FAT_LOCK_VOLUME(fs)     ff_mutex_take((fs)->ldrv)
+#define FAT_UNLOCK_VOLUME(fs)   ff_mutex_give((fs)->ldrv)
+#endif
 
 static const char *TAG = "sd_card";
 static bool is_mounted = false;
+static bool bus_ready = false;
 static sdmmc_card_t *card;
+static BYTE fat_drive = 0xFF;   // FatFs drive number of the card
+static FATFS *fat_fs = NULL;    // Volume of the card, known after the first layout query
 static sdmmc_host_t host = SDSPI_HOST_DEFAULT();
 
-esp_err_t sd_card_init(void) {
-    ESP_LOGI(TAG, "Initializing SD card");
-
-    esp_err_t ret;
+// Mount the card on the already initialized bus
+static esp_err_t mount_card(void) {
     esp_vfs_fat_sdmmc_mount_config_t mount_config = {
         .format_if_mount_failed = false,
         .max_files = MAX_FILES,
         .allocation_unit_size = 16 * 1024
     };
 
+    sdspi_device_config_t slot_config = SDSPI_DEVICE_CONFIG_DEFAULT();
+    slot_config.gpio_cs = SD_CS_PIN;
+    slot_config.gpio_cd = SD_CD_PIN;
+    slot_config.host_id = host.slot;
+
+    esp_err_t ret = esp_vfs_fat_sdspi_mount(MOUNT_POINT, &host, &slot_config, &mount_config, &card);
+    if (ret != ESP_OK) {
+        if (ret == ESP_FAIL) {
+            ESP_LOGE(TAG, "Failed to mount filesystem. "
+                "If you want the card to be formatted, set format_if_mount_failed = true.");
+        } else {
+            ESP_LOGE(TAG, "Failed to initialize SD card. Error: %s", esp_err_to_name(ret));
+        }
+        return ret;
+    }
+
+    is_mounted = true;
+    fat_drive = ff_diskio_get_pdrv_card(card);
+    return ESP_OK;
+}
+
+esp_err_t sd_card_init(void) {
+    ESP_LOGI(TAG, "Initializing SD card");
+
     spi_bus_config_t bus_cfg = {
         .mosi_io_num = SD_MOSI_PIN,
         .miso_io_num = SD_MISO_PIN,
@@ -43,32 +95,87 @@ esp_err_t sd_card_init(void) {
         .max_transfer_sz = 4000,
     };
 
-    ret = spi_bus_initialize(host.slot, &bus_cfg, SDSPI_DEFAULT_DMA);
+    esp_err_t ret = spi_bus_initialize(host.slot, &bus_cfg, SDSPI_DEFAULT_DMA);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize SPI bus. Error: %s", esp_err_to_name(ret));
         return ret;
     }
+    bus_ready = true;
 
-    sdspi_device_config_t slot_config = SDSPI_DEVICE_CONFIG_DEFAULT();
-    slot_config.gpio_cs = SD_CS_PIN;
-    slot_config.host_id = host.slot;
+    // The driver only watches the switch while the card is mounted; keep it readable in between
+#if SD_CD_PIN >= 0
+    gpio_config_t cd_config = {
+        .pin_bit_mask = 1ULL << SD_CD_PIN,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+    };
+    gpio_config(&cd_config);
+#endif
 
-    ret = esp_vfs_fat_sdspi_mount(MOUNT_POINT, &host, &slot_config, &mount_config, &card);
+    ret = mount_card();
     if (ret != ESP_OK) {
-        if (ret == ESP_FAIL) {
-            ESP_LOGE(TAG, "Failed to mount filesystem. "
-                "If you want the card to be formatted, set format_if_mount_failed = true.");
-        } else {
-            ESP_LOGE(TAG, "Failed to initialize SD card. Error: %s", esp_err_to_name(ret));
-        }
         return ret;
     }
-
-    is_mounted = true;
     ESP_LOGI(TAG, "SD card initialized successfully");
     return ESP_OK;
 }
 
+bool sd_card_has_detect(void) {
+    return SD_CD_PIN >= 0;
+}
+
+bool sd_card_present(void) {
+#if SD_CD_PIN >= 0
+    return gpio_get_level(SD_CD_PIN) == SD_CD_ACTIVE_LEVEL;
+#else
+    if (!is_mounted) {
+        return false;
+    }
+    // CMD13; a pulled card does not answer. Holds the volume lock when it is known,
+    // so the status request does not cut into a transfer.
+    if (fat_fs != NULL && !FAT_LOCK_VOLUME(fat_fs)) {
+        return true;
+    }
+    esp_err_t ret = sdmmc_get_status(card);
+    if (fat_fs != NULL) {
+        FAT_UNLOCK_VOLUME(fat_fs);
+    }
+    return ret == ESP_OK;
+#endif
+}
+
+void sd_card_unmount(void) {
+    if (!is_mounted) {
+        return;
+    }
+    esp_err_t ret = esp_vfs_fat_sdcard_unmount(MOUNT_POINT, card);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Unmount failed: %s", esp_err_to_name(ret));
+    }
+    is_mounted = false;
+    card = NULL;
+    fat_drive = 0xFF;
+    fat_fs = NULL;
+    ESP_LOGI(TAG, "SD card unmounted");
+}
+
+esp_err_t sd_card_remount(void) {
+    if (!bus_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (is_mounted) {
+        return ESP_OK;
+    }
+    if (sd_card_has_detect() && !sd_card_present()) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_err_t ret = mount_card();
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "SD card mounted again");
+    }
+    return ret;
+}
+
 bool sd_card_is_mounted(void) {
     return is_mounted;
 }
@@ -87,6 +194,10 @@ esp_err_t sd_card_write_file(const char *filepath, const void *data, size_t len)
     snprintf(full_path, sizeof(full_path), "%s%s", MOUNT_POINT, filepath);
 
     ESP_LOGI(TAG, "Writing file: %s", full_path);
+    if (sd_fault_inject(SD_FAULT_WRITE, &len, false) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write file (injected)");
+        return ESP_FAIL;
+    }
     FILE *file = fopen(full_path, "wb");
     if (!file) {
         ESP_LOGE(TAG, "Failed to open file for writing");
@@ -113,6 +224,10 @@ esp_err_t sd_card_read_file(const char *filepath, void *data, size_t max_len, si
     snprintf(full_path, sizeof(full_path), "%s%s", MOUNT_POINT, filepath);
 
     ESP_LOGI(TAG, "Reading file: %s", full_path);
+    if (sd_fault_inject(SD_FAULT_READ, &max_len, true) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read file (injected)");
+        return ESP_FAIL;
+    }
     FILE *file = fopen(full_path, "rb");
     if (!file) {
         ESP_LOGE(TAG, "Failed to open file for reading");
@@ -175,3 +290,119 @@ esp_err_t sd_card_list_dir(const char *dir_path) {
 }
 
 // sd_card_resolve_path has been removed as we're using long filenames with FATFS
+
+// Translate a VFS path under the mount point to a FatFs path on the card's drive
+static esp_err_t to_fat_path(const char *path, char *fat_path, size_t max_len) {
+    size_t mount_len = strlen(MOUNT_POINT);
+    if (fat_drive == 0xFF || strncmp(path, MOUNT_POINT, mount_len) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    snprintf(fat_path, max_len, "%u:%s", fat_drive, path + mount_len);
+    return ESP_OK;
+}
+
+esp_err_t sd_card_get_file_layout(const char *path, sd_file_layout_t *layout) {
+    if (!is_mounted) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (path == NULL || layout == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char fat_path[256];
+    esp_err_t ret = to_fat_path(path, fat_path, sizeof(fat_path));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // FIL carries a sector buffer, too big for the caller's stack
+    FIL *fil = malloc(sizeof(FIL));
+    if (fil == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (f_open(fil, fat_path, FA_READ) != FR_OK) {
+        free(fil);
+        return ESP_FAIL;
+    }
+
+    // A one-fragment table: FatFs still walks the whole chain and reports the size it needs
+    DWORD table[4] = {4};
+    fil->cltbl = table;
+    FRESULT res = f_lseek(fil, CREATE_LINKMAP);
+    fil->cltbl = NULL;
+    FATFS *fs = fil->obj.fs;
+    f_close(fil);
+    free(fil);
+    if (res != FR_OK && res != FR_NOT_ENOUGH_CORE) {
+        return ESP_FAIL;
+    }
+
+    layout->fragments = (table[0] - 2) / 2;
+    layout->clusters = 0;
+    layout->first_sector = 0;
+    if (layout->fragments == 1) {
+        layout->clusters = table[1];
+        layout->first_sector = (uint32_t)(fs->database + (LBA_t)(table[2] - 2) * fs->csize);
+    }
+#if FF_MAX_SS != FF_MIN_SS
+    // Sector numbers only map 1:1 to card sectors with 512-byte FatFs sectors
+    if (fs->ssize != SD_SECTOR_SIZE) {
+        layout->clusters = 0;
+        layout->first_sector = 0;
+    }
+#endif
+    fat_fs = fs;
+    return ESP_OK;
+}
+
+// Average time of a seek plus a one-sector read, seeking from the end towards the start
+static int64_t bench_seeks(const char *path, const char *mode, long size) {
+    FILE *file = fopen(path, mode);
+    if (file == NULL) {
+        return -1;
+    }
+    char sector[512];
+    int64_t total = 0;
+    for (int i = SEEK_BENCH_POINTS; i > 0; i--) {
+        long pos = (size / SEEK_BENCH_POINTS * i - (long)sizeof(sector)) & ~(long)(sizeof(sector) - 1);
+        int64_t start = esp_timer_get_time();
+        fseek(file, pos < 0 ? 0 : pos, SEEK_SET);
+        fread(sector, 1, sizeof(sector), file);
+        total += esp_timer_get_time() - start;
+    }
+    fclose(file);
+    return total / SEEK_BENCH_POINTS;
+}
+
+esp_err_t sd_card_benchmark_seek(const char *path) {
+    struct stat st;
+    sd_file_layout_t layout;
+    if (path == NULL || stat(path, &st) != 0 || sd_card_get_file_layout(path, &layout) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot benchmark seeks on %s", path ? path : "(null)");
+        return ESP_FAIL;
+    }
+
+    int64_t chain_us = bench_seeks(path, "r+b", st.st_size);
+    int64_t fast_us = bench_seeks(path, "rb", st.st_size);
+    ESP_LOGI(TAG, "Seek benchmark %s: %ld KB, %u fragments", path, (long)(st.st_size / 1024), layout.fragments);
+    ESP_LOGI(TAG, "  chain walk: %lld us per seek, fast seek: %lld us per seek", chain_us, fast_us);
+    if (layout.fragments > (CONFIG_FATFS_FAST_SEEK_BUFFER_SIZE - 2) / 2) {
+        ESP_LOGW(TAG, "  file has more fragments than the fast-seek map holds");
+    }
+    return ESP_OK;
+}
+
+esp_err_t sd_card_read_sectors(void *buffer, uint32_t sector, uint32_t count) {
+    if (!is_mounted || fat_fs == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!FAT_LOCK_VOLUME(fat_fs)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    esp_err_t ret = sdmmc_read_sectors(card, buffer, sector, count);
+    FAT_UNLOCK_VOLUME(fat_fs);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read %u sectors at %u: %s", (unsigned)count, (unsigned)sector, esp_err_to_name(ret));
+    }
+    return ret;
+}
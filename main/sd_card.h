@@ -2,6 +2,8 @@
 #define SD_CARD_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
 
 #ifdef TEST_MODE
 typedef int esp_err_t;
@@ -29,6 +31,40 @@ esp_err_t sd_card_init(void);
  */
 bool sd_card_is_mounted(void);
 
+/**
+ * @brief Check whether the slot has a card-detect switch wired
+ * 
+ * @return true if SD_CD_PIN is set
+ */
+bool sd_card_has_detect(void);
+
+/**
+ * @brief Check whether the card is still there
+ * 
+ * Reads the card-detect switch when one is wired. Otherwise asks a mounted
+ * card for its status, so it only answers false for a card that was pulled
+ * or stopped responding, and for an unmounted card.
+ * 
+ * @return true if a card is present
+ */
+bool sd_card_present(void);
+
+/**
+ * @brief Unmount the card after it was removed
+ * 
+ * Files still open on it must not be used any more. The SPI bus stays up
+ * for sd_card_remount().
+ */
+void sd_card_unmount(void);
+
+/**
+ * @brief Mount a card inserted after sd_card_unmount()
+ * 
+ * @return ESP_OK once mounted, ESP_ERR_INVALID_STATE before sd_card_init(),
+ *         or the mount error while no usable card is in the slot
+ */
+esp_err_t sd_card_remount(void);
+
 /**
  * @brief Get the path to the SD card mount point
  * 
@@ -73,4 +109,52 @@ bool sd_card_file_exists(const char *path);
  */
 esp_err_t sd_card_list_dir(const char *dir_path);
 
+// Card sector size used by sd_card_read_sectors
+#define SD_SECTOR_SIZE 512
+
+// Cluster layout of a file on the card
+typedef struct {
+    uint32_t fragments;         // Runs of contiguous clusters, 0 for an empty file
+    uint32_t clusters;          // Clusters in the chain, when contiguous
+    uint32_t first_sector;      // Card sector of the first byte, when contiguous
+} sd_file_layout_t;
+
+/**
+ * @brief Walk the cluster chain of a file
+ * 
+ * Files opened read-only get a fast-seek cluster map when it fits in
+ * CONFIG_FATFS_FAST_SEEK_BUFFER_SIZE entries, which holds
+ * (size - 2) / 2 fragments; more fragmented files seek by walking the chain.
+ * 
+ * @param path Full path of the file, starting with the mount point
+ * @param layout Pointer to store the layout
+ * @return ESP_OK on success
+ */
+esp_err_t sd_card_get_file_layout(const char *path, sd_file_layout_t *layout);
+
+/**
+ * @brief Read whole sectors straight from the card, bypassing the file system
+ * 
+ * Holds the FATFS volume lock for the transfer, so it is safe next to
+ * regular file access from other tasks. Meant for files that
+ * sd_card_get_file_layout() reports as contiguous.
+ * 
+ * @param buffer Destination, ideally word aligned and DMA capable for multi-block transfers
+ * @param sector First card sector
+ * @param count Number of sectors
+ * @return ESP_OK on success
+ */
+esp_err_t sd_card_read_sectors(void *buffer, uint32_t sector, uint32_t count);
+
+/**
+ * @brief Log seek latency on a file with and without the fast-seek map
+ * 
+ * Seeks backwards through the file, so every seek without the map walks the
+ * chain from the first cluster. Opening read-write skips the map.
+ * 
+ * @param path Full path of the file, starting with the mount point
+ * @return ESP_OK on success
+ */
+esp_err_t sd_card_benchmark_seek(const char *path);
+
 #endif // SD_CARD_H
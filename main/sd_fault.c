@@ -0,0 +1,221 @@
+#include "sd_fault.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef TEST_MODE
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Whole ticks sleep, the rest spins like a card transfer would
+static void default_delay(uint32_t us) {
+    uint32_t tick_us = portTICK_PERIOD_MS * 1000;
+    if (us >= tick_us) {
+        vTaskDelay(us / tick_us);
+    }
+    esp_rom_delay_us(us % tick_us);
+}
+#else
+#include <unistd.h>
+#define ESP_LOGI(tag, format, ...) printf("[INFO] " format "\n", ##__VA_ARGS__)
+
+static void default_delay(uint32_t us) {
+    usleep(us);
+}
+#endif
+
+static const char *TAG = "sd_fault";
+
+static sd_fault_config_t config;
+static bool enabled = false;
+static bool removed = false;
+static sd_fault_stats_t stats;
+static uint64_t traffic_bytes = 0;
+
+// Integer hash (lowbias32); draws depend only on the seed and the operation number
+static uint32_t mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+static uint32_t draw(uint32_t op, uint32_t salt) {
+    return mix(config.seed ^ mix(op * 0x9e3779b9U + salt));
+}
+
+static uint32_t draw_range(uint32_t op, uint32_t salt, uint32_t min, uint32_t max) {
+    if (max <= min) {
+        return min;
+    }
+    return min + draw(op, salt) % (max - min + 1);
+}
+
+static bool chance(uint32_t op, uint32_t salt, uint16_t permille) {
+    return permille > 0 && draw(op, salt) % 1000 < permille;
+}
+
+void sd_fault_configure(const sd_fault_config_t *new_config) {
+    __atomic_store_n(&enabled, false, __ATOMIC_SEQ_CST);
+    memset(&stats, 0, sizeof(stats));
+    traffic_bytes = 0;
+    if (new_config == NULL) {
+        return;
+    }
+    config = *new_config;
+    if (config.delay == NULL) {
+        config.delay = default_delay;
+    }
+    ESP_LOGI(TAG, "Injecting latency %u-%u us, stalls %u-%u ms (every %u KB, %u/1000), short reads %u/1000, errors %u/1000",
+             (unsigned)config.latency_min_us, (unsigned)config.latency_max_us,
+             (unsigned)config.stall_min_ms, (unsigned)config.stall_max_ms, (unsigned)config.stall_every_kb,
+             (unsigned)config.stall_permille, (unsigned)config.short_permille, (unsigned)config.error_permille);
+    __atomic_store_n(&enabled, true, __ATOMIC_SEQ_CST);
+}
+
+bool sd_fault_enabled(void) {
+    return __atomic_load_n(&enabled, __ATOMIC_RELAXED);
+}
+
+// "MIN-MAX" or a single value for both
+static bool parse_range(const char *value, uint32_t *min, uint32_t *max) {
+    char *end;
+    unsigned long lo = strtoul(value, &end, 10);
+    unsigned long hi = lo;
+    if (end == value) {
+        return false;
+    }
+    if (*end == '-') {
+        const char *second = end + 1;
+        hi = strtoul(second, &end, 10);
+        if (end == second) {
+            return false;
+        }
+    }
+    if ((*end != '\0' && *end != ',') || hi < lo) {
+        return false;
+    }
+    *min = (uint32_t)lo;
+    *max = (uint32_t)hi;
+    return true;
+}
+
+static bool parse_permille(const char *value, uint16_t *permille) {
+    uint32_t lo, hi;
+    if (!parse_range(value, &lo, &hi) || lo != hi || lo > 1000) {
+        return false;
+    }
+    *permille = (uint16_t)lo;
+    return true;
+}
+
+esp_err_t sd_fault_parse(const char *spec, sd_fault_config_t *out) {
+    if (spec == NULL || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sd_fault_config_t parsed = {0};
+    const char *p = spec;
+    while (*p != '\0') {
+        const char *eq = strchr(p, '=');
+        const char *comma = strchr(p, ',');
+        if (eq == NULL || (comma != NULL && comma < eq)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        size_t key_len = eq - p;
+        const char *value = eq + 1;
+        uint32_t unused;
+        bool ok;
+        if (key_len == 4 && strncmp(p, "seed", 4) == 0) {
+            ok = parse_range(value, &parsed.seed, &unused) && parsed.seed == unused;
+        } else if (key_len == 10 && strncmp(p, "latency_us", 10) == 0) {
+            ok = parse_range(value, &parsed.latency_min_us, &parsed.latency_max_us);
+        } else if (key_len == 8 && strncmp(p, "stall_ms", 8) == 0) {
+            ok = parse_range(value, &parsed.stall_min_ms, &parsed.stall_max_ms);
+        } else if (key_len == 14 && strncmp(p, "stall_every_kb", 14) == 0) {
+            ok = parse_range(value, &parsed.stall_every_kb, &unused) && parsed.stall_every_kb == unused;
+        } else if (key_len == 5 && strncmp(p, "stall", 5) == 0) {
+            ok = parse_permille(value, &parsed.stall_permille);
+        } else if (key_len == 5 && strncmp(p, "short", 5) == 0) {
+            ok = parse_permille(value, &parsed.short_permille);
+        } else if (key_len == 5 && strncmp(p, "error", 5) == 0) {
+            ok = parse_permille(value, &parsed.error_permille);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        p = comma != NULL ? comma + 1 : value + strlen(value);
+    }
+    *out = parsed;
+    return ESP_OK;
+}
+
+void sd_fault_set_removed(bool out) {
+    __atomic_store_n(&removed, out, __ATOMIC_SEQ_CST);
+    ESP_LOGI(TAG, "Card %s", out ? "removed" : "inserted");
+}
+
+bool sd_fault_removed(void) {
+    return __atomic_load_n(&removed, __ATOMIC_RELAXED);
+}
+
+esp_err_t sd_fault_inject(sd_fault_op_t op_kind, size_t *len, bool partial) {
+    if (sd_fault_removed()) {
+        return ESP_FAIL;
+    }
+    if (!sd_fault_enabled()) {
+        return ESP_OK;
+    }
+    uint32_t op = __atomic_fetch_add(&stats.ops, 1, __ATOMIC_RELAXED);
+    bool fail = chance(op, 6, config.error_permille);
+
+    // Short reads stop on a sector boundary, as a multi-block transfer cut off early would
+    if (!fail && op_kind == SD_FAULT_READ && partial && *len > SD_SECTOR_SIZE && chance(op, 1, config.short_permille)) {
+        size_t sectors = (*len - 1) / SD_SECTOR_SIZE;
+        *len = SD_SECTOR_SIZE * (1 + draw(op, 2) % sectors);
+        __atomic_fetch_add(&stats.short_reads, 1, __ATOMIC_RELAXED);
+    }
+
+    uint32_t us = draw_range(op, 3, config.latency_min_us, config.latency_max_us);
+
+    // Stall when this operation carries the traffic over a period boundary, or by chance
+    bool stall = chance(op, 4, config.stall_permille);
+    if (config.stall_every_kb > 0) {
+        uint64_t period = (uint64_t)config.stall_every_kb * 1024;
+        uint64_t before = __atomic_fetch_add(&traffic_bytes, *len, __ATOMIC_RELAXED);
+        stall |= before / period != (before + *len) / period;
+    }
+    if (stall) {
+        us += draw_range(op, 5, config.stall_min_ms, config.stall_max_ms) * 1000;
+        __atomic_fetch_add(&stats.stalls, 1, __ATOMIC_RELAXED);
+    }
+
+    if (us > 0) {
+        __atomic_fetch_add(&stats.injected_us, us, __ATOMIC_RELAXED);
+        uint32_t worst = __atomic_load_n(&stats.worst_us, __ATOMIC_RELAXED);
+        while (us > worst && !__atomic_compare_exchange_n(&stats.worst_us, &worst, us, false,
+                                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+        config.delay(us);
+    }
+
+    if (fail) {
+        __atomic_fetch_add(&stats.errors, 1, __ATOMIC_RELAXED);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void sd_fault_get_stats(sd_fault_stats_t *out) {
+    out->ops = __atomic_load_n(&stats.ops, __ATOMIC_RELAXED);
+    out->stalls = __atomic_load_n(&stats.stalls, __ATOMIC_RELAXED);
+    out->short_reads = __atomic_load_n(&stats.short_reads, __ATOMIC_RELAXED);
+    out->errors = __atomic_load_n(&stats.errors, __ATOMIC_RELAXED);
+    out->injected_us = __atomic_load_n(&stats.injected_us, __ATOMIC_RELAXED);
+    out->worst_us = __atomic_load_n(&stats.worst_us, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,106 @@
+#ifndef SD_FAULT_H
+#define SD_FAULT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "sd_card.h"
+
+// Card operations the shim sits in front of
+typedef enum {
+    SD_FAULT_READ = 0,
+    SD_FAULT_WRITE
+} sd_fault_op_t;
+
+// What to inject. All chances are per operation, in thousandths.
+typedef struct {
+    uint32_t seed;                  // Same seed, same faults for the same operations
+    uint32_t latency_min_us;        // Added to every operation, uniform in [min, max]
+    uint32_t latency_max_us;
+    uint32_t stall_min_ms;          // Length of a stall, uniform in [min, max]
+    uint32_t stall_max_ms;
+    uint32_t stall_every_kb;        // A stall each time this much data has passed, 0 for none
+    uint16_t stall_permille;        // Chance of a stall on any operation
+    uint16_t short_permille;        // Chance a read returns only some whole sectors
+    uint16_t error_permille;        // Chance an operation fails
+    void (*delay)(uint32_t us);     // How injected time passes, NULL to block the calling task
+} sd_fault_config_t;
+
+// Counts since the last sd_fault_configure()
+typedef struct {
+    uint32_t ops;
+    uint32_t stalls;
+    uint32_t short_reads;
+    uint32_t errors;
+    uint64_t injected_us;
+    uint32_t worst_us;              // Longest single injected delay
+} sd_fault_stats_t;
+
+/**
+ * @brief Turn fault injection on with a configuration, or off
+ *
+ * Call while no task is reading from the card, e.g. before the player starts.
+ *
+ * @param config Faults to inject, or NULL to pass every operation through
+ */
+void sd_fault_configure(const sd_fault_config_t *config);
+
+/**
+ * @brief Check whether faults are being injected
+ *
+ * @return true after sd_fault_configure() with a configuration
+ */
+bool sd_fault_enabled(void);
+
+/**
+ * @brief Parse a fault profile
+ *
+ * A comma separated list of key=value, for example
+ * "latency_us=200-800,stall_ms=100-300,stall_every_kb=512,short=20,error=1".
+ * Keys: seed, latency_us, stall_ms (MIN-MAX or a single value), stall_every_kb,
+ * stall, short, error (permille). Unset fields are zero.
+ *
+ * @param spec Profile text
+ * @param config Pointer to store the configuration
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an unknown key or bad value
+ */
+esp_err_t sd_fault_parse(const char *spec, sd_fault_config_t *config);
+
+/**
+ * @brief Apply the configured faults to one card operation
+ *
+ * Called by the card access paths just before they touch the card. Waits out
+ * any injected latency or stall, then may shorten the request or fail it.
+ *
+ * @param op Kind of operation
+ * @param len Requested length; on a short read, cut to a whole number of sectors
+ * @param partial Whether the caller can take fewer bytes than it asked for
+ * @return ESP_OK to go ahead, ESP_FAIL for an injected error
+ */
+esp_err_t sd_fault_inject(sd_fault_op_t op, size_t *len, bool partial);
+
+/**
+ * @brief Pull the card out of its slot, or put it back
+ *
+ * Independent of sd_fault_configure(). While the card is out, every operation
+ * fails without a delay and without being counted.
+ *
+ * @param removed true to remove the card, false to insert it again
+ */
+void sd_fault_set_removed(bool removed);
+
+/**
+ * @brief Check whether the card is pulled out
+ *
+ * @return true between sd_fault_set_removed(true) and sd_fault_set_removed(false)
+ */
+bool sd_fault_removed(void);
+
+/**
+ * @brief Get the injection counts
+ *
+ * @param stats Pointer to store the counts
+ */
+void sd_fault_get_stats(sd_fault_stats_t *stats);
+
+#endif // SD_FAULT_H
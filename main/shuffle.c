@@ -0,0 +1,74 @@
+#include "shuffle.h"
+
+// Integer hash used as the round function (lowbias32)
+static uint32_t mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+void shuffle_init(shuffle_t *shuffle, uint32_t seed, uint32_t count) {
+    shuffle->count = count;
+    // Smallest even bit width covering count, so the domain is under 4 * count
+    uint32_t bits = 1;
+    while (bits < 32 && (1U << bits) < count) {
+        bits++;
+    }
+    shuffle->half_bits = (bits + 1) / 2;
+    for (int i = 0; i < SHUFFLE_ROUNDS; i++) {
+        shuffle->keys[i] = mix(seed ^ mix(count + 0x9e3779b9U * (i + 1)));
+    }
+}
+
+// One pass of the balanced Feistel network over [0, 4^half_bits)
+static uint32_t feistel(const shuffle_t *shuffle, uint32_t x) {
+    uint32_t mask = (1U << shuffle->half_bits) - 1;
+    uint32_t left = x >> shuffle->half_bits;
+    uint32_t right = x & mask;
+    for (int i = 0; i < SHUFFLE_ROUNDS; i++) {
+        uint32_t next = left ^ (mix(right ^ shuffle->keys[i]) & mask);
+        left = right;
+        right = next;
+    }
+    return (left << shuffle->half_bits) | right;
+}
+
+static uint32_t feistel_inverse(const shuffle_t *shuffle, uint32_t x) {
+    uint32_t mask = (1U << shuffle->half_bits) - 1;
+    uint32_t left = x >> shuffle->half_bits;
+    uint32_t right = x & mask;
+    for (int i = SHUFFLE_ROUNDS - 1; i >= 0; i--) {
+        uint32_t prev = right ^ (mix(left ^ shuffle->keys[i]) & mask);
+        right = left;
+        left = prev;
+    }
+    return (left << shuffle->half_bits) | right;
+}
+
+// Cycle walking: values past count are fed back in until one lands inside.
+// The network is a bijection of the larger domain, so this restricts it to
+// a bijection of [0, count); fewer than four passes are needed on average.
+uint32_t shuffle_index_at(const shuffle_t *shuffle, uint32_t pos) {
+    if (pos >= shuffle->count) {
+        return 0;
+    }
+    uint32_t x = pos;
+    do {
+        x = feistel(shuffle, x);
+    } while (x >= shuffle->count);
+    return x;
+}
+
+uint32_t shuffle_position_of(const shuffle_t *shuffle, uint32_t index) {
+    if (index >= shuffle->count) {
+        return 0;
+    }
+    uint32_t x = index;
+    do {
+        x = feistel_inverse(shuffle, x);
+    } while (x >= shuffle->count);
+    return x;
+}
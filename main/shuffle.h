@@ -0,0 +1,46 @@
+#ifndef SHUFFLE_H
+#define SHUFFLE_H
+
+#include <stdint.h>
+
+// Feistel rounds per permutation step
+#define SHUFFLE_ROUNDS  6
+
+// A keyed permutation of [0, count). Nothing is stored per track, so the
+// whole order is reproduced from the seed alone.
+typedef struct {
+    uint32_t count;
+    uint32_t half_bits;                 // Width of each Feistel half
+    uint32_t keys[SHUFFLE_ROUNDS];
+} shuffle_t;
+
+/**
+ * @brief Set up the permutation for a seed and a number of tracks
+ *
+ * The same seed and count always give the same order.
+ *
+ * @param shuffle Permutation to initialize
+ * @param seed Shuffle seed
+ * @param count Number of tracks, 0 gives an empty permutation
+ */
+void shuffle_init(shuffle_t *shuffle, uint32_t seed, uint32_t count);
+
+/**
+ * @brief Track at a position of the shuffled order
+ *
+ * @param shuffle Permutation
+ * @param pos Position in [0, count)
+ * @return Track index in [0, count), or 0 if pos is out of range
+ */
+uint32_t shuffle_index_at(const shuffle_t *shuffle, uint32_t pos);
+
+/**
+ * @brief Position of a track in the shuffled order (inverse of shuffle_index_at)
+ *
+ * @param shuffle Permutation
+ * @param index Track index in [0, count)
+ * @return Position in [0, count), or 0 if index is out of range
+ */
+uint32_t shuffle_position_of(const shuffle_t *shuffle, uint32_t index);
+
+#endif // SHUFFLE_H
@@ -0,0 +1,791 @@
+// Host simulator for the player. Runs the real player task and index task on
+// pthreads against a music directory on disk, and writes what would go out
+// over I2S to a WAV file. The I2S stand-in drains its DMA queue at the
+// configured sample rate, optionally sped up, so gaps between buffers (track
+// changes, slow reads) show up as they would on the device.
+//
+//   ./sim.sh                      build, generate a test library and run it
+//   main/sim_player -r test_data -o out.wav -t 30 -s 1
+//
+// Built with -DTEST_MODE -DHOST_SIM; see host_rtos.h for the stand-ins.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include "host_rtos.h"
+#include "audio_player.h"
+#include "sd_card.h"
+#include "library_scanner.h"
+#include "mp3_source.h"
+#include "sd_fault.h"
+
+// Gaps shorter than this are scheduling noise, not audible dropouts
+#define SIM_GAP_MIN_US          1000
+
+// Longest silence written to the WAV for one gap
+#define SIM_GAP_MAX_US          (10 * 1000000LL)
+
+static const char *music_root = "test_data";
+static double speed = 1.0;              // 0 runs unpaced: as fast as the pipeline goes
+static int64_t queue_us = -1;           // Audio the DMA queue holds, -1 for the channel's DMA buffers
+
+static int64_t wall_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t wall_start_us;
+
+// Sleep for a span of simulated time
+static void sim_sleep_us(int64_t us) {
+    if (us <= 0) {
+        return;
+    }
+    // Unpaced runs still let idle loops wait, just briefly
+    double factor = speed > 0 ? speed : 1000.0;
+    usleep((useconds_t)(us / factor));
+}
+
+// FreeRTOS on pthreads ------------------------------------------------------
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    uint8_t *items;
+    int item_size;
+    int capacity;
+    int head;
+    int count;
+} sim_queue_t;
+
+// Deadline for a timeout in ticks (1 tick = 1 ms), scaled to wall time
+static bool deadline_for(int timeout, struct timespec *deadline) {
+    if (timeout < 0) {
+        return false;
+    }
+    double factor = speed > 0 ? speed : 1000.0;
+    int64_t us = (int64_t)(timeout * 1000LL / factor);
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += us / 1000000;
+    deadline->tv_nsec += (us % 1000000) * 1000;
+    if (deadline->tv_nsec >= 1000000000) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+    return true;
+}
+
+// Wait on a condition until signalled or the deadline passes; false on timeout
+static bool timed_wait(pthread_cond_t *cond, pthread_mutex_t *lock, bool timed, const struct timespec *deadline) {
+    if (!timed) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+QueueHandle_t xQueueCreate(int items, int size) {
+    sim_queue_t *queue = calloc(1, sizeof(sim_queue_t));
+    queue->items = calloc(items, size);
+    queue->item_size = size;
+    queue->capacity = items;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t handle) {
+    sim_queue_t *queue = handle;
+    free(queue->items);
+    free(queue);
+}
+
+int xQueueSend(QueueHandle_t handle, const void *item, int timeout) {
+    sim_queue_t *queue = handle;
+    struct timespec deadline;
+    bool timed = deadline_for(timeout, &deadline);
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->capacity) {
+        if (!timed_wait(&queue->changed, &queue->lock, timed, &deadline)) {
+            pthread_mutex_unlock(&queue->lock);
+            return 0;
+        }
+    }
+    int tail = (queue->head + queue->count) % queue->capacity;
+    memcpy(queue->items + tail * queue->item_size, item, queue->item_size);
+    queue->count++;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+int xQueueReceive(QueueHandle_t handle, void *item, int timeout) {
+    sim_queue_t *queue = handle;
+    struct timespec deadline;
+    bool timed = deadline_for(timeout, &deadline);
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0) {
+        if (!timed_wait(&queue->changed, &queue->lock, timed, &deadline)) {
+            pthread_mutex_unlock(&queue->lock);
+            return 0;
+        }
+    }
+    memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+typedef struct {
+    void (*func)(void *);
+    void *param;
+} sim_task_t;
+
+static void *task_main(void *arg) {
+    sim_task_t task = *(sim_task_t *)arg;
+    free(arg);
+    task.func(task.param);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(void *func, const char *name, int stack, void *param, int priority, TaskHandle_t *handle) {
+    sim_task_t *task = malloc(sizeof(sim_task_t));
+    task->func = (void (*)(void *))func;
+    task->param = param;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, task_main, task) != 0) {
+        free(task);
+        return 0;
+    }
+    pthread_detach(thread);
+    if (handle != NULL) {
+        *handle = (void *)thread;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(void *func, const char *name, int stack, void *param, int priority,
+                                   TaskHandle_t *handle, int core) {
+    return xTaskCreate(func, name, stack, param, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    // Tasks only ever delete themselves
+    if (task == NULL) {
+        pthread_exit(NULL);
+    }
+}
+
+void vTaskDelay(int ticks) {
+    sim_sleep_us(ticks * 1000LL);
+}
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t given;
+    bool available;
+} sim_semaphore_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    sim_semaphore_t *sem = calloc(1, sizeof(sim_semaphore_t));
+    pthread_mutex_init(&sem->lock, NULL);
+    pthread_cond_init(&sem->given, NULL);
+    return sem;
+}
+
+int xSemaphoreTake(SemaphoreHandle_t handle, int timeout) {
+    sim_semaphore_t *sem = handle;
+    struct timespec deadline;
+    bool timed = deadline_for(timeout, &deadline);
+    pthread_mutex_lock(&sem->lock);
+    while (!sem->available) {
+        if (!timed_wait(&sem->given, &sem->lock, timed, &deadline)) {
+            pthread_mutex_unlock(&sem->lock);
+            return 0;
+        }
+    }
+    sem->available = false;
+    pthread_mutex_unlock(&sem->lock);
+    return pdTRUE;
+}
+
+int xSemaphoreGive(SemaphoreHandle_t handle) {
+    sim_semaphore_t *sem = handle;
+    pthread_mutex_lock(&sem->lock);
+    sem->available = true;
+    pthread_cond_signal(&sem->given);
+    pthread_mutex_unlock(&sem->lock);
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t handle) {
+    free(handle);
+}
+
+// I2S channel writing to a WAV file ---------------------------------------
+
+typedef struct {
+    pthread_mutex_t lock;
+    const char *path;
+    FILE *wav;
+    int segment;                // A format change starts a new WAV file
+    uint32_t wav_bytes;
+    uint32_t wav_rate;
+    uint16_t wav_bits;
+    uint16_t wav_channels;
+    // Current channel configuration
+    uint32_t rate;
+    uint16_t bits;
+    uint16_t channels;
+    uint32_t dma_frames;        // Frames in all DMA buffers of the channel
+    i2s_isr_callback_t on_underrun;
+    bool enabled;
+    bool closed;
+    // Simulated time at which the queued audio runs out
+    bool started;
+    int64_t audio_end_us;
+    // Statistics
+    int64_t audio_us;
+    int64_t first_audio_wall_us;
+    uint64_t bytes;
+    int gaps;
+    int64_t gap_total_us;
+    int64_t gap_worst_us;
+    int reconfigurations;
+} sim_sink_t;
+
+static sim_sink_t sink = {.lock = PTHREAD_MUTEX_INITIALIZER, .path = "sim_output.wav"};
+
+static void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    put_le16(p, v & 0xFFFF);
+    put_le16(p + 2, v >> 16);
+}
+
+static void wav_header(uint8_t *h, uint32_t rate, uint16_t bits, uint16_t channels, uint32_t data_bytes) {
+    uint16_t block_align = (bits / 8) * channels;
+    memcpy(h, "RIFF", 4);
+    put_le32(h + 4, 36 + data_bytes);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put_le32(h + 16, 16);
+    put_le16(h + 20, 1);
+    put_le16(h + 22, channels);
+    put_le32(h + 24, rate);
+    put_le32(h + 28, rate * block_align);
+    put_le16(h + 32, block_align);
+    put_le16(h + 34, bits);
+    memcpy(h + 36, "data", 4);
+    put_le32(h + 40, data_bytes);
+}
+
+static void wav_close(void) {
+    if (sink.wav == NULL) {
+        return;
+    }
+    uint8_t header[44];
+    wav_header(header, sink.wav_rate, sink.wav_bits, sink.wav_channels, sink.wav_bytes);
+    fseek(sink.wav, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), sink.wav);
+    fclose(sink.wav);
+    sink.wav = NULL;
+}
+
+// Open the WAV file for the current format, or a new segment if it changed
+static void wav_prepare(void) {
+    if (sink.wav != NULL && sink.wav_rate == sink.rate && sink.wav_bits == sink.bits &&
+        sink.wav_channels == sink.channels) {
+        return;
+    }
+    wav_close();
+    char path[512];
+    if (sink.segment == 0) {
+        snprintf(path, sizeof(path), "%s", sink.path);
+    } else {
+        snprintf(path, sizeof(path), "%.*s.%d.wav", (int)(strlen(sink.path) - 4), sink.path, sink.segment);
+    }
+    sink.segment++;
+    sink.wav = fopen(path, "wb");
+    if (sink.wav == NULL) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        exit(1);
+    }
+    uint8_t header[44] = {0};
+    fwrite(header, 1, sizeof(header), sink.wav);
+    sink.wav_rate = sink.rate;
+    sink.wav_bits = sink.bits;
+    sink.wav_channels = sink.channels;
+    sink.wav_bytes = 0;
+}
+
+static int64_t frames_to_us(uint64_t frames) {
+    return (int64_t)(frames * 1000000 / sink.rate);
+}
+
+// Simulated now: wall time scaled by the speed, or the audio clock when unpaced
+static int64_t sim_now_us(void) {
+    if (speed <= 0) {
+        return sink.audio_end_us;
+    }
+    return (int64_t)((wall_now_us() - wall_start_us) * speed);
+}
+
+esp_err_t i2s_new_channel(i2s_chan_config_t *config, i2s_chan_handle_t *tx, i2s_chan_handle_t *rx) {
+    pthread_mutex_lock(&sink.lock);
+    sink.dma_frames = config->dma_desc_num * config->dma_frame_num;
+    sink.on_underrun = NULL;
+    pthread_mutex_unlock(&sink.lock);
+    *tx = &sink;
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_register_event_callback(i2s_chan_handle_t handle, const i2s_event_callbacks_t *callbacks,
+                                              void *user_data) {
+    sink.on_underrun = callbacks->on_send_q_ovf;
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_init_std_mode(i2s_chan_handle_t handle, i2s_std_config_t *config) {
+    static const uint16_t widths[] = {8, 16, 24, 32};
+    pthread_mutex_lock(&sink.lock);
+    sink.rate = config->clk_cfg.sample_rate_hz;
+    sink.bits = widths[config->slot_cfg.data_bit_width & 3];
+    sink.channels = config->slot_cfg.slot_mode == I2S_SLOT_MODE_MONO ? 1 : 2;
+    sink.reconfigurations++;
+    pthread_mutex_unlock(&sink.lock);
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_enable(i2s_chan_handle_t handle) {
+    sink.enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_disable(i2s_chan_handle_t handle) {
+    sink.enabled = false;
+    return ESP_OK;
+}
+
+esp_err_t i2s_del_channel(i2s_chan_handle_t handle) {
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_write(i2s_chan_handle_t handle, const void *src, size_t size, size_t *bytes_written, int timeout) {
+    *bytes_written = size;
+    pthread_mutex_lock(&sink.lock);
+    uint32_t frame_bytes = (sink.bits / 8) * sink.channels;
+    if (sink.closed || !sink.enabled || frame_bytes == 0) {
+        pthread_mutex_unlock(&sink.lock);
+        return ESP_OK;
+    }
+    wav_prepare();
+
+    // The DMA queue ran dry before this buffer arrived: the listener hears silence
+    int64_t now = sim_now_us();
+    if (!sink.started) {
+        sink.started = true;
+        sink.audio_end_us = now;
+        sink.first_audio_wall_us = wall_now_us();
+    } else if (now > sink.audio_end_us) {
+        int64_t gap = now - sink.audio_end_us;
+        if (gap >= SIM_GAP_MIN_US) {
+            // The driver reports the queue running dry
+            if (sink.on_underrun != NULL) {
+                sink.on_underrun(handle, NULL, NULL);
+            }
+            sink.gaps++;
+            sink.gap_total_us += gap;
+            if (gap > sink.gap_worst_us) {
+                sink.gap_worst_us = gap;
+            }
+            int64_t silence = (gap < SIM_GAP_MAX_US ? gap : SIM_GAP_MAX_US) * sink.rate / 1000000 * frame_bytes;
+            uint8_t zeros[1024] = {0};
+            for (int64_t left = silence; left > 0; left -= sizeof(zeros)) {
+                size_t n = left < (int64_t)sizeof(zeros) ? (size_t)left : sizeof(zeros);
+                fwrite(zeros, 1, n, sink.wav);
+                sink.wav_bytes += n;
+            }
+        }
+        sink.audio_end_us = now;
+    }
+
+    fwrite(src, 1, size, sink.wav);
+    sink.wav_bytes += size;
+    sink.bytes += size;
+    int64_t duration = frames_to_us(size / frame_bytes);
+    sink.audio_end_us += duration;
+    sink.audio_us += duration;
+
+    // Block like the driver does while the DMA queue is full
+    int64_t depth = queue_us >= 0 ? queue_us : frames_to_us(sink.dma_frames);
+    int64_t wait = sink.audio_end_us - depth - now;
+    pthread_mutex_unlock(&sink.lock);
+    if (speed > 0) {
+        sim_sleep_us(wait);
+    }
+    return ESP_OK;
+}
+
+// Stand-ins for the SD card and the parts built only on the device ---------
+
+bool sd_card_is_mounted(void) {
+    return true;
+}
+
+// The card is pulled with sd_fault_set_removed(); there is no detect switch
+bool sd_card_has_detect(void) {
+    return false;
+}
+
+bool sd_card_present(void) {
+    return !sd_fault_removed();
+}
+
+static int card_mounts = 0;
+
+void sd_card_unmount(void) {
+}
+
+esp_err_t sd_card_remount(void) {
+    if (sd_fault_removed()) {
+        return ESP_FAIL;
+    }
+    card_mounts++;
+    return ESP_OK;
+}
+
+const char *sd_card_get_mount_point(void) {
+    return music_root;
+}
+
+esp_err_t sd_card_write_file(const char *filepath, const void *data, size_t len) {
+    if (sd_fault_inject(SD_FAULT_WRITE, &len, false) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    char full_path[512];
+    snprintf(full_path, sizeof(full_path), "%s%s", music_root, filepath);
+    FILE *file = fopen(full_path, "wb");
+    if (file == NULL) {
+        return ESP_FAIL;
+    }
+    size_t written = fwrite(data, 1, len, file);
+    fclose(file);
+    return written == len ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t sd_card_read_file(const char *filepath, void *data, size_t max_len, size_t *bytes_read) {
+    if (sd_fault_inject(SD_FAULT_READ, &max_len, true) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    char full_path[512];
+    snprintf(full_path, sizeof(full_path), "%s%s", music_root, filepath);
+    FILE *file = fopen(full_path, "rb");
+    if (file == NULL) {
+        return ESP_FAIL;
+    }
+    *bytes_read = fread(data, 1, max_len, file);
+    fclose(file);
+    return ESP_OK;
+}
+
+// Files are read through the file system; there is no card image to address
+esp_err_t sd_card_get_file_layout(const char *path, sd_file_layout_t *layout) {
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t sd_card_read_sectors(void *buffer, uint32_t sector, uint32_t count) {
+    return ESP_FAIL;
+}
+
+size_t mp3_source_ring_size(void) {
+    return 0;
+}
+
+static pthread_t scanner_thread;
+static volatile bool scanner_running = false;
+static library_scan_done_cb_t scan_done;
+static void *scan_done_arg;
+
+static void *scanner_main(void *arg) {
+    char music_dir[512];
+    snprintf(music_dir, sizeof(music_dir), "%s/ESP32_MUSIC", music_root);
+    library_scan_stats_t stats;
+    esp_err_t ret = library_scanner_run(music_dir, &stats);
+    scanner_running = false;
+    if (scan_done != NULL) {
+        scan_done(ret, &stats, scan_done_arg);
+    }
+    return NULL;
+}
+
+esp_err_t library_scanner_start(library_scan_done_cb_t done, void *arg) {
+    if (scanner_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    scan_done = done;
+    scan_done_arg = arg;
+    scanner_running = true;
+    if (pthread_create(&scanner_thread, NULL, scanner_main, NULL) != 0) {
+        scanner_running = false;
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_detach(scanner_thread);
+    return ESP_OK;
+}
+
+bool library_scanner_busy(void) {
+    return scanner_running;
+}
+
+// Test library ---------------------------------------------------------------
+
+// A sine-ish tone (triangle) so the output is easy to check by ear
+static void write_tone(const char *path, uint32_t rate, uint16_t channels, double seconds, int period) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        exit(1);
+    }
+    uint32_t frames = (uint32_t)(rate * seconds);
+    uint8_t header[44];
+    wav_header(header, rate, 16, channels, frames * channels * 2);
+    fwrite(header, 1, sizeof(header), file);
+    for (uint32_t f = 0; f < frames; f++) {
+        int phase = f % period;
+        int16_t value = (int16_t)((phase < period / 2 ? phase : period - phase) * 16000 / (period / 2) - 8000);
+        for (uint16_t c = 0; c < channels; c++) {
+            uint8_t sample[2];
+            put_le16(sample, (uint16_t)value);
+            fwrite(sample, 1, 2, file);
+        }
+    }
+    fclose(file);
+}
+
+// Two folders of short tones in three formats; the index is left to the scanner
+static void generate_library(void) {
+    char path[512];
+    snprintf(path, sizeof(path), "rm -rf '%s' && mkdir -p '%s/ESP32_MUSIC/Tones' '%s/ESP32_MUSIC/Mixed'",
+             music_root, music_root, music_root);
+    if (system(path) != 0) {
+        fprintf(stderr, "Cannot create %s\n", music_root);
+        exit(1);
+    }
+    for (int i = 0; i < 3; i++) {
+        snprintf(path, sizeof(path), "%s/ESP32_MUSIC/Tones/tone%d.wav", music_root, i + 1);
+        write_tone(path, 44100, 2, 2.0, 100 + 20 * i);
+    }
+    snprintf(path, sizeof(path), "%s/ESP32_MUSIC/Mixed/a_48k.wav", music_root);
+    write_tone(path, 48000, 2, 2.0, 120);
+    snprintf(path, sizeof(path), "%s/ESP32_MUSIC/Mixed/b_22k_mono.wav", music_root);
+    write_tone(path, 22050, 1, 2.0, 60);
+}
+
+// Driver ---------------------------------------------------------------------
+
+// Injected card latency passes in simulated time
+static void sim_fault_delay(uint32_t us) {
+    sim_sleep_us(us);
+}
+
+static double cpu_seconds(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static int64_t audio_us_now(void) {
+    pthread_mutex_lock(&sink.lock);
+    int64_t us = sink.audio_us;
+    pthread_mutex_unlock(&sink.lock);
+    return us;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "Usage: %s [-r root] [-o out.wav] [-t seconds] [-s speed] [-n seconds] [-u ms] [-b ms] [-f faults] [-e at,for] [-x seconds] [-g]\n"
+            "  -r  Directory standing in for the card, holding ESP32_MUSIC (default test_data)\n"
+            "  -o  WAV file for the I2S output (default sim_output.wav)\n"
+            "  -t  Seconds of audio to play (default 10)\n"
+            "  -s  Speed relative to real time, 0 for unpaced (default 1)\n"
+            "  -n  Press next every this many seconds of audio\n"
+            "  -u  Fail if a gap in the output exceeds this many ms\n"
+            "  -b  Audio the I2S DMA queue holds, in ms (default: the channel's DMA buffers)\n"
+            "  -d  Retune the DMA queue to BUFFERS,FRAMES once playback has started\n"
+            "  -f  Card fault profile, e.g. latency_us=200-800,stall_ms=100-300,stall_every_kb=1024\n"
+            "  -e  Pull the card at AT seconds of audio and put it back FOR seconds later\n"
+            "  -x  Crossfade consecutive tracks over this many seconds\n"
+            "  -g  Replace the root with a generated test library first\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    double seconds = 10;
+    double next_every = 0;
+    double max_gap_ms = -1;
+    bool generate = false;
+    const char *faults = NULL;
+    unsigned dma_buffers = 0, dma_frames = 0;
+    double eject_at = -1, eject_for = 0;
+    int crossfade = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:o:t:s:n:u:b:d:f:e:x:gh")) != -1) {
+        switch (opt) {
+            case 'r': music_root = optarg; break;
+            case 'o': sink.path = optarg; break;
+            case 't': seconds = atof(optarg); break;
+            case 's': speed = atof(optarg); break;
+            case 'n': next_every = atof(optarg); break;
+            case 'u': max_gap_ms = atof(optarg); break;
+            case 'b': queue_us = (int64_t)(atof(optarg) * 1000); break;
+            case 'd':
+                if (sscanf(optarg, "%u,%u", &dma_buffers, &dma_frames) != 2) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'f': faults = optarg; break;
+            case 'e':
+                if (sscanf(optarg, "%lf,%lf", &eject_at, &eject_for) != 2 || eject_at < 0 || eject_for < 0) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'x': crossfade = atoi(optarg); break;
+            case 'g': generate = true; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (strlen(sink.path) < 5 || strcmp(sink.path + strlen(sink.path) - 4, ".wav") != 0) {
+        fprintf(stderr, "Output must be a .wav file\n");
+        return 2;
+    }
+    if (generate) {
+        generate_library();
+    }
+    // Faults start after the library is on disk, with the player
+    if (faults != NULL) {
+        sd_fault_config_t fault_config;
+        if (sd_fault_parse(faults, &fault_config) != ESP_OK) {
+            fprintf(stderr, "Bad fault profile: %s\n", faults);
+            return 2;
+        }
+        fault_config.delay = sim_fault_delay;
+        sd_fault_configure(&fault_config);
+    }
+
+    wall_start_us = wall_now_us();
+    double cpu_start = cpu_seconds();
+    if (audio_player_init() != ESP_OK) {
+        fprintf(stderr, "audio_player_init failed\n");
+        return 1;
+    }
+    if (crossfade > 0 && audio_player_set_crossfade(crossfade) != ESP_OK) {
+        fprintf(stderr, "Bad crossfade: %d s\n", crossfade);
+        return 2;
+    }
+    audio_player_start();
+    if (dma_buffers > 0 && audio_player_set_dma_buffers(dma_buffers, dma_frames) != ESP_OK) {
+        fprintf(stderr, "Bad DMA queue: %u,%u\n", dma_buffers, dma_frames);
+        return 2;
+    }
+
+    // Play for the requested audio time, giving up if nothing comes out
+    int64_t target_us = (int64_t)(seconds * 1000000);
+    int64_t next_at_us = next_every > 0 ? (int64_t)(next_every * 1000000) : INT64_MAX;
+    int presses = 0;
+    int64_t idle_since = wall_now_us();
+    int64_t last_audio = 0;
+    // The card stays out for simulated time; no audio plays meanwhile
+    int64_t eject_at_us = eject_at >= 0 ? (int64_t)(eject_at * 1000000) : INT64_MAX;
+    int64_t eject_wall_us = (int64_t)(eject_for * 1000000 / (speed > 0 ? speed : 1000.0));
+    int64_t ejected_since = -1;
+    while (audio_us_now() < target_us) {
+        usleep(1000);
+        int64_t audio = audio_us_now();
+        if (audio >= next_at_us && audio_player_next() == ESP_OK) {
+            presses++;
+            next_at_us += (int64_t)(next_every * 1000000);
+        }
+        if (audio >= eject_at_us) {
+            sd_fault_set_removed(true);
+            ejected_since = wall_now_us();
+            eject_at_us = INT64_MAX;
+        }
+        if (ejected_since >= 0) {
+            if (wall_now_us() - ejected_since >= eject_wall_us) {
+                sd_fault_set_removed(false);
+                ejected_since = -1;
+                idle_since = wall_now_us();
+            }
+            continue;
+        }
+        if (audio != last_audio) {
+            last_audio = audio;
+            idle_since = wall_now_us();
+        } else if (wall_now_us() - idle_since > 5000000) {
+            fprintf(stderr, "No audio for 5 s of wall time - stopping\n");
+            break;
+        }
+    }
+    audio_player_stop();
+
+    pthread_mutex_lock(&sink.lock);
+    sink.closed = true;
+    wav_close();
+    double wall = (wall_now_us() - wall_start_us) / 1e6;
+    double first_audio_ms = sink.started ? (sink.first_audio_wall_us - wall_start_us) / 1000.0 : -1;
+    double audio = sink.audio_us / 1e6;
+    double cpu = cpu_seconds() - cpu_start;
+    printf("\nSimulation: %.1f s of audio in %.2f s of wall time (%.1fx real time, speed %g)\n",
+           audio, wall, wall > 0 ? audio / wall : 0, speed);
+    printf("First audio: %.1f ms after init\n", first_audio_ms);
+    printf("CPU: %.2f s, %.2f%% of the audio time\n", cpu, audio > 0 ? cpu * 100 / audio : 0);
+    printf("Gaps: %d, %.1f ms in total, worst %.1f ms\n",
+           sink.gaps, sink.gap_total_us / 1000.0, sink.gap_worst_us / 1000.0);
+    printf("I2S configurations: %d, next presses: %d\n", sink.reconfigurations, presses);
+    audio_player_stats_t player_stats;
+    audio_player_get_stats(&player_stats);
+    printf("Player: %u underruns, %u reads, %u x %u frame DMA queue, %u byte reads\n",
+           (unsigned)player_stats.underruns, (unsigned)player_stats.reads, (unsigned)player_stats.dma_desc_num,
+           (unsigned)player_stats.dma_frame_num, (unsigned)player_stats.read_size);
+    if (eject_at >= 0) {
+        printf("Card: pulled at %.1f s for %.1f s, %u removals seen, %d mounts, %d tracks quarantined\n", eject_at,
+               eject_for, (unsigned)player_stats.card_removals, card_mounts, player_stats.quarantined);
+    }
+    if (sd_fault_enabled()) {
+        sd_fault_stats_t faults_seen;
+        sd_fault_get_stats(&faults_seen);
+        printf("Card faults: %u ops, %u stalls, %u short reads, %u errors, %.1f ms injected, worst %.1f ms\n",
+               (unsigned)faults_seen.ops, (unsigned)faults_seen.stalls, (unsigned)faults_seen.short_reads,
+               (unsigned)faults_seen.errors, faults_seen.injected_us / 1000.0, faults_seen.worst_us / 1000.0);
+    }
+    printf("Output: %s (%d file%s)\n", sink.path, sink.segment, sink.segment == 1 ? "" : "s");
+    pthread_mutex_unlock(&sink.lock);
+
+    if (audio <= 0) {
+        fprintf(stderr, "FAIL: no audio reached the I2S sink\n");
+        return 1;
+    }
+    if (max_gap_ms >= 0 && sink.gap_worst_us / 1000.0 > max_gap_ms) {
+        fprintf(stderr, "FAIL: worst gap %.1f ms exceeds %.1f ms\n", sink.gap_worst_us / 1000.0, max_gap_ms);
+        return 1;
+    }
+    return 0;
+}
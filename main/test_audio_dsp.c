@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "audio_dsp.h"
+
+void test_crossfade_gains() {
+    printf("Testing crossfade gains...\n");
+
+    int32_t g_out, g_in;
+
+    // Start of fade: only the outgoing track
+    audio_dsp_crossfade_gains(0, 1000, &g_out, &g_in);
+    assert(g_out == AUDIO_DSP_GAIN_UNITY);
+    assert(g_in == 0);
+
+    // Past the end of the fade: only the incoming track
+    audio_dsp_crossfade_gains(1000, 1000, &g_out, &g_in);
+    assert(g_out == 0);
+    assert(g_in == AUDIO_DSP_GAIN_UNITY);
+
+    // Equal power: g_out^2 + g_in^2 stays at unity across the fade
+    for (uint32_t pos = 0; pos <= 1000; pos += 37) {
+        audio_dsp_crossfade_gains(pos, 1000, &g_out, &g_in);
+        double power = ((double)g_out * g_out + (double)g_in * g_in) / ((double)AUDIO_DSP_GAIN_UNITY * AUDIO_DSP_GAIN_UNITY);
+        assert(power > 0.995 && power < 1.005);
+    }
+
+    // Midpoint is -3 dB for both tracks
+    audio_dsp_crossfade_gains(500, 1000, &g_out, &g_in);
+    assert(abs(g_out - g_in) < 64);
+    assert(abs(g_in - 23170) < 64);
+
+    printf("✓ crossfade gains test passed\n");
+}
+
+void test_crossfade_mix_16bit() {
+    printf("Testing 16-bit crossfade mix...\n");
+
+    int16_t incoming[8];
+    int16_t outgoing[8];
+    for (int i = 0; i < 8; i++) {
+        incoming[i] = 1000;
+        outgoing[i] = -1000;
+    }
+
+    // First frame of a fade is all outgoing
+    audio_dsp_crossfade(incoming, outgoing, sizeof(incoming), 16, 2, 0, 4);
+    assert(incoming[0] == -1000);
+    assert(incoming[1] == -1000);
+
+    // Loud samples saturate instead of wrapping
+    for (int i = 0; i < 8; i++) {
+        incoming[i] = 32000;
+        outgoing[i] = 32000;
+    }
+    audio_dsp_crossfade(incoming, outgoing, sizeof(incoming), 16, 2, 2, 4);
+    assert(incoming[0] == INT16_MAX);
+
+    printf("✓ 16-bit crossfade mix test passed\n");
+}
+
+void test_crossfade_mix_24bit() {
+    printf("Testing 24-bit crossfade mix...\n");
+
+    // One stereo frame of packed 24-bit samples: incoming 0x100000, outgoing -0x100000
+    uint8_t incoming[6] = {0x00, 0x00, 0x10, 0x00, 0x00, 0x10};
+    uint8_t outgoing[6] = {0x00, 0x00, 0xF0, 0x00, 0x00, 0xF0};
+
+    // Last frame of a fade is all incoming
+    audio_dsp_crossfade(incoming, outgoing, sizeof(incoming), 24, 2, 4, 4);
+    assert(incoming[0] == 0x00 && incoming[1] == 0x00 && incoming[2] == 0x10);
+
+    // First frame is all outgoing
+    audio_dsp_crossfade(incoming, outgoing, sizeof(incoming), 24, 2, 0, 4);
+    assert(incoming[0] == 0x00 && incoming[1] == 0x00 && incoming[2] == 0xF0);
+
+    printf("✓ 24-bit crossfade mix test passed\n");
+}
+
+void test_loudness_gain() {
+    printf("Testing loudness gain...\n");
+
+    // 0 dB is unity
+    assert(audio_dsp_gain_from_db(0.0f, 0.0f) == AUDIO_DSP_GAIN_UNITY);
+
+    // -6.02 dB halves the level
+    int32_t half = audio_dsp_gain_from_db(-6.0206f, 0.5f);
+    assert(abs(half - AUDIO_DSP_GAIN_UNITY / 2) < 4);
+
+    // A boost is limited so the peak stays at full scale
+    int32_t limited = audio_dsp_gain_from_db(6.0f, 0.8f);
+    assert(abs(limited - (int32_t)(AUDIO_DSP_GAIN_UNITY / 0.8f)) < 4);
+
+    // Large boosts without peak data are capped
+    assert(audio_dsp_gain_from_db(40.0f, 0.0f) == AUDIO_DSP_GAIN_MAX);
+
+    // Apply to 16-bit samples, saturating instead of wrapping
+    int16_t samples[4] = {1000, -1000, 30000, -30000};
+    audio_dsp_apply_gain(samples, sizeof(samples), 16, AUDIO_DSP_GAIN_UNITY * 2);
+    assert(samples[0] == 2000);
+    assert(samples[1] == -2000);
+    assert(samples[2] == INT16_MAX);
+    assert(samples[3] == INT16_MIN);
+
+    // Apply to packed 24-bit samples
+    uint8_t packed[3] = {0x00, 0x00, 0x10};   // 0x100000
+    audio_dsp_apply_gain(packed, sizeof(packed), 24, AUDIO_DSP_GAIN_UNITY / 2);
+    assert(packed[0] == 0x00 && packed[1] == 0x00 && packed[2] == 0x08);
+
+    printf("✓ loudness gain test passed\n");
+}
+
+void test_unsupported_format() {
+    printf("Testing unsupported formats...\n");
+
+    assert(audio_dsp_supports(16));
+    assert(audio_dsp_supports(24));
+    assert(audio_dsp_supports(32));
+    assert(!audio_dsp_supports(8));
+
+    // 8-bit data is left untouched
+    uint8_t incoming[4] = {1, 2, 3, 4};
+    uint8_t outgoing[4] = {5, 6, 7, 8};
+    audio_dsp_crossfade(incoming, outgoing, sizeof(incoming), 8, 2, 0, 4);
+    assert(incoming[0] == 1 && incoming[3] == 4);
+
+    printf("✓ unsupported formats test passed\n");
+}
+
+int main() {
+    printf("Running audio DSP unit tests...\n\n");
+
+    test_crossfade_gains();
+    test_crossfade_mix_16bit();
+    test_crossfade_mix_24bit();
+    test_loudness_gain();
+    test_unsupported_format();
+
+    printf("\n✅ All audio DSP tests passed!\n");
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <sys/stat.h>
 
 // Test mode definitions to avoid ESP-IDF dependencies
 #ifdef TEST_MODE
@@ -28,7 +29,17 @@ typedef int BaseType_t;
 #define tskIDLE_PRIORITY 0
 
 // Mock SD card functions (these are not in audio_player.c)
+static bool mock_card_present = true;
+static int mock_unmounts = 0;
+static int mock_remounts = 0;
 bool sd_card_is_mounted() { return true; }
+bool sd_card_has_detect(void) { return false; }
+bool sd_card_present(void) { return mock_card_present; }
+void sd_card_unmount(void) { mock_unmounts++; }
+esp_err_t sd_card_remount(void) {
+    mock_remounts++;
+    return mock_card_present ? ESP_OK : ESP_FAIL;
+}
 const char* sd_card_get_mount_point() { return "/test"; }
 esp_err_t sd_card_write_file(const char* path, const void* data, size_t size) { return ESP_OK; }
 esp_err_t sd_card_read_file(const char* path, void* data, size_t size, size_t* bytes_read) { 
@@ -40,13 +51,24 @@ esp_err_t sd_card_read_file(const char* path, void* data, size_t size, size_t* b
 
 #include "audio_player.h"
 #include "json_parser.h"
+#include "playlist.h"
+#include "library_scanner.h"
+#include "index_cache.h"
 #include "pcm_file.h"
+#include "boot_profile.h"
 
 // Test helper function declarations
 #ifdef TEST_MODE
 esp_err_t test_select_next_file(void);
 esp_err_t test_select_prev_file(void);
 esp_err_t test_play_current_file(void);
+esp_err_t test_play_index(int index);
+esp_err_t test_select_next_folder(void);
+esp_err_t test_select_prev_folder(void);
+void test_reload_index(void);
+esp_err_t test_read_current_file(size_t *bytes_read);
+esp_err_t test_seek_current(uint32_t position_ms);
+void test_card_poll(void);
 #endif
 
 // Test data - simulate a loaded index
@@ -63,7 +85,7 @@ void setup_test_index() {
     test_index.folder_count = 2;
     
     // Allocate and setup allFiles
-    test_index.all_files = malloc(sizeof(file_entry_t) * 4);
+    test_index.all_files = calloc(4, sizeof(file_entry_t));
     
     // File 0: Pop/song1.pcm (folder 0)
     strcpy(test_index.all_files[0].name, "song1.pcm");
@@ -109,6 +131,11 @@ void setup_test_index() {
     strcpy(test_index.all_files[3].album, "Rock Collection");
     strcpy(test_index.all_files[3].artist, "Rock Artist D");
     
+    // Folder entries copied below point back at their allFiles position
+    for (int i = 0; i < 4; i++) {
+        test_index.all_files[i].position = i;
+    }
+    
     // Allocate and setup folders
     test_index.music_folders = malloc(sizeof(folder_t) * 2);
     
@@ -139,8 +166,15 @@ void cleanup_test_index() {
     index_loaded = false;
 }
 
-// Override json_parse_index to return our test data
+// Override json_parse_index to return our test data, or fail like a corrupt index.json
+static int index_loads = 0;
+static bool mock_index_corrupt = false;
 esp_err_t json_parse_index(const char *filepath, index_file_t *index) {
+    index_loads++;
+    memset(index, 0, sizeof(index_file_t));
+    if (mock_index_corrupt) {
+        return ESP_FAIL;
+    }
     setup_test_index();
     memcpy(index, &test_index, sizeof(index_file_t));
     
@@ -177,21 +211,114 @@ esp_err_t json_free_index(index_file_t *index) {
     return ESP_OK;
 }
 
+#define MOCK_PLAYLIST_DIR "test_playlists"
+
 // Mock json_get_full_path
 esp_err_t json_get_full_path(const char *relative_path, char *full_path, size_t max_len) {
     if (!relative_path || !full_path) {
         return ESP_ERR_INVALID_ARG;
     }
     
+    // Playlists are read from a real directory next to the test
+    if (strcmp(relative_path, PLAYLIST_DIR) == 0) {
+        snprintf(full_path, max_len, "%s", MOCK_PLAYLIST_DIR);
+        return ESP_OK;
+    }
     snprintf(full_path, max_len, "/test/%s", relative_path);
     return ESP_OK;
 }
 
-// Mock pcm_file functions
+// Mock index accessors over the in-memory test index
+file_entry_t *json_index_file(index_file_t *index, int file_index) {
+    if (!index || file_index < 0 || file_index >= index->total_files || !index->all_files) {
+        return NULL;
+    }
+    return &index->all_files[file_index];
+}
+
+int json_index_folder_size(index_file_t *index, int folder) {
+    if (!index || folder < 0 || folder >= index->folder_count || !index->music_folders) {
+        return 0;
+    }
+    return index->music_folders[folder].file_count;
+}
+
+file_entry_t *json_index_folder_file(index_file_t *index, int folder, int file_index) {
+    if (file_index < 0 || file_index >= json_index_folder_size(index, folder)) {
+        return NULL;
+    }
+    return &index->music_folders[folder].files[file_index];
+}
+
+int json_index_find(index_file_t *index, const char *rel_path) {
+    for (int i = 0; index && rel_path && i < index->total_files; i++) {
+        if (strcmp(index->all_files[i].path, rel_path) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void json_index_prefetch_folder(index_file_t *index, int folder) {
+    (void)index;
+    (void)folder;
+}
+
+// Mock index cache; every boot parses the index
+esp_err_t index_cache_key(const char *path, index_cache_key_t *key) {
+    return ESP_FAIL;
+}
+
+esp_err_t index_cache_load(const index_cache_key_t *key, index_file_t *index) {
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t index_cache_store(const index_cache_key_t *key, const index_file_t *index) {
+    return ESP_OK;
+}
+
+// Mock library scanner; counts the scans started and cancelled, and runs while mock_scan_busy
+static int mock_scans = 0;
+static int mock_scan_cancels = 0;
+static bool mock_scan_busy = false;
+esp_err_t library_scanner_start(library_scan_done_cb_t done, void *arg) {
+    mock_scans++;
+    return ESP_OK;
+}
+void library_scanner_cancel(void) { mock_scan_cancels++; }
+bool library_scanner_busy(void) { return mock_scan_busy; }
+
+// Mock MP3 source ring size
+size_t mp3_source_ring_size(void) { return MP3_PCM_BUFFER_SIZE; }
+
+// Mock pcm_file functions; a missing card or a path in mock_unreadable fails to open,
+// a path in mock_broken opens as a format error
+static const char *mock_broken[4];
+static const char *mock_unreadable;
+static int mock_opens = 0;
+
+static bool mock_is_broken(const char *filepath) {
+    for (int i = 0; i < 4; i++) {
+        if (mock_broken[i] != NULL && strstr(filepath, mock_broken[i]) != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
 esp_err_t pcm_file_open(const char *filepath, pcm_file_t *pcm_file, uint32_t sample_rate, uint16_t bit_depth, uint16_t channels) {
     if (!filepath || !pcm_file) {
         return ESP_ERR_INVALID_ARG;
     }
+    mock_opens++;
+    if (!mock_card_present || (mock_unreadable != NULL && strstr(filepath, mock_unreadable) != NULL)) {
+        printf("[INFO] Mock: Cannot open PCM file: %s\n", filepath);
+        return ESP_FAIL;
+    }
+    if (mock_is_broken(filepath)) {
+        printf("[INFO] Mock: Unsupported PCM file: %s\n", filepath);
+        return ESP_ERR_INVALID_ARG;
+    }
     
     memset(pcm_file, 0, sizeof(pcm_file_t));
     strncpy(pcm_file->filepath, filepath, sizeof(pcm_file->filepath) - 1);
@@ -200,6 +327,8 @@ esp_err_t pcm_file_open(const char *filepath, pcm_file_t *pcm_file, uint32_t sam
     pcm_file->bit_depth = bit_depth;
     pcm_file->channels = channels;
     pcm_file->file_size = 1024; // Mock file size
+    pcm_file->data_size = 1024;
+    pcm_file->pcm_size = 1024;
     pcm_file->file = (FILE*)1; // Mock file handle
     pcm_file->position = 0;
     
@@ -209,6 +338,31 @@ esp_err_t pcm_file_open(const char *filepath, pcm_file_t *pcm_file, uint32_t sam
     return ESP_OK;
 }
 
+esp_err_t pcm_file_set_codec(pcm_file_t *pcm_file, pcm_codec_t codec, uint16_t block_align) {
+    if (!pcm_file || pcm_file->file == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    pcm_file->codec = codec;
+    pcm_file->block_align = block_align;
+    if (codec != PCM_CODEC_RAW) {
+        pcm_file->bit_depth = 16;
+    }
+    
+    return ESP_OK;
+}
+
+esp_err_t pcm_file_set_frame_index(pcm_file_t *pcm_file, const mp3_frame_index_t *frame_index) {
+    if (!pcm_file || pcm_file->file == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (frame_index != NULL) {
+        pcm_file->frame_index = *frame_index;
+    }
+    return ESP_OK;
+}
+
 esp_err_t pcm_file_close(pcm_file_t *pcm_file) {
     if (!pcm_file) {
         return ESP_ERR_INVALID_ARG;
@@ -257,6 +411,31 @@ esp_err_t pcm_file_seek(pcm_file_t *pcm_file, uint32_t byte_pos) {
     return ESP_OK;
 }
 
+esp_err_t pcm_file_seek_ms(pcm_file_t *pcm_file, uint32_t position_ms) {
+    if (!pcm_file || pcm_file->file == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    uint32_t frame_bytes = (pcm_file->bit_depth / 8) * pcm_file->channels;
+    pcm_file->position = (uint32_t)((uint64_t)position_ms * pcm_file->sample_rate / 1000) * frame_bytes;
+    
+    return ESP_OK;
+}
+
+uint32_t pcm_file_position_ms(const pcm_file_t *pcm_file) {
+    uint32_t frame_bytes = (pcm_file->bit_depth / 8) * pcm_file->channels;
+    return frame_bytes && pcm_file->sample_rate ? (uint32_t)((uint64_t)(pcm_file->position / frame_bytes) * 1000 / pcm_file->sample_rate) : 0;
+}
+
+uint32_t pcm_file_duration_ms(const pcm_file_t *pcm_file) {
+    uint32_t frame_bytes = (pcm_file->bit_depth / 8) * pcm_file->channels;
+    return frame_bytes && pcm_file->sample_rate ? (uint32_t)((uint64_t)(pcm_file->pcm_size / frame_bytes) * 1000 / pcm_file->sample_rate) : 0;
+}
+
+size_t pcm_file_buffered(const pcm_file_t *pcm_file) {
+    return 0;
+}
+
 // Test initialization
 void test_audio_player_init() {
     printf("Testing audio_player_init...\n");
@@ -264,6 +443,16 @@ void test_audio_player_init() {
     esp_err_t ret = audio_player_init();
     assert(ret == ESP_OK);
     
+    // The boot phases show up in the same timeline as on the device
+    const char *phases[] = {"state load", "i2s setup", "player_task", "index load"};
+    boot_event_t event;
+    for (int i = 0; i < 4; i++) {
+        assert(boot_profile_get(i, &event));
+        assert(strcmp(event.name, phases[i]) == 0);
+        assert(event.end_us >= event.start_us);
+    }
+    boot_profile_report();
+    
     printf("✓ audio_player_init test passed\n");
 }
 
@@ -318,6 +507,37 @@ void test_play_all_order_mode() {
     printf("✓ play all order mode test passed\n");
 }
 
+// Test play all shuffle mode
+void test_play_all_shuffle_mode() {
+    printf("Testing play all shuffle mode...\n");
+
+    audio_player_set_mode(MODE_PLAY_ALL_SHUFFLE);
+    player_state_t state = audio_player_get_state();
+    uint32_t seed = state.shuffle_seed;
+
+    // One round of the order plays every file once and comes back around
+    bool played[4] = {false};
+    int start = state.current_file_index;
+    for (int i = 0; i < 4; i++) {
+        assert(test_select_next_file() == ESP_OK);
+        state = audio_player_get_state();
+        assert(state.current_file_index >= 0 && state.current_file_index < 4);
+        assert(!played[state.current_file_index]);
+        played[state.current_file_index] = true;
+    }
+    assert(state.current_file_index == start);
+    assert(state.shuffle_seed == seed);
+
+    // Previous retraces the order
+    assert(test_select_next_file() == ESP_OK);
+    int after_start = audio_player_get_state().current_file_index;
+    assert(test_select_next_file() == ESP_OK);
+    assert(test_select_prev_file() == ESP_OK);
+    assert(audio_player_get_state().current_file_index == after_start);
+
+    printf("✓ play all shuffle mode test passed\n");
+}
+
 // Test folder order mode
 void test_folder_order_mode() {
     printf("Testing folder order mode...\n");
@@ -438,16 +658,410 @@ void test_folder_index_usage() {
     printf("✓ folder index usage test passed\n");
 }
 
+// Test playing a track by its position in allFiles
+void test_play_by_index() {
+    printf("Testing play by index...\n");
+    
+    assert(audio_player_play_index(-1) == ESP_ERR_INVALID_ARG);
+    assert(audio_player_play_index(4) == ESP_ERR_INVALID_ARG);
+    assert(audio_player_play_index(3) == ESP_OK);
+    
+    // The all modes continue from the track itself
+    audio_player_set_mode(MODE_PLAY_ALL_ORDER);
+    assert(test_play_index(3) == ESP_OK);
+    player_state_t state = audio_player_get_state();
+    assert(state.current_file_index == 3);
+    assert(state.current_folder_index == 1);
+    assert(strcmp(state.current_file_path, "/test/Rock/song4.pcm") == 0);
+    assert(test_select_next_file() == ESP_OK);
+    assert(audio_player_get_state().current_file_index == 0);
+    
+    // The folder modes continue within the track's folder
+    audio_player_set_mode(MODE_PLAY_FOLDER_ORDER);
+    assert(test_play_index(2) == ESP_OK);
+    state = audio_player_get_state();
+    assert(state.current_folder_index == 1);
+    assert(state.current_file_index == 0);
+    assert(test_select_next_file() == ESP_OK);
+    assert(strcmp(audio_player_get_state().current_file_path, "/test/Rock/song4.pcm") == 0);
+    
+    assert(test_play_index(7) == ESP_ERR_NOT_FOUND);
+    
+    printf("✓ play by index test passed\n");
+}
+
+// Test runtime tuning and the read trace
+void test_runtime_tuning() {
+    printf("Testing runtime tuning...\n");
+    
+    audio_player_stats_t stats;
+    audio_player_get_stats(&stats);
+    assert(stats.read_size == AUDIO_PLAYER_READ_SIZE_MAX);
+    assert(stats.dma_desc_num == 6 && stats.dma_frame_num == 240);
+    
+    // Reads are whole sectors within the audio buffer
+    assert(audio_player_set_read_size(0) == ESP_ERR_INVALID_ARG);
+    assert(audio_player_set_read_size(256) == ESP_ERR_INVALID_ARG);
+    assert(audio_player_set_read_size(1000) == ESP_ERR_INVALID_ARG);
+    assert(audio_player_set_read_size(8192) == ESP_ERR_INVALID_ARG);
+    assert(audio_player_set_read_size(1024) == ESP_OK);
+    audio_player_get_stats(&stats);
+    assert(stats.read_size == 1024);
+    
+    assert(audio_player_set_dma_buffers(1, 240) == ESP_ERR_INVALID_ARG);
+    assert(audio_player_set_dma_buffers(17, 240) == ESP_ERR_INVALID_ARG);
+    assert(audio_player_set_dma_buffers(6, 7) == ESP_ERR_INVALID_ARG);
+    assert(audio_player_set_dma_buffers(6, 512) == ESP_ERR_INVALID_ARG);
+    assert(audio_player_set_dma_buffers(8, 480) == ESP_OK);
+    
+    // The next read uses the new size
+    audio_player_set_mode(MODE_PLAY_ALL_ORDER);
+    assert(test_play_index(0) == ESP_OK);
+    size_t bytes_read = 0;
+    assert(test_read_current_file(&bytes_read) == ESP_OK);
+    assert(bytes_read == 1024);
+    
+    // Trace events queue up until taken
+    audio_player_trace_t events[80];
+    uint32_t dropped = 0;
+    assert(audio_player_take_trace(events, 80, &dropped) == 0);
+    audio_player_set_trace(true);
+    for (int i = 0; i < 3; i++) {
+        assert(test_read_current_file(&bytes_read) == ESP_OK);
+    }
+    assert(audio_player_take_trace(events, 80, &dropped) == 3);
+    assert(events[0].bytes == 1024 && events[2].bytes == 1024);
+    assert(events[0].time_ms <= events[2].time_ms);
+    assert(audio_player_take_trace(events, 80, &dropped) == 0);
+    
+    // A reader that falls behind loses the newest events
+    for (int i = 0; i < 70; i++) {
+        assert(test_read_current_file(&bytes_read) == ESP_OK);
+    }
+    assert(audio_player_take_trace(events, 80, &dropped) == 64);
+    assert(dropped == 6);
+    assert(audio_player_take_trace(events, 80, &dropped) == 0);
+    assert(dropped == 0);
+    
+    audio_player_set_trace(false);
+    assert(test_read_current_file(&bytes_read) == ESP_OK);
+    assert(audio_player_take_trace(events, 80, &dropped) == 0);
+    
+    assert(audio_player_set_read_size(AUDIO_PLAYER_READ_SIZE_MAX) == ESP_OK);
+    printf("✓ runtime tuning test passed\n");
+}
+
+// Tracks that cannot be played are skipped by every mode without being opened again
+void test_quarantine_skipping() {
+    printf("Testing track quarantine...\n");
+    audio_player_stats_t stats;
+    
+    // A track that only failed to open is skipped, and tried again on its next turn
+    audio_player_set_mode(MODE_PLAY_ALL_ORDER);
+    assert(test_play_index(0) == ESP_OK);
+    mock_unreadable = "Pop/song2.pcm";
+    int opens = mock_opens;
+    assert(test_select_next_file() == ESP_OK);
+    assert(mock_opens == opens + 2);
+    assert(audio_player_get_state().current_file_index == 2);
+    audio_player_get_stats(&stats);
+    assert(stats.quarantined == 0);
+    opens = mock_opens;
+    assert(test_select_prev_file() == ESP_OK);
+    assert(mock_opens == opens + 2);
+    assert(audio_player_get_state().current_file_index == 0);
+    mock_unreadable = NULL;
+    assert(test_select_next_file() == ESP_OK);
+    assert(audio_player_get_state().current_file_index == 1);
+    
+    // Play all in order passes over Pop/song2.pcm once it failed
+    audio_player_set_mode(MODE_PLAY_ALL_ORDER);
+    assert(test_play_index(0) == ESP_OK);
+    mock_broken[0] = "Pop/song2.pcm";
+    opens = mock_opens;
+    assert(test_select_next_file() == ESP_OK);
+    assert(mock_opens == opens + 2);
+    assert(audio_player_get_state().current_file_index == 2);
+    audio_player_get_stats(&stats);
+    assert(stats.quarantined == 1);
+    assert(test_select_prev_file() == ESP_OK);
+    assert(audio_player_get_state().current_file_index == 0);
+    opens = mock_opens;
+    assert(test_select_next_file() == ESP_OK);
+    assert(mock_opens == opens + 1);
+    assert(audio_player_get_state().current_file_index == 2);
+    
+    // Shuffle deals around it
+    audio_player_set_mode(MODE_PLAY_ALL_SHUFFLE);
+    for (int i = 0; i < 6; i++) {
+        assert(test_select_next_file() == ESP_OK);
+        assert(audio_player_get_state().current_file_index != 1);
+    }
+    
+    // The folder modes stay on the folder's remaining track
+    audio_player_set_mode(MODE_PLAY_FOLDER_ORDER);
+    assert(test_play_index(0) == ESP_OK);
+    opens = mock_opens;
+    for (int i = 0; i < 3; i++) {
+        assert(test_select_next_file() == ESP_OK);
+        assert(strcmp(audio_player_get_state().current_file_path, "/test/Pop/song1.pcm") == 0);
+    }
+    assert(mock_opens == opens + 3);
+    audio_player_set_mode(MODE_PLAY_FOLDER_SHUFFLE);
+    for (int i = 0; i < 3; i++) {
+        assert(test_select_prev_file() == ESP_OK);
+        assert(strcmp(audio_player_get_state().current_file_path, "/test/Pop/song1.pcm") == 0);
+    }
+    
+    // A folder with nothing left to play ends the search
+    mock_broken[1] = "Pop/song1.pcm";
+    audio_player_set_mode(MODE_PLAY_FOLDER_ORDER);
+    assert(test_select_next_file() == ESP_FAIL);
+    audio_player_get_stats(&stats);
+    assert(stats.quarantined == 2);
+    opens = mock_opens;
+    assert(test_select_next_file() == ESP_FAIL);
+    assert(mock_opens == opens);
+    
+    // Picking a track by index tries it regardless, and a track that plays is released
+    mock_broken[0] = NULL;
+    mock_broken[1] = NULL;
+    audio_player_set_mode(MODE_PLAY_ALL_ORDER);
+    assert(test_play_index(1) == ESP_OK);
+    assert(test_play_index(0) == ESP_OK);
+    audio_player_get_stats(&stats);
+    assert(stats.quarantined == 0);
+    
+    printf("✓ track quarantine test passed\n");
+}
+
+// A pulled card is unmounted, and a new one is mounted and its index reloaded
+void test_card_hot_swap() {
+    printf("Testing card removal and insertion...\n");
+    audio_player_stats_t stats;
+    
+    audio_player_set_mode(MODE_PLAY_ALL_ORDER);
+    mock_broken[0] = "Rock/song4.pcm";
+    assert(test_play_index(2) == ESP_OK);
+    assert(test_select_next_file() == ESP_OK);
+    assert(audio_player_get_state().current_file_index == 0);
+    audio_player_get_stats(&stats);
+    assert(stats.quarantined == 1);
+    uint32_t removals = stats.card_removals;
+    assert(test_seek_current(20) == ESP_OK);
+    assert(audio_player_get_position_ms() == 20);
+    
+    // Failing to open with the card gone quarantines nothing. A library scan
+    // still running is cancelled, and the card stays mounted until it ends.
+    mock_card_present = false;
+    mock_scan_busy = true;
+    int unmounts = mock_unmounts;
+    int cancels = mock_scan_cancels;
+    assert(test_select_next_file() != ESP_OK);
+    audio_player_get_stats(&stats);
+    assert(stats.card_removals == removals + 1);
+    assert(stats.quarantined == 1);
+    assert(mock_scan_cancels == cancels + 1);
+    assert(mock_unmounts == unmounts);
+    int remounts = mock_remounts;
+    test_card_poll();
+    assert(mock_unmounts == unmounts);
+    assert(mock_remounts == remounts);
+    
+    // No more opens while the card is out
+    int opens = mock_opens;
+    assert(test_select_next_file() != ESP_OK);
+    assert(mock_opens == opens);
+    assert(mock_unmounts == unmounts);
+    
+    // The new card's index comes with a clean quarantine, and the track that was playing
+    // is opened again through the index and resumed where it stopped
+    mock_broken[0] = NULL;
+    mock_card_present = true;
+    mock_scan_busy = false;
+    int loads = index_loads;
+    test_card_poll();
+    assert(mock_unmounts == unmounts + 1);
+    assert(mock_remounts == remounts + 1);
+    assert(index_loads == loads + 1);
+    audio_player_get_stats(&stats);
+    assert(stats.quarantined == 0);
+    assert(stats.card_removals == removals + 1);
+    player_state_t state = audio_player_get_state();
+    assert(strcmp(state.current_file_path, "/test/Pop/song1.pcm") == 0);
+    assert(audio_player_get_position_ms() == 20);
+    assert(mock_opens == opens + 1);
+    size_t bytes_read = 0;
+    assert(test_read_current_file(&bytes_read) == ESP_OK && bytes_read > 0);
+    assert(test_select_next_file() == ESP_OK);
+    assert(audio_player_get_state().current_file_index == 1);
+    
+    // A card whose index.json cannot be read keeps the current index playing
+    // and has its library scanned
+    mock_index_corrupt = true;
+    int scans = mock_scans;
+    loads = index_loads;
+    test_reload_index();
+    assert(index_loads == loads + 1);
+    assert(mock_scans == scans + 1);
+    assert(test_select_next_file() == ESP_OK);
+    assert(audio_player_get_state().current_file_index == 2);
+    mock_index_corrupt = false;
+    
+    printf("✓ card removal and insertion test passed\n");
+}
+
+// Playlists follow the index folders and play their tracks in file order
+void test_playlist_folders() {
+    printf("Testing playlist folders...\n");
+    
+    mkdir(MOCK_PLAYLIST_DIR, 0755);
+    FILE *file = fopen(MOCK_PLAYLIST_DIR "/Mix.m3u", "w");
+    assert(file != NULL);
+    fprintf(file, "#EXTM3U\n#EXTINF:180,Heavy Metal\n../Rock/song4.pcm\n../Gone/song9.pcm\n/ESP32_MUSIC/Pop/song1.pcm\n");
+    fclose(file);
+    file = fopen(MOCK_PLAYLIST_DIR "/Stale.m3u", "w");
+    assert(file != NULL);
+    fprintf(file, "../Gone/song9.pcm\n");
+    fclose(file);
+    test_reload_index();
+    
+    // Pop, Rock, then Mix; a playlist without a known track is left out
+    audio_player_set_mode(MODE_PLAY_FOLDER_ORDER);
+    assert(test_play_index(2) == ESP_OK);
+    assert(test_select_next_folder() == ESP_OK);
+    player_state_t state = audio_player_get_state();
+    assert(state.current_folder_index == 2 && state.current_file_index == 0);
+    assert(strcmp(state.current_file_path, "/test/Rock/song4.pcm") == 0);
+    assert(test_select_next_file() == ESP_OK);
+    assert(strcmp(audio_player_get_state().current_file_path, "/test/Pop/song1.pcm") == 0);
+    assert(audio_player_get_state().current_folder_index == 2);
+    assert(test_select_next_file() == ESP_OK);
+    assert(strcmp(audio_player_get_state().current_file_path, "/test/Rock/song4.pcm") == 0);
+    assert(test_select_next_folder() == ESP_OK);
+    assert(audio_player_get_state().current_folder_index == 0);
+    assert(test_select_prev_folder() == ESP_OK);
+    assert(audio_player_get_state().current_folder_index == 2);
+    
+    // Shuffle stays inside the playlist
+    audio_player_set_mode(MODE_PLAY_FOLDER_SHUFFLE);
+    for (int i = 0; i < 4; i++) {
+        assert(test_select_next_file() == ESP_OK);
+        assert(audio_player_get_state().current_folder_index == 2);
+        const char *path = audio_player_get_state().current_file_path;
+        assert(strcmp(path, "/test/Rock/song4.pcm") == 0 || strcmp(path, "/test/Pop/song1.pcm") == 0);
+    }
+    
+    // Without the directory the playlists are gone with the next index
+    unlink(MOCK_PLAYLIST_DIR "/Mix.m3u");
+    unlink(MOCK_PLAYLIST_DIR "/Stale.m3u");
+    rmdir(MOCK_PLAYLIST_DIR);
+    test_reload_index();
+    audio_player_set_mode(MODE_PLAY_FOLDER_ORDER);
+    assert(audio_player_get_state().current_folder_index < 2);
+    assert(test_select_next_folder() == ESP_OK);
+    assert(test_select_next_folder() == ESP_OK);
+    assert(audio_player_get_state().current_folder_index < 2);
+    
+    printf("✓ playlist folders test passed\n");
+}
+
+static const char *current_path(void) {
+    static player_state_t state;
+    state = audio_player_get_state();
+    return state.current_file_path;
+}
+
+// Artist and album modes walk orders sorted at index load
+void test_sorted_modes() {
+    printf("Testing artist and album modes...\n");
+    
+    strcpy(test_index.all_files[0].artist, "Zed");
+    strcpy(test_index.all_files[2].artist, "abba");
+    strcpy(test_index.all_files[3].album, "Ballads");
+    test_reload_index();
+    
+    // abba, Pop Artist B, Rock Artist D, Zed; the current index is the rank
+    audio_player_set_mode(MODE_PLAY_ARTIST_ORDER);
+    assert(test_play_index(2) == ESP_OK);
+    assert(audio_player_get_state().current_file_index == 0);
+    const char *by_artist[] = {"/test/Pop/song2.pcm", "/test/Rock/song4.pcm", "/test/Pop/song1.pcm", "/test/Rock/song3.pcm"};
+    for (int i = 0; i < 4; i++) {
+        assert(test_select_next_file() == ESP_OK);
+        assert(strcmp(current_path(), by_artist[i]) == 0);
+    }
+    assert(test_select_prev_file() == ESP_OK);
+    assert(strcmp(current_path(), "/test/Pop/song1.pcm") == 0);
+    assert(audio_player_get_state().current_file_index == 3);
+    
+    // Ballads, Pop Hits, Rock Collection; the current track keeps playing across the switch
+    audio_player_set_mode(MODE_PLAY_ALBUM_ORDER);
+    assert(audio_player_get_state().current_file_index == 1);
+    const char *by_album[] = {"/test/Pop/song2.pcm", "/test/Rock/song3.pcm", "/test/Rock/song4.pcm"};
+    for (int i = 0; i < 3; i++) {
+        assert(test_select_next_file() == ESP_OK);
+        assert(strcmp(current_path(), by_album[i]) == 0);
+    }
+    
+    // Albums come in a shuffled order, each played through in order
+    audio_player_set_mode(MODE_PLAY_ALBUM_SHUFFLE);
+    assert(test_play_index(0) == ESP_OK);
+    assert(test_select_next_file() == ESP_OK);
+    assert(strcmp(current_path(), "/test/Pop/song2.pcm") == 0);
+    bool seen[4] = {false};
+    for (int i = 0; i < 8; i++) {
+        bool was_song1 = strcmp(current_path(), "/test/Pop/song1.pcm") == 0;
+        assert(test_select_next_file() == ESP_OK);
+        if (was_song1) {
+            assert(strcmp(current_path(), "/test/Pop/song2.pcm") == 0);
+        }
+        const char *path = current_path();
+        seen[strcmp(path, "/test/Pop/song1.pcm") == 0 ? 0 : strcmp(path, "/test/Pop/song2.pcm") == 0 ? 1 :
+             strcmp(path, "/test/Rock/song3.pcm") == 0 ? 2 : 3] = true;
+    }
+    assert(seen[0] && seen[1] && seen[2] && seen[3]);
+    
+    // Back from an album's first track is the last track of the album before
+    assert(test_play_index(0) == ESP_OK);
+    assert(test_select_prev_file() == ESP_OK);
+    assert(strcmp(current_path(), "/test/Pop/song2.pcm") != 0);
+    assert(test_select_next_file() == ESP_OK);
+    assert(strcmp(current_path(), "/test/Pop/song1.pcm") == 0);
+    
+    // A quarantined track is passed over within its album
+    mock_broken[0] = "Pop/song2.pcm";
+    audio_player_set_mode(MODE_PLAY_ALBUM_ORDER);
+    assert(test_play_index(0) == ESP_OK);
+    assert(test_select_next_file() == ESP_OK);
+    assert(strcmp(current_path(), "/test/Rock/song3.pcm") == 0);
+    mock_broken[0] = NULL;
+    
+    strcpy(test_index.all_files[0].artist, "Pop Artist A");
+    strcpy(test_index.all_files[2].artist, "Rock Artist C");
+    strcpy(test_index.all_files[3].album, "Rock Collection");
+    test_reload_index();
+    audio_player_set_mode(MODE_PLAY_ALL_ORDER);
+    
+    printf("✓ artist and album modes test passed\n");
+}
+
 int main() {
     printf("Running Audio Player unit tests...\n\n");
     
     test_audio_player_init();
     test_mode_switching();
     test_play_all_order_mode();
+    test_play_all_shuffle_mode();
     test_folder_order_mode();
     test_metadata_loading();
     test_state_persistence();
     test_folder_index_usage();
+    test_play_by_index();
+    test_runtime_tuning();
+    test_quarantine_skipping();
+    test_card_hot_swap();
+    test_playlist_folders();
+    test_sorted_modes();
     
     cleanup_test_index();
     
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "boot_profile.h"
+
+void test_boot_profile_timeline() {
+    printf("Testing boot profile timeline...\n");
+
+    int outer = boot_profile_begin("outer");
+    int inner = boot_profile_begin("inner");
+    usleep(2000);
+    boot_profile_end(inner);
+    boot_profile_task("worker");
+    int open = boot_profile_begin("still running");
+    boot_profile_end(outer);
+
+    boot_event_t event;
+    assert(boot_profile_get(outer, &event));
+    assert(strcmp(event.name, "outer") == 0);
+    assert(!event.task);
+    int64_t outer_start = event.start_us;
+    int64_t outer_end = event.end_us;
+    assert(outer_end - outer_start >= 2000);
+
+    // Nested phases lie within their parent
+    assert(boot_profile_get(inner, &event));
+    assert(event.start_us >= outer_start);
+    assert(event.end_us <= outer_end);
+    assert(event.end_us - event.start_us >= 2000);
+
+    assert(boot_profile_get(2, &event));
+    assert(event.task);
+    assert(strcmp(event.name, "worker") == 0);
+
+    assert(boot_profile_get(open, &event));
+    assert(event.end_us == -1);
+    assert(!boot_profile_get(4, &event));
+
+    boot_profile_report();
+    printf("✓ boot profile timeline test passed\n");
+}
+
+void test_boot_profile_overflow() {
+    printf("Testing boot profile overflow...\n");
+
+    // The table keeps the first events and drops the rest
+    for (int i = 0; i < BOOT_PROFILE_MAX_EVENTS; i++) {
+        boot_profile_task("filler");
+    }
+    boot_event_t event;
+    assert(boot_profile_get(BOOT_PROFILE_MAX_EVENTS - 1, &event));
+    assert(!boot_profile_get(BOOT_PROFILE_MAX_EVENTS, &event));
+    assert(boot_profile_begin("late") == -1);
+    boot_profile_end(-1);
+
+    boot_profile_report();
+    printf("✓ boot profile overflow test passed\n");
+}
+
+int main() {
+    printf("Running boot profile unit tests...\n\n");
+
+    test_boot_profile_timeline();
+    test_boot_profile_overflow();
+
+    printf("\n✅ All boot profile tests passed!\n");
+    return 0;
+}
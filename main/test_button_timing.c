@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "button_handler.h"
+#include "audio_player.h"
+#include "../components/ezbutton/ezbutton.h"
+
+// Virtual clock and pins behind ezButton_setIO()
+#define TICK_MS         10      // CONFIG_FREERTOS_HZ=100
+#define POLL_MS         10      // button_task delay
+#define DEBOUNCE_MS     50
+#define LONGPRESS_MS    1000
+#define RESTART_MS      2000
+#define MAX_BOUNCE_MS   8
+#define MAX_EVENTS      64
+#define MAX_PIN         40
+#define LOGGED_ACTIONS  8
+
+static unsigned long virtual_ms = 0;
+static int pin_level[MAX_PIN];
+
+static unsigned long virtual_millis(void) {
+    return virtual_ms / TICK_MS * TICK_MS;
+}
+
+static int virtual_read_pin(int pin) {
+    return pin_level[pin];
+}
+
+static const ezButton_io_t virtual_io = { virtual_millis, virtual_read_pin };
+
+// The handler only asks the player for its mode
+static player_state_t player_state;
+
+player_state_t audio_player_get_state(void) {
+    return player_state;
+}
+
+// One scripted press: the pin goes low at at_ms and high hold_ms later,
+// with contacts chattering for bounce_ms after each edge
+typedef struct {
+    int pin;
+    unsigned long at_ms;
+    unsigned long hold_ms;
+    unsigned long bounce_ms;
+} press_t;
+
+typedef struct {
+    int presses;
+    int actions;
+    unsigned long worst_latency_ms;
+    unsigned long total_latency_ms;
+    unsigned long virtual_ms;
+    button_action_t log[LOGGED_ACTIONS];    // First actions in order
+} replay_stats_t;
+
+typedef struct {
+    unsigned long at_ms;
+    int pin;
+    int level;
+} pin_event_t;
+
+// Expected action for a clean press, mirroring the documented controls
+static button_action_t expected_action(const press_t *press, playback_mode_t mode, unsigned long *last_back_release) {
+    bool folder_mode = (mode == MODE_PLAY_FOLDER_ORDER || mode == MODE_PLAY_FOLDER_SHUFFLE);
+    bool long_press = press->hold_ms >= LONGPRESS_MS;
+    unsigned long release = press->at_ms + press->hold_ms;
+
+    // Shorter than the debounce time: never seen as a press
+    if (press->hold_ms < DEBOUNCE_MS) {
+        return BTN_ACTION_NONE;
+    }
+
+    switch (press->pin) {
+    case BTN_FWD_PIN:
+        if (long_press) {
+            return folder_mode ? BTN_ACTION_NEXT_FOLDER : BTN_ACTION_NONE;
+        }
+        return BTN_ACTION_NEXT;
+    case BTN_BCK_PIN:
+        if (long_press) {
+            return folder_mode ? BTN_ACTION_PREV_FOLDER : BTN_ACTION_NONE;
+        } else {
+            bool within = release - *last_back_release < RESTART_MS;
+            *last_back_release = release;
+            return within ? BTN_ACTION_PREV : BTN_ACTION_RESTART_TRACK;
+        }
+    default:
+        return BTN_ACTION_CHANGE_MODE;
+    }
+}
+
+// Edge at `at` to `level`, chattering for `bounce` ms first
+static int add_edge(pin_event_t *events, int count, int pin, unsigned long at, unsigned long bounce, int level) {
+    unsigned long t = at;
+    int current = level;
+    while (bounce > 0 && t + 1 < at + bounce && count < MAX_EVENTS - 2) {
+        events[count++] = (pin_event_t){ t, pin, current };
+        current = !current;
+        t += 1 + (unsigned long)rand() % 2;
+    }
+    events[count++] = (pin_event_t){ t, pin, level };
+    return count;
+}
+
+// Poll the handler every POLL_MS across the presses and check each one
+// produces its expected action, measuring release-to-action latency
+static void replay(const press_t *presses, int press_count, playback_mode_t mode, replay_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < MAX_PIN; i++) {
+        pin_level[i] = 1;
+    }
+    player_state.mode = mode;
+    virtual_ms = presses[0].at_ms / POLL_MS * POLL_MS - POLL_MS;
+    unsigned long start_ms = virtual_ms;
+    ezButton_setIO(&virtual_io);
+    assert(button_handler_init() == ESP_OK);
+
+    unsigned long last_back_release = 0;
+    for (int i = 0; i < press_count; i++) {
+        const press_t *press = &presses[i];
+        unsigned long release = press->at_ms + press->hold_ms;
+        unsigned long window_end = (i + 1 < press_count) ? presses[i + 1].at_ms : release + 500;
+        button_action_t expected = expected_action(press, player_state.mode, &last_back_release);
+
+        pin_event_t events[MAX_EVENTS];
+        int event_count = add_edge(events, 0, press->pin, press->at_ms, press->bounce_ms, 0);
+        event_count = add_edge(events, event_count, press->pin, release, press->bounce_ms, 1);
+        assert(events[event_count - 1].at_ms < window_end);
+
+        int next_event = 0;
+        int fired = 0;
+        while (virtual_ms + POLL_MS < window_end) {
+            virtual_ms += POLL_MS;
+            while (next_event < event_count && events[next_event].at_ms <= virtual_ms) {
+                pin_level[events[next_event].pin] = events[next_event].level;
+                next_event++;
+            }
+            button_action_t action = button_handler_get_action();
+            if (action == BTN_ACTION_NONE) {
+                continue;
+            }
+            if (action != expected || virtual_ms < release) {
+                printf("press %d (pin %d, at %lu, hold %lu): got %d at %lu, expected %d\n",
+                       i, press->pin, press->at_ms, press->hold_ms, action, virtual_ms, expected);
+                assert(0);
+            }
+            unsigned long latency = virtual_ms - release;
+            if (stats->actions < LOGGED_ACTIONS) {
+                stats->log[stats->actions] = action;
+            }
+            stats->actions++;
+            stats->total_latency_ms += latency;
+            if (latency > stats->worst_latency_ms) {
+                stats->worst_latency_ms = latency;
+            }
+            if (action == BTN_ACTION_CHANGE_MODE) {
+                player_state.mode = (player_state.mode + 1) % MODE_MAX;
+            }
+            fired++;
+        }
+        assert(fired == (expected == BTN_ACTION_NONE ? 0 : 1));
+        stats->presses++;
+    }
+
+    stats->virtual_ms = virtual_ms - start_ms;
+    button_handler_deinit();
+    ezButton_setIO(NULL);
+}
+
+static button_action_t single_press(int pin, unsigned long hold_ms, unsigned long bounce_ms, playback_mode_t mode) {
+    press_t press = { pin, 10000, hold_ms, bounce_ms };
+    replay_stats_t stats;
+    replay(&press, 1, mode, &stats);
+    return stats.actions ? stats.log[0] : BTN_ACTION_NONE;
+}
+
+void test_short_and_long_press() {
+    printf("Testing short and long press timing...\n");
+
+    // Both edges are debounced alike, so the measured hold is exact on tick boundaries
+    assert(single_press(BTN_FWD_PIN, 990, 0, MODE_PLAY_FOLDER_ORDER) == BTN_ACTION_NEXT);
+    assert(single_press(BTN_FWD_PIN, 1000, 0, MODE_PLAY_FOLDER_ORDER) == BTN_ACTION_NEXT_FOLDER);
+    assert(single_press(BTN_BCK_PIN, 1500, 0, MODE_PLAY_FOLDER_SHUFFLE) == BTN_ACTION_PREV_FOLDER);
+    assert(single_press(BTN_FWD_PIN, 1500, 0, MODE_PLAY_ALL_ORDER) == BTN_ACTION_NONE);
+    assert(single_press(BTN_MENU_PIN, 120, 0, MODE_PLAY_ALL_ORDER) == BTN_ACTION_CHANGE_MODE);
+
+    printf("✓ short and long press test passed\n");
+}
+
+void test_debounce() {
+    printf("Testing debounce...\n");
+
+    // A glitch shorter than the debounce time is not a press
+    press_t glitch = { BTN_FWD_PIN, 10000, 30, 0 };
+    replay_stats_t stats;
+    replay(&glitch, 1, MODE_PLAY_ALL_ORDER, &stats);
+    assert(stats.actions == 0);
+
+    // Chatter on both edges still gives exactly one action
+    press_t chatter = { BTN_FWD_PIN, 10000, 200, MAX_BOUNCE_MS };
+    replay(&chatter, 1, MODE_PLAY_ALL_ORDER, &stats);
+    assert(stats.actions == 1);
+
+    printf("✓ debounce test passed\n");
+}
+
+void test_restart_window() {
+    printf("Testing restart window...\n");
+
+    // Releases 10 s, 11.99 s, 14 s and 16.5 s into the run
+    press_t presses[] = {
+        { BTN_BCK_PIN, 9900, 100, 0 },
+        { BTN_BCK_PIN, 11890, 100, 0 },
+        { BTN_BCK_PIN, 13900, 100, 0 },
+        { BTN_BCK_PIN, 16400, 100, 0 },
+    };
+    replay_stats_t stats;
+    replay(presses, 4, MODE_PLAY_ALL_ORDER, &stats);
+    assert(stats.actions == 4);
+    assert(stats.log[0] == BTN_ACTION_RESTART_TRACK);
+    assert(stats.log[1] == BTN_ACTION_PREV);
+    assert(stats.log[2] == BTN_ACTION_RESTART_TRACK);
+    assert(stats.log[3] == BTN_ACTION_RESTART_TRACK);
+
+    printf("✓ restart window test passed\n");
+}
+
+// Keep random holds and gaps clear of the thresholds by more than
+// chatter and tick rounding can move them
+static unsigned long random_outside(unsigned long min, unsigned long max, unsigned long threshold) {
+    unsigned long guard = MAX_BOUNCE_MS + 2 * TICK_MS;
+    for (;;) {
+        unsigned long v = min + (unsigned long)rand() % (max - min);
+        if (v + guard < threshold || v > threshold + guard) {
+            return v;
+        }
+    }
+}
+
+void test_random_traces() {
+    printf("Testing random press traces...\n");
+
+    const int traces = 500;
+    const int presses_per_trace = 40;
+    const int pins[] = { BTN_FWD_PIN, BTN_BCK_PIN, BTN_MENU_PIN };
+    press_t presses[40];
+    replay_stats_t total = {0};
+
+    srand(44);
+    clock_t start = clock();
+    for (int trace = 0; trace < traces; trace++) {
+        unsigned long t = 10000;
+        for (int i = 0; i < presses_per_trace; i++) {
+            press_t *press = &presses[i];
+            press->pin = pins[rand() % 3];
+            press->bounce_ms = (unsigned long)rand() % (MAX_BOUNCE_MS + 1);
+            press->hold_ms = random_outside(DEBOUNCE_MS + 2 * MAX_BOUNCE_MS + 2 * TICK_MS, 2500, LONGPRESS_MS);
+            press->at_ms = t;
+            // Gaps between back releases stay clear of the restart window
+            t += press->hold_ms + random_outside(DEBOUNCE_MS + 2 * MAX_BOUNCE_MS + 2 * TICK_MS, 3000, RESTART_MS);
+        }
+        replay_stats_t stats;
+        replay(presses, presses_per_trace, (playback_mode_t)(rand() % MODE_MAX), &stats);
+        total.presses += stats.presses;
+        total.actions += stats.actions;
+        total.total_latency_ms += stats.total_latency_ms;
+        total.virtual_ms += stats.virtual_ms;
+        if (stats.worst_latency_ms > total.worst_latency_ms) {
+            total.worst_latency_ms = stats.worst_latency_ms;
+        }
+    }
+    double wall_ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+    printf("%d presses, %d actions over %.1f virtual minutes in %.0f ms (%.0fx real time)\n",
+           total.presses, total.actions, total.virtual_ms / 60000.0, wall_ms,
+           wall_ms > 0 ? total.virtual_ms / wall_ms : 0.0);
+    printf("Release-to-action latency: mean %.1f ms, worst %lu ms\n",
+           total.actions ? (double)total.total_latency_ms / total.actions : 0.0, total.worst_latency_ms);
+
+    // Chatter, then the debounce time, then at most one tick and one poll
+    assert(total.worst_latency_ms <= MAX_BOUNCE_MS + DEBOUNCE_MS + TICK_MS + POLL_MS);
+
+    printf("✓ random press traces test passed\n");
+}
+
+int main() {
+    printf("Running button timing tests...\n\n");
+
+    test_short_and_long_press();
+    test_debounce();
+    test_restart_window();
+    test_random_traces();
+
+    printf("\n✅ All button timing tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,412 @@
+#include "test_flac_encoder.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef struct {
+    uint8_t *data;
+    size_t cap;
+    size_t len;
+    uint64_t acc;
+    int bits;
+} bitwriter_t;
+
+static void put_byte(bitwriter_t *bw, uint8_t b) {
+    if (bw->len == bw->cap) {
+        bw->cap = bw->cap ? bw->cap * 2 : 65536;
+        bw->data = realloc(bw->data, bw->cap);
+    }
+    bw->data[bw->len++] = b;
+}
+
+static void put_bits(bitwriter_t *bw, uint32_t value, int n) {
+    if (n == 0) {
+        return;
+    }
+    bw->acc = (bw->acc << n) | (value & ((1ULL << n) - 1));
+    bw->bits += n;
+    while (bw->bits >= 8) {
+        bw->bits -= 8;
+        put_byte(bw, (uint8_t)(bw->acc >> bw->bits));
+    }
+}
+
+static void put_signed(bitwriter_t *bw, int32_t value, int n) {
+    put_bits(bw, (uint32_t)value, n);
+}
+
+static void put_unary(bitwriter_t *bw, uint32_t q) {
+    while (q >= 31) {
+        put_bits(bw, 0, 31);
+        q -= 31;
+    }
+    put_bits(bw, 1, q + 1);
+}
+
+static void align(bitwriter_t *bw) {
+    if (bw->bits > 0) {
+        put_bits(bw, 0, 8 - bw->bits);
+    }
+}
+
+static uint8_t crc8(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint16_t crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x8005) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void write_residual(bitwriter_t *bw, const int32_t *res, uint32_t n, uint32_t order) {
+    uint32_t partition_order = 0;
+    while (partition_order < 4 && (n % (2u << partition_order)) == 0 && (n >> (partition_order + 1)) > order) {
+        partition_order++;
+    }
+    uint32_t partitions = 1u << partition_order;
+    uint32_t partition_size = n >> partition_order;
+
+    // Pick a Rice parameter per partition from the mean folded residual
+    uint32_t params[16];
+    int method = 0;
+    for (uint32_t p = 0; p < partitions; p++) {
+        uint32_t start = p == 0 ? order : p * partition_size;
+        uint32_t end = (p + 1) * partition_size;
+        uint64_t sum = 0;
+        for (uint32_t i = start; i < end; i++) {
+            sum += ((uint32_t)res[i] << 1) ^ (uint32_t)(res[i] >> 31);
+        }
+        uint32_t count = end - start;
+        uint32_t k = 0;
+        while (k < 30 && ((uint64_t)count << (k + 1)) < sum) {
+            k++;
+        }
+        params[p] = (sum == 0 && count > 0) ? UINT32_MAX : k;
+        if (k > 14 && params[p] != UINT32_MAX) {
+            method = 1;
+        }
+    }
+
+    uint32_t escape = method ? 31 : 15;
+    put_bits(bw, method, 2);
+    put_bits(bw, partition_order, 4);
+    for (uint32_t p = 0; p < partitions; p++) {
+        uint32_t start = p == 0 ? order : p * partition_size;
+        uint32_t end = (p + 1) * partition_size;
+        if (params[p] == UINT32_MAX) {
+            // All-zero partition: escape with zero-bit samples
+            put_bits(bw, escape, method ? 5 : 4);
+            put_bits(bw, 0, 5);
+            continue;
+        }
+        put_bits(bw, params[p], method ? 5 : 4);
+        for (uint32_t i = start; i < end; i++) {
+            uint32_t u = ((uint32_t)res[i] << 1) ^ (uint32_t)(res[i] >> 31);
+            put_unary(bw, u >> params[p]);
+            put_bits(bw, u, params[p]);
+        }
+    }
+}
+
+// Quantized LPC coefficients by autocorrelation and Levinson-Durbin; returns false if unusable
+static int compute_lpc(const int32_t *x, uint32_t n, uint32_t order, uint32_t precision,
+                       int32_t *q, int *shift_out) {
+    double r[33] = {0};
+    for (uint32_t lag = 0; lag <= order; lag++) {
+        for (uint32_t i = lag; i < n; i++) {
+            r[lag] += (double)x[i] * x[i - lag];
+        }
+    }
+    if (r[0] == 0) {
+        return 0;
+    }
+    r[0] *= 1.0 + 1e-9;
+
+    double a[33] = {0};
+    double tmp[33];
+    double err = r[0];
+    for (uint32_t i = 1; i <= order; i++) {
+        double acc = r[i];
+        for (uint32_t j = 1; j < i; j++) {
+            acc -= a[j] * r[i - j];
+        }
+        double k = acc / err;
+        memcpy(tmp, a, sizeof(tmp));
+        a[i] = k;
+        for (uint32_t j = 1; j < i; j++) {
+            a[j] = tmp[j] - k * tmp[i - j];
+        }
+        err *= 1.0 - k * k;
+        if (err <= 0) {
+            return 0;
+        }
+    }
+
+    double cmax = 0;
+    for (uint32_t j = 1; j <= order; j++) {
+        if (fabs(a[j]) > cmax) cmax = fabs(a[j]);
+    }
+    if (cmax == 0) {
+        return 0;
+    }
+    int log2cmax;
+    frexp(cmax, &log2cmax);
+    int shift = (int)precision - log2cmax - 1;
+    if (shift > 15) shift = 15;
+    if (shift < 0) return 0;
+    int32_t qmax = (1 << (precision - 1)) - 1;
+    for (uint32_t j = 0; j < order; j++) {
+        long v = lround(a[j + 1] * (1 << shift));
+        if (v > qmax) v = qmax;
+        if (v < -qmax) v = -qmax;
+        q[j] = (int32_t)v;
+    }
+    *shift_out = shift;
+    return 1;
+}
+
+static void write_subframe(bitwriter_t *bw, const int32_t *in, uint32_t n, uint32_t bps,
+                           const test_flac_options_t *opt, int force_verbatim) {
+    int constant = 1;
+    uint32_t all = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        all |= (uint32_t)in[i];
+        if (in[i] != in[0]) constant = 0;
+    }
+    if (constant) {
+        put_bits(bw, 0, 1);
+        put_bits(bw, 0, 6);
+        put_bits(bw, 0, 1);
+        put_signed(bw, in[0], bps);
+        return;
+    }
+
+    uint32_t wasted = 0;
+    while (!(all & (1u << wasted)) && wasted < bps - 1) {
+        wasted++;
+    }
+    int32_t *x = malloc(n * sizeof(int32_t));
+    int32_t *res = malloc(n * sizeof(int32_t));
+    for (uint32_t i = 0; i < n; i++) {
+        x[i] = in[i] >> wasted;
+    }
+    bps -= wasted;
+
+    uint32_t type;
+    uint32_t order = 0;
+    uint32_t precision = bps <= 17 ? 12 : 14;
+    int32_t q[32];
+    int shift = 0;
+    if (force_verbatim || n <= 2) {
+        type = 1;
+    } else if (opt->lpc_order > 0 && n > opt->lpc_order * 2 &&
+               compute_lpc(x, n, opt->lpc_order, precision, q, &shift)) {
+        order = opt->lpc_order;
+        type = 32 + order - 1;
+    } else {
+        order = 2;
+        type = 10;
+    }
+
+    if (type != 1) {
+        for (uint32_t i = order; i < n; i++) {
+            int64_t pred;
+            if (type == 10) {
+                pred = 2 * (int64_t)x[i - 1] - x[i - 2];
+            } else {
+                int64_t sum = 0;
+                for (uint32_t j = 0; j < order; j++) sum += (int64_t)q[j] * x[i - 1 - j];
+                pred = sum >> shift;
+            }
+            int64_t r = x[i] - pred;
+            if (r > (1 << 30) || r < -(1 << 30)) {
+                type = 1;
+                break;
+            }
+            res[i] = (int32_t)r;
+        }
+    }
+
+    put_bits(bw, 0, 1);
+    put_bits(bw, type, 6);
+    if (wasted) {
+        put_bits(bw, 1, 1);
+        put_unary(bw, wasted - 1);
+    } else {
+        put_bits(bw, 0, 1);
+    }
+
+    if (type == 1) {
+        for (uint32_t i = 0; i < n; i++) put_signed(bw, x[i], bps);
+    } else {
+        for (uint32_t i = 0; i < order; i++) put_signed(bw, x[i], bps);
+        if (type >= 32) {
+            put_bits(bw, precision - 1, 4);
+            put_signed(bw, shift, 5);
+            for (uint32_t j = 0; j < order; j++) put_signed(bw, q[j], precision);
+        }
+        write_residual(bw, res, n, order);
+    }
+
+    free(x);
+    free(res);
+}
+
+static uint32_t block_size_code(uint32_t n) {
+    if (n == 192) return 1;
+    for (uint32_t c = 2; c <= 5; c++) if (n == (576u << (c - 2))) return c;
+    for (uint32_t c = 8; c <= 15; c++) if (n == (256u << (c - 8))) return c;
+    return n <= 256 ? 6 : 7;
+}
+
+static uint32_t sample_rate_code(uint32_t rate) {
+    static const uint32_t rates[12] = {0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000};
+    for (uint32_t c = 1; c < 12; c++) if (rates[c] == rate) return c;
+    return 0;
+}
+
+static uint32_t sample_size_code(uint16_t bit_depth) {
+    switch (bit_depth) {
+        case 8: return 1;
+        case 12: return 2;
+        case 16: return 4;
+        case 20: return 5;
+        case 24: return 6;
+        default: return 0;
+    }
+}
+
+static void write_frame(bitwriter_t *bw, const int32_t *samples, size_t first, uint32_t n,
+                        uint32_t frame_number, uint32_t sample_rate, uint16_t channels,
+                        uint16_t bit_depth, const test_flac_options_t *opt) {
+    size_t start = bw->len;
+
+    // Stereo frames cycle through every decorrelation mode
+    uint32_t assignment = channels == 2 ? (uint32_t[]){1, 8, 9, 10}[frame_number % 4] : 0;
+    uint32_t bs_code = block_size_code(n);
+
+    put_bits(bw, 0xFFF8, 16);
+    put_bits(bw, bs_code, 4);
+    put_bits(bw, sample_rate_code(sample_rate), 4);
+    put_bits(bw, assignment, 4);
+    put_bits(bw, sample_size_code(bit_depth), 3);
+    put_bits(bw, 0, 1);
+
+    // UTF-8 style frame number
+    if (frame_number < 0x80) {
+        put_bits(bw, frame_number, 8);
+    } else if (frame_number < 0x800) {
+        put_bits(bw, 0xC0 | (frame_number >> 6), 8);
+        put_bits(bw, 0x80 | (frame_number & 0x3F), 8);
+    } else {
+        put_bits(bw, 0xE0 | (frame_number >> 12), 8);
+        put_bits(bw, 0x80 | ((frame_number >> 6) & 0x3F), 8);
+        put_bits(bw, 0x80 | (frame_number & 0x3F), 8);
+    }
+    if (bs_code == 6) put_bits(bw, n - 1, 8);
+    if (bs_code == 7) put_bits(bw, n - 1, 16);
+    put_bits(bw, crc8(bw->data + start, bw->len - start), 8);
+
+    int32_t *ch[2];
+    ch[0] = malloc(n * sizeof(int32_t));
+    ch[1] = malloc(n * sizeof(int32_t));
+    for (uint32_t i = 0; i < n; i++) {
+        int32_t l = samples[(first + i) * channels];
+        int32_t r = channels == 2 ? samples[(first + i) * channels + 1] : 0;
+        switch (assignment) {
+            case 8:  ch[0][i] = l; ch[1][i] = l - r; break;
+            case 9:  ch[0][i] = l - r; ch[1][i] = r; break;
+            case 10: ch[0][i] = (l + r) >> 1; ch[1][i] = l - r; break;
+            default: ch[0][i] = l; ch[1][i] = r; break;
+        }
+    }
+    for (uint16_t c = 0; c < channels; c++) {
+        uint32_t bps = bit_depth;
+        if ((assignment == 8 && c == 1) || (assignment == 9 && c == 0) || (assignment == 10 && c == 1)) {
+            bps++;
+        }
+        // Every seventh frame stores its first channel verbatim
+        write_subframe(bw, ch[c], n, bps, opt, c == 0 && frame_number % 7 == 6);
+    }
+    free(ch[0]);
+    free(ch[1]);
+
+    align(bw);
+    uint16_t crc = crc16(bw->data + start, bw->len - start);
+    put_bits(bw, crc, 16);
+}
+
+uint8_t *test_flac_encode(const int32_t *samples, size_t frames, uint32_t sample_rate,
+                          uint16_t channels, uint16_t bit_depth,
+                          const test_flac_options_t *options, size_t *out_size) {
+    if (channels < 1 || channels > 2 || bit_depth < 4 || bit_depth > 24 || options->block_size < 16) {
+        return NULL;
+    }
+
+    // Encode the frames first so the seek table can point into them
+    bitwriter_t body = {0};
+    size_t frame_count = (frames + options->block_size - 1) / options->block_size;
+    size_t *offsets = malloc((frame_count + 1) * sizeof(size_t));
+    for (size_t f = 0; f < frame_count; f++) {
+        size_t first = f * options->block_size;
+        uint32_t n = (uint32_t)(frames - first < options->block_size ? frames - first : options->block_size);
+        offsets[f] = body.len;
+        write_frame(&body, samples, first, n, (uint32_t)f, sample_rate, channels, bit_depth, options);
+    }
+
+    uint32_t seek_points = options->seek_interval ? (uint32_t)((frame_count + options->seek_interval - 1) / options->seek_interval) : 0;
+
+    bitwriter_t out = {0};
+    put_bits(&out, 0x664C6143, 32);     // "fLaC"
+
+    put_bits(&out, seek_points == 0, 1);
+    put_bits(&out, 0, 7);               // STREAMINFO
+    put_bits(&out, 34, 24);
+    put_bits(&out, options->block_size, 16);
+    put_bits(&out, options->block_size, 16);
+    put_bits(&out, 0, 24);
+    put_bits(&out, 0, 24);
+    put_bits(&out, sample_rate, 20);
+    put_bits(&out, channels - 1, 3);
+    put_bits(&out, bit_depth - 1, 5);
+    put_bits(&out, (uint32_t)((uint64_t)frames >> 32), 4);
+    put_bits(&out, (uint32_t)frames, 32);
+    for (int i = 0; i < 4; i++) put_bits(&out, 0, 32);     // MD5 not computed
+
+    if (seek_points > 0) {
+        put_bits(&out, 1, 1);
+        put_bits(&out, 3, 7);           // SEEKTABLE
+        put_bits(&out, seek_points * 18, 24);
+        for (uint32_t p = 0; p < seek_points; p++) {
+            size_t f = (size_t)p * options->seek_interval;
+            uint64_t sample = (uint64_t)f * options->block_size;
+            put_bits(&out, (uint32_t)(sample >> 32), 32);
+            put_bits(&out, (uint32_t)sample, 32);
+            put_bits(&out, 0, 32);
+            put_bits(&out, (uint32_t)offsets[f], 32);
+            put_bits(&out, options->block_size, 16);
+        }
+    }
+
+    for (size_t i = 0; i < body.len; i++) {
+        put_byte(&out, body.data[i]);
+    }
+    free(body.data);
+    free(offsets);
+
+    *out_size = out.len;
+    return out.data;
+}
@@ -0,0 +1,34 @@
+#ifndef TEST_FLAC_ENCODER_H
+#define TEST_FLAC_ENCODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Minimal FLAC encoder for host tests and benchmarks. It covers the stream
+// features the decoder must handle: STREAMINFO, SEEKTABLE, all stereo
+// decorrelation modes, constant/verbatim/fixed/LPC subframes, wasted bits and
+// partitioned Rice residuals with 4- and 5-bit parameters.
+
+typedef struct {
+    uint32_t block_size;        // Samples per frame, at most FLAC_MAX_BLOCK_SIZE
+    uint32_t lpc_order;         // 0 uses fixed order-2 prediction, otherwise LPC of this order (up to 32)
+    uint32_t seek_interval;     // Frames between seek points, 0 for no SEEKTABLE
+} test_flac_options_t;
+
+/**
+ * @brief Encode interleaved samples as a FLAC stream
+ *
+ * @param samples Interleaved samples, right-aligned at bit_depth
+ * @param frames Number of frames (samples per channel)
+ * @param sample_rate Sample rate in Hz
+ * @param channels Number of channels (1 or 2)
+ * @param bit_depth Bits per sample (4 to 24)
+ * @param options Encoder settings
+ * @param out_size Pointer to store the stream size
+ * @return Stream allocated with malloc, NULL on failure
+ */
+uint8_t *test_flac_encode(const int32_t *samples, size_t frames, uint32_t sample_rate,
+                          uint16_t channels, uint16_t bit_depth,
+                          const test_flac_options_t *options, size_t *out_size);
+
+#endif // TEST_FLAC_ENCODER_H
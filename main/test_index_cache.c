@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "index_cache.h"
+
+// Mock SD card functions
+const char* sd_card_get_mount_point() { return "/test"; }
+
+static void write_index_json(const char *filename, const char *album) {
+    FILE *file = fopen(filename, "w");
+    assert(file != NULL);
+    fprintf(file,
+    "{\n"
+    "  \"version\": \"1.1\",\n"
+    "  \"allFiles\": [\n"
+    "    {\n"
+    "      \"name\": \"song1.pcm\", \"path\": \"Pop/song1.pcm\",\n"
+    "      \"sampleRate\": 44100, \"bitDepth\": 16, \"channels\": 2,\n"
+    "      \"folderIndex\": 0, \"trackGain\": -6.5, \"trackPeak\": 0.9,\n"
+    "      \"song\": \"Song One\", \"album\": \"%s\", \"artist\": \"Artist A\"\n"
+    "    },\n"
+    "    {\n"
+    "      \"name\": \"song2.mp3\", \"path\": \"Rock/song2.mp3\",\n"
+    "      \"format\": \"mp3\", \"frameCount\": 2500, \"frameInterval\": 1000,\n"
+    "      \"frameOffsets\": [417, 418017, 835617],\n"
+    "      \"folderIndex\": 1, \"song\": \"Song Two\"\n"
+    "    },\n"
+    "    {\n"
+    "      \"name\": \"song3.wav\", \"path\": \"Rock/song3.wav\",\n"
+    "      \"format\": \"ima_adpcm\", \"blockAlign\": 1024, \"channels\": 2,\n"
+    "      \"sampleRate\": 22050, \"folderIndex\": 1, \"albumGain\": 2.0\n"
+    "    }\n"
+    "  ],\n"
+    "  \"musicFolders\": [\n"
+    "    {\n"
+    "      \"name\": \"Pop\",\n"
+    "      \"files\": [ { \"name\": \"song1.pcm\", \"path\": \"Pop/song1.pcm\", \"sampleRate\": 44100 } ]\n"
+    "    },\n"
+    "    {\n"
+    "      \"name\": \"Rock\",\n"
+    "      \"files\": [\n"
+    "        { \"name\": \"song2.mp3\", \"path\": \"Rock/song2.mp3\", \"format\": \"mp3\" },\n"
+    "        { \"name\": \"song3.wav\", \"path\": \"Rock/song3.wav\", \"format\": \"ima_adpcm\" }\n"
+    "      ]\n"
+    "    }\n"
+    "  ]\n"
+    "}\n", album);
+    fclose(file);
+}
+
+static void assert_entries_equal(const file_entry_t *a, const file_entry_t *b) {
+    assert(strcmp(a->name, b->name) == 0);
+    assert(strcmp(a->path, b->path) == 0);
+    assert(strcmp(a->song, b->song) == 0);
+    assert(strcmp(a->album, b->album) == 0);
+    assert(strcmp(a->artist, b->artist) == 0);
+    assert(a->sample_rate == b->sample_rate);
+    assert(a->bit_depth == b->bit_depth);
+    assert(a->channels == b->channels);
+    assert(a->codec == b->codec);
+    assert(a->block_align == b->block_align);
+    assert(a->folder_index == b->folder_index);
+    assert(a->position == b->position);
+    assert(a->has_track_gain == b->has_track_gain);
+    assert(a->track_gain_db == b->track_gain_db);
+    assert(a->track_peak == b->track_peak);
+    assert(a->has_album_gain == b->has_album_gain);
+    assert(a->album_gain_db == b->album_gain_db);
+    assert(a->frame_index.frame_count == b->frame_index.frame_count);
+    assert(a->frame_index.interval == b->frame_index.interval);
+    assert(a->frame_index.count == b->frame_index.count);
+    assert((a->frame_index.offsets == NULL) == (b->frame_index.offsets == NULL));
+    if (a->frame_index.offsets != NULL) {
+        assert(memcmp(a->frame_index.offsets, b->frame_index.offsets, a->frame_index.count * sizeof(uint32_t)) == 0);
+    }
+}
+
+void test_index_cache_round_trip() {
+    printf("Testing index cache round trip...\n");
+
+    const char *test_file = "test_index_cache.json";
+    write_index_json(test_file, "Pop Hits");
+
+    index_cache_key_t key;
+    assert(index_cache_key(test_file, &key) == ESP_OK);
+
+    // Nothing cached yet
+    index_file_t cached;
+    assert(index_cache_load(&key, &cached) == ESP_ERR_NOT_FOUND);
+
+    index_file_t parsed;
+    assert(json_parse_index(test_file, &parsed) == ESP_OK);
+    assert(index_cache_store(&key, &parsed) == ESP_OK);
+
+    assert(index_cache_load(&key, &cached) == ESP_OK);
+    assert(strcmp(cached.version, parsed.version) == 0);
+    assert(cached.total_files == parsed.total_files);
+    assert(cached.folder_count == parsed.folder_count);
+    assert(cached.pager == NULL);
+    // The image records the arena size, so the load takes one exact block
+    assert(cached.arena.chunks == 1);
+    assert(cached.arena.used == cached.arena.capacity);
+    for (int i = 0; i < parsed.total_files; i++) {
+        assert_entries_equal(&cached.all_files[i], &parsed.all_files[i]);
+    }
+    for (int i = 0; i < parsed.folder_count; i++) {
+        assert(strcmp(cached.music_folders[i].name, parsed.music_folders[i].name) == 0);
+        assert(cached.music_folders[i].file_count == parsed.music_folders[i].file_count);
+        for (int j = 0; j < parsed.music_folders[i].file_count; j++) {
+            assert_entries_equal(&cached.music_folders[i].files[j], &parsed.music_folders[i].files[j]);
+        }
+    }
+    assert(cached.all_files[1].frame_index.offsets[2] == 835617);
+    // The path table is rebuilt after the load, outside the arena
+    assert(cached.paths.slots != NULL);
+    for (int i = 0; i < parsed.total_files; i++) {
+        assert(json_index_find(&cached, parsed.all_files[i].path) == i);
+    }
+    json_free_index(&cached);
+
+    // Same size, different content: the hash tells them apart
+    write_index_json(test_file, "Pop Hitz");
+    index_cache_key_t changed;
+    assert(index_cache_key(test_file, &changed) == ESP_OK);
+    assert(changed.size == key.size);
+    assert(changed.hash != key.hash);
+    assert(index_cache_load(&changed, &cached) == ESP_ERR_NOT_FOUND);
+    assert(cached.all_files == NULL);
+
+    json_free_index(&parsed);
+    unlink(test_file);
+    printf("✓ index cache round trip test passed\n");
+}
+
+void test_index_cache_rejects() {
+    printf("Testing index cache rejects...\n");
+
+    index_cache_key_t key = {0};
+    index_file_t index;
+    assert(index_cache_key("missing.json", &key) == ESP_FAIL);
+    assert(index_cache_load(NULL, &index) == ESP_ERR_INVALID_ARG);
+
+    // Paged indexes read their pages from the card and are not cached
+    memset(&index, 0, sizeof(index));
+    index.pager = (json_index_pager_t *)&key;
+    assert(index_cache_store(&key, &index) == ESP_ERR_INVALID_ARG);
+
+    printf("✓ index cache rejects test passed\n");
+}
+
+int main() {
+    printf("Running index cache unit tests...\n\n");
+
+    test_index_cache_round_trip();
+    test_index_cache_rejects();
+
+    printf("\n✅ All index cache tests passed!\n");
+    return 0;
+}
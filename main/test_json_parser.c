@@ -20,6 +20,7 @@ const char* sd_card_get_mount_point() { return "/test"; }
 #endif
 
 #include "json_parser.h"
+#include "mem_policy.h"
 
 // Create test index.json file with new format
 void create_test_index_json(const char* filename) {
@@ -49,6 +50,10 @@ void create_test_index_json(const char* filename) {
     "      \"bitDepth\": 24,\n"
     "      \"channels\": 2,\n"
     "      \"folderIndex\": 0,\n"
+    "      \"trackGain\": -6.5,\n"
+    "      \"trackPeak\": 0.98,\n"
+    "      \"albumGain\": -5.25,\n"
+    "      \"albumPeak\": 1.02,\n"
     "      \"song\": \"Song Two\",\n"
     "      \"album\": \"Pop Hits\",\n"
     "      \"artist\": \"Artist B\"\n"
@@ -60,6 +65,8 @@ void create_test_index_json(const char* filename) {
     "      \"bitDepth\": 16,\n"
     "      \"channels\": 2,\n"
     "      \"folderIndex\": 1,\n"
+    "      \"format\": \"ima_adpcm\",\n"
+    "      \"blockAlign\": 1024,\n"
     "      \"song\": \"Rock Anthem\",\n"
     "      \"album\": \"Rock Collection\",\n"
     "      \"artist\": \"Artist C\"\n"
@@ -144,11 +151,24 @@ void test_json_parse_index() {
     assert(index.all_files[1].sample_rate == 48000);
     assert(index.all_files[1].bit_depth == 24);
     assert(index.all_files[1].folder_index == 0);
+    assert(index.all_files[1].has_track_gain);
+    assert(index.all_files[1].track_gain_db == -6.5f);
+    assert(index.all_files[1].track_peak > 0.979f && index.all_files[1].track_peak < 0.981f);
+    assert(index.all_files[1].has_album_gain);
+    assert(index.all_files[1].album_gain_db == -5.25f);
+    assert(index.all_files[1].album_peak > 1.019f && index.all_files[1].album_peak < 1.021f);
+    
+    // Files without loudness data play at unity gain
+    assert(!index.all_files[0].has_track_gain);
+    assert(!index.all_files[0].has_album_gain);
     
     // Test third file in different folder
     assert(strcmp(index.all_files[2].name, "song3.pcm") == 0);
     assert(index.all_files[2].folder_index == 1);
     assert(strcmp(index.all_files[2].song, "Rock Anthem") == 0);
+    assert(index.all_files[2].codec == PCM_CODEC_IMA_ADPCM);
+    assert(index.all_files[2].block_align == 1024);
+    assert(index.all_files[0].codec == PCM_CODEC_RAW);
     
     // Test musicFolders array
     assert(index.music_folders != NULL);
@@ -167,11 +187,189 @@ void test_json_parse_index() {
     assert(index.music_folders[1].files != NULL);
     assert(strcmp(index.music_folders[1].files[0].name, "song3.pcm") == 0);
     
+    // Folder entries know where their track sits in allFiles
+    for (int i = 0; i < index.total_files; i++) {
+        assert(index.all_files[i].position == i);
+    }
+    assert(index.music_folders[0].files[1].position == 1);
+    assert(index.music_folders[1].files[0].position == 2);
+    
     json_free_index(&index);
     unlink(test_file);
     printf("✓ json_parse_index test passed\n");
 }
 
+void test_json_parse_mp3_frame_index() {
+    printf("Testing MP3 frame index parsing...\n");
+    
+    const char* test_file = "test_index_mp3.json";
+    FILE* file = fopen(test_file, "w");
+    assert(file != NULL);
+    fprintf(file, "%s",
+    "{\n"
+    "  \"version\": \"1.1\",\n"
+    "  \"allFiles\": [\n"
+    "    {\n"
+    "      \"name\": \"song4.mp3\",\n"
+    "      \"path\": \"Rock/song4.mp3\",\n"
+    "      \"sampleRate\": 44100,\n"
+    "      \"bitDepth\": 16,\n"
+    "      \"channels\": 2,\n"
+    "      \"format\": \"mp3\",\n"
+    "      \"frameCount\": 2500,\n"
+    "      \"frameInterval\": 1000,\n"
+    "      \"frameOffsets\": [ 417, 418017,\n 835617 ],\n"
+    "      \"song\": \"Song Four\"\n"
+    "    }\n"
+    "  ],\n"
+    "  \"musicFolders\": [\n"
+    "    {\n"
+    "      \"name\": \"Rock\",\n"
+    "      \"files\": [\n"
+    "        {\n"
+    "          \"name\": \"song4.mp3\",\n"
+    "          \"format\": \"mp3\",\n"
+    "          \"frameOffsets\": [417, 418017, 835617]\n"
+    "        }\n"
+    "      ]\n"
+    "    }\n"
+    "  ]\n"
+    "}");
+    fclose(file);
+    
+    index_file_t index;
+    assert(json_parse_index(test_file, &index) == ESP_OK);
+    assert(index.total_files == 1);
+    assert(index.all_files[0].codec == PCM_CODEC_MP3);
+    assert(index.all_files[0].frame_index.frame_count == 2500);
+    assert(index.all_files[0].frame_index.interval == 1000);
+    assert(index.all_files[0].frame_index.count == 3);
+    assert(index.all_files[0].frame_index.offsets[0] == 417);
+    assert(index.all_files[0].frame_index.offsets[1] == 418017);
+    assert(index.all_files[0].frame_index.offsets[2] == 835617);
+    assert(strcmp(index.all_files[0].song, "Song Four") == 0);
+    
+    // Folder entries are only for browsing and do not carry the table
+    assert(index.music_folders[0].files[0].codec == PCM_CODEC_MP3);
+    assert(index.music_folders[0].files[0].frame_index.offsets == NULL);
+    
+    json_free_index(&index);
+    unlink(test_file);
+    printf("✓ MP3 frame index parsing test passed\n");
+}
+
+// Write an index with folders * files_per_folder allFiles entries, grouped by folder
+static void create_large_index_json(const char *filename, int folders, int files_per_folder, bool grouped) {
+    FILE *file = fopen(filename, "w");
+    assert(file != NULL);
+    fprintf(file, "{\n  \"version\": \"1.1\",\n  \"allFiles\": [\n");
+    int total = folders * files_per_folder;
+    for (int i = 0; i < total; i++) {
+        int folder = grouped ? i / files_per_folder : i % folders;
+        int n = grouped ? i % files_per_folder : i / folders;
+        fprintf(file,
+                "    {\n"
+                "      \"name\": \"track%02d.mp3\",\n"
+                "      \"path\": \"Artist %03d/track%02d.mp3\",\n"
+                "      \"sampleRate\": 44100, \"bitDepth\": 16, \"channels\": 2,\n"
+                "      \"format\": \"mp3\", \"frameCount\": 9000, \"frameInterval\": 1000,\n"
+                "      \"frameOffsets\": [%d, %d],\n"
+                "      \"folderIndex\": %d,\n"
+                "      \"comment\": \"brace \\\"}\\\" in a string\",\n"
+                "      \"song\": \"Song {%d}\",\n"
+                "      \"album\": \"Album %03d\",\n"
+                "      \"artist\": \"Artist %03d\"\n"
+                "    }%s\n",
+                n, folder, n, i, i + 1, folder, i, folder, folder, i + 1 < total ? "," : "");
+    }
+    fprintf(file, "  ],\n  \"musicFolders\": []\n}\n");
+    fclose(file);
+}
+
+void test_json_parse_index_paged() {
+    printf("Testing paged index...\n");
+
+    const char *test_file = "test_index_paged.json";
+    create_large_index_json(test_file, 120, 10, true);
+
+    // Large indexes are paged automatically
+    index_file_t index;
+    assert(json_parse_index(test_file, &index) == ESP_OK);
+    assert(index.pager != NULL);
+    assert(index.all_files == NULL && index.music_folders == NULL);
+    assert(strcmp(index.version, "1.1") == 0);
+    assert(index.total_files == 1200);
+    assert(index.folder_count == 120);
+    assert(json_index_folder_size(&index, 0) == 10);
+    assert(json_index_folder_size(&index, 119) == 10);
+    assert(json_index_folder_size(&index, 120) == 0);
+
+    file_entry_t *entry = json_index_file(&index, 537);
+    assert(entry != NULL);
+    assert(strcmp(entry->path, "Artist 053/track07.mp3") == 0);
+    assert(strcmp(entry->song, "Song {537}") == 0);
+    assert(entry->folder_index == 53);
+    assert(entry->codec == PCM_CODEC_MP3);
+    assert(entry->frame_index.count == 2);
+    assert(entry->frame_index.offsets[1] == 538);
+
+    entry = json_index_folder_file(&index, 53, 7);
+    assert(entry != NULL && strcmp(entry->path, "Artist 053/track07.mp3") == 0);
+    assert(entry->position == 537);
+    assert(json_index_folder_file(&index, 53, 10) == NULL);
+    assert(json_index_file(&index, 1200) == NULL);
+
+    // Repeated use of a page is served from RAM
+    json_page_stats_t stats;
+    json_index_get_page_stats(&index, &stats);
+    assert(stats.loads == 1);
+    assert(stats.hits == 1);
+
+    assert(json_index_find(&index, "Artist 119/track09.mp3") == 1199);
+    assert(json_index_find(&index, "Artist 000/track00.mp3") == 0);
+    assert(json_index_find(&index, "Artist 053/missing.mp3") == -1);
+    assert(json_index_find(&index, "Nowhere/track00.mp3") == -1);
+
+    // Walking the whole library keeps only a bounded set of pages
+    for (int i = 0; i < index.total_files; i++) {
+        entry = json_index_file(&index, i);
+        assert(entry != NULL && entry->folder_index == i / 10);
+    }
+    json_index_get_page_stats(&index, &stats);
+    assert(stats.resident_pages > 0);
+    assert(stats.resident_pages < 1200 / JSON_PAGE_FILES);
+
+    json_free_index(&index);
+    assert(index.pager == NULL);
+
+    // Small indexes can be paged explicitly
+    create_large_index_json(test_file, 3, 5, true);
+    assert(json_parse_index_paged(test_file, &index) == ESP_OK);
+    assert(index.total_files == 15);
+    assert(strcmp(json_index_folder_file(&index, 2, 4)->path, "Artist 002/track04.mp3") == 0);
+    json_free_index(&index);
+
+    // Without room for the path hashes the index still pages and lookups scan the folders
+    create_large_index_json(test_file, 120, 10, true);
+    mem_test_limit_realloc(4096);
+    assert(json_parse_index_paged(test_file, &index) == ESP_OK);
+    mem_test_limit_realloc(0);
+    assert(index.paths.slots == NULL);
+    assert(index.total_files == 1200);
+    assert(json_index_find(&index, "Artist 119/track09.mp3") == 1199);
+    assert(json_index_find(&index, "Artist 053/track07.mp3") == 537);
+    assert(json_index_find(&index, "Artist 053/missing.mp3") == -1);
+    json_free_index(&index);
+
+    // Folders split across allFiles cannot be paged
+    create_large_index_json(test_file, 3, 5, false);
+    assert(json_parse_index_paged(test_file, &index) == ESP_FAIL);
+    assert(index.pager == NULL);
+
+    unlink(test_file);
+    printf("✓ paged index test passed\n");
+}
+
 void test_json_get_full_path() {
     printf("Testing json_get_full_path...\n");
     
@@ -221,10 +419,105 @@ void test_json_free_index() {
     printf("✓ json_free_index test passed\n");
 }
 
+void test_json_index_arena() {
+    printf("Testing index arena...\n");
+
+    const char *test_file = "test_index_arena.json";
+    create_large_index_json(test_file, 20, 5, true);
+
+    // The whole index comes out of one block sized up front
+    index_file_t index;
+    assert(json_parse_index(test_file, &index) == ESP_OK);
+    assert(index.pager == NULL);
+    assert(index.total_files == 100);
+    assert(index.arena.chunks == 1);
+    assert(index.arena.used == index.arena.capacity);
+    const uint8_t *start = (const uint8_t *)index.all_files;
+    const uint8_t *end = start + index.arena.capacity;
+    for (int i = 0; i < index.total_files; i++) {
+        const mp3_frame_index_t *frames = &index.all_files[i].frame_index;
+        assert(frames->count == 2 && frames->offsets[0] == (uint32_t)i && frames->offsets[1] == (uint32_t)i + 1);
+        assert((const uint8_t *)frames->offsets > start && (const uint8_t *)frames->offsets < end);
+    }
+
+    // Objects are parsed in place; braces inside strings do not end them
+    char song[32];
+    snprintf(song, sizeof(song), "Song {%d}", 42);
+    assert(strcmp(index.all_files[42].song, song) == 0);
+    assert(strcmp(index.all_files[99].artist, "Artist 019") == 0);
+
+    assert(json_free_index(&index) == ESP_OK);
+    assert(index.arena.chunks == 0);
+    assert(index.all_files == NULL && index.music_folders == NULL);
+
+    unlink(test_file);
+    printf("✓ index arena test passed\n");
+}
+
+void test_json_index_find() {
+    printf("Testing path lookup...\n");
+
+    const char *test_file = "test_index_find.json";
+    create_large_index_json(test_file, 20, 10, true);
+
+    // Lookups go through a table built with the index, at most three quarters full
+    index_file_t index;
+    assert(json_parse_index(test_file, &index) == ESP_OK);
+    assert(index.pager == NULL);
+    assert(index.paths.slots != NULL);
+    assert(index.paths.count * 3 >= 4 * (uint32_t)index.total_files);
+    for (int i = 0; i < index.total_files; i++) {
+        assert(json_index_find(&index, index.all_files[i].path) == i);
+    }
+    assert(json_index_find(&index, "Artist 003/track99.mp3") == -1);
+    assert(json_index_find(&index, "Artist 003/track0") == -1);
+    assert(json_index_find(&index, "") == -1);
+    assert(json_index_find(&index, NULL) == -1);
+
+    // Without the table the same answers come from a scan
+    json_path_table_t paths = index.paths;
+    index.paths.slots = NULL;
+    assert(json_index_find(&index, index.all_files[137].path) == 137);
+    assert(json_index_find(&index, "Artist 003/track99.mp3") == -1);
+    index.paths = paths;
+    json_free_index(&index);
+    assert(index.paths.slots == NULL);
+
+    // A table that would take more than its share of the free memory is skipped
+    mem_test_limit_realloc(4 * 267 * JSON_PATH_TABLE_SHARE - 1);
+    assert(json_parse_index(test_file, &index) == ESP_OK);
+    mem_test_limit_realloc(0);
+    assert(index.paths.slots == NULL);
+    assert(json_index_find(&index, index.all_files[137].path) == 137);
+    json_free_index(&index);
+
+    // A path listed twice resolves to its first entry
+    FILE *file = fopen(test_file, "w");
+    assert(file != NULL);
+    fprintf(file, "{\"allFiles\": ["
+                  "{\"name\": \"a.pcm\", \"path\": \"Pop/a.pcm\"},"
+                  "{\"name\": \"b.pcm\", \"path\": \"Pop/b.pcm\"},"
+                  "{\"name\": \"a.pcm\", \"path\": \"Pop/a.pcm\"}"
+                  "], \"musicFolders\": []}");
+    fclose(file);
+    assert(json_parse_index(test_file, &index) == ESP_OK);
+    assert(index.total_files == 3);
+    assert(json_index_find(&index, "Pop/a.pcm") == 0);
+    assert(json_index_find(&index, "Pop/b.pcm") == 1);
+    json_free_index(&index);
+
+    unlink(test_file);
+    printf("✓ path lookup test passed\n");
+}
+
 int main() {
     printf("Running JSON parser unit tests...\n\n");
     
     test_json_parse_index();
+    test_json_parse_mp3_frame_index();
+    test_json_parse_index_paged();
+    test_json_index_arena();
+    test_json_index_find();
     test_json_get_full_path();
     test_json_invalid_args();
     test_json_free_index();
@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "library_scanner.h"
+#include "json_parser.h"
+
+// Mock SD card functions
+const char* sd_card_get_mount_point() { return "/test"; }
+
+#define LIBRARY "test_library"
+
+static void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    put_le16(p, v & 0xFFFF);
+    put_le16(p + 2, v >> 16);
+}
+
+static void write_bytes(const char *path, const uint8_t *data, size_t len, size_t padding) {
+    FILE *file = fopen(path, "wb");
+    assert(file != NULL);
+    fwrite(data, 1, len, file);
+    for (size_t i = 0; i < padding; i++) {
+        fputc(0, file);
+    }
+    fclose(file);
+}
+
+static void write_esp32pcm(const char *path, uint32_t rate, uint16_t bits, uint16_t channels) {
+    uint8_t header[32] = "ESP32PCM";
+    put_le32(header + 8, rate);
+    put_le16(header + 12, bits);
+    put_le16(header + 14, channels);
+    write_bytes(path, header, sizeof(header), 256);
+}
+
+static void write_wav(const char *path, uint16_t tag, uint32_t rate, uint16_t channels, uint16_t block_align, uint16_t bits) {
+    // A LIST chunk ahead of fmt has to be stepped over
+    uint8_t header[48] = "RIFF\0\0\0\0WAVELIST\4\0\0\0INFOfmt ";
+    put_le32(header + 28, 16);
+    put_le16(header + 32, tag);
+    put_le16(header + 34, channels);
+    put_le32(header + 36, rate);
+    put_le16(header + 44, block_align);
+    put_le16(header + 46, bits);
+    write_bytes(path, header, sizeof(header), 128);
+}
+
+static void write_flac(const char *path, uint32_t rate, uint16_t channels, uint16_t bits) {
+    uint8_t header[42] = "fLaC";
+    header[4] = 0x80;   // Last metadata block, STREAMINFO
+    header[7] = 34;
+    header[18] = rate >> 12;
+    header[19] = rate >> 4;
+    header[20] = ((rate & 0x0F) << 4) | ((channels - 1) << 1) | ((bits - 1) >> 4);
+    header[21] = ((bits - 1) & 0x0F) << 4;
+    write_bytes(path, header, sizeof(header), 64);
+}
+
+// MPEG-1 Layer III, 128 kbps, 44.1 kHz: 417-byte frames
+static void write_mp3(const char *path, int frames) {
+    FILE *file = fopen(path, "wb");
+    assert(file != NULL);
+    const uint8_t hdr[4] = {0xFF, 0xFB, 0x90, 0x40};
+    for (int i = 0; i < frames; i++) {
+        fwrite(hdr, 1, 4, file);
+        for (int j = 4; j < 417; j++) {
+            fputc(0, file);
+        }
+    }
+    fclose(file);
+}
+
+static char *read_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    assert(file != NULL);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = malloc(size + 1);
+    assert(fread(text, 1, size, file) == (size_t)size);
+    text[size] = '\0';
+    fclose(file);
+    return text;
+}
+
+static void create_library(void) {
+    assert(system("rm -rf " LIBRARY) == 0);
+    mkdir(LIBRARY, 0755);
+    mkdir(LIBRARY "/Pop", 0755);
+    mkdir(LIBRARY "/Rock", 0755);
+    mkdir(LIBRARY "/Rock/Live", 0755);
+    mkdir(LIBRARY "/Empty", 0755);
+    write_esp32pcm(LIBRARY "/intro.pcm", 48000, 24, 2);
+    write_wav(LIBRARY "/Pop/b_song.wav", 1, 22050, 1, 2, 16);
+    write_esp32pcm(LIBRARY "/Pop/a_song.pcm", 44100, 16, 2);
+    write_bytes(LIBRARY "/Pop/cover.jpg", (const uint8_t *)"jpg", 3, 0);
+    write_mp3(LIBRARY "/Rock/anthem.mp3", 600);
+    write_flac(LIBRARY "/Rock/ballad.flac", 96000, 2, 24);
+    write_wav(LIBRARY "/Rock/Live/encore.wav", 0x11, 44100, 2, 1024, 4);
+    // Not a WAV file, skipped
+    write_bytes(LIBRARY "/Rock/Live/broken.wav", (const uint8_t *)"garbage", 7, 64);
+}
+
+void test_library_scan() {
+    printf("Testing library scan...\n");
+    create_library();
+
+    library_scan_stats_t stats;
+    assert(library_scanner_run(LIBRARY, &stats) == ESP_OK);
+    assert(stats.dirs_scanned == 4);
+    assert(stats.dirs_reused == 0);
+    assert(stats.files == 6);
+    assert(stats.folders == 4);
+    assert(stats.skipped == 1);
+
+    index_file_t index;
+    assert(json_parse_index(LIBRARY "/index.json", &index) == ESP_OK);
+    assert(index.total_files == 6);
+    assert(index.folder_count == 4);
+
+    // Top-level tracks first, then directories in name order
+    file_entry_t *f = &index.all_files[0];
+    assert(strcmp(f->path, "intro.pcm") == 0);
+    assert(f->sample_rate == 48000 && f->bit_depth == 24 && f->channels == 2);
+    assert(f->folder_index == 0);
+    assert(strcmp(index.music_folders[0].name, LIBRARY) == 0);
+
+    f = &index.all_files[1];
+    assert(strcmp(f->path, "Pop/a_song.pcm") == 0);
+    assert(strcmp(f->song, "a_song") == 0);
+    assert(strcmp(f->album, "Pop") == 0);
+    assert(f->folder_index == 1);
+
+    f = &index.all_files[2];
+    assert(strcmp(f->path, "Pop/b_song.wav") == 0);
+    assert(f->codec == PCM_CODEC_RAW);
+    assert(f->sample_rate == 22050 && f->channels == 1);
+
+    f = &index.all_files[3];
+    assert(strcmp(f->path, "Rock/anthem.mp3") == 0);
+    assert(f->codec == PCM_CODEC_MP3);
+    assert(f->sample_rate == 44100 && f->channels == 2);
+    assert(f->frame_index.frame_count == 600);
+    assert(f->frame_index.interval == LIBRARY_SCAN_MP3_INTERVAL);
+    assert(f->frame_index.count == 3);
+    assert(f->frame_index.offsets[1] == 250 * 417);
+    assert(f->folder_index == 2);
+
+    f = &index.all_files[4];
+    assert(f->codec == PCM_CODEC_FLAC);
+    assert(f->sample_rate == 96000 && f->bit_depth == 24);
+
+    f = &index.all_files[5];
+    assert(strcmp(f->path, "Rock/Live/encore.wav") == 0);
+    assert(f->codec == PCM_CODEC_IMA_ADPCM);
+    assert(f->block_align == 1024);
+    assert(f->folder_index == 3);
+
+    assert(index.music_folders[2].file_count == 2);
+    assert(strcmp(index.music_folders[3].name, "Live") == 0);
+    assert(strcmp(index.music_folders[3].files[0].path, "Rock/Live/encore.wav") == 0);
+    json_free_index(&index);
+
+    printf("✓ library scan test passed\n");
+}
+
+void test_library_rescan() {
+    printf("Testing incremental library scan...\n");
+
+    char *first = read_file(LIBRARY "/index.json");
+    library_scan_stats_t stats;
+
+    // Nothing changed: every directory comes from the manifest
+    assert(library_scanner_run(LIBRARY, &stats) == ESP_OK);
+    assert(stats.dirs_scanned == 0);
+    assert(stats.dirs_reused == 4);
+    assert(stats.files == 6);
+    char *second = read_file(LIBRARY "/index.json");
+    assert(strcmp(first, second) == 0);
+    free(second);
+
+    // A new album only costs its own directory
+    mkdir(LIBRARY "/Jazz", 0755);
+    write_esp32pcm(LIBRARY "/Jazz/blue.pcm", 44100, 16, 2);
+    assert(library_scanner_run(LIBRARY, &stats) == ESP_OK);
+    assert(stats.dirs_scanned == 1);
+    assert(stats.dirs_reused == 4);
+    assert(stats.files == 7);
+    assert(stats.folders == 5);
+
+    // A rewritten or removed track rescans its directory only; the size
+    // change makes the edit visible within the same second
+    write_esp32pcm(LIBRARY "/Pop/a_song.pcm", 32000, 16, 1);
+    FILE *grow = fopen(LIBRARY "/Pop/a_song.pcm", "ab");
+    fputc(0, grow);
+    fclose(grow);
+    unlink(LIBRARY "/Rock/ballad.flac");
+    assert(library_scanner_run(LIBRARY, &stats) == ESP_OK);
+    assert(stats.dirs_scanned == 2);
+    assert(stats.dirs_reused == 3);
+    assert(stats.files == 6);
+
+    index_file_t index;
+    assert(json_parse_index(LIBRARY "/index.json", &index) == ESP_OK);
+    assert(index.total_files == 6);
+    assert(strcmp(index.all_files[1].path, "Jazz/blue.pcm") == 0);
+    assert(index.all_files[2].sample_rate == 32000);
+    assert(strcmp(index.all_files[3].path, "Pop/b_song.wav") == 0);
+    assert(index.all_files[4].frame_index.offsets != NULL);
+    assert(strcmp(index.all_files[5].path, "Rock/Live/encore.wav") == 0);
+    json_free_index(&index);
+
+    // A damaged manifest only costs a full scan
+    FILE *manifest = fopen(LIBRARY "/" LIBRARY_SCAN_MANIFEST, "w");
+    fputs("garbage\n", manifest);
+    fclose(manifest);
+    assert(library_scanner_run(LIBRARY, &stats) == ESP_OK);
+    assert(stats.dirs_reused == 0);
+    assert(stats.files == 6);
+
+    assert(library_scanner_run(NULL, &stats) == ESP_ERR_INVALID_ARG);
+    assert(library_scanner_run(LIBRARY "/missing", &stats) == ESP_FAIL);
+
+    free(first);
+    assert(system("rm -rf " LIBRARY) == 0);
+    printf("✓ incremental library scan test passed\n");
+}
+
+int main() {
+    printf("Running library scanner unit tests...\n\n");
+
+    test_library_scan();
+    test_library_rescan();
+
+    printf("\n✅ All library scanner tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "mem_policy.h"
+
+void test_arena_alloc() {
+    printf("Testing arena allocation...\n");
+
+    mem_arena_t arena;
+    mem_arena_init(&arena, MEM_BULK, 256);
+    assert(arena.chunks == 0 && arena.capacity == 0);
+    assert(mem_arena_alloc(&arena, 0) == NULL);
+
+    // Allocations are aligned and packed into the first chunk
+    uint8_t *a = mem_arena_alloc(&arena, 3);
+    uint8_t *b = mem_arena_alloc(&arena, 10);
+    assert(a != NULL && b != NULL);
+    assert((uintptr_t)a % MEM_ARENA_ALIGN == 0 && (uintptr_t)b % MEM_ARENA_ALIGN == 0);
+    assert(b == a + MEM_ARENA_SPAN(3));
+    assert(arena.chunks == 1 && arena.capacity == 256);
+    assert(arena.used == MEM_ARENA_SPAN(3) + MEM_ARENA_SPAN(10));
+
+    uint32_t *zeroed = mem_arena_calloc(&arena, 8, sizeof(uint32_t));
+    for (int i = 0; i < 8; i++) {
+        assert(zeroed[i] == 0);
+    }
+    assert(mem_arena_calloc(&arena, SIZE_MAX / 2, 4) == NULL);
+
+    // Running out adds a chunk, at least as large as the request
+    uint8_t *big = mem_arena_alloc(&arena, 1000);
+    assert(big != NULL);
+    memset(big, 0xAB, 1000);
+    assert(arena.chunks == 2 && arena.capacity == 256 + 1000);
+    assert(a + MEM_ARENA_SPAN(3) == b);
+
+    mem_arena_release(&arena);
+    assert(arena.chunks == 0 && arena.used == 0 && arena.capacity == 0);
+    printf("✓ arena allocation test passed\n");
+}
+
+void test_arena_reserve() {
+    printf("Testing arena reserve...\n");
+
+    mem_arena_t arena;
+    mem_arena_init(&arena, MEM_BULK, 64);
+    assert(mem_arena_reserve(&arena, 4096));
+    assert(arena.chunks == 1 && arena.capacity == 4096);
+
+    // Everything reserved for comes from the one block
+    for (int i = 0; i < 64; i++) {
+        assert(mem_arena_alloc(&arena, 64) != NULL);
+    }
+    assert(arena.chunks == 1 && arena.used == 4096);
+    assert(mem_arena_reserve(&arena, 0));
+    assert(!mem_arena_reserve(&arena, SIZE_MAX));
+    assert(arena.chunks == 1);
+
+    mem_arena_release(&arena);
+    printf("✓ arena reserve test passed\n");
+}
+
+void test_arena_reset() {
+    printf("Testing arena reset...\n");
+
+    mem_arena_t arena;
+    mem_arena_init(&arena, MEM_BULK, 128);
+    mem_arena_alloc(&arena, 100);
+    mem_arena_alloc(&arena, 200);
+    mem_arena_alloc(&arena, 400);
+    assert(arena.chunks == 3);
+    size_t capacity = arena.capacity;
+
+    // A reset merges the chunks, so the same work then fits in one
+    mem_arena_reset(&arena);
+    assert(arena.chunks == 1 && arena.used == 0 && arena.capacity == capacity);
+    uint8_t *first = mem_arena_alloc(&arena, 100);
+    mem_arena_alloc(&arena, 200);
+    mem_arena_alloc(&arena, 400);
+    assert(arena.chunks == 1);
+
+    // A single chunk is reused in place
+    mem_arena_reset(&arena);
+    assert(mem_arena_alloc(&arena, 100) == first);
+
+    mem_arena_release(&arena);
+    mem_arena_reset(&arena);
+    assert(arena.chunks == 0);
+    printf("✓ arena reset test passed\n");
+}
+
+int main() {
+    printf("Running memory policy unit tests...\n\n");
+
+    test_arena_alloc();
+    test_arena_reserve();
+    test_arena_reset();
+
+    printf("\n✅ All memory policy tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "mp3_frame.h"
+
+// MPEG-1 Layer III, 128 kbps, 44.1 kHz, joint stereo
+static const uint8_t HEADER_128K[4] = {0xFF, 0xFB, 0x90, 0x40};
+
+// Write a frame with the given header and a zero payload; returns its size
+static size_t write_frame(FILE *file, const uint8_t *hdr) {
+    mp3_header_t header;
+    assert(mp3_parse_header(hdr, &header));
+    fwrite(hdr, 1, 4, file);
+    for (size_t i = 4; i < header.frame_bytes; i++) {
+        fputc(0, file);
+    }
+    return header.frame_bytes;
+}
+
+void test_mp3_parse_header() {
+    printf("Testing mp3_parse_header...\n");
+
+    mp3_header_t header;
+    assert(mp3_parse_header(HEADER_128K, &header));
+    assert(header.bitrate_kbps == 128);
+    assert(header.sample_rate == 44100);
+    assert(header.samples == 1152);
+    assert(header.channels == 2);
+    assert(header.frame_bytes == 417);
+
+    // Padding adds a byte
+    const uint8_t padded[4] = {0xFF, 0xFB, 0x92, 0x40};
+    assert(mp3_parse_header(padded, &header));
+    assert(header.frame_bytes == 418);
+
+    // MPEG-2, 64 kbps, 22.05 kHz, mono
+    const uint8_t mpeg2[4] = {0xFF, 0xF3, 0x80, 0xC0};
+    assert(mp3_parse_header(mpeg2, &header));
+    assert(header.sample_rate == 22050);
+    assert(header.samples == 576);
+    assert(header.channels == 1);
+    assert(header.frame_bytes == 208);
+
+    // No sync, Layer II, free format, reserved rate
+    const uint8_t bad[][4] = {
+        {0xFE, 0xFB, 0x90, 0x40},
+        {0xFF, 0xFD, 0x90, 0x40},
+        {0xFF, 0xFB, 0x00, 0x40},
+        {0xFF, 0xFB, 0x9C, 0x40},
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        assert(!mp3_parse_header(bad[i], &header));
+    }
+
+    printf("✓ mp3_parse_header test passed\n");
+}
+
+void test_mp3_find_and_skip() {
+    printf("Testing MP3 frame scanning...\n");
+
+    const char *test_file = "test_audio.mp3";
+    FILE *file = fopen(test_file, "w+b");
+    assert(file != NULL);
+
+    // ID3v2 tag with a 90-byte body
+    const uint8_t id3[10] = {'I', 'D', '3', 4, 0, 0, 0, 0, 0, 90};
+    fwrite(id3, 1, sizeof(id3), file);
+    for (int i = 0; i < 90; i++) {
+        fputc('x', file);
+    }
+    // Stray sync word that is not followed by a second frame
+    fwrite(HEADER_128K, 1, 4, file);
+    fputc(0, file);
+
+    long first = ftell(file);
+    long offsets[12];
+    for (int i = 0; i < 12; i++) {
+        offsets[i] = ftell(file);
+        const uint8_t padded[4] = {0xFF, 0xFB, 0x92, 0x40};
+        write_frame(file, i % 3 == 0 ? padded : HEADER_128K);
+    }
+    fflush(file);
+
+    long offset;
+    mp3_header_t header;
+    assert(mp3_find_first_frame(file, &offset, &header));
+    assert(offset == first);
+    assert(header.bitrate_kbps == 128);
+
+    assert(mp3_skip_frames(file, &offset, 5) == 5);
+    assert(offset == offsets[5]);
+
+    // Stops at the end of the file
+    assert(mp3_skip_frames(file, &offset, 100) == 7);
+
+    fclose(file);
+    unlink(test_file);
+
+    // No frames at all
+    file = tmpfile();
+    for (int i = 0; i < 4096; i++) {
+        fputc(i & 0x7F, file);
+    }
+    assert(!mp3_find_first_frame(file, &offset, &header));
+    fclose(file);
+
+    printf("✓ MP3 frame scanning test passed\n");
+}
+
+void test_mp3_plan_seek() {
+    printf("Testing mp3_plan_seek...\n");
+
+    mp3_seek_plan_t plan;
+
+    // Without an index, walk from the first frame
+    mp3_plan_seek(NULL, 100, 1152, 10 * 1152 + 7, &plan);
+    assert(plan.offset == 100);
+    assert(plan.skip_frames == 10 - MP3_SEEK_PREROLL_FRAMES);
+    assert(plan.preroll_frames == MP3_SEEK_PREROLL_FRAMES);
+    assert(plan.discard_samples == 7);
+
+    // Near the start there is less to preroll
+    mp3_plan_seek(NULL, 100, 1152, 1152 + 1, &plan);
+    assert(plan.skip_frames == 0);
+    assert(plan.preroll_frames == 1);
+    assert(plan.discard_samples == 1);
+
+    // With an index, start at the closest entry before the preroll
+    uint32_t offsets[3] = {100, 41900, 83700};
+    mp3_frame_index_t index = {.frame_count = 250, .interval = 100, .count = 3, .offsets = offsets};
+    mp3_plan_seek(&index, 100, 1152, 150 * 1152, &plan);
+    assert(plan.offset == 41900);
+    assert(plan.skip_frames == 48);
+    assert(plan.preroll_frames == MP3_SEEK_PREROLL_FRAMES);
+    assert(plan.discard_samples == 0);
+
+    // An entry that falls inside the preroll is not used
+    mp3_plan_seek(&index, 100, 1152, 201 * 1152, &plan);
+    assert(plan.offset == 41900);
+    assert(plan.skip_frames == 99);
+
+    // Past the end clamps to the last frame
+    mp3_plan_seek(&index, 100, 1152, 1000000, &plan);
+    assert(plan.offset == 83700);
+    assert(plan.skip_frames == 49 - MP3_SEEK_PREROLL_FRAMES);
+    assert(plan.discard_samples == 0);
+
+    printf("✓ mp3_plan_seek test passed\n");
+}
+
+int main() {
+    printf("Running MP3 frame unit tests...\n\n");
+
+    test_mp3_parse_header();
+    test_mp3_find_and_skip();
+    test_mp3_plan_seek();
+
+    printf("\n✅ All MP3 frame tests passed!\n");
+    return 0;
+}
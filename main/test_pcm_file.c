@@ -3,6 +3,7 @@
 #include <string.h>
 #include <assert.h>
 #include <unistd.h>
+#include <math.h>
 
 // Test mode definitions to avoid ESP-IDF dependencies
 #ifdef TEST_MODE
@@ -15,6 +16,41 @@ typedef int esp_err_t;
 #endif
 
 #include "pcm_file.h"
+#include "sd_fault.h"
+#include "test_flac_encoder.h"
+
+// Mock card: when contiguous, the file itself is the card image starting at sector 0
+static bool mock_contiguous = false;
+static bool mock_read_fail = false;
+static int mock_sector_reads = 0;
+static int mock_layout_walks = 0;
+static char mock_path[256];
+
+esp_err_t sd_card_get_file_layout(const char *path, sd_file_layout_t *layout) {
+    mock_layout_walks++;
+    if (!mock_contiguous) {
+        return ESP_FAIL;
+    }
+    snprintf(mock_path, sizeof(mock_path), "%s", path);
+    layout->fragments = 1;
+    layout->clusters = 1;
+    layout->first_sector = 0;
+    return ESP_OK;
+}
+
+esp_err_t sd_card_read_sectors(void *buffer, uint32_t sector, uint32_t count) {
+    if (mock_read_fail) {
+        return ESP_FAIL;
+    }
+    mock_sector_reads++;
+    FILE *file = fopen(mock_path, "rb");
+    assert(file != NULL);
+    memset(buffer, 0, (size_t)count * SD_SECTOR_SIZE);
+    fseek(file, (long)sector * SD_SECTOR_SIZE, SEEK_SET);
+    fread(buffer, 1, (size_t)count * SD_SECTOR_SIZE, file);
+    fclose(file);
+    return ESP_OK;
+}
 
 // Create a test PCM file
 void create_test_pcm_file(const char* filename, size_t size) {
@@ -135,6 +171,686 @@ void test_pcm_file_get_params() {
     printf("✓ pcm_file_get_params test passed\n");
 }
 
+// Triangle wave test signal, different per channel
+static int16_t test_signal(size_t frame, uint16_t channel) {
+    int32_t period = channel ? 150 : 100;
+    int32_t phase = (int32_t)(frame % period);
+    int32_t v = phase < period / 2 ? phase : period - phase;
+    return (int16_t)((v * 4 * 20000) / period - 20000);
+}
+
+// Encode the test signal as IMA ADPCM: full blocks plus a short final block
+static size_t create_test_adpcm_file(const char* filename, uint16_t channels, size_t block_align, size_t blocks) {
+    size_t frames_per_block = ima_adpcm_frames_per_block(block_align, channels);
+    int16_t *pcm = malloc(frames_per_block * channels * sizeof(int16_t));
+    uint8_t *block = malloc(block_align);
+    uint8_t step_index[2] = {0, 0};
+    FILE* file = fopen(filename, "wb");
+    assert(pcm && block && file);
+    
+    size_t frame = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        for (size_t f = 0; f < frames_per_block; f++) {
+            for (uint16_t c = 0; c < channels; c++) {
+                pcm[f * channels + c] = test_signal(frame + f, c);
+            }
+        }
+        ima_adpcm_encode_block(pcm, channels, block_align, step_index, block);
+        // The last block is cut after its header and first nibble group
+        size_t size = (b == blocks - 1) ? 8u * channels : block_align;
+        fwrite(block, 1, size, file);
+        frame += frames_per_block;
+    }
+    
+    fclose(file);
+    free(pcm);
+    free(block);
+    return (blocks - 1) * frames_per_block + 9;
+}
+
+void test_pcm_file_adpcm() {
+    printf("Testing IMA ADPCM decoding...\n");
+    
+    const char* test_file = "test_audio.adpcm";
+    const size_t block_align = 1024;
+    size_t frames = create_test_adpcm_file(test_file, 2, block_align, 4);
+    assert(ima_adpcm_frames_per_block(block_align, 2) == 1017);
+    
+    pcm_file_t pcm_file;
+    esp_err_t ret = pcm_file_open(test_file, &pcm_file, 44100, 4, 2);
+    assert(ret == ESP_OK);
+    ret = pcm_file_set_codec(&pcm_file, PCM_CODEC_IMA_ADPCM, block_align);
+    assert(ret == ESP_OK);
+    assert(pcm_file.bit_depth == 16);
+    assert(pcm_file.pcm_size == frames * 4);
+    
+    // Read everything in odd-sized chunks and compare against the source signal
+    int16_t *decoded = malloc(pcm_file.pcm_size + 64);
+    size_t total = 0;
+    size_t bytes_read;
+    do {
+        ret = pcm_file_read(&pcm_file, (uint8_t *)decoded + total, 998, &bytes_read);
+        assert(ret == ESP_OK);
+        total += bytes_read;
+    } while (bytes_read > 0);
+    assert(total == pcm_file.pcm_size);
+    assert(pcm_file.position == total);
+    
+    double signal = 0, noise = 0;
+    for (size_t f = 0; f < frames; f++) {
+        for (uint16_t c = 0; c < 2; c++) {
+            double s = test_signal(f, c);
+            double e = decoded[f * 2 + c] - s;
+            signal += s * s;
+            noise += e * e;
+        }
+    }
+    // 4-bit ADPCM on a smooth signal stays well above 30 dB SNR
+    assert(noise * 1000 < signal);
+    
+    // Seek into the middle of the third block and compare with the linear read
+    uint32_t seek_pos = (1017 * 2 + 123) * 4 + 2;
+    ret = pcm_file_seek(&pcm_file, seek_pos);
+    assert(ret == ESP_OK);
+    assert(pcm_file.position == seek_pos);
+    int16_t sample;
+    ret = pcm_file_read(&pcm_file, &sample, sizeof(sample), &bytes_read);
+    assert(ret == ESP_OK);
+    assert(bytes_read == sizeof(sample));
+    assert(sample == decoded[seek_pos / 2]);
+    
+    // Oversized blocks are rejected
+    assert(pcm_file_set_codec(&pcm_file, PCM_CODEC_IMA_ADPCM, IMA_ADPCM_MAX_BLOCK_ALIGN * 2) == ESP_ERR_INVALID_ARG);
+    
+    free(decoded);
+    pcm_file_close(&pcm_file);
+    unlink(test_file);
+    printf("✓ IMA ADPCM decoding test passed\n");
+}
+
+static void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    put_le16(p, v & 0xFFFF);
+    put_le16(p + 2, v >> 16);
+}
+
+// Write a WAV file: fmt, a fact chunk, data, then an odd-sized LIST chunk that must not be played
+static void write_wav_file(const char* filename, uint16_t format_tag, uint32_t sample_rate, uint16_t bit_depth,
+                           uint16_t channels, uint16_t block_align, const uint8_t *data, size_t data_size) {
+    FILE* file = fopen(filename, "wb");
+    assert(file != NULL);
+    uint8_t chunk[8];
+    uint8_t fmt[20] = {0};
+    put_le16(fmt, format_tag);
+    put_le16(fmt + 2, channels);
+    put_le32(fmt + 4, sample_rate);
+    put_le32(fmt + 8, sample_rate * block_align);
+    put_le16(fmt + 12, block_align);
+    put_le16(fmt + 14, bit_depth);
+
+    fwrite("RIFF\0\0\0\0WAVE", 1, 12, file);
+    memcpy(chunk, "fmt ", 4);
+    put_le32(chunk + 4, sizeof(fmt));
+    fwrite(chunk, 1, 8, file);
+    fwrite(fmt, 1, sizeof(fmt), file);
+    memcpy(chunk, "fact", 4);
+    put_le32(chunk + 4, 4);
+    fwrite(chunk, 1, 8, file);
+    fwrite("\0\0\0\0", 1, 4, file);
+    memcpy(chunk, "data", 4);
+    put_le32(chunk + 4, data_size);
+    fwrite(chunk, 1, 8, file);
+    fwrite(data, 1, data_size, file);
+    if (data_size & 1) {
+        fputc(0, file);
+    }
+    memcpy(chunk, "LIST", 4);
+    put_le32(chunk + 4, 5);
+    fwrite(chunk, 1, 8, file);
+    fwrite("INFO\x7F", 1, 5, file);
+    fclose(file);
+}
+
+void test_pcm_file_headers() {
+    printf("Testing file header detection...\n");
+    
+    uint8_t data[1000];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(i * 7);
+    }
+    pcm_file_t pcm_file;
+    uint8_t buffer[2048];
+    size_t bytes_read;
+    
+    // ESP32PCM header: format from the header, trailing bytes beyond the declared size ignored
+    const char* test_file = "test_audio.pcm";
+    FILE* file = fopen(test_file, "wb");
+    uint8_t header[PCM_FILE_HEADER_SIZE] = "ESP32PCM";
+    put_le32(header + 8, 48000);
+    put_le16(header + 12, 24);
+    put_le16(header + 14, 2);
+    put_le32(header + 16, 600);
+    fwrite(header, 1, sizeof(header), file);
+    fwrite(data, 1, sizeof(data), file);
+    fclose(file);
+    assert(pcm_file_open(test_file, &pcm_file, 44100, 16, 1) == ESP_OK);
+    assert(pcm_file.has_header);
+    assert(pcm_file.sample_rate == 48000);
+    assert(pcm_file.bit_depth == 24);
+    assert(pcm_file.channels == 2);
+    assert(pcm_file.data_offset == PCM_FILE_HEADER_SIZE);
+    assert(pcm_file.pcm_size == 600);
+    assert(pcm_file_read(&pcm_file, buffer, sizeof(buffer), &bytes_read) == ESP_OK);
+    assert(bytes_read == 600);
+    assert(memcmp(buffer, data, 600) == 0);
+    assert(pcm_file_seek(&pcm_file, 120) == ESP_OK);
+    assert(pcm_file_read(&pcm_file, buffer, 6, &bytes_read) == ESP_OK);
+    assert(memcmp(buffer, data + 120, 6) == 0);
+    pcm_file_close(&pcm_file);
+    
+    // WAV PCM: data chunk found past other chunks, the LIST chunk after it is not played
+    write_wav_file(test_file, 1, 22050, 16, 1, 2, data, 999);
+    assert(pcm_file_open(test_file, &pcm_file, 44100, 24, 2) == ESP_OK);
+    assert(pcm_file.has_header);
+    assert(pcm_file.sample_rate == 22050);
+    assert(pcm_file.bit_depth == 16);
+    assert(pcm_file.channels == 1);
+    assert(pcm_file.codec == PCM_CODEC_RAW);
+    assert(pcm_file.pcm_size == 999);
+    assert(pcm_file_read(&pcm_file, buffer, sizeof(buffer), &bytes_read) == ESP_OK);
+    assert(bytes_read == 999);
+    assert(memcmp(buffer, data, 999) == 0);
+    assert(pcm_file_read(&pcm_file, buffer, sizeof(buffer), &bytes_read) == ESP_OK);
+    assert(bytes_read == 0);
+    pcm_file_close(&pcm_file);
+    
+    // WAV IMA ADPCM decodes like the headerless stream
+    const char* adpcm_file = "test_audio.adpcm";
+    create_test_adpcm_file(adpcm_file, 2, 512, 3);
+    file = fopen(adpcm_file, "rb");
+    uint8_t *adpcm = malloc(2048);
+    size_t adpcm_size = fread(adpcm, 1, 2048, file);
+    fclose(file);
+    write_wav_file(test_file, 0x11, 44100, 4, 2, 512, adpcm, adpcm_size);
+    
+    pcm_file_t raw;
+    assert(pcm_file_open(adpcm_file, &raw, 44100, 4, 2) == ESP_OK);
+    assert(!raw.has_header);
+    assert(pcm_file_set_codec(&raw, PCM_CODEC_IMA_ADPCM, 512) == ESP_OK);
+    assert(pcm_file_open(test_file, &pcm_file, 0, 0, 0) == ESP_OK);
+    assert(pcm_file.codec == PCM_CODEC_IMA_ADPCM);
+    assert(pcm_file.block_align == 512);
+    assert(pcm_file.bit_depth == 16);
+    assert(pcm_file.pcm_size == raw.pcm_size);
+    size_t total = 0;
+    do {
+        uint8_t expected[700];
+        size_t expected_read;
+        assert(pcm_file_read(&pcm_file, buffer, 700, &bytes_read) == ESP_OK);
+        assert(pcm_file_read(&raw, expected, 700, &expected_read) == ESP_OK);
+        assert(bytes_read == expected_read);
+        assert(memcmp(buffer, expected, bytes_read) == 0);
+        total += bytes_read;
+    } while (bytes_read > 0);
+    assert(total == raw.pcm_size);
+    assert(pcm_file_seek(&pcm_file, 2000) == ESP_OK);
+    assert(pcm_file_seek(&raw, 2000) == ESP_OK);
+    assert(pcm_file_read(&pcm_file, buffer, 8, &bytes_read) == ESP_OK);
+    assert(pcm_file_read(&raw, buffer + 8, 8, &bytes_read) == ESP_OK);
+    assert(memcmp(buffer, buffer + 8, 8) == 0);
+    pcm_file_close(&raw);
+    pcm_file_close(&pcm_file);
+    free(adpcm);
+    unlink(adpcm_file);
+    
+    // Float WAV is refused rather than played as noise, as a format error
+    write_wav_file(test_file, 3, 44100, 32, 2, 8, data, 800);
+    assert(pcm_file_open(test_file, &pcm_file, 44100, 16, 2) == ESP_ERR_INVALID_ARG);
+    assert(pcm_file.file == NULL);
+    
+    // A file that cannot be opened is not
+    assert(pcm_file_open("missing.pcm", &pcm_file, 44100, 16, 2) == ESP_FAIL);
+    
+    unlink(test_file);
+    printf("✓ file header detection test passed\n");
+}
+
+// Two sine tones with a silent gap, scaled to bit_depth
+static int32_t *make_flac_signal(size_t frames, uint16_t channels, uint16_t bit_depth) {
+    int32_t *samples = malloc(frames * channels * sizeof(int32_t));
+    double full_scale = (double)(1 << (bit_depth - 1)) * 0.7;
+    for (size_t f = 0; f < frames; f++) {
+        for (uint16_t c = 0; c < channels; c++) {
+            double v = sin(f * (0.031 + 0.007 * c)) * 0.6 + sin(f * 0.0021) * 0.4;
+            bool silent = f >= frames / 3 && f < frames / 3 + 3000;
+            samples[f * channels + c] = silent ? 0 : (int32_t)(v * full_scale);
+        }
+    }
+    return samples;
+}
+
+static void write_flac_file(const char *filename, const int32_t *samples, size_t frames,
+                            uint16_t channels, uint16_t bit_depth, const test_flac_options_t *opt) {
+    size_t size;
+    uint8_t *stream = test_flac_encode(samples, frames, 44100, channels, bit_depth, opt, &size);
+    assert(stream != NULL);
+    FILE *file = fopen(filename, "wb");
+    assert(file != NULL);
+    fwrite(stream, 1, size, file);
+    fclose(file);
+    free(stream);
+}
+
+// Value of one output sample as the decoder packs it
+static int32_t load_output_sample(const uint8_t *p, uint16_t bit_depth) {
+    if (bit_depth == 16) {
+        return (int16_t)(p[0] | (p[1] << 8));
+    }
+    return ((int32_t)((p[0] << 8) | (p[1] << 16) | ((uint32_t)p[2] << 24))) >> 8;
+}
+
+static void check_flac_roundtrip(uint16_t channels, uint16_t bit_depth, const test_flac_options_t *opt) {
+    const char* test_file = "test_audio.flac";
+    const size_t frames = 44100 * 2 + 777;
+    int32_t *samples = make_flac_signal(frames, channels, bit_depth);
+    write_flac_file(test_file, samples, frames, channels, bit_depth, opt);
+
+    uint16_t out_depth = bit_depth <= 16 ? 16 : 24;
+    uint32_t frame_bytes = (out_depth / 8) * channels;
+    uint32_t shift = out_depth - bit_depth;
+
+    // The stream is recognised on open; index parameters are overridden by STREAMINFO
+    pcm_file_t pcm_file;
+    esp_err_t ret = pcm_file_open(test_file, &pcm_file, 8000, 8, 1);
+    assert(ret == ESP_OK);
+    assert(pcm_file.codec == PCM_CODEC_FLAC);
+    assert(pcm_file.has_header);
+    ret = pcm_file_set_codec(&pcm_file, PCM_CODEC_FLAC, 0);
+    assert(ret == ESP_OK);
+    assert(pcm_file.sample_rate == 44100);
+    assert(pcm_file.bit_depth == out_depth);
+    assert(pcm_file.channels == channels);
+    assert(pcm_file.pcm_size == frames * frame_bytes);
+
+    // Decode everything in odd-sized chunks; FLAC is lossless so it must match exactly
+    uint8_t *decoded = malloc(pcm_file.pcm_size + 4096);
+    size_t total = 0;
+    size_t bytes_read;
+    do {
+        ret = pcm_file_read(&pcm_file, decoded + total, 1001, &bytes_read);
+        assert(ret == ESP_OK);
+        assert(bytes_read % frame_bytes == 0);
+        total += bytes_read;
+    } while (bytes_read > 0);
+    assert(total == pcm_file.pcm_size);
+    for (size_t i = 0; i < frames * channels; i++) {
+        assert(load_output_sample(decoded + i * (out_depth / 8), out_depth) == samples[i] * (1 << shift));
+    }
+
+    // Seek to a few places, including the last frame, and compare with the linear decode
+    const size_t targets[] = {0, 12345, frames / 2 + 3, frames - 1};
+    for (size_t t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+        uint32_t pos = targets[t] * frame_bytes;
+        ret = pcm_file_seek(&pcm_file, pos + 1);   // lands on the containing frame
+        assert(ret == ESP_OK);
+        assert(pcm_file.position == pos);
+        uint8_t frame[6];
+        ret = pcm_file_read(&pcm_file, frame, frame_bytes, &bytes_read);
+        assert(ret == ESP_OK);
+        assert(bytes_read == frame_bytes);
+        assert(memcmp(frame, decoded + pos, frame_bytes) == 0);
+    }
+
+    free(decoded);
+    free(samples);
+    pcm_file_close(&pcm_file);
+    unlink(test_file);
+}
+
+void test_pcm_file_flac() {
+    printf("Testing FLAC decoding...\n");
+
+    // 16-bit stereo, LPC, seek table
+    test_flac_options_t lpc = {.block_size = 4096, .lpc_order = 8, .seek_interval = 4};
+    check_flac_roundtrip(2, 16, &lpc);
+
+    // 24-bit stereo, fixed prediction, no seek table
+    test_flac_options_t fixed = {.block_size = 1152, .lpc_order = 0, .seek_interval = 0};
+    check_flac_roundtrip(2, 24, &fixed);
+
+    // 20-bit mono is played as 24-bit
+    test_flac_options_t mono = {.block_size = 1000, .lpc_order = 12, .seek_interval = 10};
+    check_flac_roundtrip(1, 20, &mono);
+
+    // 16-bit data in a 24-bit stream uses wasted bits
+    const char* test_file = "test_audio.flac";
+    size_t frames = 5000;
+    int32_t *samples = make_flac_signal(frames, 2, 16);
+    for (size_t i = 0; i < frames * 2; i++) {
+        samples[i] *= 256;
+    }
+    write_flac_file(test_file, samples, frames, 2, 24, &lpc);
+    pcm_file_t pcm_file;
+    assert(pcm_file_open(test_file, &pcm_file, 44100, 24, 2) == ESP_OK);
+    assert(pcm_file_set_codec(&pcm_file, PCM_CODEC_FLAC, 0) == ESP_OK);
+    uint8_t frame[6];
+    size_t bytes_read;
+    for (size_t f = 0; f < frames; f++) {
+        assert(pcm_file_read(&pcm_file, frame, sizeof(frame), &bytes_read) == ESP_OK);
+        assert(bytes_read == sizeof(frame));
+        assert(load_output_sample(frame, 24) == samples[f * 2]);
+        assert(load_output_sample(frame + 3, 24) == samples[f * 2 + 1]);
+    }
+
+    // Decoders come from a fixed pool; a file opened with none free stays raw
+    pcm_file_t second, third;
+    assert(pcm_file_open(test_file, &second, 44100, 24, 2) == ESP_OK);
+    assert(pcm_file_open(test_file, &third, 44100, 24, 2) == ESP_OK);
+    assert(third.codec == PCM_CODEC_RAW && !third.has_header);
+    assert(pcm_file_set_codec(&second, PCM_CODEC_FLAC, 0) == ESP_OK);
+    assert(pcm_file_set_codec(&third, PCM_CODEC_FLAC, 0) == ESP_ERR_NO_MEM);
+    pcm_file_close(&second);
+    assert(pcm_file_set_codec(&third, PCM_CODEC_FLAC, 0) == ESP_OK);
+    pcm_file_close(&third);
+    pcm_file_close(&pcm_file);
+    free(samples);
+    unlink(test_file);
+
+    // A FLAC stream behind an ID3v2 tag is found past the tag
+    uint8_t tag[10 + 300] = {'I', 'D', '3', 4, 0, 0, 0, 0, 0x02, 0x2C};
+    size_t stream_size;
+    samples = make_flac_signal(1000, 2, 16);
+    uint8_t *stream = test_flac_encode(samples, 1000, 44100, 2, 16, &lpc, &stream_size);
+    assert(stream != NULL);
+    free(samples);
+    FILE *file = fopen(test_file, "wb");
+    fwrite(tag, 1, sizeof(tag), file);
+    fwrite(stream, 1, stream_size, file);
+    fclose(file);
+    free(stream);
+    // Decoded streams are not read sector by sector, so their cluster chain is not walked
+    int walks = mock_layout_walks;
+    assert(pcm_file_open(test_file, &pcm_file, 8000, 8, 1) == ESP_OK);
+    assert(pcm_file.codec == PCM_CODEC_FLAC);
+    assert(pcm_file.sample_rate == 44100 && pcm_file.bit_depth == 16);
+    assert(mock_layout_walks == walks && !pcm_file.direct);
+    pcm_file_close(&pcm_file);
+    unlink(test_file);
+
+    // Raw PCM is not mistaken for FLAC, and the decoder goes back to the pool
+    create_test_pcm_file("test_audio.pcm", 1024);
+    assert(pcm_file_open("test_audio.pcm", &pcm_file, 44100, 16, 2) == ESP_OK);
+    assert(pcm_file.codec == PCM_CODEC_RAW && !pcm_file.has_header);
+    assert(mock_layout_walks == walks + 1);
+    assert(pcm_file_set_codec(&pcm_file, PCM_CODEC_FLAC, 0) == ESP_ERR_INVALID_ARG);
+    assert(pcm_file.codec == PCM_CODEC_RAW);
+    pcm_file_close(&pcm_file);
+    unlink("test_audio.pcm");
+
+    printf("✓ FLAC decoding test passed\n");
+}
+
+void test_pcm_file_seek_ms() {
+    printf("Testing time-based seek...\n");
+    
+    // One second of 8 kHz 16-bit stereo plus half a frame
+    const char* test_file = "test_audio.pcm";
+    create_test_pcm_file(test_file, 8000 * 4 + 2);
+    pcm_file_t pcm_file;
+    assert(pcm_file_open(test_file, &pcm_file, 8000, 16, 2) == ESP_OK);
+    assert(pcm_file_duration_ms(&pcm_file) == 1000);
+    assert(pcm_file_position_ms(&pcm_file) == 0);
+    
+    // 1/8 ms per frame: positions land on whole frames
+    assert(pcm_file_seek_ms(&pcm_file, 250) == ESP_OK);
+    assert(pcm_file.position == 2000 * 4);
+    assert(pcm_file_position_ms(&pcm_file) == 250);
+    uint8_t frame[4];
+    size_t bytes_read;
+    assert(pcm_file_read(&pcm_file, frame, sizeof(frame), &bytes_read) == ESP_OK);
+    assert(frame[0] == (uint8_t)(2000 * 4));
+    
+    // Past the end clamps to the last whole frame
+    assert(pcm_file_seek_ms(&pcm_file, 5000) == ESP_OK);
+    assert(pcm_file.position == 8000 * 4);
+    assert(pcm_file_position_ms(&pcm_file) == 1000);
+    pcm_file_close(&pcm_file);
+    
+    // 44.1 kHz does not divide into milliseconds; round down to the containing frame
+    assert(pcm_file_open(test_file, &pcm_file, 44100, 24, 1) == ESP_OK);
+    assert(pcm_file_seek_ms(&pcm_file, 3) == ESP_OK);
+    assert(pcm_file.position == 132 * 3);
+    pcm_file_close(&pcm_file);
+    
+    assert(pcm_file_seek_ms(NULL, 0) == ESP_ERR_INVALID_ARG);
+    unlink(test_file);
+    printf("✓ time-based seek test passed\n");
+}
+
+// Read a whole file in odd-sized chunks with a seek in the middle
+static size_t read_with_seek(const char *path, uint16_t bit_depth, size_t block_align,
+                             size_t seek_to, uint8_t *out, size_t out_size) {
+    pcm_file_t pcm_file;
+    assert(pcm_file_open(path, &pcm_file, 44100, bit_depth, 2) == ESP_OK);
+    assert(pcm_file.direct == mock_contiguous);
+    if (block_align > 0) {
+        assert(pcm_file_set_codec(&pcm_file, PCM_CODEC_IMA_ADPCM, block_align) == ESP_OK);
+    }
+    size_t total = 0;
+    size_t bytes_read;
+    uint8_t skipped[700];
+    assert(pcm_file_read(&pcm_file, skipped, sizeof(skipped), &bytes_read) == ESP_OK);
+    assert(pcm_file_seek(&pcm_file, seek_to) == ESP_OK);
+    do {
+        size_t want = out_size - total < 1111 ? out_size - total : 1111;
+        assert(pcm_file_read(&pcm_file, out + total, want, &bytes_read) == ESP_OK);
+        total += bytes_read;
+    } while (bytes_read > 0 && total < out_size);
+    pcm_file_close(&pcm_file);
+    return total;
+}
+
+void test_pcm_file_direct() {
+    printf("Testing direct sector reads...\n");
+    
+    const size_t out_size = 64 * 1024;
+    uint8_t *via_fs = malloc(out_size);
+    uint8_t *direct = malloc(out_size);
+    
+    // Headerless raw PCM whose end is not sector aligned
+    const char* test_file = "test_audio.pcm";
+    create_test_pcm_file(test_file, 5 * SD_SECTOR_SIZE + 300);
+    size_t fs_total = read_with_seek(test_file, 16, 0, 1028, via_fs, out_size);
+    pcm_read_stats_t before;
+    pcm_file_get_read_stats(NULL, &before);
+    mock_contiguous = true;
+    mock_sector_reads = 0;
+    size_t direct_total = read_with_seek(test_file, 16, 0, 1028, direct, out_size);
+    assert(fs_total == 5 * SD_SECTOR_SIZE + 300 - 1028);
+    assert(direct_total == fs_total);
+    assert(memcmp(via_fs, direct, fs_total) == 0);
+    // Whole sectors go out in multi-sector transfers rather than one call each
+    assert(mock_sector_reads < 8);
+    pcm_read_stats_t after;
+    pcm_file_get_read_stats(NULL, &after);
+    assert(after.bytes - before.bytes == 700 + direct_total);
+    mock_contiguous = false;
+    
+    // WAV data starts mid-sector
+    uint8_t data[3000];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(i * 13 + 5);
+    }
+    write_wav_file(test_file, 1, 44100, 16, 2, 4, data, sizeof(data));
+    fs_total = read_with_seek(test_file, 16, 0, 2000, via_fs, out_size);
+    mock_contiguous = true;
+    direct_total = read_with_seek(test_file, 16, 0, 2000, direct, out_size);
+    assert(fs_total == sizeof(data) - 2000);
+    assert(direct_total == fs_total);
+    assert(memcmp(via_fs, direct, fs_total) == 0);
+    assert(memcmp(direct, data + 2000, fs_total) == 0);
+    mock_contiguous = false;
+    unlink(test_file);
+    
+    // ADPCM blocks straddle sector boundaries
+    const char* adpcm_file = "test_audio.adpcm";
+    const size_t block_align = 1024;
+    create_test_adpcm_file(adpcm_file, 2, block_align, 3);
+    fs_total = read_with_seek(adpcm_file, 4, block_align, 5000, via_fs, out_size);
+    mock_contiguous = true;
+    direct_total = read_with_seek(adpcm_file, 4, block_align, 5000, direct, out_size);
+    assert(fs_total > 0);
+    assert(direct_total == fs_total);
+    assert(memcmp(via_fs, direct, fs_total) == 0);
+    
+    // A failing card read surfaces as a read error
+    pcm_file_t pcm_file;
+    assert(pcm_file_open(adpcm_file, &pcm_file, 44100, 4, 2) == ESP_OK);
+    assert(pcm_file_set_codec(&pcm_file, PCM_CODEC_IMA_ADPCM, block_align) == ESP_OK);
+    mock_read_fail = true;
+    size_t bytes_read;
+    assert(pcm_file_read(&pcm_file, direct, 4096, &bytes_read) == ESP_FAIL);
+    mock_read_fail = false;
+    pcm_file_close(&pcm_file);
+    mock_contiguous = false;
+    unlink(adpcm_file);
+    
+    free(via_fs);
+    free(direct);
+    printf("✓ direct sector read test passed\n");
+}
+
+void test_pcm_file_prefetch() {
+    printf("Testing track-head prefetch...\n");
+    
+    const size_t out_size = 16 * 1024;
+    uint8_t *via_fs = malloc(out_size);
+    uint8_t *cached = malloc(out_size);
+    assert(track_cache_init(600) == ESP_OK);
+    
+    // Raw file longer than the head: reads and seeks cross from RAM to the file
+    const char* test_file = "test_audio.pcm";
+    create_test_pcm_file(test_file, 3000);
+    size_t fs_total = read_with_seek(test_file, 16, 0, 400, via_fs, out_size);
+    assert(track_cache_prefetch(test_file) == ESP_OK);
+    size_t cached_total = read_with_seek(test_file, 16, 0, 400, cached, out_size);
+    assert(cached_total == fs_total);
+    assert(memcmp(via_fs, cached, fs_total) == 0);
+    track_cache_stats_t stats;
+    track_cache_get_stats(&stats);
+    assert(stats.hits == 1 && stats.misses == 1);
+    
+    // Same with direct sector reads behind the head
+    mock_contiguous = true;
+    assert(track_cache_prefetch(test_file) == ESP_OK);
+    cached_total = read_with_seek(test_file, 16, 0, 400, cached, out_size);
+    assert(cached_total == fs_total);
+    assert(memcmp(via_fs, cached, fs_total) == 0);
+    mock_contiguous = false;
+    
+    // WAV header parsed from the head
+    uint8_t data[1500];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(i * 11 + 3);
+    }
+    const char* wav_file = "test_audio.wav";
+    write_wav_file(wav_file, 1, 44100, 16, 2, 4, data, sizeof(data));
+    assert(track_cache_prefetch(wav_file) == ESP_OK);
+    pcm_file_t pcm_file;
+    assert(pcm_file_open(wav_file, &pcm_file, 8000, 8, 1) == ESP_OK);
+    assert(pcm_file.head != NULL);
+    assert(pcm_file.has_header && pcm_file.pcm_size == sizeof(data));
+    size_t bytes_read;
+    assert(pcm_file_read(&pcm_file, cached, out_size, &bytes_read) == ESP_OK);
+    assert(bytes_read == sizeof(data));
+    assert(memcmp(cached, data, sizeof(data)) == 0);
+    
+    // The playing track holds its slot; the others can be filled and dropped
+    assert(track_cache_prefetch(test_file) == ESP_OK);
+    assert(track_cache_prefetch("missing.pcm") == ESP_FAIL);
+    const char *keep[2] = {wav_file, NULL};
+    track_cache_retain(keep, 2);
+    assert(track_cache_prefetch(wav_file) == ESP_OK);
+    pcm_file_close(&pcm_file);
+    assert(pcm_file_open(test_file, &pcm_file, 44100, 16, 2) == ESP_OK);
+    assert(pcm_file.head == NULL);
+    pcm_file_close(&pcm_file);
+    track_cache_get_stats(&stats);
+    assert(stats.hits == 3 && stats.misses == 2);
+    
+    assert(track_cache_init(0) == ESP_OK);
+    unlink(test_file);
+    unlink(wav_file);
+    free(via_fs);
+    free(cached);
+    printf("✓ track-head prefetch test passed\n");
+}
+
+static uint64_t fault_delay_total_us = 0;
+
+static void record_fault_delay(uint32_t us) {
+    fault_delay_total_us += us;
+}
+
+void test_pcm_file_faults() {
+    printf("Testing pcm_file reads under injected card faults...\n");
+
+    const char* test_file = "test_audio.pcm";
+    create_test_pcm_file(test_file, 64 * 1024);
+
+    // Short reads hand back fewer bytes but the stream stays intact
+    sd_fault_config_t config = {
+        .seed = 7, .latency_min_us = 100, .latency_max_us = 300,
+        .stall_min_ms = 150, .stall_max_ms = 150, .stall_every_kb = 16,
+        .short_permille = 500, .delay = record_fault_delay,
+    };
+    sd_fault_configure(&config);
+
+    pcm_file_t pcm_file;
+    assert(pcm_file_open(test_file, &pcm_file, 44100, 16, 2) == ESP_OK);
+    uint8_t buffer[4096];
+    size_t total = 0;
+    size_t bytes_read;
+    int short_reads = 0;
+    while (pcm_file_read(&pcm_file, buffer, sizeof(buffer), &bytes_read) == ESP_OK && bytes_read > 0) {
+        assert(bytes_read % SD_SECTOR_SIZE == 0);
+        if (bytes_read < sizeof(buffer)) {
+            short_reads++;
+        }
+        for (size_t i = 0; i < bytes_read; i++) {
+            assert(buffer[i] == (uint8_t)((total + i) % 256));
+        }
+        total += bytes_read;
+    }
+    assert(total == 64 * 1024);
+    assert(short_reads > 0);
+    pcm_file_close(&pcm_file);
+
+    sd_fault_stats_t stats;
+    sd_fault_get_stats(&stats);
+    // The last read may also come up short at the end of the data
+    assert(stats.short_reads > 0 && stats.short_reads <= (uint32_t)short_reads);
+    assert(stats.stalls == 4);
+    assert(fault_delay_total_us == stats.injected_us);
+    assert(stats.worst_us >= 150000);
+
+    // An injected error fails the read
+    sd_fault_config_t failing = { .error_permille = 1000, .delay = record_fault_delay };
+    sd_fault_configure(&failing);
+    assert(pcm_file_open(test_file, &pcm_file, 44100, 16, 2) == ESP_OK);
+    assert(pcm_file_read(&pcm_file, buffer, sizeof(buffer), &bytes_read) == ESP_FAIL);
+    assert(bytes_read == 0);
+    pcm_file_close(&pcm_file);
+
+    sd_fault_configure(NULL);
+    unlink(test_file);
+    printf("✓ pcm_file faults test passed\n");
+}
+
 void test_pcm_file_invalid_args() {
     printf("Testing pcm_file invalid arguments...\n");
     
@@ -162,6 +878,13 @@ int main() {
     test_pcm_file_read();
     test_pcm_file_seek();
     test_pcm_file_get_params();
+    test_pcm_file_seek_ms();
+    test_pcm_file_adpcm();
+    test_pcm_file_headers();
+    test_pcm_file_flac();
+    test_pcm_file_direct();
+    test_pcm_file_prefetch();
+    test_pcm_file_faults();
     test_pcm_file_invalid_args();
     
     printf("\n✅ All PCM file tests passed!\n");
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Mock SD card functions
+const char* sd_card_get_mount_point() { return "/test"; }
+
+#include "playlist.h"
+
+#define TEST_DIR "test_playlists"
+
+static void assert_resolves(const char *line, const char *expected) {
+    char rel_path[256];
+    bool resolved = playlist_resolve_path(line, rel_path, sizeof(rel_path));
+    if (expected == NULL) {
+        assert(!resolved);
+    } else {
+        assert(resolved);
+        assert(strcmp(rel_path, expected) == 0);
+    }
+}
+
+static void test_playlist_resolve_path() {
+    printf("Testing playlist path resolution...\n");
+
+    // Relative lines start in the playlist directory
+    assert_resolves("Mix/song.mp3", "playlists/Mix/song.mp3");
+    assert_resolves("../Pop/song1.pcm", "Pop/song1.pcm");
+    assert_resolves("./../Pop/./song1.pcm", "Pop/song1.pcm");
+    assert_resolves("..\\Rock\\song3.pcm", "Rock/song3.pcm");
+    assert_resolves("../Rock/Live/../song3.pcm", "Rock/song3.pcm");
+
+    // Absolute lines count from the music root, wherever the card was mounted
+    assert_resolves("/Pop/song1.pcm", "Pop/song1.pcm");
+    assert_resolves("/ESP32_MUSIC/Pop/song1.pcm", "Pop/song1.pcm");
+    assert_resolves("/sdcard/ESP32_MUSIC/Pop/song1.pcm", "Pop/song1.pcm");
+    assert_resolves("\\ESP32_MUSIC\\Pop\\song1.pcm", "Pop/song1.pcm");
+
+    // Comments, URLs and paths outside the music root name nothing
+    assert_resolves("", NULL);
+    assert_resolves("#EXTINF:123,Artist - Song", NULL);
+    assert_resolves("http://radio.example/stream.mp3", NULL);
+    assert_resolves("../../song.mp3", NULL);
+    assert_resolves("/..", NULL);
+
+    // A path that does not fit is rejected, not cut
+    char small[8];
+    assert(!playlist_resolve_path("../Pop/song1.pcm", small, sizeof(small)));
+
+    printf("✓ playlist path resolution test passed\n");
+}
+
+static void write_file(const char *path, const char *text) {
+    FILE *file = fopen(path, "w");
+    assert(file != NULL);
+    fputs(text, file);
+    fclose(file);
+}
+
+// Index with three tracks in two folders
+static void create_index(index_file_t *index) {
+    write_file("test_playlist_index.json",
+        "{\"version\": \"1.1\", \"allFiles\": ["
+        "{\"name\": \"song1.pcm\", \"path\": \"Pop/song1.pcm\", \"folderIndex\": 0},"
+        "{\"name\": \"song2.pcm\", \"path\": \"Pop/song2.pcm\", \"folderIndex\": 0},"
+        "{\"name\": \"song3.pcm\", \"path\": \"Rock/song3.pcm\", \"folderIndex\": 1}"
+        "], \"musicFolders\": ["
+        "{\"name\": \"Pop\", \"files\": [{\"name\": \"song1.pcm\"}, {\"name\": \"song2.pcm\"}]},"
+        "{\"name\": \"Rock\", \"files\": [{\"name\": \"song3.pcm\"}]}"
+        "]}");
+    assert(json_parse_index("test_playlist_index.json", index) == ESP_OK);
+    assert(index->total_files == 3);
+    unlink("test_playlist_index.json");
+}
+
+static void test_playlist_load_dir() {
+    printf("Testing playlist loading...\n");
+
+    index_file_t index;
+    create_index(&index);
+    mkdir(TEST_DIR, 0755);
+    write_file(TEST_DIR "/Road Trip.m3u8",
+        "\xEF\xBB\xBF#EXTM3U\r\n"
+        "#EXTINF:200,Rock Anthem\r\n"
+        "../Rock/song3.pcm\r\n"
+        "\r\n"
+        "  ../Pop/song1.pcm  \r\n"
+        "../Pop/missing.pcm\r\n"
+        "/sdcard/ESP32_MUSIC/Rock/song3.pcm\r\n");
+    write_file(TEST_DIR "/Calm.M3U", "/Pop/song2.pcm\n");
+    write_file(TEST_DIR "/Gone.m3u", "#EXTM3U\n../Jazz/song9.pcm\n");
+    write_file(TEST_DIR "/notes.txt", "../Pop/song1.pcm\n");
+
+    // Sorted by name; the playlist without a known track and other files are left out
+    playlist_set_t set;
+    assert(playlist_load_dir(TEST_DIR, &index, &set) == ESP_OK);
+    assert(set.count == 2);
+    assert(strcmp(set.lists[0].name, "Calm") == 0);
+    assert(strcmp(set.lists[1].name, "Road Trip") == 0);
+
+    // Only allFiles positions are kept, in playlist order and with repeats
+    assert(playlist_size(&set, 0) == 1);
+    assert(playlist_track(&set, 0, 0) == 1);
+    assert(playlist_size(&set, 1) == 3);
+    assert(playlist_track(&set, 1, 0) == 2);
+    assert(playlist_track(&set, 1, 1) == 0);
+    assert(playlist_track(&set, 1, 2) == 2);
+
+    // Out of range
+    assert(playlist_size(&set, 2) == 0);
+    assert(playlist_size(&set, -1) == 0);
+    assert(playlist_track(&set, 1, 3) == -1);
+    assert(playlist_track(&set, 2, 0) == -1);
+
+    playlist_free(&set);
+    assert(set.count == 0 && set.lists == NULL);
+    assert(set.arena.chunks == 0);
+
+    unlink(TEST_DIR "/Road Trip.m3u8");
+    unlink(TEST_DIR "/Calm.M3U");
+    unlink(TEST_DIR "/Gone.m3u");
+    unlink(TEST_DIR "/notes.txt");
+    rmdir(TEST_DIR);
+
+    // A card without the directory has no playlists
+    assert(playlist_load_dir(TEST_DIR, &index, &set) == ESP_OK);
+    assert(set.count == 0);
+    playlist_free(&set);
+
+    assert(playlist_load_dir(NULL, &index, &set) == ESP_ERR_INVALID_ARG);
+    json_free_index(&index);
+    printf("✓ playlist loading test passed\n");
+}
+
+int main() {
+    printf("Running playlist unit tests...\n\n");
+
+    test_playlist_resolve_path();
+    test_playlist_load_dir();
+
+    printf("\n✅ All playlist tests passed!\n");
+    return 0;
+}
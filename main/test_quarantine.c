@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "quarantine.h"
+
+static void test_quarantine_bits() {
+    printf("Testing quarantine bitmap...\n");
+
+    quarantine_t quarantine = {0};
+    assert(quarantine_init(&quarantine, 100));
+    assert(quarantine.count == 100 && quarantine.quarantined == 0);
+
+    // Word edges and the last track
+    int tracks[] = {0, 31, 32, 63, 64, 99};
+    for (size_t i = 0; i < sizeof(tracks) / sizeof(tracks[0]); i++) {
+        assert(!quarantine_contains(&quarantine, tracks[i]));
+        assert(quarantine_add(&quarantine, tracks[i]));
+        assert(quarantine_contains(&quarantine, tracks[i]));
+    }
+    assert(quarantine.quarantined == 6);
+    assert(!quarantine_add(&quarantine, 31));
+    assert(quarantine.quarantined == 6);
+    for (int track = 0; track < 100; track++) {
+        bool expected = track == 0 || track == 31 || track == 32 || track == 63 || track == 64 || track == 99;
+        assert(quarantine_contains(&quarantine, track) == expected);
+    }
+
+    // Out of range is never quarantined
+    assert(!quarantine_add(&quarantine, -1));
+    assert(!quarantine_add(&quarantine, 100));
+    assert(!quarantine_contains(&quarantine, -1));
+    assert(!quarantine_contains(&quarantine, 100));
+
+    quarantine_remove(&quarantine, 32);
+    quarantine_remove(&quarantine, 33);
+    assert(!quarantine_contains(&quarantine, 32));
+    assert(quarantine_contains(&quarantine, 31) && quarantine_contains(&quarantine, 63));
+    assert(quarantine.quarantined == 5);
+
+    quarantine_clear(&quarantine);
+    assert(quarantine.quarantined == 0);
+    for (int track = 0; track < 100; track++) {
+        assert(!quarantine_contains(&quarantine, track));
+    }
+
+    quarantine_free(&quarantine);
+    printf("✓ quarantine bitmap test passed\n");
+}
+
+static void test_quarantine_resize() {
+    printf("Testing quarantine resize...\n");
+
+    // A new index starts with a clean slate of its own size
+    quarantine_t quarantine = {0};
+    assert(quarantine_init(&quarantine, 10));
+    quarantine_add(&quarantine, 5);
+    assert(quarantine_init(&quarantine, 1000));
+    assert(quarantine.count == 1000 && quarantine.quarantined == 0);
+    assert(!quarantine_contains(&quarantine, 5));
+    assert(quarantine_add(&quarantine, 999));
+
+    // An empty index quarantines nothing
+    assert(quarantine_init(&quarantine, 0));
+    assert(quarantine.bits == NULL);
+    assert(!quarantine_add(&quarantine, 0));
+    assert(!quarantine_contains(&quarantine, 0));
+    quarantine_clear(&quarantine);
+
+    quarantine_free(&quarantine);
+    printf("✓ quarantine resize test passed\n");
+}
+
+int main() {
+    printf("Running quarantine unit tests...\n\n");
+
+    test_quarantine_bits();
+    test_quarantine_resize();
+
+    printf("\n✅ All quarantine tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "sd_fault.h"
+
+// Injected time is recorded instead of slept
+static uint64_t delayed_us = 0;
+static uint32_t delays[64];
+static int delay_count = 0;
+
+static void record_delay(uint32_t us) {
+    delayed_us += us;
+    if (delay_count < 64) {
+        delays[delay_count] = us;
+    }
+    delay_count++;
+}
+
+static void reset_delays(void) {
+    delayed_us = 0;
+    delay_count = 0;
+}
+
+void test_sd_fault_parse() {
+    printf("Testing fault profile parsing...\n");
+
+    sd_fault_config_t config;
+    assert(sd_fault_parse("latency_us=200-800,stall_ms=100-300,stall_every_kb=512,stall=5,short=20,error=1,seed=9",
+                          &config) == ESP_OK);
+    assert(config.latency_min_us == 200 && config.latency_max_us == 800);
+    assert(config.stall_min_ms == 100 && config.stall_max_ms == 300);
+    assert(config.stall_every_kb == 512);
+    assert(config.stall_permille == 5);
+    assert(config.short_permille == 20);
+    assert(config.error_permille == 1);
+    assert(config.seed == 9);
+    assert(config.delay == NULL);
+
+    // A single value sets both ends of a range
+    assert(sd_fault_parse("stall_ms=250", &config) == ESP_OK);
+    assert(config.stall_min_ms == 250 && config.stall_max_ms == 250);
+    assert(config.latency_max_us == 0);
+    assert(sd_fault_parse("", &config) == ESP_OK);
+
+    assert(sd_fault_parse("latency_us=800-200", &config) == ESP_ERR_INVALID_ARG);
+    assert(sd_fault_parse("error=1001", &config) == ESP_ERR_INVALID_ARG);
+    assert(sd_fault_parse("short=1-2", &config) == ESP_ERR_INVALID_ARG);
+    assert(sd_fault_parse("jitter=5", &config) == ESP_ERR_INVALID_ARG);
+    assert(sd_fault_parse("stall", &config) == ESP_ERR_INVALID_ARG);
+    assert(sd_fault_parse("stall_ms=x", &config) == ESP_ERR_INVALID_ARG);
+    assert(sd_fault_parse(NULL, &config) == ESP_ERR_INVALID_ARG);
+
+    printf("✓ fault profile parsing test passed\n");
+}
+
+void test_sd_fault_pass_through() {
+    printf("Testing pass-through without a profile...\n");
+
+    sd_fault_configure(NULL);
+    assert(!sd_fault_enabled());
+    size_t len = 4096;
+    assert(sd_fault_inject(SD_FAULT_READ, &len, true) == ESP_OK);
+    assert(len == 4096);
+
+    sd_fault_stats_t stats;
+    sd_fault_get_stats(&stats);
+    assert(stats.ops == 0);
+
+    printf("✓ pass-through test passed\n");
+}
+
+void test_sd_fault_latency_and_stalls() {
+    printf("Testing latency and periodic stalls...\n");
+
+    sd_fault_config_t config = {
+        .seed = 1, .latency_min_us = 200, .latency_max_us = 800,
+        .stall_min_ms = 100, .stall_max_ms = 300, .stall_every_kb = 64,
+        .delay = record_delay,
+    };
+    sd_fault_configure(&config);
+    assert(sd_fault_enabled());
+    reset_delays();
+
+    // 1 MB in 4 KB reads crosses 16 stall periods
+    for (int i = 0; i < 256; i++) {
+        size_t len = 4096;
+        assert(sd_fault_inject(SD_FAULT_READ, &len, true) == ESP_OK);
+        assert(len == 4096);
+    }
+    sd_fault_stats_t stats;
+    sd_fault_get_stats(&stats);
+    assert(stats.ops == 256);
+    assert(stats.stalls == 16);
+    assert(stats.short_reads == 0 && stats.errors == 0);
+    assert(stats.injected_us == delayed_us);
+    assert(stats.worst_us >= 100000 + 200 && stats.worst_us <= 300000 + 800);
+    assert(delayed_us >= 256 * 200ULL + 16 * 100000ULL);
+    assert(delayed_us <= 256 * 800ULL + 16 * 300000ULL);
+    for (int i = 0; i < 64; i++) {
+        assert(delays[i] >= 200);
+    }
+    // The stall lands on the read that completes each 64 KB
+    assert(delays[15] >= 100000 && delays[14] <= 800);
+
+    printf("✓ latency and periodic stalls test passed\n");
+}
+
+void test_sd_fault_short_reads_and_errors() {
+    printf("Testing short reads and errors...\n");
+
+    sd_fault_config_t config = { .seed = 3, .short_permille = 250, .error_permille = 100, .delay = record_delay };
+    sd_fault_configure(&config);
+    reset_delays();
+
+    int shorts = 0;
+    int errors = 0;
+    for (int i = 0; i < 4000; i++) {
+        size_t len = 4096;
+        if (sd_fault_inject(SD_FAULT_READ, &len, true) != ESP_OK) {
+            errors++;
+            continue;
+        }
+        assert(len >= 512 && len <= 4096 && len % 512 == 0);
+        if (len < 4096) {
+            shorts++;
+        }
+    }
+    // Roughly the configured rates
+    assert(errors > 300 && errors < 500);
+    assert(shorts > 800 && shorts < 1200);
+    assert(delay_count == 0);
+
+    // Requests that must complete, single sectors and writes keep their length
+    for (int i = 0; i < 200; i++) {
+        size_t len = 4096;
+        sd_fault_inject(SD_FAULT_READ, &len, false);
+        assert(len == 4096);
+        len = 512;
+        sd_fault_inject(SD_FAULT_READ, &len, true);
+        assert(len == 512);
+        len = 4096;
+        sd_fault_inject(SD_FAULT_WRITE, &len, true);
+        assert(len == 4096);
+    }
+
+    sd_fault_stats_t stats;
+    sd_fault_get_stats(&stats);
+    assert(stats.short_reads == (uint32_t)shorts);
+
+    printf("✓ short reads and errors test passed\n");
+}
+
+void test_sd_fault_deterministic() {
+    printf("Testing seeded repeatability...\n");
+
+    sd_fault_config_t config = {
+        .seed = 42, .latency_min_us = 0, .latency_max_us = 1000,
+        .stall_min_ms = 100, .stall_max_ms = 300, .stall_permille = 20,
+        .short_permille = 50, .error_permille = 10, .delay = record_delay,
+    };
+    uint64_t totals[2];
+    size_t lengths[2][500];
+    for (int run = 0; run < 2; run++) {
+        sd_fault_configure(&config);
+        reset_delays();
+        for (int i = 0; i < 500; i++) {
+            size_t len = 8192;
+            lengths[run][i] = sd_fault_inject(SD_FAULT_READ, &len, true) == ESP_OK ? len : 0;
+        }
+        totals[run] = delayed_us;
+    }
+    assert(totals[0] == totals[1]);
+    assert(memcmp(lengths[0], lengths[1], sizeof(lengths[0])) == 0);
+
+    // A different seed gives different faults
+    config.seed = 43;
+    sd_fault_configure(&config);
+    reset_delays();
+    for (int i = 0; i < 500; i++) {
+        size_t len = 8192;
+        sd_fault_inject(SD_FAULT_READ, &len, true);
+    }
+    assert(delayed_us != totals[0]);
+
+    sd_fault_configure(NULL);
+    printf("✓ seeded repeatability test passed\n");
+}
+
+void test_sd_fault_removal() {
+    printf("Testing card removal...\n");
+
+    // Removal fails every operation, with or without a profile, and adds no delay
+    sd_fault_config_t config = {.seed = 1, .latency_min_us = 500, .latency_max_us = 500, .delay = record_delay};
+    for (int profile = 0; profile < 2; profile++) {
+        sd_fault_configure(profile ? &config : NULL);
+        delayed_us = 0;
+        sd_fault_set_removed(true);
+        assert(sd_fault_removed());
+        size_t len = 4096;
+        assert(sd_fault_inject(SD_FAULT_READ, &len, true) == ESP_FAIL);
+        assert(sd_fault_inject(SD_FAULT_WRITE, &len, false) == ESP_FAIL);
+        assert(len == 4096 && delayed_us == 0);
+
+        sd_fault_set_removed(false);
+        assert(!sd_fault_removed());
+        assert(sd_fault_inject(SD_FAULT_READ, &len, true) == ESP_OK);
+        sd_fault_stats_t stats;
+        sd_fault_get_stats(&stats);
+        assert(stats.ops == (profile ? 1 : 0) && stats.errors == 0);
+    }
+
+    sd_fault_configure(NULL);
+    printf("✓ card removal test passed\n");
+}
+
+int main() {
+    printf("Running SD fault injection unit tests...\n\n");
+
+    test_sd_fault_parse();
+    test_sd_fault_pass_through();
+    test_sd_fault_latency_and_stalls();
+    test_sd_fault_short_reads_and_errors();
+    test_sd_fault_deterministic();
+    test_sd_fault_removal();
+
+    printf("\n✅ All SD fault injection tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "shuffle.h"
+
+// Every position maps to a distinct track and back again
+static void check_permutation(uint32_t seed, uint32_t count) {
+    shuffle_t shuffle;
+    shuffle_init(&shuffle, seed, count);
+    uint8_t *seen = calloc(count > 0 ? count : 1, 1);
+    assert(seen != NULL);
+    for (uint32_t pos = 0; pos < count; pos++) {
+        uint32_t index = shuffle_index_at(&shuffle, pos);
+        assert(index < count);
+        assert(!seen[index]);
+        seen[index] = 1;
+        assert(shuffle_position_of(&shuffle, index) == pos);
+    }
+    free(seen);
+}
+
+void test_shuffle_permutation() {
+    printf("Testing shuffle permutation...\n");
+
+    for (uint32_t count = 0; count <= 300; count++) {
+        check_permutation(0x12345678, count);
+        check_permutation(count * 2654435761u, count);
+    }
+    // Sizes just past a power of two walk the most
+    check_permutation(7, 1025);
+    check_permutation(7, 65537);
+    check_permutation(42, 100000);
+
+    printf("✓ shuffle permutation test passed\n");
+}
+
+void test_shuffle_seed() {
+    printf("Testing shuffle seeds...\n");
+
+    // The same seed always deals the same order
+    shuffle_t a, b;
+    shuffle_init(&a, 1234, 500);
+    shuffle_init(&b, 1234, 500);
+    for (uint32_t pos = 0; pos < 500; pos++) {
+        assert(shuffle_index_at(&a, pos) == shuffle_index_at(&b, pos));
+    }
+
+    // Another seed deals another order
+    shuffle_init(&b, 1235, 500);
+    int same = 0;
+    for (uint32_t pos = 0; pos < 500; pos++) {
+        same += shuffle_index_at(&a, pos) == shuffle_index_at(&b, pos);
+    }
+    assert(same < 50);
+
+    // The order is actually mixed up
+    int fixed = 0;
+    for (uint32_t pos = 0; pos < 500; pos++) {
+        fixed += shuffle_index_at(&a, pos) == pos;
+    }
+    assert(fixed < 50);
+
+    // Out of range positions and tracks
+    assert(shuffle_index_at(&a, 500) == 0);
+    assert(shuffle_position_of(&a, 500) == 0);
+    shuffle_init(&a, 1234, 0);
+    assert(shuffle_index_at(&a, 0) == 0);
+
+    printf("✓ shuffle seed test passed\n");
+}
+
+// Every track comes up about equally often at the first position
+void test_shuffle_uniformity() {
+    printf("Testing shuffle uniformity...\n");
+
+    enum { COUNT = 10, SEEDS = 20000 };
+    int first[COUNT] = {0};
+    shuffle_t shuffle;
+    for (uint32_t seed = 0; seed < SEEDS; seed++) {
+        shuffle_init(&shuffle, seed * 2654435761u, COUNT);
+        first[shuffle_index_at(&shuffle, 0)]++;
+    }
+    for (int i = 0; i < COUNT; i++) {
+        printf("  track %d first: %d\n", i, first[i]);
+        assert(first[i] > SEEDS / COUNT * 8 / 10);
+        assert(first[i] < SEEDS / COUNT * 12 / 10);
+    }
+
+    printf("✓ shuffle uniformity test passed\n");
+}
+
+int main() {
+    printf("Running shuffle unit tests...\n\n");
+
+    test_shuffle_permutation();
+    test_shuffle_seed();
+    test_shuffle_uniformity();
+
+    printf("\n✅ All shuffle tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "track_order.h"
+
+static void set_track(file_entry_t *file, const char *artist, const char *album, int folder) {
+    strcpy(file->artist, artist);
+    strcpy(file->album, album);
+    file->folder_index = folder;
+}
+
+static void test_track_order_sort() {
+    printf("Testing track orders...\n");
+
+    file_entry_t *files = calloc(7, sizeof(file_entry_t));
+    assert(files != NULL);
+    set_track(&files[0], "Zed", "Blue", 0);
+    set_track(&files[1], "abba", "Gold", 1);
+    set_track(&files[2], "Zed", "Amber", 2);
+    set_track(&files[3], "", "Blue", 0);
+    set_track(&files[4], "ABBA", "gold", 1);
+    set_track(&files[5], "Zed", "Blue", 3);
+    set_track(&files[6], "Mo", "", 4);
+
+    track_order_t order = {0};
+    assert(track_order_build(&order, files, 7) == ESP_OK);
+    assert(order.count == 7 && !order.wide);
+
+    // Artist, then album, then index order; no artist comes last
+    int by_artist[] = {1, 4, 6, 2, 0, 5, 3};
+    for (int rank = 0; rank < 7; rank++) {
+        assert(track_order_at(&order, TRACK_ORDER_ARTIST, rank) == by_artist[rank]);
+        assert(track_order_rank_of(&order, TRACK_ORDER_ARTIST, by_artist[rank]) == rank);
+    }
+
+    // Album, then folder: the two folders holding "Blue" are two albums
+    int by_album[] = {2, 0, 3, 5, 1, 4, 6};
+    for (int rank = 0; rank < 7; rank++) {
+        assert(track_order_at(&order, TRACK_ORDER_ALBUM, rank) == by_album[rank]);
+    }
+    assert(order.album_count == 5);
+    uint32_t album_first[] = {0, 1, 3, 4, 6, 7};
+    assert(memcmp(order.album_first, album_first, sizeof(album_first)) == 0);
+    int album_of[] = {0, 1, 1, 2, 3, 3, 4};
+    for (int rank = 0; rank < 7; rank++) {
+        assert(track_order_album_of(&order, rank) == album_of[rank]);
+    }
+
+    // Out of range
+    assert(track_order_at(&order, TRACK_ORDER_ALBUM, 7) == -1);
+    assert(track_order_at(&order, TRACK_ORDER_ARTIST, -1) == -1);
+    assert(track_order_rank_of(&order, TRACK_ORDER_ALBUM, 7) == -1);
+    assert(track_order_album_of(&order, 7) == -1);
+
+    track_order_free(&order);
+    assert(order.count == 0 && order.album_count == 0);
+    assert(track_order_at(&order, TRACK_ORDER_ARTIST, 0) == -1);
+
+    // An empty index has no orders
+    assert(track_order_build(&order, files, 0) == ESP_OK);
+    assert(order.count == 0);
+    free(files);
+    printf("✓ track orders test passed\n");
+}
+
+static void test_track_order_wide() {
+    printf("Testing wide track orders...\n");
+
+    // Past 65536 tracks the entries widen to 32 bits
+    int count = 70000;
+    file_entry_t *files = calloc(count, sizeof(file_entry_t));
+    assert(files != NULL);
+    for (int i = 0; i < count; i++) {
+        snprintf(files[i].artist, sizeof(files[i].artist), "Artist %02d", (count - 1 - i) % 100);
+        snprintf(files[i].album, sizeof(files[i].album), "Album %05d", i / 10);
+        files[i].folder_index = i / 10;
+    }
+
+    track_order_t order = {0};
+    assert(track_order_build(&order, files, count) == ESP_OK);
+    assert(order.wide);
+    assert(order.album_count == count / 10);
+    assert(track_order_at(&order, TRACK_ORDER_ARTIST, 0) == 99);
+    assert(track_order_at(&order, TRACK_ORDER_ARTIST, count - 1) == count - 100);
+    assert(track_order_at(&order, TRACK_ORDER_ALBUM, 65537) == 65537);
+    assert(track_order_album_of(&order, 65537) == 6553);
+    for (int rank = 1; rank < count; rank++) {
+        int a = track_order_at(&order, TRACK_ORDER_ARTIST, rank - 1);
+        int b = track_order_at(&order, TRACK_ORDER_ARTIST, rank);
+        assert(strcmp(files[a].artist, files[b].artist) <= 0);
+    }
+
+    track_order_free(&order);
+    free(files);
+    printf("✓ wide track orders test passed\n");
+}
+
+int main() {
+    printf("Running track order unit tests...\n\n");
+
+    test_track_order_sort();
+    test_track_order_wide();
+
+    printf("\n✅ All track order tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include "track_cache.h"
+#include "mem_policy.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef TEST_MODE
+#include "esp_log.h"
+#else
+#define ESP_LOGI(tag, format, ...) printf("[INFO] " format "\n", ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) printf("[WARN] " format "\n", ##__VA_ARGS__)
+#define ESP_LOGE(tag, format, ...) printf("[ERROR] " format "\n", ##__VA_ARGS__)
+#endif
+
+static const char *TAG = "track_cache";
+
+// A slot is idle while it only holds a prefetched track and taken while its
+// head is being played; the file handle leaves the slot when it is taken
+typedef struct {
+    bool valid;
+    bool taken;
+    char path[256];
+    FILE *file;
+    uint8_t *head;
+    size_t head_len;
+    size_t file_size;
+} cache_slot_t;
+
+static cache_slot_t slots[TRACK_CACHE_SLOTS];
+static uint8_t *head_pool = NULL;
+static size_t head_size = 0;
+static track_cache_stats_t stats;
+
+static void drop_slot(cache_slot_t *slot) {
+    if (slot->file != NULL) {
+        fclose(slot->file);
+        slot->file = NULL;
+    }
+    slot->valid = false;
+}
+
+static cache_slot_t *find_slot(const char *path) {
+    for (int i = 0; i < TRACK_CACHE_SLOTS; i++) {
+        if (slots[i].valid && !slots[i].taken && strcmp(slots[i].path, path) == 0) {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t track_cache_init(size_t size) {
+    for (int i = 0; i < TRACK_CACHE_SLOTS; i++) {
+        drop_slot(&slots[i]);
+        slots[i].taken = false;
+    }
+    mem_free(head_pool);
+    head_pool = NULL;
+    head_size = 0;
+    memset(&stats, 0, sizeof(stats));
+    if (size == 0) {
+        return ESP_OK;
+    }
+
+    head_pool = mem_alloc(MEM_BULK, size * TRACK_CACHE_SLOTS);
+    if (head_pool == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes for the track cache", (unsigned)(size * TRACK_CACHE_SLOTS));
+        return ESP_FAIL;
+    }
+    head_size = size;
+    for (int i = 0; i < TRACK_CACHE_SLOTS; i++) {
+        slots[i].head = head_pool + i * size;
+    }
+    ESP_LOGI(TAG, "Track cache: %d slots of %u bytes", TRACK_CACHE_SLOTS, (unsigned)size);
+    return ESP_OK;
+}
+
+void track_cache_retain(const char *const *paths, size_t count) {
+    for (int i = 0; i < TRACK_CACHE_SLOTS; i++) {
+        if (!slots[i].valid || slots[i].taken) {
+            continue;
+        }
+        bool wanted = false;
+        for (size_t j = 0; j < count && !wanted; j++) {
+            wanted = paths[j] != NULL && strcmp(slots[i].path, paths[j]) == 0;
+        }
+        if (!wanted) {
+            drop_slot(&slots[i]);
+        }
+    }
+}
+
+esp_err_t track_cache_prefetch(const char *path) {
+    if (head_size == 0 || path == NULL) {
+        return ESP_FAIL;
+    }
+    if (find_slot(path) != NULL) {
+        return ESP_OK;
+    }
+
+    cache_slot_t *slot = NULL;
+    for (int i = 0; i < TRACK_CACHE_SLOTS && slot == NULL; i++) {
+        if (!slots[i].valid && !slots[i].taken) {
+            slot = &slots[i];
+        }
+    }
+    if (slot == NULL) {
+        return ESP_FAIL;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        ESP_LOGW(TAG, "Cannot prefetch %s", path);
+        return ESP_FAIL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    size_t n = fread(slot->head, 1, head_size, file);
+    if (size < 0 || ferror(file)) {
+        fclose(file);
+        return ESP_FAIL;
+    }
+
+    strncpy(slot->path, path, sizeof(slot->path) - 1);
+    slot->path[sizeof(slot->path) - 1] = '\0';
+    slot->file = file;
+    slot->head_len = n;
+    slot->file_size = (size_t)size;
+    slot->valid = true;
+    return ESP_OK;
+}
+
+bool track_cache_take(const char *path, track_cache_entry_t *entry) {
+    if (head_size == 0) {
+        return false;
+    }
+    cache_slot_t *slot = find_slot(path);
+    if (slot == NULL) {
+        stats.misses++;
+        return false;
+    }
+    stats.hits++;
+    slot->taken = true;
+    entry->file = slot->file;
+    entry->head = slot->head;
+    entry->head_len = slot->head_len;
+    entry->file_size = slot->file_size;
+    slot->file = NULL;
+    return true;
+}
+
+void track_cache_release(const uint8_t *head) {
+    if (head == NULL) {
+        return;
+    }
+    for (int i = 0; i < TRACK_CACHE_SLOTS; i++) {
+        if (slots[i].taken && slots[i].head == head) {
+            slots[i].taken = false;
+            slots[i].valid = false;
+        }
+    }
+}
+
+void track_cache_get_stats(track_cache_stats_t *out) {
+    *out = stats;
+}
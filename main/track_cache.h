@@ -0,0 +1,99 @@
+#ifndef TRACK_CACHE_H
+#define TRACK_CACHE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef TEST_MODE
+#include "esp_err.h"
+#else
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG -2
+#endif
+
+// Bytes kept from the start of each prefetched track (about 90 ms at 44.1 kHz
+// 16-bit stereo, enough to cover opening the next track). Override at build time.
+#ifndef TRACK_CACHE_HEAD_SIZE
+#define TRACK_CACHE_HEAD_SIZE   (16 * 1024)
+#endif
+
+// Head size when the slots live in PSRAM
+#define TRACK_CACHE_HEAD_SIZE_PSRAM (4 * TRACK_CACHE_HEAD_SIZE)
+
+// The likely next and previous tracks, plus one slot still held by the
+// playing track when it was itself a cache hit
+#define TRACK_CACHE_SLOTS       3
+
+// A prefetched track handed over to its reader
+typedef struct {
+    FILE *file;                 // Open handle, positioned at head_len
+    const uint8_t *head;        // First head_len bytes of the file
+    size_t head_len;
+    size_t file_size;
+} track_cache_entry_t;
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+} track_cache_stats_t;
+
+/**
+ * @brief Allocate the cache slots
+ *
+ * All functions are meant to be called from the player task only.
+ *
+ * @param head_size Bytes to keep per track, 0 to disable the cache
+ * @return ESP_OK on success, ESP_FAIL if the slots cannot be allocated
+ */
+esp_err_t track_cache_init(size_t head_size);
+
+/**
+ * @brief Drop idle tracks that are not in the given list
+ *
+ * @param paths Full paths of the tracks to keep
+ * @param count Number of paths
+ */
+void track_cache_retain(const char *const *paths, size_t count);
+
+/**
+ * @brief Open a track and read its head into a free slot
+ *
+ * Blocks for the SD transfer; callers prefetch one track at a time between
+ * audio buffers.
+ *
+ * @param path Full path of the track
+ * @return ESP_OK if the track is cached, ESP_FAIL if no slot is free or the file cannot be read
+ */
+esp_err_t track_cache_prefetch(const char *path);
+
+/**
+ * @brief Take a cached track; counts a hit or a miss
+ *
+ * The file handle belongs to the caller from here on. The head stays valid
+ * until track_cache_release().
+ *
+ * @param path Full path of the track
+ * @param entry Pointer to store the cached track
+ * @return true on a hit
+ */
+bool track_cache_take(const char *path, track_cache_entry_t *entry);
+
+/**
+ * @brief Return the slot of a taken head to the cache
+ *
+ * @param head Head from track_cache_take(); NULL is ignored
+ */
+void track_cache_release(const uint8_t *head);
+
+/**
+ * @brief Get hit and miss counts since init
+ *
+ * @param stats Pointer to store the counts
+ */
+void track_cache_get_stats(track_cache_stats_t *stats);
+
+#endif // TRACK_CACHE_H
@@ -0,0 +1,159 @@
+#include "track_order.h"
+#include "mem_policy.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// Index sorted by the comparators; qsort passes no context
+static const file_entry_t *sort_files;
+
+// Case-insensitive, with empty names after every other name
+static int compare_names(const char *a, const char *b) {
+    if (a[0] == '\0' || b[0] == '\0') {
+        return (a[0] == '\0') - (b[0] == '\0');
+    }
+    return strcasecmp(a, b);
+}
+
+static int compare_positions(uint32_t a, uint32_t b) {
+    return (a > b) - (a < b);
+}
+
+static int compare_artist(const void *pa, const void *pb) {
+    uint32_t a = *(const uint32_t *)pa, b = *(const uint32_t *)pb;
+    int diff = compare_names(sort_files[a].artist, sort_files[b].artist);
+    if (diff == 0) {
+        diff = compare_names(sort_files[a].album, sort_files[b].album);
+    }
+    return diff != 0 ? diff : compare_positions(a, b);
+}
+
+// Albums of the same name in different folders stay apart
+static int compare_album(const void *pa, const void *pb) {
+    uint32_t a = *(const uint32_t *)pa, b = *(const uint32_t *)pb;
+    int diff = compare_names(sort_files[a].album, sort_files[b].album);
+    if (diff == 0) {
+        diff = (sort_files[a].folder_index > sort_files[b].folder_index) -
+               (sort_files[a].folder_index < sort_files[b].folder_index);
+    }
+    return diff != 0 ? diff : compare_positions(a, b);
+}
+
+static bool same_album(const file_entry_t *a, const file_entry_t *b) {
+    return a->folder_index == b->folder_index && strcasecmp(a->album, b->album) == 0;
+}
+
+// Sort into scratch and keep the result at the width of the order
+static bool sort_into(track_order_t *order, track_order_key_t key, uint32_t *scratch,
+                      int (*compare)(const void *, const void *)) {
+    uint32_t *sorted = order->wide ? mem_alloc(MEM_BULK, order->count * sizeof(uint32_t)) : scratch;
+    if (sorted == NULL) {
+        return false;
+    }
+    for (int i = 0; i < order->count; i++) {
+        sorted[i] = i;
+    }
+    qsort(sorted, order->count, sizeof(uint32_t), compare);
+    if (order->wide) {
+        order->ranks[key] = sorted;
+        return true;
+    }
+    uint16_t *narrow = mem_alloc(MEM_BULK, order->count * sizeof(uint16_t));
+    if (narrow == NULL) {
+        return false;
+    }
+    for (int i = 0; i < order->count; i++) {
+        narrow[i] = (uint16_t)sorted[i];
+    }
+    order->ranks[key] = narrow;
+    return true;
+}
+
+// Record where each run of one album starts in the album order
+static bool find_albums(track_order_t *order, const file_entry_t *files) {
+    int albums = 0;
+    for (int rank = 0; rank < order->count; rank++) {
+        albums += rank == 0 || !same_album(&files[track_order_at(order, TRACK_ORDER_ALBUM, rank - 1)],
+                                           &files[track_order_at(order, TRACK_ORDER_ALBUM, rank)]);
+    }
+    order->album_first = mem_alloc(MEM_BULK, (albums + 1) * sizeof(uint32_t));
+    if (order->album_first == NULL) {
+        return false;
+    }
+    int album = 0;
+    for (int rank = 0; rank < order->count; rank++) {
+        if (rank == 0 || !same_album(&files[track_order_at(order, TRACK_ORDER_ALBUM, rank - 1)],
+                                     &files[track_order_at(order, TRACK_ORDER_ALBUM, rank)])) {
+            order->album_first[album++] = rank;
+        }
+    }
+    order->album_first[albums] = order->count;
+    order->album_count = albums;
+    return true;
+}
+
+esp_err_t track_order_build(track_order_t *order, const file_entry_t *files, int count) {
+    track_order_free(order);
+    if (files == NULL || count <= 0) {
+        return ESP_OK;
+    }
+    order->count = count;
+    order->wide = count > UINT16_MAX + 1;
+    uint32_t *scratch = order->wide ? NULL : mem_alloc(MEM_BULK, count * sizeof(uint32_t));
+    bool ok = order->wide || scratch != NULL;
+
+    sort_files = files;
+    ok = ok && sort_into(order, TRACK_ORDER_ARTIST, scratch, compare_artist);
+    ok = ok && sort_into(order, TRACK_ORDER_ALBUM, scratch, compare_album);
+    sort_files = NULL;
+    mem_free(scratch);
+    if (!ok || !find_albums(order, files)) {
+        track_order_free(order);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void track_order_free(track_order_t *order) {
+    for (int key = 0; key < TRACK_ORDER_MAX; key++) {
+        mem_free(order->ranks[key]);
+        order->ranks[key] = NULL;
+    }
+    mem_free(order->album_first);
+    order->album_first = NULL;
+    order->album_count = 0;
+    order->count = 0;
+}
+
+int track_order_at(const track_order_t *order, track_order_key_t key, int rank) {
+    if (key >= TRACK_ORDER_MAX || rank < 0 || rank >= order->count) {
+        return -1;
+    }
+    return order->wide ? (int)((const uint32_t *)order->ranks[key])[rank] : ((const uint16_t *)order->ranks[key])[rank];
+}
+
+int track_order_rank_of(const track_order_t *order, track_order_key_t key, int position) {
+    for (int rank = 0; rank < order->count; rank++) {
+        if (track_order_at(order, key, rank) == position) {
+            return rank;
+        }
+    }
+    return -1;
+}
+
+int track_order_album_of(const track_order_t *order, int rank) {
+    if (rank < 0 || rank >= order->count) {
+        return -1;
+    }
+    // The last album starting at or before the rank
+    int low = 0, high = order->album_count - 1;
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if ((int)order->album_first[mid] <= rank) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
@@ -0,0 +1,74 @@
+#ifndef TRACK_ORDER_H
+#define TRACK_ORDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "json_parser.h"
+
+// Orders the index is sorted into
+typedef enum {
+    TRACK_ORDER_ARTIST = 0,     // Artist, album, then index order
+    TRACK_ORDER_ALBUM,          // Album, folder, then index order
+    TRACK_ORDER_MAX
+} track_order_key_t;
+
+// Sort permutations of allFiles. A rank is a place in an order and maps to an
+// allFiles position; below 65536 tracks the entries take two bytes each.
+typedef struct {
+    int count;                          // Tracks in each order, 0 if none were built
+    bool wide;                          // Entries are uint32_t, uint16_t otherwise
+    void *ranks[TRACK_ORDER_MAX];       // allFiles position at each rank
+    uint32_t *album_first;              // Album order rank of each album's first track, album_count + 1 entries
+    int album_count;
+} track_order_t;
+
+/**
+ * @brief Sort the tracks by artist and by album
+ *
+ * Frees the previous orders. Names compare without case and empty names
+ * sort last. Runs once per index load, in O(n log n).
+ *
+ * @param order Orders, zeroed before their first use
+ * @param files allFiles, in memory
+ * @param count Number of tracks
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the arrays do not fit; no orders are kept then
+ */
+esp_err_t track_order_build(track_order_t *order, const file_entry_t *files, int count);
+
+/**
+ * @brief Free the orders
+ */
+void track_order_free(track_order_t *order);
+
+/**
+ * @brief Track at a rank, in constant time
+ *
+ * @param order Orders
+ * @param key Order to look in
+ * @param rank Rank in [0, count)
+ * @return allFiles position, -1 if out of range
+ */
+int track_order_at(const track_order_t *order, track_order_key_t key, int rank);
+
+/**
+ * @brief Rank of a track (inverse of track_order_at)
+ *
+ * Scans the order; meant for jumps and mode changes, not for stepping.
+ *
+ * @param order Orders
+ * @param key Order to look in
+ * @param position allFiles position
+ * @return Rank, -1 if not found
+ */
+int track_order_rank_of(const track_order_t *order, track_order_key_t key, int position);
+
+/**
+ * @brief Album holding a rank of the album order
+ *
+ * @param order Orders
+ * @param rank Rank in [0, count)
+ * @return Album number, -1 if out of range
+ */
+int track_order_album_of(const track_order_t *order, int rank);
+
+#endif // TRACK_ORDER_H
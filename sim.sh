@@ -0,0 +1,18 @@
+#!/bin/sh
+set -e
+
+echo "Building the host simulator..."
+gcc -O2 -I./main -DTEST_MODE -DHOST_SIM -o main/sim_player main/sim_player.c main/audio_player.c main/audio_dsp.c main/shuffle.c main/quarantine.c main/playlist.c main/track_order.c main/boot_profile.c main/track_cache.c main/mem_policy.c main/pcm_file.c main/ima_adpcm.c main/flac_decoder.c main/json_parser.c main/index_cache.c main/library_scanner.c main/mp3_frame.c main/sd_fault.c -lm -lpthread
+
+echo "Playing a generated library at 2x real time..."
+# Skipping every 3 s crosses tracks and sample rates. Host scheduling adds a
+# few ms per gap at this speed, so the limit only catches stalls on the
+# track-change path.
+./main/sim_player -r sim_library -o sim_output.wav -t 12 -s 2 -n 3 -u 100 -g > sim_log.txt
+tail -n 6 sim_log.txt
+
+echo "Pulling the card for 2 s and putting it back..."
+# The player unmounts, polls for the card, remounts it, reloads the index
+# and resumes; the output shows one gap about as long as the card was out.
+./main/sim_player -r sim_library -o sim_output.wav -t 8 -s 2 -e 3,2 > sim_log.txt
+grep -e "^Gaps" -e "^Card" sim_log.txt
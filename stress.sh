@@ -0,0 +1,36 @@
+#!/bin/sh
+set -e
+
+# Underruns against output buffer depth, with and without card faults.
+# STRESS_PROFILE and STRESS_SECONDS override the fault profile and run length.
+PROFILE=${STRESS_PROFILE:-latency_us=200-800,stall_ms=100-300,stall_every_kb=512,stall=2,short=20,error=1}
+SECONDS_PER_RUN=${STRESS_SECONDS:-12}
+BUFFERS_MS="33 50 100 200 300 400"
+
+echo "Building the host simulator..."
+gcc -O2 -I./main -DTEST_MODE -DHOST_SIM -o main/sim_player main/sim_player.c main/audio_player.c main/audio_dsp.c main/shuffle.c main/quarantine.c main/playlist.c main/track_order.c main/boot_profile.c main/track_cache.c main/mem_policy.c main/pcm_file.c main/ima_adpcm.c main/flac_decoder.c main/json_parser.c main/index_cache.c main/library_scanner.c main/mp3_frame.c main/sd_fault.c -lm -lpthread
+
+# Gaps: N, T ms in total, worst W ms  ->  "N T W"
+gaps() {
+    sed -n 's/^Gaps: \([0-9]*\), \([0-9.]*\) ms in total, worst \([0-9.]*\) ms$/\1 \2 \3/p' "$1"
+}
+
+run() {
+    ./main/sim_player -r sim_library -o sim_output.wav -t "$SECONDS_PER_RUN" -s 2 -b "$1" $2 > sim_log.txt || true
+}
+
+echo "Fault profile: $PROFILE"
+echo "$SECONDS_PER_RUN s of audio per run at 2x real time"
+./main/sim_player -r sim_library -o sim_output.wav -t 1 -s 0 -g > /dev/null
+printf "\n%10s | %-28s | %-28s\n" "buffer ms" "underruns, no faults" "underruns, with faults"
+printf "%10s | %8s %9s %9s | %8s %9s %9s\n" "" "count" "total ms" "worst ms" "count" "total ms" "worst ms"
+for buffer in $BUFFERS_MS; do
+    run "$buffer" ""
+    clean=$(gaps sim_log.txt)
+    run "$buffer" "-f $PROFILE"
+    faulty=$(gaps sim_log.txt)
+    # shellcheck disable=SC2086
+    printf "%10s | %8s %9s %9s | %8s %9s %9s\n" "$buffer" $clean $faulty
+done
+printf "\nLast run with faults: "
+grep "^Card faults" sim_log.txt || echo "no report"
@@ -5,16 +5,64 @@ echo "Building and running button handler unit tests..."
 gcc -o main/test_button_handler main/test_button_handler.c
 ./main/test_button_handler
 
+echo "Building and running button timing tests..."
+gcc -I./main -o main/test_button_timing main/test_button_timing.c main/button_handler.c components/ezbutton/ezbutton.c -DTEST_MODE
+./main/test_button_timing
+
 echo "Building and running PCM file unit tests..."
-gcc -I./main -o main/test_pcm_file main/test_pcm_file.c main/pcm_file.c -DTEST_MODE
+gcc -I./main -o main/test_pcm_file main/test_pcm_file.c main/test_flac_encoder.c main/pcm_file.c main/track_cache.c main/mem_policy.c main/ima_adpcm.c main/flac_decoder.c main/mp3_frame.c main/sd_fault.c -DTEST_MODE -lm
 ./main/test_pcm_file
 
+echo "Building and running MP3 frame unit tests..."
+gcc -I./main -o main/test_mp3_frame main/test_mp3_frame.c main/mp3_frame.c
+./main/test_mp3_frame
+
+echo "Building and running SD fault injection unit tests..."
+gcc -I./main -o main/test_sd_fault main/test_sd_fault.c main/sd_fault.c -DTEST_MODE
+./main/test_sd_fault
+
+echo "Building and running shuffle unit tests..."
+gcc -I./main -o main/test_shuffle main/test_shuffle.c main/shuffle.c
+./main/test_shuffle
+
+echo "Building and running quarantine unit tests..."
+gcc -I./main -o main/test_quarantine main/test_quarantine.c main/quarantine.c main/mem_policy.c -DTEST_MODE
+./main/test_quarantine
+
+echo "Building and running memory policy unit tests..."
+gcc -I./main -o main/test_mem_policy main/test_mem_policy.c main/mem_policy.c -DTEST_MODE
+./main/test_mem_policy
+
 echo "Building and running JSON parser unit tests..."
-gcc -I./main -o main/test_json_parser main/test_json_parser.c main/json_parser.c -DTEST_MODE
+gcc -I./main -o main/test_json_parser main/test_json_parser.c main/json_parser.c main/mem_policy.c -DTEST_MODE
 ./main/test_json_parser
 
+echo "Building and running track order unit tests..."
+gcc -I./main -o main/test_track_order main/test_track_order.c main/track_order.c main/mem_policy.c -DTEST_MODE
+./main/test_track_order
+
+echo "Building and running playlist unit tests..."
+gcc -I./main -o main/test_playlist main/test_playlist.c main/playlist.c main/json_parser.c main/mem_policy.c -DTEST_MODE
+./main/test_playlist
+
+echo "Building and running index cache unit tests..."
+gcc -I./main -o main/test_index_cache main/test_index_cache.c main/index_cache.c main/json_parser.c main/mem_policy.c -DTEST_MODE
+./main/test_index_cache
+
+echo "Building and running library scanner unit tests..."
+gcc -I./main -o main/test_library_scanner main/test_library_scanner.c main/library_scanner.c main/json_parser.c main/mem_policy.c main/mp3_frame.c -DTEST_MODE
+./main/test_library_scanner
+
+echo "Building and running audio DSP unit tests..."
+gcc -I./main -o main/test_audio_dsp main/test_audio_dsp.c main/audio_dsp.c -DTEST_MODE -lm
+./main/test_audio_dsp
+
+echo "Building and running boot profile unit tests..."
+gcc -I./main -o main/test_boot_profile main/test_boot_profile.c main/boot_profile.c main/mem_policy.c -DTEST_MODE
+./main/test_boot_profile
+
 echo "Building and running Audio Player unit tests..."
-gcc -I./main -o main/test_audio_player main/test_audio_player.c main/audio_player.c -DTEST_MODE
+gcc -I./main -o main/test_audio_player main/test_audio_player.c main/audio_player.c main/audio_dsp.c main/shuffle.c main/quarantine.c main/playlist.c main/track_order.c main/boot_profile.c main/track_cache.c main/mem_policy.c -DTEST_MODE -lm
 ./main/test_audio_player
 
 echo "All tests passed!"